@@ -18,7 +18,7 @@
 TEMPLATE = app
 TARGET = VPaint
 CONFIG += qt c++11
-QT += opengl openglextensions network
+QT += opengl openglextensions network concurrent
 
 # App version
 #
@@ -117,6 +117,7 @@ INCLUDEPATH += $$PWD/../
 HEADERS += ../VAC/MainWindow.h \
     ../VAC/SaveAndLoad.h \
     ../VAC/Picking.h \
+    ../VAC/Profiler.h \
     ../VAC/Random.h \
     ../VAC/GLUtils.h \
     ../VAC/GLWidget.h \
@@ -156,6 +157,7 @@ HEADERS += ../VAC/MainWindow.h \
     ../VAC/VectorAnimationComplex/Operators.h \
     ../VAC/VectorAnimationComplex/Operator.h \
     ../VAC/VectorAnimationComplex/SculptCurve.h \
+    ../VAC/VectorAnimationComplex/PlanarArrangement.h \
     ../VAC/VectorAnimationComplex/ProperCycle.h \
     ../VAC/VectorAnimationComplex/ProperPath.h \
     ../VAC/VectorAnimationComplex/CycleHelper.h \
@@ -165,6 +167,7 @@ HEADERS += ../VAC/MainWindow.h \
     ../VAC/VectorAnimationComplex/SmartKeyEdgeSet.h \
     ../VAC/OpenGL.h \
     ../VAC/VectorAnimationComplex/Triangles.h \
+    ../VAC/VectorAnimationComplex/Rasterizer.h \
     ../VAC/SelectionInfoWidget.h \
     ../VAC/VectorAnimationComplex/Cycle.h \
     ../VAC/VectorAnimationComplex/Path.h \
@@ -176,8 +179,17 @@ HEADERS += ../VAC/MainWindow.h \
     ../VAC/ViewSettings.h \
     ../VAC/View3DSettings.h \
     ../VAC/ObjectPropertiesWidget.h \
+    ../VAC/OnionSkinCache.h \
+    ../VAC/SpaceTimeSurfaceCache.h \
+    ../VAC/MeshWriter.h \
+    ../VAC/SvgWriter.h \
+    ../VAC/InputRecorder.h \
+    ../VAC/DamageTracker.h \
     ../VAC/AnimatedCycleWidget.h \
     ../VAC/VectorAnimationComplex/CellObserver.h \
+    ../VAC/VectorAnimationComplex/CellPool.h \
+    ../VAC/VectorAnimationComplex/CellStore.h \
+    ../VAC/VectorAnimationComplex/TimeIndex.h \
     ../VAC/Color.h \
     ../VAC/DevSettings.h \
     ../VAC/Settings.h \
@@ -195,9 +207,12 @@ HEADERS += ../VAC/MainWindow.h \
     ../VAC/EditCanvasSizeDialog.h \
     ../VAC/ExportPngDialog.h \
     ../VAC/AboutDialog.h \
+    ../VAC/Benchmark.h \
+    ../VAC/DocumentSaver.h \
     ../VAC/ViewWidget.h \
     ../VAC/Background/Background.h \
     ../VAC/Background/BackgroundData.h \
+    ../VAC/Background/BackgroundImageCache.h \
     ../VAC/Background/BackgroundRenderer.h \
     ../VAC/Background/BackgroundWidget.h \
     ../VAC/Background/BackgroundUrlValidator.h \
@@ -221,6 +236,7 @@ HEADERS += ../VAC/MainWindow.h \
 SOURCES += main.cpp \
     ../VAC/SaveAndLoad.cpp \
     ../VAC/Picking.cpp \
+    ../VAC/Profiler.cpp \
     ../VAC/Random.cpp \
     ../VAC/GLUtils.cpp  \
     ../VAC/GLWidget.cpp  \
@@ -251,6 +267,7 @@ SOURCES += main.cpp \
     ../VAC/VectorAnimationComplex/CellVisitor.cpp \
     ../VAC/VectorAnimationComplex/Operators.cpp \
     ../VAC/VectorAnimationComplex/Operator.cpp \
+    ../VAC/VectorAnimationComplex/PlanarArrangement.cpp \
     ../VAC/VectorAnimationComplex/ProperCycle.cpp \
     ../VAC/VectorAnimationComplex/ProperPath.cpp \
     ../VAC/VectorAnimationComplex/CycleHelper.cpp \
@@ -260,6 +277,7 @@ SOURCES += main.cpp \
     ../VAC/VectorAnimationComplex/Algorithms.cpp \
     ../VAC/VectorAnimationComplex/SmartKeyEdgeSet.cpp \
     ../VAC/VectorAnimationComplex/Triangles.cpp \
+    ../VAC/VectorAnimationComplex/Rasterizer.cpp \
     ../VAC/SelectionInfoWidget.cpp \
     ../VAC/VectorAnimationComplex/Path.cpp \
     ../VAC/VectorAnimationComplex/AnimatedVertex.cpp \
@@ -270,8 +288,17 @@ SOURCES += main.cpp \
     ../VAC/ViewSettings.cpp \
     ../VAC/View3DSettings.cpp \
     ../VAC/ObjectPropertiesWidget.cpp \
+    ../VAC/OnionSkinCache.cpp \
+    ../VAC/SpaceTimeSurfaceCache.cpp \
+    ../VAC/MeshWriter.cpp \
+    ../VAC/SvgWriter.cpp \
+    ../VAC/InputRecorder.cpp \
+    ../VAC/DamageTracker.cpp \
     ../VAC/AnimatedCycleWidget.cpp \
     ../VAC/VectorAnimationComplex/CellObserver.cpp \
+    ../VAC/VectorAnimationComplex/CellPool.cpp \
+    ../VAC/VectorAnimationComplex/CellStore.cpp \
+    ../VAC/VectorAnimationComplex/TimeIndex.cpp \
     ../VAC/Color.cpp \
     ../VAC/DevSettings.cpp \
     ../VAC/Settings.cpp \
@@ -289,9 +316,12 @@ SOURCES += main.cpp \
     ../VAC/EditCanvasSizeDialog.cpp \
     ../VAC/ExportPngDialog.cpp \
     ../VAC/AboutDialog.cpp \
+    ../VAC/Benchmark.cpp \
+    ../VAC/DocumentSaver.cpp \
     ../VAC/ViewWidget.cpp \
     ../VAC/Background/Background.cpp \
     ../VAC/Background/BackgroundData.cpp \
+    ../VAC/Background/BackgroundImageCache.cpp \
     ../VAC/Background/BackgroundRenderer.cpp \
     ../VAC/Background/BackgroundWidget.cpp \
     ../VAC/Background/BackgroundUrlValidator.cpp \
@@ -17,6 +17,7 @@
 #include <VAC/MainWindow.h>
 #include <VAC/Global.h>
 #include <VAC/GLUtils.h>
+#include <VAC/Benchmark.h>
 
 #include "Application.h"
 #include "UpdateCheck.h"
@@ -37,6 +38,13 @@ int main(int argc, char *argv[])
 
     Application app(argc, argv);
     MainWindow mainWindow;
+
+    // Benchmark mode (development only): run and quit. See Benchmark.h
+    if(!app.arguments().filter(QRegExp("^--benchmark(=|$)")).isEmpty())
+    {
+        return Benchmark::exec(app.arguments());
+    }
+
     UpdateCheck update(&mainWindow);
 
     // About window
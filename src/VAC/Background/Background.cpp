@@ -16,6 +16,7 @@
 
 #include "Background.h"
 
+#include "BackgroundImageCache.h"
 #include "BackgroundUrlValidator.h"
 
 #include "../XmlStreamReader.h"
@@ -26,6 +27,7 @@
 
 #include <QDir>
 #include <QFileInfo>
+#include <QImageReader>
 #include <QVector>
 #include <QTextStream>
 
@@ -129,6 +131,8 @@ void Background::clearCache_()
 
 void Background::clearCache()
 {
+    // Image files may have changed on disk
+    BackgroundImageCache::instance()->clear();
     clearCache_();
     emit changed();
 }
@@ -672,9 +676,13 @@ void Background::exportSVG(int frame, QTextStream & out,
     QFileInfo fileInfo(linkedImageFilePath);
     if (fileInfo.exists() && fileInfo.isFile())
     {
-        QImage image(linkedImageFilePath);
-        linkedImageWidth = image.width();
-        linkedImageHeight = image.height();
+        // Only read the header if the format allows it, since this is
+        // called for each frame when exporting sequences and animations
+        QSize size = QImageReader(linkedImageFilePath).size();
+        if (!size.isValid())
+            size = QImage(linkedImageFilePath).size();
+        linkedImageWidth = size.width();
+        linkedImageHeight = size.height();
         linkedImageAbsoluteFilePath = fileInfo.absoluteFilePath();
     }
 
@@ -0,0 +1,326 @@
+// Copyright (C) 2012-2019 The VPaint Developers.
+// See the COPYRIGHT file at the top-level directory of this distribution
+// and at https://github.com/dalboris/vpaint/blob/master/COPYRIGHT
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "BackgroundImageCache.h"
+
+#include "../Global.h"
+
+#include <QApplication>
+#include <QImageReader>
+#include <QRunnable>
+#include <QThread>
+
+#include <algorithm>
+
+namespace
+{
+
+// Maximum width and height of proxies
+const int PROXY_SIZE = 512;
+
+// Priorities in the thread pool
+const int IMAGE_PRIORITY = 1;
+const int PREFETCH_PRIORITY = 0;
+
+// Reads the file, converts it to RGBA8888, and flips it vertically
+QImage decode_(const QString & filePath)
+{
+    QImageReader reader(filePath);
+    QImage image = reader.read();
+    if (image.isNull())
+        return image;
+
+    if (image.format() != QImage::Format_RGBA8888)
+        image = image.convertToFormat(QImage::Format_RGBA8888);
+
+    // Flip in place, rather than QImage::mirrored() which makes a copy
+    const int h = image.height();
+    const int bytesPerLine = image.bytesPerLine();
+    for (int y = 0; y < h/2; ++y)
+    {
+        uchar * a = image.scanLine(y);
+        uchar * b = image.scanLine(h-1-y);
+        std::swap_ranges(a, a + bytesPerLine, b);
+    }
+
+    return image;
+}
+
+// Downscales the image to fit in PROXY_SIZE, or returns it if it already fits
+QImage proxy_(const QImage & image)
+{
+    if (image.width() > PROXY_SIZE || image.height() > PROXY_SIZE)
+        return image.scaled(PROXY_SIZE, PROXY_SIZE, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    else
+        return image;
+}
+
+class Decoder: public QRunnable
+{
+public:
+    Decoder(BackgroundImageCache * cache, const QString & filePath,
+            int generation, const std::shared_ptr<std::atomic<bool>> & canceled) :
+        cache_(cache),
+        filePath_(filePath),
+        generation_(generation),
+        canceled_(canceled)
+    {
+    }
+
+    void run()
+    {
+        if (*canceled_)
+            return;
+
+        QImage image = decode_(filePath_);
+        QImage proxy = proxy_(image);
+
+        QMetaObject::invokeMethod(cache_, "onDecoded_", Qt::QueuedConnection,
+                                  Q_ARG(QString, filePath_),
+                                  Q_ARG(QImage, image),
+                                  Q_ARG(QImage, proxy),
+                                  Q_ARG(int, generation_));
+    }
+
+private:
+    BackgroundImageCache * cache_;
+    QString filePath_;
+    int generation_;
+    std::shared_ptr<std::atomic<bool>> canceled_;
+};
+
+}
+
+BackgroundImageCache * BackgroundImageCache::instance()
+{
+    static BackgroundImageCache * res = new BackgroundImageCache(qApp);
+    return res;
+}
+
+BackgroundImageCache::BackgroundImageCache(QObject * parent) :
+    QObject(parent),
+    useCounter_(0),
+    usedBytes_(0),
+    generation_(0)
+{
+    // Leave some cores to the GUI thread and the rest of the application
+    threadPool_.setMaxThreadCount(std::max(1, QThread::idealThreadCount() / 2));
+}
+
+BackgroundImageCache::~BackgroundImageCache()
+{
+    clear();
+    threadPool_.waitForDone();
+}
+
+QImage BackgroundImageCache::image(const QString & filePath)
+{
+    auto it = entries_.find(filePath);
+    if (it != entries_.end() && (it->failed || !it->image.isNull()))
+    {
+        it->lastUse = ++useCounter_;
+        return it->image;
+    }
+    else
+    {
+        request_(filePath, nullptr);
+        return QImage();
+    }
+}
+
+QImage BackgroundImageCache::proxy(const QString & filePath)
+{
+    auto it = entries_.find(filePath);
+    if (it != entries_.end() && (it->failed || !it->proxy.isNull()))
+    {
+        it->lastUse = ++useCounter_;
+        return it->proxy;
+    }
+    else
+    {
+        request_(filePath, nullptr);
+        return QImage();
+    }
+}
+
+QImage BackgroundImageCache::decodedImage(const QString & filePath)
+{
+    auto it = entries_.find(filePath);
+    if (it != entries_.end() && (it->failed || !it->image.isNull()))
+    {
+        it->lastUse = ++useCounter_;
+        return it->image;
+    }
+
+    // Cancel the pending decoding, if any, since we do it now
+    auto pending = pending_.find(filePath);
+    if (pending != pending_.end())
+    {
+        *pending->canceled = true;
+        pending_.erase(pending);
+    }
+
+    QImage image = decode_(filePath);
+    insert_(filePath, image, proxy_(image));
+    return image;
+}
+
+bool BackgroundImageCache::hasFailed(const QString & filePath) const
+{
+    auto it = entries_.find(filePath);
+    return it != entries_.end() && it->failed;
+}
+
+void BackgroundImageCache::prefetch(QObject * client, const QStringList & filePaths)
+{
+    // Cancel previous prefetches which are not wanted anymore
+    for (auto it = pending_.begin(); it != pending_.end();)
+    {
+        if (it->prefetchClients.contains(client) && !filePaths.contains(it.key()))
+        {
+            it->prefetchClients.remove(client);
+            if (it->prefetchClients.isEmpty())
+            {
+                *it->canceled = true;
+                it = pending_.erase(it);
+                continue;
+            }
+        }
+        ++it;
+    }
+
+    // Schedule new ones
+    foreach (const QString & filePath, filePaths)
+    {
+        auto it = entries_.find(filePath);
+        if (it == entries_.end() || (!it->failed && it->image.isNull()))
+            request_(filePath, client);
+    }
+}
+
+void BackgroundImageCache::clear()
+{
+    // Results of decoders already running will be ignored
+    ++generation_;
+    foreach (const Pending & pending, pending_)
+        *pending.canceled = true;
+    pending_.clear();
+
+    entries_.clear();
+    usedBytes_ = 0;
+
+    emit cleared();
+}
+
+void BackgroundImageCache::request_(const QString & filePath, QObject * prefetchClient)
+{
+    const bool isPrefetch = (prefetchClient != nullptr);
+
+    auto it = pending_.find(filePath);
+    if (it != pending_.end())
+    {
+        const bool wasPrefetch = !it->prefetchClients.isEmpty();
+        if (isPrefetch && wasPrefetch)
+        {
+            it->prefetchClients.insert(prefetchClient);
+            return;
+        }
+        else if (isPrefetch || !wasPrefetch)
+        {
+            return;
+        }
+
+        // Reschedule a prefetch with higher priority
+        *it->canceled = true;
+        pending_.erase(it);
+    }
+
+    Pending pending;
+    pending.canceled = std::make_shared<std::atomic<bool>>(false);
+    if (isPrefetch)
+        pending.prefetchClients.insert(prefetchClient);
+    pending_.insert(filePath, pending);
+
+    threadPool_.start(new Decoder(this, filePath, generation_, pending.canceled),
+                      isPrefetch ? PREFETCH_PRIORITY : IMAGE_PRIORITY);
+}
+
+void BackgroundImageCache::onDecoded_(const QString & filePath, const QImage & image,
+                                      const QImage & proxy, int generation)
+{
+    if (generation != generation_)
+        return;
+
+    pending_.remove(filePath);
+    insert_(filePath, image, proxy);
+
+    emit imageDecoded(filePath);
+}
+
+void BackgroundImageCache::insert_(const QString & filePath, const QImage & image,
+                                   const QImage & proxy)
+{
+    Entry & entry = entries_[filePath];
+    usedBytes_ -= numBytes_(entry);
+    entry.image = image;
+    entry.proxy = proxy;
+    entry.failed = image.isNull();
+    entry.lastUse = ++useCounter_;
+    usedBytes_ += numBytes_(entry);
+
+    evict_();
+}
+
+qint64 BackgroundImageCache::numBytes_(const Entry & entry)
+{
+    qint64 res = 0;
+    if (!entry.image.isNull())
+        res += entry.image.sizeInBytes();
+    if (!entry.proxy.isNull() && entry.proxy.cacheKey() != entry.image.cacheKey())
+        res += entry.proxy.sizeInBytes();
+    return res;
+}
+
+void BackgroundImageCache::evict_()
+{
+    const qint64 budget = qint64(global()->settings().backgroundImageMemoryBudget()) * 1024 * 1024;
+
+    // Evict full images first, least recently used first, and then proxies.
+    // The most recently used entry is never evicted, even if it alone
+    // exceeds the budget.
+    for (int pass = 0; pass < 2 && usedBytes_ > budget; ++pass)
+    {
+        QList<QPair<qint64, QString>> candidates;
+        for (auto it = entries_.cbegin(); it != entries_.cend(); ++it)
+        {
+            const QImage & img = (pass == 0) ? it->image : it->proxy;
+            if (!img.isNull() && it->lastUse != useCounter_)
+                candidates << qMakePair(it->lastUse, it.key());
+        }
+        std::sort(candidates.begin(), candidates.end());
+
+        for (int i = 0; i < candidates.size() && usedBytes_ > budget; ++i)
+        {
+            Entry & entry = entries_[candidates[i].second];
+            usedBytes_ -= numBytes_(entry);
+            if (pass == 0)
+                entry.image = QImage();
+            else
+                entry.proxy = QImage();
+            usedBytes_ += numBytes_(entry);
+        }
+    }
+}
@@ -0,0 +1,119 @@
+// Copyright (C) 2012-2019 The VPaint Developers.
+// See the COPYRIGHT file at the top-level directory of this distribution
+// and at https://github.com/dalboris/vpaint/blob/master/COPYRIGHT
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BACKGROUND_IMAGE_CACHE_H
+#define BACKGROUND_IMAGE_CACHE_H
+
+#include <QHash>
+#include <QImage>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+
+#include <atomic>
+#include <memory>
+
+// Decodes background images in worker threads, and keeps the decoded images
+// in memory up to the budget given in the preferences. Images are identified
+// by their file path, so this cache is shared by all backgrounds and views.
+//
+// Decoded images are in QImage::Format_RGBA8888 and flipped vertically (the
+// first scanline is the bottom of the image), which is what OpenGL expects.
+// They are flipped in place while decoding, so no extra copy is made. For
+// each image, a downscaled proxy is also computed, which is much cheaper to
+// upload to the GPU while scrubbing, and which is kept in memory longer.
+//
+// This class must only be used from the GUI thread.
+//
+class BackgroundImageCache: public QObject
+{
+    Q_OBJECT
+
+public:
+    // Returns the unique instance, owned by qApp
+    static BackgroundImageCache * instance();
+
+    // Returns the decoded image, or a null image if it is not decoded yet,
+    // in which case it is scheduled for decoding with a high priority, and
+    // imageDecoded() is emitted once done. Also returns a null image if the
+    // file couldn't be read, which you can check with hasFailed().
+    QImage image(const QString & filePath);
+
+    // Same as image(), but returns the proxy
+    QImage proxy(const QString & filePath);
+
+    // Same as image(), but if the image is not decoded yet, it is decoded
+    // now in the calling thread rather than scheduled. This is used by
+    // exports, which can't wait for worker threads. Returns a null image
+    // only if the file couldn't be read.
+    QImage decodedImage(const QString & filePath);
+
+    // Returns whether the file has been decoded but couldn't be read
+    bool hasFailed(const QString & filePath) const;
+
+    // Schedules the given files for decoding with a low priority, on behalf
+    // of the given client. Files scheduled by a previous call from the same
+    // client and not yet started are canceled, unless they are in filePaths
+    // or also wanted by another client.
+    void prefetch(QObject * client, const QStringList & filePaths);
+
+    // Removes all decoded images, and cancels all pending decoding. This
+    // should be called when image files may have changed on disk.
+    void clear();
+
+signals:
+    void imageDecoded(const QString & filePath);
+    void cleared();
+
+private slots:
+    void onDecoded_(const QString & filePath, const QImage & image,
+                    const QImage & proxy, int generation);
+
+private:
+    BackgroundImageCache(QObject * parent);
+    ~BackgroundImageCache();
+
+    struct Entry
+    {
+        Entry() : failed(false), lastUse(0) {}
+        QImage image; // null if evicted
+        QImage proxy; // null if evicted
+        bool failed;
+        qint64 lastUse;
+    };
+    QHash<QString, Entry> entries_;
+    qint64 useCounter_;
+    qint64 usedBytes_;
+
+    typedef std::shared_ptr<std::atomic<bool>> CancelFlag;
+    struct Pending
+    {
+        CancelFlag canceled;
+        QSet<QObject *> prefetchClients; // empty if requested with high priority
+    };
+    QHash<QString, Pending> pending_;
+    int generation_;
+    QThreadPool threadPool_;
+
+    void request_(const QString & filePath, QObject * prefetchClient);
+    void insert_(const QString & filePath, const QImage & image, const QImage & proxy);
+    void evict_();
+    static qint64 numBytes_(const Entry & entry);
+};
+
+#endif // BACKGROUND_IMAGE_CACHE_H
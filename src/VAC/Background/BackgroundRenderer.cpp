@@ -17,25 +17,63 @@
 #include "BackgroundRenderer.h"
 
 #include "Background.h"
+#include "BackgroundImageCache.h"
+#include "../Global.h"
+#include "../Timeline.h"
+#include "../VectorAnimationComplex/Rasterizer.h"
 
+#include <QImage>
 #include <QOpenGLContext>
 #include <QOpenGLTexture>
+#include <QTimer>
+
+#include <limits>
+
+namespace
+{
+
+// Number of frames to prefetch after and before the current frame
+const int NUM_PREFETCHED_FRAMES_AFTER = 8;
+const int NUM_PREFETCHED_FRAMES_BEFORE = 2;
+
+// Frames changing more often than this are considered as scrubbing
+const int SCRUBBING_INTERVAL = 200; // milliseconds
+
+}
 
 BackgroundRenderer::BackgroundRenderer(
         Background * background,
         QObject * parent) :
     QObject(parent),
     background_(background),
-    isCacheDirty_(false)
+    isCacheDirty_(false),
+    useCounter_(0),
+    textureBytes_(0),
+    lastFrame_(std::numeric_limits<int>::min()),
+    isScrubbing_(false)
 {
-    connect(background_, SIGNAL(cacheCleared()), this, SLOT(setDirty_()));
+    BackgroundImageCache * cache = BackgroundImageCache::instance();
+    connect(cache, SIGNAL(cleared()), this, SLOT(setDirty_()));
+    connect(cache, SIGNAL(imageDecoded(QString)), this, SLOT(onImageDecoded_(QString)));
+    connect(background_, SIGNAL(cacheCleared()), this, SLOT(onBackgroundCacheCleared_()));
     connect(background_, SIGNAL(destroyed()), this, SLOT(onBackgroundDestroyed_()));
+
+    scrubbingTimer_ = new QTimer(this);
+    scrubbingTimer_->setSingleShot(true);
+    scrubbingTimer_->setInterval(SCRUBBING_INTERVAL);
+    connect(scrubbingTimer_, SIGNAL(timeout()), this, SLOT(onScrubbingEnded_()));
+}
+
+BackgroundRenderer::~BackgroundRenderer()
+{
+    // Cancel our prefetches
+    BackgroundImageCache::instance()->prefetch(this, QStringList());
 }
 
 void BackgroundRenderer::cleanup()
 {
     // Delete all textures allocated in GPU
-    foreach (QOpenGLTexture * texture, textures_)
+    foreach (const Texture & texture, textures_)
     {
         // Note 1: Qt documentation doesn't specify whether QOpenGLTexture's
         // destructor destroys the underlying OpenGL texture object, so we
@@ -44,18 +82,13 @@ void BackgroundRenderer::cleanup()
         // Note 2: this requires a current valid OpenGL context, reason why we
         // defer calling cleanup() via the isCacheDirty_ flag.
         //
-        // Note 3: texture may be nullptr, for example if users haven't set
-        // a background image
-        //
-        if (texture)
-        {
-            texture->destroy();
-            delete texture;
-        }
+        texture.texture->destroy();
+        delete texture.texture;
     }
 
     // Clear map
     textures_.clear();
+    textureBytes_ = 0;
 
     // Clear isCacheDirty_ flag
     isCacheDirty_ = false;
@@ -64,6 +97,7 @@ void BackgroundRenderer::cleanup()
 void BackgroundRenderer::setDirty_()
 {
     isCacheDirty_ = true;
+    emit changed();
 }
 
 void BackgroundRenderer::clearCache_()
@@ -71,6 +105,14 @@ void BackgroundRenderer::clearCache_()
     cleanup();
 }
 
+void BackgroundRenderer::onBackgroundCacheCleared_()
+{
+    // Image file paths may have changed: prefetch again on next draw.
+    // Textures don't need to be destroyed since they are identified by
+    // their file paths.
+    lastFrame_ = std::numeric_limits<int>::min();
+}
+
 void BackgroundRenderer::onBackgroundDestroyed_()
 {
     Background * b = background_;
@@ -78,35 +120,217 @@ void BackgroundRenderer::onBackgroundDestroyed_()
     emit backgroundDestroyed(b);
 }
 
+void BackgroundRenderer::onImageDecoded_(const QString & filePath)
+{
+    if (filePath == waitingFilePath_)
+    {
+        emit changed();
+    }
+}
+
+void BackgroundRenderer::onScrubbingEnded_()
+{
+    isScrubbing_ = false;
+    emit changed();
+}
+
+void BackgroundRenderer::updateScrubbing_()
+{
+    Timeline * timeline = global()->timeline();
+    bool isPlaying = timeline && timeline->isPlaying();
+
+    isScrubbing_ = !isPlaying &&
+                   lastFrameChange_.isValid() &&
+                   lastFrameChange_.elapsed() < SCRUBBING_INTERVAL;
+    lastFrameChange_.start();
+
+    if (isScrubbing_)
+    {
+        scrubbingTimer_->start();
+    }
+}
+
+void BackgroundRenderer::prefetch_(int frame)
+{
+    // Note: frames sharing the same image are only prefetched once
+    QStringList filePaths;
+    for (int i = -NUM_PREFETCHED_FRAMES_BEFORE; i <= NUM_PREFETCHED_FRAMES_AFTER; ++i)
+    {
+        if (i != 0)
+        {
+            int f = background_->referenceFrame(frame + i);
+            QString filePath = background_->resolvedImageFilePath(f);
+            if (!filePath.isEmpty() && !filePaths.contains(filePath))
+            {
+                filePaths << filePath;
+            }
+        }
+    }
+    BackgroundImageCache::instance()->prefetch(this, filePaths);
+}
+
 QOpenGLTexture * BackgroundRenderer::texture_(int frame)
 {
-    // Avoid allocating several textures for frames sharing the same image.
-    // If users haven't set a background image at all, this sets frame to 0.
+    // Avoid resolving file paths for frames sharing the same image. If users
+    // haven't set a background image at all, this sets frame to 0.
     frame = background_->referenceFrame(frame);
+    if (frame != lastFrame_)
+    {
+        updateScrubbing_();
+        prefetch_(frame);
+        lastFrame_ = frame;
+    }
+
+    // No image to draw. This includes the very common case where no
+    // background image is set.
+    QString filePath = background_->resolvedImageFilePath(frame);
+    if (filePath.isEmpty())
+    {
+        waitingFilePath_.clear();
+        lastFilePath_.clear();
+        return nullptr;
+    }
 
-    // Load texture to GPU if not done already
-    if (!textures_.contains(frame))
+    // Use the uploaded texture if any, unless it is a proxy and we're not
+    // scrubbing anymore
+    const bool preferProxy = isScrubbing_ && global()->settings().backgroundProxiesWhileScrubbing();
+    auto it = textures_.find(filePath);
+    const bool hasTexture = (it != textures_.end());
+    if (hasTexture && (!it->isProxy || preferProxy))
     {
-        // Get QImage
-        QImage img = background_->image(frame);
+        it->lastUse = ++useCounter_;
+        lastFilePath_ = filePath;
+        waitingFilePath_.clear();
+        return it->texture;
+    }
 
-        if (img.isNull())
+    // Otherwise, get the decoded image. If the full image is not decoded yet,
+    // we use its proxy if available (e.g., the full image has been evicted
+    // from memory but not the proxy).
+    BackgroundImageCache * cache = BackgroundImageCache::instance();
+    bool isProxy = preferProxy;
+    QImage image = isProxy ? cache->proxy(filePath) : cache->image(filePath);
+    if (image.isNull() && cache->hasFailed(filePath))
+    {
+        // The file couldn't be read
+        waitingFilePath_.clear();
+        lastFilePath_.clear();
+        return nullptr;
+    }
+    if (image.isNull() && !hasTexture && !isProxy)
+    {
+        isProxy = true;
+        image = cache->proxy(filePath);
+    }
+
+    // Not decoded yet: keep drawing what we have until it is
+    if (image.isNull())
+    {
+        waitingFilePath_ = filePath;
+        if (hasTexture)
         {
-            // Set nullptr as cached value, so we won't try to re-read the file later.
-            // This includes the rare cases when the image couldn't be read, but
-            // also includes the very common case where no background image is
-            // set.
-            textures_[frame] = nullptr;
+            it->lastUse = ++useCounter_;
+            lastFilePath_ = filePath;
+            return it->texture;
         }
-        else
+        auto last = textures_.find(lastFilePath_);
+        return (last != textures_.end()) ? last->texture : nullptr;
+    }
+
+    // Upload texture
+    lastFilePath_ = filePath;
+    waitingFilePath_ = (isProxy && !preferProxy) ? filePath : QString();
+    return upload_(filePath, image, isProxy);
+}
+
+QOpenGLTexture * BackgroundRenderer::exportTexture_(int frame)
+{
+    frame = background_->referenceFrame(frame);
+    QString filePath = background_->resolvedImageFilePath(frame);
+    if (filePath.isEmpty())
+    {
+        return nullptr;
+    }
+
+    // Use the uploaded texture only if it is the full image
+    auto it = textures_.find(filePath);
+    if (it != textures_.end() && !it->isProxy)
+    {
+        it->lastUse = ++useCounter_;
+        lastFilePath_ = filePath;
+        return it->texture;
+    }
+
+    // Otherwise, decode now if needed, and upload. Setting lastFilePath_
+    // prevents the texture from being evicted before being drawn.
+    QImage image = BackgroundImageCache::instance()->decodedImage(filePath);
+    if (image.isNull())
+    {
+        return nullptr;
+    }
+    lastFilePath_ = filePath;
+    if (waitingFilePath_ == filePath)
+    {
+        waitingFilePath_.clear();
+    }
+    return upload_(filePath, image, false);
+}
+
+QOpenGLTexture * BackgroundRenderer::upload_(
+        const QString & filePath, const QImage & image, bool isProxy)
+{
+    // Destroy previous texture (typically, a proxy) for this file
+    auto it = textures_.find(filePath);
+    if (it != textures_.end())
+    {
+        it->texture->destroy();
+        delete it->texture;
+        textureBytes_ -= it->numBytes;
+        textures_.erase(it);
+    }
+
+    // Images from the cache are already in the layout expected by OpenGL,
+    // so no conversion nor mirroring is performed here. We count one third
+    // more bytes for mipmaps.
+    Texture texture;
+    texture.texture = new QOpenGLTexture(image);
+    texture.isProxy = isProxy;
+    texture.numBytes = image.sizeInBytes() * 4 / 3;
+    texture.lastUse = ++useCounter_;
+    textures_.insert(filePath, texture);
+    textureBytes_ += texture.numBytes;
+
+    evict_();
+
+    return texture.texture;
+}
+
+void BackgroundRenderer::evict_()
+{
+    const qint64 budget = qint64(global()->settings().backgroundTextureMemoryBudget()) * 1024 * 1024;
+
+    // Destroy least recently used textures, except the last one drawn
+    while (textureBytes_ > budget)
+    {
+        auto lru = textures_.end();
+        for (auto it = textures_.begin(); it != textures_.end(); ++it)
         {
-            // Load texture to GPU.
-            textures_[frame] = new QOpenGLTexture(img.mirrored());
+            if (it.key() != lastFilePath_ &&
+                (lru == textures_.end() || it->lastUse < lru->lastUse))
+            {
+                lru = it;
+            }
+        }
+        if (lru == textures_.end())
+        {
+            break;
         }
-    }
 
-    // Returned cached texture
-    return textures_[frame];
+        lru->texture->destroy();
+        delete lru->texture;
+        textureBytes_ -= lru->numBytes;
+        textures_.erase(lru);
+    }
 }
 
 namespace
@@ -248,7 +472,9 @@ void BackgroundRenderer::draw(int frame, bool showCanvas,
                               double canvasWidth, double canvasHeight,
 
                               double xSceneMin, double xSceneMax,
-                              double ySceneMin, double ySceneMax)
+                              double ySceneMin, double ySceneMax,
+
+                              bool isExporting)
 {
     if (!background_) {
         return;
@@ -319,7 +545,7 @@ void BackgroundRenderer::draw(int frame, bool showCanvas,
     // ----- Draw background image -----
 
     // Get texture
-    QOpenGLTexture * texture = texture_(frame);
+    QOpenGLTexture * texture = isExporting ? exportTexture_(frame) : texture_(frame);
 
     // Draw image if non-zero
     if (texture)
@@ -357,3 +583,60 @@ void BackgroundRenderer::draw(int frame, bool showCanvas,
         }
     }
 }
+
+void BackgroundRenderer::rasterize(Background * background,
+                                   VectorAnimationComplex::Rasterizer & rasterizer,
+                                   int frame, bool showCanvas,
+
+                                   double canvasLeft, double canvasTop,
+                                   double canvasWidth, double canvasHeight,
+
+                                   double xSceneMin, double xSceneMax,
+                                   double ySceneMin, double ySceneMax)
+{
+    if (!background) {
+        return;
+    }
+
+    // Get canvas boundary
+    const double & wc = canvasWidth;
+    const double & hc = canvasHeight;
+    const double & xc1 = canvasLeft;
+    const double & yc1 = canvasTop;
+    const double xc2 = xc1 + wc;
+    const double yc2 = yc1 + hc;
+
+    // ----- Draw background color -----
+
+    if(showCanvas)
+    {
+        rasterizer.fillRect(xc1, yc1, xc2, yc2, background->color());
+    }
+    else
+    {
+        rasterizer.fillRect(xSceneMin, ySceneMin, xSceneMax, ySceneMax, background->color());
+    }
+
+    // ----- Draw background image -----
+
+    // Note: unlike in draw(), the image is not mirrored since the rasterizer
+    // already uses the convention that v = 1 is the top row of the image.
+    QImage img = background->image(background->referenceFrame(frame));
+    if (!img.isNull())
+    {
+        // Determine background quad positions and UVs
+        double x1, x2, y1, y2, u1, u2, v1, v2;
+        bool outOfCanvas;
+        computeBackgroundQuad_(background, showCanvas,
+                               wc, hc, xc1, xc2, yc1, yc2,
+                               xSceneMin, xSceneMax, ySceneMin, ySceneMax,
+                               x1, x2, y1, y2, u1, u2, v1, v2, outOfCanvas);
+
+        // Draw textured quad
+        if (!outOfCanvas)
+        {
+            rasterizer.drawImage(img, x1, y1, x2, y2, u1, v1, u2, v2,
+                                 background->opacity());
+        }
+    }
+}
@@ -18,11 +18,16 @@
 #define BACKGROUND_RENDERER_H
 
 #include <QObject>
-#include <QMap>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QString>
 
 class Background;
+namespace VectorAnimationComplex { class Rasterizer; }
+class QImage;
 class QOpenGLContext;
 class QOpenGLTexture;
+class QTimer;
 
 class BackgroundRenderer: public QObject
 {
@@ -31,6 +36,7 @@ class BackgroundRenderer: public QObject
 public:
     BackgroundRenderer(Background * background,
                        QObject * parent = 0);
+    ~BackgroundRenderer();
 
     // Destroys allocated GPU resources. This requires a current valid OpenGL
     // context.
@@ -48,6 +54,11 @@ public:
     // at all, since showCanvas = false would paint the whole window with the
     // background color, which doesn't make sense.
     //
+    // If isExporting = true, the full-resolution image of the frame is drawn,
+    // decoding it now if necessary, instead of a proxy or the image of the
+    // last frame drawn while it is being decoded. This doesn't affect the
+    // detection of scrubbing nor prefetching.
+    //
     // XXX We should probably pass a pointer to a canvas object in the
     // constructor, so we don't have to pass that many parameters. (but the
     // 'Canvas' class is not even implemented yet)
@@ -58,23 +69,75 @@ public:
               double canvasWidth, double canvasHeight,
 
               double xSceneMin, double xSceneMax,
-              double ySceneMin, double ySceneMax);
+              double ySceneMin, double ySceneMax,
+
+              bool isExporting = false);
+
+    // Same as draw(), but using the software rasterizer instead of OpenGL.
+    // This doesn't use any GPU resources, hence is static.
+    //
+    static void rasterize(Background * background,
+                          VectorAnimationComplex::Rasterizer & rasterizer,
+                          int frame, bool showCanvas,
+
+                          double canvasLeft, double canvasTop,
+                          double canvasWidth, double canvasHeight,
+
+                          double xSceneMin, double xSceneMax,
+                          double ySceneMin, double ySceneMax);
 
 signals:
     void backgroundDestroyed(Background * background);
 
+    // Emitted when the background should be redrawn, for instance because
+    // the image to draw has been decoded in the background
+    void changed();
+
 private slots:
     void setDirty_();
     void clearCache_();
+    void onBackgroundCacheCleared_();
     void onBackgroundDestroyed_();
+    void onImageDecoded_(const QString & filePath);
+    void onScrubbingEnded_();
 
 private:
     Background * background_;
 
     bool isCacheDirty_;
 
+    // Images are decoded asynchronously by BackgroundImageCache. While the
+    // image of the current frame is not decoded yet, we keep drawing the
+    // last image drawn, and redraw once it's decoded.
     QOpenGLTexture * texture_(int frame);
-    QMap<int, QOpenGLTexture *> textures_;
+    QOpenGLTexture * exportTexture_(int frame);
+    QString lastFilePath_;
+    QString waitingFilePath_;
+
+    // Uploaded textures, by file path. The least recently used are destroyed
+    // first when exceeding the budget given in the preferences.
+    struct Texture
+    {
+        QOpenGLTexture * texture;
+        bool isProxy;
+        qint64 numBytes;
+        qint64 lastUse;
+    };
+    QHash<QString, Texture> textures_;
+    qint64 useCounter_;
+    qint64 textureBytes_;
+    QOpenGLTexture * upload_(const QString & filePath, const QImage & image, bool isProxy);
+    void evict_();
+
+    // Prefetching around the current frame, and detection of scrubbing,
+    // i.e. when the frame changes quickly without the timeline playing.
+    // While scrubbing, proxies are uploaded rather than full images.
+    void prefetch_(int frame);
+    void updateScrubbing_();
+    int lastFrame_;
+    bool isScrubbing_;
+    QElapsedTimer lastFrameChange_;
+    QTimer * scrubbingTimer_;
 };
 
 #endif // BACKGROUND_RENDERER_H
@@ -0,0 +1,874 @@
+// Copyright (C) 2012-2019 The VPaint Developers.
+// See the COPYRIGHT file at the top-level directory of this distribution
+// and at https://github.com/dalboris/vpaint/blob/master/COPYRIGHT
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Benchmark.h"
+
+#include "DocumentSaver.h"
+#include "Global.h"
+#include "InputRecorder.h"
+#include "Layer.h"
+#include "Scene.h"
+#include "Timeline.h"
+#include "XmlStreamReader.h"
+#include "XmlStreamWriter.h"
+#include "Background/Background.h"
+#include "VectorAnimationComplex/VAC.h"
+#include "VectorAnimationComplex/Cell.h"
+#include "VectorAnimationComplex/KeyVertex.h"
+#include "VectorAnimationComplex/KeyEdge.h"
+#include "VectorAnimationComplex/KeyFace.h"
+#include "VectorAnimationComplex/Cycle.h"
+#include "VectorAnimationComplex/EdgeGeometry.h"
+#include "VectorAnimationComplex/EdgeSample.h"
+#include "VectorAnimationComplex/SculptCurve.h"
+
+#include <QBuffer>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QTextStream>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace
+{
+
+// Operations, in the order they are performed
+const char * OPERATIONS[] = { "load", "check", "triangulate", "select", "sketch", "save" };
+const int NUM_OPERATIONS = 6;
+
+// Timings below this threshold (in milliseconds) are considered noise
+const double NOISE_THRESHOLD = 1.0;
+
+// Latencies below this threshold (in microseconds) are considered noise
+const double LATENCY_NOISE_THRESHOLD = 100.0;
+
+// Number of input points of the replayed strokes
+const int STROKE_SIZES[] = { 1000, 10000, 100000 };
+const int NUM_STROKE_SIZES = 3;
+
+// Tolerances of adaptive sampling, in pixels
+const double SAMPLING_TOLERANCES[] = { 0.1, 0.25, 0.5, 1.0, 2.0 };
+const int NUM_SAMPLING_TOLERANCES = 5;
+
+void readScene_(const QByteArray & data, Scene * scene, PlaybackSettings & playback)
+{
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+
+    // Same as MainWindow::read(), but without touching the timeline
+    XmlStreamReader xml(&buffer);
+    if (xml.readNextStartElement() && xml.name() == "vec")
+    {
+        while (xml.readNextStartElement())
+        {
+            if (xml.name() == "playback")
+                playback.read(xml);
+            else if (xml.name() == "canvas")
+                scene->readCanvas(xml);
+            else if (xml.name() == "sampling")
+                scene->readSampling(xml);
+            else if (xml.name() == "layer")
+                scene->readOneLayer(xml);
+            else
+                xml.skipCurrentElement();
+        }
+    }
+}
+
+QByteArray writeScene_(Scene * scene, const PlaybackSettings & playback)
+{
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+
+    {
+        XmlStreamWriter xml(&buffer);
+        DocumentSaver::write(xml, scene, playback);
+    }
+
+    return buffer.data();
+}
+
+// Creates a grid of n x n square key faces at frame 0, and returns it as VEC data
+QByteArray syntheticScene_(int n)
+{
+    using namespace VectorAnimationComplex;
+
+    const double size = 20.0;
+    const Time t(0);
+
+    Scene scene;
+    scene.setLeft(0);
+    scene.setTop(0);
+    scene.setWidth(n * size);
+    scene.setHeight(n * size);
+    Layer * layer = scene.createLayer("Layer 1");
+    layer->background()->setColor(Qt::white);
+    VAC * vac = layer->vac();
+
+    // Create cells in a batch, which must end before writing the scene
+    {
+        VAC::BatchEdit batchEdit(vac);
+
+        // Vertices
+        const int m = n + 1;
+        batchEdit.reserve(m*m + 2*n*m + n*n);
+        std::vector<KeyVertex *> vertices(m * m);
+        for (int j = 0; j < m; ++j)
+            for (int i = 0; i < m; ++i)
+                vertices[j*m + i] = vac->newKeyVertex(t, Eigen::Vector2d(i * size, j * size));
+
+        // Horizontal edges h(i,j) from (i,j) to (i+1,j), and vertical edges
+        // v(i,j) from (i,j) to (i,j+1)
+        const double width = 2.0;
+        std::vector<KeyEdge *> h(n * m);
+        std::vector<KeyEdge *> v(m * n);
+        for (int j = 0; j < m; ++j)
+            for (int i = 0; i < n; ++i)
+                h[j*n + i] = vac->newKeyEdge(t, vertices[j*m + i], vertices[j*m + i+1], 0, width);
+        for (int j = 0; j < n; ++j)
+            for (int i = 0; i < m; ++i)
+                v[j*m + i] = vac->newKeyEdge(t, vertices[j*m + i], vertices[(j+1)*m + i], 0, width);
+
+        // Faces
+        for (int j = 0; j < n; ++j)
+        {
+            for (int i = 0; i < n; ++i)
+            {
+                QList<KeyHalfedge> halfedges;
+                halfedges << KeyHalfedge(h[j*n + i], true)
+                          << KeyHalfedge(v[j*m + i+1], true)
+                          << KeyHalfedge(h[(j+1)*n + i], false)
+                          << KeyHalfedge(v[j*m + i], false);
+                vac->newKeyFace(Cycle(halfedges));
+            }
+        }
+    }
+
+    PlaybackSettings playback;
+    playback.setFirstFrame(0);
+    playback.setLastFrame(0);
+    return writeScene_(&scene, playback);
+}
+
+double toMilliseconds(qint64 nsecs)
+{
+    return nsecs * 1e-6;
+}
+
+double toMicroseconds(qint64 nsecs)
+{
+    return nsecs * 1e-3;
+}
+
+// Returns the given percentile of the given latencies, which must be sorted
+qint64 percentile_(const std::vector<qint64> & sorted, double p)
+{
+    if (sorted.empty())
+        return 0;
+    return sorted[static_cast<size_t>(p * (sorted.size() - 1))];
+}
+
+// Input points of a stroke drawn with a tablet at about 200 Hz: a curve
+// wandering at constant speed, with small steps and jitter, and a varying
+// width as given by pen pressure. The stroke is deterministic, so that
+// results can be compared across runs.
+std::vector<VectorAnimationComplex::EdgeSample> stroke_(int n)
+{
+    using VectorAnimationComplex::EdgeSample;
+
+    std::vector<EdgeSample> res;
+    res.reserve(n);
+    unsigned int seed = 12345;
+    auto jitter = [&seed]()
+    {
+        seed = seed * 1103515245u + 12345u;
+        return 0.3 * (((seed >> 8) & 0xffff) / 65535.0 - 0.5);
+    };
+    double angle = 0;
+    double x = 0;
+    double y = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        angle += 0.01 + 0.02 * std::sin(i * 0.003);
+        x += 0.8 * std::cos(angle);
+        y += 0.8 * std::sin(angle);
+        res.push_back(EdgeSample(x + jitter(), y + jitter(), 3 + std::sin(i * 0.01)));
+    }
+    return res;
+}
+
+// Visual error of a sample against a polyline: its distance to the closest
+// point of the polyline, plus half the difference of width at this point
+double samplingError_(const VectorAnimationComplex::EdgeSample & sample,
+                      const SculptCurve::Curve<VectorAnimationComplex::EdgeSample> & polyline)
+{
+    const Eigen::Vector2d p(sample.x(), sample.y());
+    double res = std::numeric_limits<double>::max();
+    for (int i = 0; i + 1 < polyline.size(); ++i)
+    {
+        const Eigen::Vector2d a(polyline[i].x(), polyline[i].y());
+        const Eigen::Vector2d b(polyline[i+1].x(), polyline[i+1].y());
+        const Eigen::Vector2d ab = b - a;
+        const double l2 = ab.squaredNorm();
+        const double u = (l2 > 0) ? std::max(0.0, std::min(1.0, (p-a).dot(ab) / l2)) : 0.0;
+        const double w = (1-u) * polyline[i].width() + u * polyline[i+1].width();
+        res = std::min(res, (a + u*ab - p).norm() + 0.5 * std::abs(w - sample.width()));
+    }
+    return res;
+}
+
+// Number of samples and visual error of the key edges of the scene, when
+// they are resampled adaptively with increasing tolerances. The error is
+// measured at the samples of the uniform resampling of the same curves.
+QJsonObject samplingResults_(const QByteArray & data)
+{
+    using namespace VectorAnimationComplex;
+    typedef SculptCurve::Curve<EdgeSample> Curve;
+
+    Scene scene;
+    PlaybackSettings playback;
+    readScene_(data, &scene, playback);
+
+    std::vector<Curve, Eigen::aligned_allocator<Curve> > uniformCurves;
+    std::vector<Curve, Eigen::aligned_allocator<Curve> > inputCurves;
+    int numUniformSamples = 0;
+    for (int i = 0; i < scene.numLayers(); ++i)
+    {
+        foreach (KeyEdge * edge, scene.layer(i)->vac()->instantEdges())
+        {
+            LinearSpline * spline = dynamic_cast<LinearSpline *>(edge->geometry());
+            if (!spline)
+                continue;
+
+            Curve curve = spline->constCurve();
+            curve.setTolerance(0);
+            inputCurves.push_back(curve);
+            curve.resample(true);
+            numUniformSamples += curve.size();
+            uniformCurves.push_back(curve);
+        }
+    }
+
+    QJsonArray tolerances;
+    for (int k = 0; k < NUM_SAMPLING_TOLERANCES; ++k)
+    {
+        int numSamples = 0;
+        int numErrors = 0;
+        double maxError = 0;
+        double sumError = 0;
+        for (size_t j = 0; j < inputCurves.size(); ++j)
+        {
+            Curve curve = inputCurves[j];
+            curve.setTolerance(SAMPLING_TOLERANCES[k]);
+            curve.resample(true);
+            numSamples += curve.size();
+            for (int i = 0; i < uniformCurves[j].size(); ++i)
+            {
+                const double error = samplingError_(uniformCurves[j][i], curve);
+                maxError = std::max(maxError, error);
+                sumError += error;
+                ++numErrors;
+            }
+        }
+
+        QJsonObject tolerance;
+        tolerance["tolerance"] = SAMPLING_TOLERANCES[k];
+        tolerance["samples"] = numSamples;
+        tolerance["maxError"] = maxError;
+        tolerance["meanError"] = numErrors ? sumError / numErrors : 0.0;
+        tolerances.append(tolerance);
+    }
+
+    QJsonObject res;
+    res["edges"] = static_cast<int>(inputCurves.size());
+    res["uniformSamples"] = numUniformSamples;
+    res["adaptive"] = tolerances;
+    return res;
+}
+
+// Replays a stroke into a curve being sketched, as done while drawing an
+// edge, and returns the latency of each input point, in nanoseconds
+std::vector<qint64> replayStroke_(const std::vector<VectorAnimationComplex::EdgeSample> & stroke)
+{
+    std::vector<qint64> res;
+    if (stroke.empty())
+        return res;
+
+    res.reserve(stroke.size());
+    SculptCurve::Curve<VectorAnimationComplex::EdgeSample> curve;
+    QElapsedTimer timer;
+    timer.start();
+    curve.beginSketch(stroke[0]);
+    res.push_back(timer.nsecsElapsed());
+    for (size_t i = 1; i < stroke.size(); ++i)
+    {
+        timer.start();
+        curve.continueSketch(stroke[i]);
+        res.push_back(timer.nsecsElapsed());
+    }
+    timer.start();
+    curve.endSketch();
+    res.back() += timer.nsecsElapsed();
+    return res;
+}
+
+}
+
+Benchmark::Benchmark() :
+    numRepetitions_(3),
+    tolerance_(0.2)
+{
+    syntheticSizes_ << 8 << 16 << 32;
+}
+
+int Benchmark::numRepetitions() const
+{
+    return numRepetitions_;
+}
+
+void Benchmark::setNumRepetitions(int n)
+{
+    numRepetitions_ = std::max(1, n);
+}
+
+double Benchmark::tolerance() const
+{
+    return tolerance_;
+}
+
+void Benchmark::setTolerance(double tolerance)
+{
+    tolerance_ = tolerance;
+}
+
+QList<int> Benchmark::syntheticSizes() const
+{
+    return syntheticSizes_;
+}
+
+void Benchmark::setSyntheticSizes(const QList<int> & sizes)
+{
+    syntheticSizes_ = sizes;
+}
+
+QStringList Benchmark::recordings() const
+{
+    return recordings_;
+}
+
+void Benchmark::setRecordings(const QStringList & filePaths)
+{
+    recordings_ = filePaths;
+}
+
+QJsonObject Benchmark::runOne_(const QByteArray & data) const
+{
+    using namespace VectorAnimationComplex;
+
+    qint64 best[NUM_OPERATIONS];
+    for (int k = 0; k < NUM_OPERATIONS; ++k)
+        best[k] = std::numeric_limits<qint64>::max();
+
+    int numCells = 0;
+    int numFrames = 0;
+    bool valid = true;
+
+    for (int r = 0; r < numRepetitions_; ++r)
+    {
+        Scene scene;
+        PlaybackSettings playback;
+        QElapsedTimer timer;
+        qint64 elapsed[NUM_OPERATIONS];
+        int op = 0;
+
+        // Load
+        timer.start();
+        readScene_(data, &scene, playback);
+        elapsed[op++] = timer.nsecsElapsed();
+
+        // Check
+        timer.start();
+        for (int i = 0; i < scene.numLayers(); ++i)
+            valid = scene.layer(i)->vac()->check() && valid;
+        elapsed[op++] = timer.nsecsElapsed();
+
+        // Triangulate. Caches are cold since the scene was just loaded.
+        numCells = 0;
+        numFrames = playback.lastFrame() - playback.firstFrame() + 1;
+        timer.start();
+        for (int i = 0; i < scene.numLayers(); ++i)
+        {
+            CellSet cells = scene.layer(i)->vac()->cells();
+            numCells += cells.size();
+            for (int f = playback.firstFrame(); f <= playback.lastFrame(); ++f)
+            {
+                const Time t(f);
+                foreach (Cell * c, cells)
+                {
+                    if (c->exists(t))
+                        c->triangles(t);
+                }
+            }
+        }
+        elapsed[op++] = timer.nsecsElapsed();
+
+        // Select: sweep of rectangles growing from the top-left of the canvas
+        const double x0 = scene.left();
+        const double y0 = scene.top();
+        const double w = scene.width();
+        const double h = scene.height();
+        const int numRectangles = 16;
+        timer.start();
+        for (int i = 0; i < scene.numLayers(); ++i)
+        {
+            VAC * vac = scene.layer(i)->vac();
+            vac->beginRectangleOfSelection(x0, y0, Time(playback.firstFrame()));
+            for (int k = 1; k <= numRectangles; ++k)
+            {
+                const double s = (double) k / numRectangles;
+                vac->continueRectangleOfSelection(x0 + s*w, y0 + s*h);
+            }
+            vac->endRectangleOfSelection();
+            vac->deselectAll();
+        }
+        elapsed[op++] = timer.nsecsElapsed();
+
+        // Sketch: horizontal zig-zag strokes, each crossing its neighbours
+        const int numStrokes = 8;
+        const int numSamples = 64;
+        const double amplitude = h / numStrokes;
+        Layer * layer = scene.activeLayer();
+        timer.start();
+        if (layer)
+        {
+            VAC * vac = layer->vac();
+            const double edgeWidth = global()->edgeWidth();
+            for (int k = 0; k < numStrokes; ++k)
+            {
+                const double y = y0 + (k + 0.5) * h / numStrokes;
+                vac->beginSketchEdge(x0, y, edgeWidth, Time(playback.firstFrame()));
+                for (int i = 1; i <= numSamples; ++i)
+                {
+                    const double x = x0 + w * i / numSamples;
+                    const double dy = (i % 2) ? amplitude : -amplitude;
+                    vac->continueSketchEdge(x, y + dy, edgeWidth);
+                }
+                vac->endSketchEdge();
+                vac->completePendingSketch();
+            }
+        }
+        elapsed[op++] = timer.nsecsElapsed();
+
+        // Save
+        timer.start();
+        writeScene_(&scene, playback);
+        elapsed[op++] = timer.nsecsElapsed();
+
+        for (int k = 0; k < NUM_OPERATIONS; ++k)
+            best[k] = std::min(best[k], elapsed[k]);
+    }
+
+    QJsonObject timings;
+    for (int k = 0; k < NUM_OPERATIONS; ++k)
+        timings[OPERATIONS[k]] = toMilliseconds(best[k]);
+
+    QJsonObject res;
+    res["cells"] = numCells;
+    res["frames"] = numFrames;
+    res["valid"] = valid;
+    res["timings"] = timings;
+    res["sampling"] = samplingResults_(data);
+    return res;
+}
+
+QJsonObject Benchmark::runStrokes_() const
+{
+    QJsonObject res;
+    for (int k = 0; k < NUM_STROKE_SIZES; ++k)
+    {
+        const int n = STROKE_SIZES[k];
+        const std::vector<VectorAnimationComplex::EdgeSample> points = stroke_(n);
+
+        // Keep the repetition with the smallest total time
+        std::vector<qint64> best;
+        qint64 bestTotal = std::numeric_limits<qint64>::max();
+        for (int r = 0; r < numRepetitions_; ++r)
+        {
+            std::vector<qint64> latencies = replayStroke_(points);
+            qint64 total = 0;
+            for (qint64 latency: latencies)
+                total += latency;
+            if (total < bestTotal)
+            {
+                bestTotal = total;
+                best.swap(latencies);
+            }
+        }
+
+        // Percentiles over the whole stroke, and over its first and last
+        // tenth, which should be about the same if the cost per input point
+        // doesn't depend on the length of the stroke
+        const size_t tenth = best.size() / 10;
+        std::vector<qint64> first(best.begin(), best.begin() + tenth);
+        std::vector<qint64> last(best.end() - tenth, best.end());
+        std::sort(best.begin(), best.end());
+        std::sort(first.begin(), first.end());
+        std::sort(last.begin(), last.end());
+
+        QJsonObject latencies;
+        latencies["p50"] = toMicroseconds(percentile_(best, 0.5));
+        latencies["p99"] = toMicroseconds(percentile_(best, 0.99));
+        latencies["max"] = toMicroseconds(percentile_(best, 1.0));
+        latencies["firstTenthP99"] = toMicroseconds(percentile_(first, 0.99));
+        latencies["lastTenthP99"] = toMicroseconds(percentile_(last, 0.99));
+
+        QJsonObject timings;
+        timings["fit"] = toMilliseconds(bestTotal);
+
+        QJsonObject stroke;
+        stroke["samples"] = n;
+        stroke["latencies"] = latencies;
+        stroke["timings"] = timings;
+        res[QString("stroke_%1").arg(n)] = stroke;
+    }
+    return res;
+}
+
+QJsonObject Benchmark::runReplay_(const QByteArray & data) const
+{
+    using namespace VectorAnimationComplex;
+
+    QByteArray document;
+    std::vector<InputEvent> events;
+    if (!InputRecorder::read(data, document, events))
+        return QJsonObject();
+
+    // Replaying changes the tool mode and settings, restored at the end
+    Global * g = global();
+    const Global::ToolMode toolMode = g->toolMode();
+    const Qt::KeyboardModifiers modifiers = g->keyboardModifiers();
+    const bool planarMapMode = g->planarMapMode();
+    const bool snapMode = g->snapMode();
+    const double snapThreshold = g->snapThreshold();
+    const double sculptRadius = g->sculptRadius();
+
+    // Keep the repetition with the smallest total time
+    std::vector<qint64> best;
+    std::vector<qint64> bestCommits;
+    qint64 bestTotal = std::numeric_limits<qint64>::max();
+    bool valid = true;
+    for (int r = 0; r < numRepetitions_; ++r)
+    {
+        Scene scene;
+        PlaybackSettings playback;
+        readScene_(document, &scene, playback);
+
+        std::vector<qint64> latencies;
+        std::vector<qint64> commits;
+        latencies.reserve(events.size());
+        qint64 total = 0;
+        QElapsedTimer timer;
+        for (const InputEvent & event: events)
+        {
+            InputRecorder::restoreState(event, &scene);
+            timer.start();
+            InputRecorder::replay(event, &scene);
+            latencies.push_back(timer.nsecsElapsed());
+            total += latencies.back();
+
+            // Insertion of the sketched edge, once its intersections are
+            // computed in a worker thread
+            if (event.type == InputEvent::SketchEnd)
+            {
+                timer.start();
+                scene.completePendingSketches();
+                commits.push_back(timer.nsecsElapsed());
+                total += commits.back();
+            }
+        }
+
+        for (int i = 0; i < scene.numLayers(); ++i)
+            valid = scene.layer(i)->vac()->check() && valid;
+
+        if (total < bestTotal)
+        {
+            bestTotal = total;
+            best.swap(latencies);
+            bestCommits.swap(commits);
+        }
+    }
+
+    if (toolMode < Global::NUMBER_OF_TOOL_MODES)
+        g->setToolMode(toolMode);
+    g->setKeyboardModifiers(modifiers);
+    g->setPlanarMapMode(planarMapMode);
+    g->setSnapMode(snapMode);
+    g->setSnapThreshold(snapThreshold);
+    g->setSculptRadius(sculptRadius);
+
+    // Percentiles per type of event, and over all events
+    std::vector<std::vector<qint64>> byType(InputEvent::NumTypes);
+    for (size_t i = 0; i < best.size(); ++i)
+        byType[events[i].type].push_back(best[i]);
+    std::sort(best.begin(), best.end());
+
+    auto percentiles = [](const std::vector<qint64> & sorted)
+    {
+        QJsonObject res;
+        res["count"] = static_cast<int>(sorted.size());
+        res["p50"] = toMicroseconds(percentile_(sorted, 0.5));
+        res["p90"] = toMicroseconds(percentile_(sorted, 0.9));
+        res["p99"] = toMicroseconds(percentile_(sorted, 0.99));
+        res["max"] = toMicroseconds(percentile_(sorted, 1.0));
+        return res;
+    };
+
+    QJsonObject latencies;
+    latencies["all"] = percentiles(best);
+    for (int type = 0; type < InputEvent::NumTypes; ++type)
+    {
+        std::vector<qint64> & sorted = byType[type];
+        if (!sorted.empty())
+        {
+            std::sort(sorted.begin(), sorted.end());
+            latencies[InputEvent::typeName(static_cast<InputEvent::Type>(type))] = percentiles(sorted);
+        }
+    }
+    if (!bestCommits.empty())
+    {
+        std::sort(bestCommits.begin(), bestCommits.end());
+        latencies["sketchCommit"] = percentiles(bestCommits);
+    }
+
+    QJsonObject timings;
+    timings["replay"] = toMilliseconds(bestTotal);
+
+    QJsonObject res;
+    res["events"] = static_cast<int>(events.size());
+    res["valid"] = valid;
+    res["latencies"] = latencies;
+    res["timings"] = timings;
+    return res;
+}
+
+QJsonObject Benchmark::run(const QStringList & filePaths) const
+{
+    QJsonObject scenes;
+
+    foreach (const QString & filePath, filePaths)
+    {
+        QFile file(filePath);
+        if (!file.open(QFile::ReadOnly | QFile::Text))
+        {
+            qWarning("Benchmark: cannot open %s", qPrintable(filePath));
+            continue;
+        }
+        QByteArray data = file.readAll();
+        file.close();
+
+        scenes[QFileInfo(filePath).baseName()] = runOne_(data);
+    }
+
+    foreach (int n, syntheticSizes_)
+    {
+        scenes[QString("synthetic_grid_%1").arg(n)] = runOne_(syntheticScene_(n));
+    }
+
+    QJsonObject replays;
+    foreach (const QString & filePath, recordings_)
+    {
+        QFile file(filePath);
+        if (!file.open(QFile::ReadOnly))
+        {
+            qWarning("Benchmark: cannot open %s", qPrintable(filePath));
+            continue;
+        }
+        QJsonObject replay = runReplay_(file.readAll());
+        file.close();
+
+        if (replay.isEmpty())
+            qWarning("Benchmark: %s is not a valid input recording", qPrintable(filePath));
+        else
+            replays[QFileInfo(filePath).baseName()] = replay;
+    }
+
+    QJsonObject res;
+    res["version"] = qApp->applicationVersion();
+    res["repetitions"] = numRepetitions_;
+    res["planarMapMode"] = global()->planarMapMode();
+    res["scenes"] = scenes;
+    res["strokes"] = runStrokes_();
+    res["replays"] = replays;
+    return res;
+}
+
+bool Benchmark::compare(const QJsonObject & results,
+                        const QJsonObject & baseline,
+                        QTextStream & out) const
+{
+    bool ok = true;
+
+    QJsonObject scenes = results["scenes"].toObject();
+    QJsonObject baselineScenes = baseline["scenes"].toObject();
+    foreach (const QString & key, QStringList() << "strokes" << "replays")
+    {
+        QJsonObject other = results[key].toObject();
+        QJsonObject baselineOther = baseline[key].toObject();
+        for (auto it = other.constBegin(); it != other.constEnd(); ++it)
+            scenes[it.key()] = it.value();
+        for (auto it = baselineOther.constBegin(); it != baselineOther.constEnd(); ++it)
+            baselineScenes[it.key()] = it.value();
+    }
+
+    QStringList ops;
+    for (int k = 0; k < NUM_OPERATIONS; ++k)
+        ops << OPERATIONS[k];
+    ops << "fit" << "replay";
+
+    foreach (const QString & name, scenes.keys())
+    {
+        if (!baselineScenes.contains(name))
+        {
+            out << name << ": not in baseline\n";
+            continue;
+        }
+
+        QJsonObject timings = scenes[name].toObject()["timings"].toObject();
+        QJsonObject baselineTimings = baselineScenes[name].toObject()["timings"].toObject();
+        foreach (const QString & op, ops)
+        {
+            if (!timings.contains(op) || !baselineTimings.contains(op))
+                continue;
+
+            const double t = timings[op].toDouble();
+            const double t0 = baselineTimings[op].toDouble();
+            const double change = (t0 > 0) ? (t - t0) / t0 : 0.0;
+            const bool isRegression = (change > tolerance_) && (t - t0 > NOISE_THRESHOLD);
+
+            out << name << "/" << op << ": "
+                << QString::number(t, 'f', 2) << " ms (baseline "
+                << QString::number(t0, 'f', 2) << " ms, "
+                << (change >= 0 ? "+" : "") << QString::number(100 * change, 'f', 1) << "%)"
+                << (isRegression ? "  REGRESSION" : "") << "\n";
+
+            if (isRegression)
+                ok = false;
+        }
+
+        // 99th percentile of the latency of each type of replayed event
+        QJsonObject latencies = scenes[name].toObject()["latencies"].toObject();
+        QJsonObject baselineLatencies = baselineScenes[name].toObject()["latencies"].toObject();
+        foreach (const QString & type, latencies.keys())
+        {
+            if (!latencies[type].isObject() || !baselineLatencies[type].isObject())
+                continue;
+
+            const double t = latencies[type].toObject()["p99"].toDouble();
+            const double t0 = baselineLatencies[type].toObject()["p99"].toDouble();
+            const double change = (t0 > 0) ? (t - t0) / t0 : 0.0;
+            const bool isRegression = (change > tolerance_) && (t - t0 > LATENCY_NOISE_THRESHOLD);
+
+            out << name << "/" << type << "/p99: "
+                << QString::number(t, 'f', 1) << " us (baseline "
+                << QString::number(t0, 'f', 1) << " us, "
+                << (change >= 0 ? "+" : "") << QString::number(100 * change, 'f', 1) << "%)"
+                << (isRegression ? "  REGRESSION" : "") << "\n";
+
+            if (isRegression)
+                ok = false;
+        }
+    }
+
+    return ok;
+}
+
+int Benchmark::exec(const QStringList & arguments)
+{
+    QCommandLineParser parser;
+    QCommandLineOption outputOption("benchmark",
+        "Runs benchmarks and writes results to <file>.", "file");
+    QCommandLineOption baselineOption("benchmark-baseline",
+        "Compares results against the baseline <file>.", "file");
+    QCommandLineOption repeatOption("benchmark-repeat",
+        "Number of repetitions of each operation.", "n", "3");
+    QCommandLineOption toleranceOption("benchmark-tolerance",
+        "Relative slowdown considered a regression.", "ratio", "0.2");
+    QCommandLineOption syntheticOption("benchmark-synthetic",
+        "Comma-separated grid sizes of synthetic scenes.", "sizes", "8,16,32");
+    QCommandLineOption replayOption("benchmark-replay",
+        "Replays the input recording <file>. Can be repeated.", "file");
+    parser.addOption(outputOption);
+    parser.addOption(baselineOption);
+    parser.addOption(repeatOption);
+    parser.addOption(toleranceOption);
+    parser.addOption(syntheticOption);
+    parser.addOption(replayOption);
+    parser.addPositionalArgument("files", "VEC files to benchmark.", "[files...]");
+
+    if (!parser.parse(arguments) || !parser.isSet(outputOption))
+    {
+        qWarning("Benchmark: %s", qPrintable(parser.errorText()));
+        return 2;
+    }
+
+    Benchmark benchmark;
+    benchmark.setNumRepetitions(parser.value(repeatOption).toInt());
+    benchmark.setTolerance(parser.value(toleranceOption).toDouble());
+    QList<int> sizes;
+    foreach (const QString & size, parser.value(syntheticOption).split(",", QString::SkipEmptyParts))
+        sizes << size.toInt();
+    benchmark.setSyntheticSizes(sizes);
+    benchmark.setRecordings(parser.values(replayOption));
+
+    // Run and write results
+    QJsonObject results = benchmark.run(parser.positionalArguments());
+    QFile outputFile(parser.value(outputOption));
+    if (!outputFile.open(QFile::WriteOnly | QFile::Truncate))
+    {
+        qWarning("Benchmark: cannot write %s", qPrintable(parser.value(outputOption)));
+        return 2;
+    }
+    outputFile.write(QJsonDocument(results).toJson());
+    outputFile.close();
+
+    // Compare against baseline
+    if (parser.isSet(baselineOption))
+    {
+        QFile baselineFile(parser.value(baselineOption));
+        if (!baselineFile.open(QFile::ReadOnly))
+        {
+            qWarning("Benchmark: cannot open %s", qPrintable(parser.value(baselineOption)));
+            return 2;
+        }
+        QJsonObject baseline = QJsonDocument::fromJson(baselineFile.readAll()).object();
+        baselineFile.close();
+
+        QTextStream out(stdout);
+        if (!benchmark.compare(results, baseline, out))
+            return 1;
+    }
+
+    return 0;
+}
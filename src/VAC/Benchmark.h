@@ -0,0 +1,116 @@
+// Copyright (C) 2012-2019 The VPaint Developers.
+// See the COPYRIGHT file at the top-level directory of this distribution
+// and at https://github.com/dalboris/vpaint/blob/master/COPYRIGHT
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QJsonObject>
+#include <QList>
+#include <QStringList>
+
+class QTextStream;
+class Scene;
+
+// This class is intended for development only, to catch performance
+// regressions. It times the following operations on a list of VEC files, and
+// on synthetic scenes of increasing size:
+//
+//   - load:        parse the file (already in memory) into a new scene
+//   - check:       VAC::check() on all layers
+//   - triangulate: triangulate all cells at every frame, from a cold cache
+//   - select:      a sweep of rectangles of selection over the canvas
+//   - sketch:      insert a few zig-zag strokes (honoring planar map mode)
+//   - save:        write the scene to memory
+//
+// It also replays long synthetic tablet strokes into a curve being sketched
+// (see SculptCurve), and reports the total fitting time and the percentiles
+// of the latency per input point, over the whole stroke and over its first
+// and last tenth.
+//
+// For each file, it also reports the number of samples of its key edges when
+// they are resampled adaptively (see SculptCurve) with a few tolerances, and
+// the resulting maximum and mean visual error compared to uniform sampling.
+// These are not timings, and are not compared against baseline.
+//
+// Finally, it replays input recordings (see InputRecorder) on the document
+// they embed, and reports the percentiles of the latency of each type of
+// event. Only the VAC operations are timed, not rendering nor picking, since
+// replays run without views. The insertion of sketched edges, which is
+// deferred until their intersections are computed, is reported separately
+// as "sketchCommit".
+//
+// Each operation is repeated several times, and the minimum is reported.
+// Results are JSON, which can be stored as baseline for later runs:
+//
+//     VPaint --benchmark results.json examples/*.vec
+//     VPaint --benchmark results.json --benchmark-baseline baseline.json examples/*.vec
+//     VPaint --benchmark results.json --benchmark-replay recording.json
+//
+// Benchmarks run on separate scenes, so they never modify the current
+// document. However, MainWindow must exist since cells query global().
+//
+class Benchmark
+{
+public:
+    Benchmark();
+
+    // Number of times each operation is run. The minimum is reported.
+    int numRepetitions() const;
+    void setNumRepetitions(int n);
+
+    // Relative slowdown above which an operation is a regression (e.g., 0.2
+    // means 20% slower than baseline). This also applies to the 99th
+    // percentile of the latency of replayed events. Timings below one
+    // millisecond, and latencies below 100 microseconds, are considered
+    // noise and never reported as regressions.
+    double tolerance() const;
+    void setTolerance(double tolerance);
+
+    // Grid sizes of synthetic scenes. A synthetic scene of size n is a grid
+    // of n x n key faces, with their boundary edges and vertices.
+    QList<int> syntheticSizes() const;
+    void setSyntheticSizes(const QList<int> & sizes);
+
+    // Input recordings to replay
+    QStringList recordings() const;
+    void setRecordings(const QStringList & filePaths);
+
+    // Runs all benchmarks on the given files, synthetic scenes, and recordings
+    QJsonObject run(const QStringList & filePaths) const;
+
+    // Prints a comparison of results against baseline, and returns whether
+    // there is no regression
+    bool compare(const QJsonObject & results,
+                 const QJsonObject & baseline,
+                 QTextStream & out) const;
+
+    // Parses the --benchmark* command line options and runs the benchmark.
+    // Returns the process exit code: 0 on success, 1 if there is a
+    // regression, and 2 if the arguments or files are invalid.
+    static int exec(const QStringList & arguments);
+
+private:
+    int numRepetitions_;
+    double tolerance_;
+    QList<int> syntheticSizes_;
+    QStringList recordings_;
+
+    QJsonObject runOne_(const QByteArray & data) const;
+    QJsonObject runStrokes_() const;
+    QJsonObject runReplay_(const QByteArray & data) const;
+};
+
+#endif // BENCHMARK_H
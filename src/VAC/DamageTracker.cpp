@@ -0,0 +1,293 @@
+// Copyright (C) 2012-2019 The VPaint Developers.
+// See the COPYRIGHT file at the top-level directory of this distribution
+// and at https://github.com/dalboris/vpaint/blob/master/COPYRIGHT
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "DamageTracker.h"
+
+#include "Global.h"
+#include "Scene.h"
+#include "ViewSettings.h"
+#include "VectorAnimationComplex/Cell.h"
+#include "VectorAnimationComplex/VAC.h"
+
+#include <QSet>
+
+#include <algorithm>
+#include <cmath>
+
+using VectorAnimationComplex::BoundingBox;
+using VectorAnimationComplex::Cell;
+using VectorAnimationComplex::CellSet;
+using VectorAnimationComplex::VAC;
+
+namespace
+{
+
+// Width, in pixels, by which antialiasing may extend the drawing of a cell
+// beyond its bounding box
+const double ANTIALIASING_MARGIN = 2.0;
+
+}
+
+bool DamageTracker::State::operator==(const State & other) const
+{
+    return std::equal(viewport, viewport + 4, other.viewport) &&
+           std::equal(projection, projection + 16, other.projection) &&
+           std::equal(modelview, modelview + 16, other.modelview) &&
+           time == other.time &&
+           otherTimes == other.otherTimes &&
+           toolMode == other.toolMode &&
+           globalDisplayMode == other.globalDisplayMode &&
+           keyboardModifiers == other.keyboardModifiers &&
+           displayMode == other.displayMode &&
+           drawCursor == other.drawCursor &&
+           vertexTopologySize == other.vertexTopologySize &&
+           edgeTopologyWidth == other.edgeTopologyWidth &&
+           drawTopologyFaces == other.drawTopologyFaces &&
+           screenRelative == other.screenRelative &&
+           zoom == other.zoom &&
+           onionSkinsXOffset == other.onionSkinsXOffset &&
+           onionSkinsYOffset == other.onionSkinsYOffset &&
+           onionSkinsTransparencyRatio == other.onionSkinsTransparencyRatio &&
+           showCanvas == other.showCanvas &&
+           std::equal(canvas, canvas + 4, other.canvas);
+}
+
+DamageTracker::DamageTracker() :
+    state_(),
+    isValid_(false),
+    records_()
+{
+}
+
+DamageTracker::State DamageTracker::currentState_(Scene * scene, Time time,
+                                                  const QList<Time> & otherTimes,
+                                                  const ViewSettings & viewSettings)
+{
+    State res;
+    glGetIntegerv(GL_VIEWPORT, res.viewport);
+    glGetDoublev(GL_PROJECTION_MATRIX, res.projection);
+    glGetDoublev(GL_MODELVIEW_MATRIX, res.modelview);
+    res.time = time;
+    res.otherTimes = otherTimes;
+    res.toolMode = global()->toolMode();
+    res.globalDisplayMode = global()->displayMode();
+    res.keyboardModifiers = int(global()->keyboardModifiers());
+    res.displayMode = viewSettings.displayMode();
+    res.drawCursor = viewSettings.drawCursor();
+    res.vertexTopologySize = viewSettings.vertexTopologySize();
+    res.edgeTopologyWidth = viewSettings.edgeTopologyWidth();
+    res.drawTopologyFaces = viewSettings.drawTopologyFaces();
+    res.screenRelative = viewSettings.screenRelative();
+    res.zoom = viewSettings.zoom();
+    res.onionSkinsXOffset = viewSettings.onionSkinsXOffset();
+    res.onionSkinsYOffset = viewSettings.onionSkinsYOffset();
+    res.onionSkinsTransparencyRatio = viewSettings.onionSkinsTransparencyRatio();
+    res.showCanvas = global()->showCanvas();
+    res.canvas[0] = scene->left();
+    res.canvas[1] = scene->top();
+    res.canvas[2] = scene->width();
+    res.canvas[3] = scene->height();
+    return res;
+}
+
+bool DamageTracker::update(Scene * scene, const QList<VAC*> & vacs,
+                           Time time, const QList<Time> & otherTimes,
+                           const ViewSettings & viewSettings,
+                           QRect & damaged, BoundingBox & cullRegion)
+{
+    damaged = QRect();
+    cullRegion = BoundingBox();
+
+    // Check whether anything else than cells at the given time changed
+    const State state = currentState_(scene, time, otherTimes, viewSettings);
+    bool isFullyDamaged = !(isValid_ && state == state_) || vacs.size() != records_.size();
+    QList<QSet<int>> changedCells;
+    for(int i=0; i<records_.size() && !isFullyDamaged; ++i)
+    {
+        const Record & record = records_[i];
+        QSet<int> ids;
+        if(record.vac != vacs[i] || !record.vac->changedCellsSince(record.revision, ids))
+        {
+            isFullyDamaged = true;
+            break;
+        }
+        for(int j=0; j<otherTimes.size(); ++j)
+        {
+            if(record.vac->isDrawingChangedSince(record.revision, otherTimes[j]))
+            {
+                isFullyDamaged = true;
+                break;
+            }
+        }
+        changedCells << ids;
+    }
+
+    if(isFullyDamaged)
+    {
+        state_ = state;
+        reset_(vacs, viewSettings);
+        return true;
+    }
+
+    // Union of the bounding boxes of changed cells, before and after change
+    BoundingBox damagedRegion;
+    for(int i=0; i<records_.size(); ++i)
+    {
+        Record & record = records_[i];
+        foreach(int id, changedCells[i])
+        {
+            auto it = record.boundingBoxes.find(id);
+            if(it != record.boundingBoxes.end())
+            {
+                damagedRegion.unite(*it);
+                record.boundingBoxes.erase(it);
+            }
+
+            Cell * cell = record.vac->getCell(id);
+            if(cell && cell->exists(time))
+            {
+                BoundingBox bb = cell->drawnBoundingBox(time, viewSettings);
+                damagedRegion.unite(bb);
+                if(!bb.isEmpty())
+                    record.boundingBoxes.insert(id, bb);
+            }
+        }
+        record.revision = record.vac->drawingRevision();
+    }
+
+    if(damagedRegion.isEmpty())
+    {
+        return false;
+    }
+    else if(damagedRegion.isInfinite())
+    {
+        reset_(vacs, viewSettings);
+        return true;
+    }
+
+    // Cells are drawn up to margin_() outside of their bounding box, so
+    // cells up to twice this margin away from the damaged region must be
+    // redrawn to cover the damaged rectangle
+    const double m = margin_();
+    damaged = windowRect_(BoundingBox(damagedRegion.xMin() - m, damagedRegion.xMax() + m,
+                                      damagedRegion.yMin() - m, damagedRegion.yMax() + m));
+    cullRegion = BoundingBox(damagedRegion.xMin() - 2*m, damagedRegion.xMax() + 2*m,
+                             damagedRegion.yMin() - 2*m, damagedRegion.yMax() + 2*m);
+    return false;
+}
+
+void DamageTracker::invalidate()
+{
+    isValid_ = false;
+    records_.clear();
+}
+
+void DamageTracker::reset_(const QList<VAC*> & vacs, const ViewSettings & viewSettings)
+{
+    isValid_ = true;
+    records_.clear();
+    foreach(VAC * vac, vacs)
+    {
+        Record record;
+        record.vac = vac;
+        record.revision = vac->drawingRevision();
+        CellSet cells = vac->cells(state_.time);
+        foreach(Cell * cell, cells)
+        {
+            BoundingBox bb = cell->drawnBoundingBox(state_.time, viewSettings);
+            if(!bb.isEmpty())
+                record.boundingBoxes.insert(cell->id(), bb);
+        }
+        records_ << record;
+    }
+}
+
+double DamageTracker::margin_() const
+{
+    const double zoom = (state_.zoom > 0) ? state_.zoom : 1.0;
+
+    // Outlines, see VertexCell::drawRawTopology() and
+    // EdgeCell::drawRawTopology(). The full width of edges is used, rather
+    // than half of it, to account for their joins.
+    double outline = 0.0;
+    if(state_.displayMode != ViewSettings::ILLUSTRATION)
+    {
+        double r = 0.5 * state_.vertexTopologySize;
+        double w = state_.edgeTopologyWidth;
+        if(state_.screenRelative)
+        {
+            r /= zoom;
+            w /= zoom;
+        }
+        else if(r == 0)
+        {
+            r = 3;
+        }
+        else if(r < 1)
+        {
+            r = 1;
+        }
+        outline = std::max(r, w);
+    }
+
+    return outline + ANTIALIASING_MARGIN / zoom;
+}
+
+QRect DamageTracker::windowRect_(const BoundingBox & bb) const
+{
+    const GLdouble * p = state_.projection;
+    const GLdouble * m = state_.modelview;
+    const GLint * v = state_.viewport;
+
+    // Project the corners of the bounding box to window coordinates
+    double xMin = v[0] + v[2];
+    double xMax = v[0];
+    double yMin = v[1] + v[3];
+    double yMax = v[1];
+    const double xs[2] = { bb.xMin(), bb.xMax() };
+    const double ys[2] = { bb.yMin(), bb.yMax() };
+    for(int i=0; i<2; ++i)
+    {
+        for(int j=0; j<2; ++j)
+        {
+            const double x = xs[i];
+            const double y = ys[j];
+            const double ex = m[0]*x + m[4]*y + m[12];
+            const double ey = m[1]*x + m[5]*y + m[13];
+            const double ez = m[2]*x + m[6]*y + m[14];
+            const double ew = m[3]*x + m[7]*y + m[15];
+            const double cx = p[0]*ex + p[4]*ey + p[8]*ez  + p[12]*ew;
+            const double cy = p[1]*ex + p[5]*ey + p[9]*ez  + p[13]*ew;
+            const double cw = p[3]*ex + p[7]*ey + p[11]*ez + p[15]*ew;
+            const double wx = v[0] + 0.5 * (cx/cw + 1.0) * v[2];
+            const double wy = v[1] + 0.5 * (cy/cw + 1.0) * v[3];
+            xMin = std::min(xMin, wx);
+            xMax = std::max(xMax, wx);
+            yMin = std::min(yMin, wy);
+            yMax = std::max(yMax, wy);
+        }
+    }
+
+    // Round outwards, and clip to the viewport
+    const int x1 = (int) std::max<double>(v[0], std::floor(xMin) - 1);
+    const int x2 = (int) std::min<double>(v[0] + v[2], std::ceil(xMax) + 1);
+    const int y1 = (int) std::max<double>(v[1], std::floor(yMin) - 1);
+    const int y2 = (int) std::min<double>(v[1] + v[3], std::ceil(yMax) + 1);
+    if(x2 <= x1 || y2 <= y1)
+        return QRect();
+    else
+        return QRect(x1, y1, x2 - x1, y2 - y1);
+}
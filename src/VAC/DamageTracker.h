@@ -0,0 +1,115 @@
+// Copyright (C) 2012-2019 The VPaint Developers.
+// See the COPYRIGHT file at the top-level directory of this distribution
+// and at https://github.com/dalboris/vpaint/blob/master/COPYRIGHT
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DAMAGE_TRACKER_H
+#define DAMAGE_TRACKER_H
+
+#include "OpenGL.h"
+#include "TimeDef.h"
+#include "VectorAnimationComplex/BoundingBox.h"
+
+#include <QHash>
+#include <QList>
+#include <QRect>
+
+class Scene;
+class ViewSettings;
+namespace VectorAnimationComplex { class VAC; }
+
+// Tracks which part of a view must be redrawn since its last frame, so that
+// a View can keep what it drew in a buffer and only redraw the damaged part,
+// e.g. when sculpting one edge of a large illustration. A View uses one
+// tracker for its display, and one for its picking image.
+//
+// The damage is the union of the bounding boxes, before and after their
+// change, of the cells which changed since the last frame (see
+// VAC::changedCellsSince()), expanded to account for outlines and
+// antialiasing. Bounding boxes before the change are the ones recorded
+// when the cells were last drawn. Everything is damaged when anything else
+// which affects drawing has changed: the time, the viewport, the view
+// transform, the view settings, the tool and display modes, the keyboard
+// modifiers (which affect highlighting), the canvas, the drawn layers, or
+// the drawing of their VACs at any of the given other times (e.g., onion
+// skins).
+//
+// For simplicity, damaged rectangles are merged into a single rectangle.
+//
+class DamageTracker
+{
+public:
+    DamageTracker();
+
+    // Starts a new frame where the given VACs are drawn at the given time,
+    // with the current OpenGL viewport and matrices. Returns whether
+    // everything must be redrawn. Otherwise, damaged is set to the window
+    // rectangle to redraw (possibly empty), and cullRegion to the scene
+    // region where cells must be redrawn to cover this rectangle.
+    bool update(Scene * scene, const QList<VectorAnimationComplex::VAC*> & vacs,
+                Time time, const QList<Time> & otherTimes,
+                const ViewSettings & viewSettings,
+                QRect & damaged, VectorAnimationComplex::BoundingBox & cullRegion);
+
+    // Forces everything to be redrawn in the next frame, e.g. when a
+    // background changed, or when what was drawn has been lost
+    void invalidate();
+
+private:
+    // Everything which affects drawing, apart from the VACs themselves
+    struct State
+    {
+        GLint viewport[4];
+        GLdouble projection[16];
+        GLdouble modelview[16];
+        Time time;
+        QList<Time> otherTimes;
+        int toolMode;
+        int globalDisplayMode;
+        int keyboardModifiers;
+        int displayMode;
+        bool drawCursor;
+        int vertexTopologySize;
+        int edgeTopologyWidth;
+        bool drawTopologyFaces;
+        bool screenRelative;
+        double zoom;
+        double onionSkinsXOffset;
+        double onionSkinsYOffset;
+        double onionSkinsTransparencyRatio;
+        bool showCanvas;
+        double canvas[4];
+
+        bool operator==(const State & other) const;
+    };
+    State state_;
+    bool isValid_;
+
+    // What was last drawn for each VAC
+    struct Record
+    {
+        VectorAnimationComplex::VAC * vac;
+        quint64 revision;
+        QHash<int, VectorAnimationComplex::BoundingBox> boundingBoxes;
+    };
+    QList<Record> records_;
+
+    static State currentState_(Scene * scene, Time time, const QList<Time> & otherTimes,
+                               const ViewSettings & viewSettings);
+    void reset_(const QList<VectorAnimationComplex::VAC*> & vacs, const ViewSettings & viewSettings);
+    double margin_() const;
+    QRect windowRect_(const VectorAnimationComplex::BoundingBox & bb) const;
+};
+
+#endif // DAMAGE_TRACKER_H
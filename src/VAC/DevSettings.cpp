@@ -15,8 +15,15 @@
 // limitations under the License.
 
 #include "DevSettings.h"
+#include "Global.h"
+#include "InputRecorder.h"
+#include "Profiler.h"
+#include "Timeline.h"
 
+#include <QFileDialog>
 #include <QLabel>
+#include <QMessageBox>
+#include <QPushButton>
 #include <QtDebug>
 
 DevSettings * DevSettings::s = 0;
@@ -39,9 +46,64 @@ DevSettings::DevSettings()
 
     createCheckBox("draw edge orientation", false);
 
+    addSection("Profiling");
+
+    QCheckBox * profilerCheckBox = createCheckBox("profiler", false);
+    connect(profilerCheckBox, &QCheckBox::toggled, this, &DevSettings::onProfilerToggled_);
+
+    QPushButton * exportTraceButton = new QPushButton(tr("Export..."));
+    connect(exportTraceButton, &QPushButton::clicked, this, &DevSettings::onExportProfilerTraceClicked_);
+    addWidget(exportTraceButton, "Chrome trace");
+
+    QCheckBox * recordInputCheckBox = createCheckBox("record input", false);
+    connect(recordInputCheckBox, &QCheckBox::toggled, this, &DevSettings::onRecordInputToggled_);
+
+    QPushButton * saveRecordingButton = new QPushButton(tr("Save..."));
+    connect(saveRecordingButton, &QPushButton::clicked, this, &DevSettings::onSaveInputRecordingClicked_);
+    addWidget(saveRecordingButton, "Input recording");
+
     setLayout(layout_);
 }
 
+void DevSettings::onProfilerToggled_(bool checked)
+{
+    Profiler::setEnabled(checked);
+}
+
+void DevSettings::onExportProfilerTraceClicked_()
+{
+    QString filePath = QFileDialog::getSaveFileName(this, tr("Export Chrome Trace"), QString(), tr("JSON files (*.json)"));
+    if (filePath.isEmpty())
+        return;
+
+    if (!filePath.endsWith(".json"))
+        filePath.append(".json");
+
+    if (!Profiler::exportChromeTrace(filePath))
+        QMessageBox::warning(this, tr("Error"), tr("Error: couldn't write file %1").arg(filePath));
+}
+
+void DevSettings::onRecordInputToggled_(bool checked)
+{
+    if (checked)
+        InputRecorder::start(global()->scene(), global()->timeline()->playbackSettings());
+    else
+        InputRecorder::stop();
+}
+
+void DevSettings::onSaveInputRecordingClicked_()
+{
+    QString filePath = QFileDialog::getSaveFileName(this, tr("Save Input Recording"), QString(), tr("JSON files (*.json)"));
+    if (filePath.isEmpty())
+        return;
+
+    if (!filePath.endsWith(".json"))
+        filePath.append(".json");
+
+    if (!InputRecorder::save(filePath))
+        QMessageBox::warning(this, tr("Error"), tr("Error: couldn't write file %1").arg(filePath));
+}
+
 bool DevSettings::getBool(const QString & name)
 {
     if(!s || !s->checkBoxes_.contains(name))
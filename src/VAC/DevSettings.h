@@ -48,6 +48,12 @@ public:
 signals:
     void changed();
 
+private slots:
+    void onProfilerToggled_(bool checked);
+    void onExportProfilerTraceClicked_();
+    void onRecordInputToggled_(bool checked);
+    void onSaveInputRecordingClicked_();
+
 private:
     static DevSettings *s;
 
@@ -0,0 +1,201 @@
+// Copyright (C) 2012-2019 The VPaint Developers.
+// See the COPYRIGHT file at the top-level directory of this distribution
+// and at https://github.com/dalboris/vpaint/blob/master/COPYRIGHT
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "DocumentSaver.h"
+
+#include "Layer.h"
+#include "Scene.h"
+#include "Version.h"
+#include "XmlStreamWriter.h"
+
+#include <QCoreApplication>
+#include <QRunnable>
+#include <QSaveFile>
+
+namespace
+{
+
+class Writer: public QRunnable
+{
+public:
+    Writer(DocumentSaver * saver, int id, Scene * snapshot,
+           const PlaybackSettings & playback, const QString & filePath) :
+        saver_(saver),
+        id_(id),
+        snapshot_(snapshot),
+        playback_(playback),
+        filePath_(filePath)
+    {
+    }
+
+    void run()
+    {
+        QString errorString;
+
+        QSaveFile file(filePath_);
+        if (!file.open(QIODevice::WriteOnly | QFile::Text))
+        {
+            errorString = file.errorString();
+        }
+        else
+        {
+            const int numLayers = snapshot_->numLayers();
+            XmlStreamWriter xml(&file);
+            DocumentSaver::write(xml, snapshot_, playback_, [this, numLayers](int numLayersWritten)
+            {
+                QMetaObject::invokeMethod(saver_, "onProgress_", Qt::QueuedConnection,
+                                          Q_ARG(int, id_),
+                                          Q_ARG(QString, filePath_),
+                                          Q_ARG(int, numLayersWritten),
+                                          Q_ARG(int, numLayers));
+            });
+
+            // Renames the temporary file to filePath_. If writing failed,
+            // the temporary file is discarded and filePath_ is untouched.
+            if (xml.hasError())
+            {
+                file.cancelWriting();
+                errorString = QCoreApplication::translate("DocumentSaver", "couldn't write file");
+            }
+            else if (!file.commit())
+            {
+                errorString = file.errorString();
+            }
+        }
+
+        QMetaObject::invokeMethod(saver_, "onFinished_", Qt::QueuedConnection,
+                                  Q_ARG(int, id_),
+                                  Q_ARG(QString, filePath_),
+                                  Q_ARG(QString, errorString));
+    }
+
+private:
+    DocumentSaver * saver_;
+    int id_;
+    Scene * snapshot_;
+    PlaybackSettings playback_;
+    QString filePath_;
+};
+
+}
+
+DocumentSaver::DocumentSaver(QObject * parent) :
+    QObject(parent),
+    lastId_(0)
+{
+    threadPool_.setMaxThreadCount(1);
+}
+
+DocumentSaver::~DocumentSaver()
+{
+    threadPool_.waitForDone();
+    foreach (Scene * snapshot, snapshots_)
+        delete snapshot;
+}
+
+int DocumentSaver::save(Scene * scene, const PlaybackSettings & playback, const QString & filePath)
+{
+    Scene * snapshot = new Scene();
+    snapshot->copyFrom(scene);
+    snapshot->setLeft(scene->left());
+    snapshot->setTop(scene->top());
+    snapshot->setWidth(scene->width());
+    snapshot->setHeight(scene->height());
+
+    const int id = ++lastId_;
+    snapshots_.insert(id, snapshot);
+    threadPool_.start(new Writer(this, id, snapshot, playback, filePath));
+    return id;
+}
+
+bool DocumentSaver::isSaving() const
+{
+    return !snapshots_.isEmpty();
+}
+
+void DocumentSaver::waitForDone()
+{
+    threadPool_.waitForDone();
+    QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
+}
+
+void DocumentSaver::write(XmlStreamWriter & xml, Scene * scene, const PlaybackSettings & playback,
+                          std::function<void(int)> layerWritten)
+{
+    // Start XML Document
+    xml.writeStartDocument();
+
+    // Header
+    xml.writeComment(" Created with VPaint (http://www.vpaint.org) ");
+    xml.writeCharacters("\n\n");
+
+    // Document
+    xml.writeStartElement("vec");
+    {
+        Version version(qApp->applicationVersion());
+        bool ignorePatch = true;
+        xml.writeAttribute("version", version.toString(ignorePatch));
+
+        // Playback
+        xml.writeStartElement("playback");
+        playback.write(xml);
+        xml.writeEndElement();
+
+        // Canvas
+        xml.writeStartElement("canvas");
+        scene->writeCanvas(xml);
+        xml.writeEndElement();
+
+        // Sampling, only if edges are adaptively sampled
+        if (scene->samplingTolerance() > 0)
+        {
+            xml.writeStartElement("sampling");
+            scene->writeSampling(xml);
+            xml.writeEndElement();
+        }
+
+        // Layers
+        for (int i = 0; i < scene->numLayers(); ++i)
+        {
+            xml.writeStartElement("layer");
+            scene->layer(i)->write(xml);
+            xml.writeEndElement();
+
+            if (layerWritten)
+                layerWritten(i+1);
+        }
+    }
+    xml.writeEndElement();
+
+    // End XML Document
+    xml.writeEndDocument();
+}
+
+void DocumentSaver::onProgress_(int id, const QString & filePath, int numLayersWritten, int numLayers)
+{
+    emit progress(id, filePath, numLayersWritten, numLayers);
+}
+
+void DocumentSaver::onFinished_(int id, const QString & filePath, const QString & errorString)
+{
+    delete snapshots_.take(id);
+
+    if (errorString.isEmpty())
+        emit saved(id, filePath);
+    else
+        emit failed(id, filePath, errorString);
+}
@@ -0,0 +1,89 @@
+// Copyright (C) 2012-2019 The VPaint Developers.
+// See the COPYRIGHT file at the top-level directory of this distribution
+// and at https://github.com/dalboris/vpaint/blob/master/COPYRIGHT
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef DOCUMENT_SAVER_H
+#define DOCUMENT_SAVER_H
+
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+
+#include <functional>
+
+#include "Timeline.h"
+
+class Scene;
+class XmlStreamWriter;
+
+// Saves documents in a worker thread, so that the GUI doesn't freeze while
+// a big document is serialized.
+//
+// When a save is requested, a snapshot of the scene is made in the calling
+// thread, the same way as for the undo stack (i.e., Scene::copyFrom(), which
+// is cheap since edge geometry is shared between copies until modified).
+// The snapshot is then written in the worker thread through a QSaveFile, so
+// that the file is atomically replaced once fully written, and never left
+// half-written if the application crashes or the disk is full.
+//
+// Saves are performed one at a time, in the order they are requested.
+//
+// This class must only be used from the GUI thread.
+//
+class DocumentSaver: public QObject
+{
+    Q_OBJECT
+
+public:
+    DocumentSaver(QObject * parent = nullptr);
+
+    // Waits for pending saves
+    ~DocumentSaver();
+
+    // Takes a snapshot of the given scene and playback settings, and schedules
+    // writing it to the given file. Returns an identifier of this save, passed
+    // to the signals below.
+    int save(Scene * scene, const PlaybackSettings & playback, const QString & filePath);
+
+    // Returns whether there are saves not finished yet
+    bool isSaving() const;
+
+    // Blocks until all saves are finished, and emits their signals before
+    // returning
+    void waitForDone();
+
+    // Writes the whole document. The callback, if any, is called after each
+    // layer with the number of layers written so far.
+    static void write(XmlStreamWriter & xml, Scene * scene, const PlaybackSettings & playback,
+                      std::function<void(int)> layerWritten = nullptr);
+
+signals:
+    void progress(int id, const QString & filePath, int numLayersWritten, int numLayers);
+    void saved(int id, const QString & filePath);
+    void failed(int id, const QString & filePath, const QString & errorString);
+
+private slots:
+    void onProgress_(int id, const QString & filePath, int numLayersWritten, int numLayers);
+    void onFinished_(int id, const QString & filePath, const QString & errorString);
+
+private:
+    QThreadPool threadPool_;
+    QHash<int, Scene*> snapshots_; // pending saves, deleted in the GUI thread once done
+    int lastId_;
+};
+
+#endif // DOCUMENT_SAVER_H
@@ -77,6 +77,11 @@ ExportPngDialog::ExportPngDialog(Scene * scene) :
     useViewSettings_->setChecked(false);
     renderingLayout->addWidget(useViewSettings_);
 
+    useSoftwareRendering_ = new QCheckBox(tr("Software rendering"));
+    useSoftwareRendering_->setToolTip(tr("Render on the CPU instead of the GPU. View settings are ignored."));
+    useSoftwareRendering_->setChecked(false);
+    renderingLayout->addWidget(useSoftwareRendering_);
+
     motionBlurCheckBox_ = new QCheckBox(tr("Motion blur"));
     motionBlurCheckBox_->setChecked(false);
     renderingLayout->addWidget(motionBlurCheckBox_);
@@ -146,6 +151,11 @@ bool ExportPngDialog::useViewSettings() const
     return useViewSettings_->isChecked();
 }
 
+bool ExportPngDialog::useSoftwareRendering() const
+{
+    return useSoftwareRendering_->isChecked();
+}
+
 bool ExportPngDialog::motionBlur() const
 {
     return motionBlurCheckBox_->isChecked();
@@ -44,6 +44,7 @@ public:
     bool preserveAspectRatio() const;
     bool exportSequence() const;
     bool useViewSettings() const;
+    bool useSoftwareRendering() const;
 
     // Motion blur
     bool motionBlur() const;
@@ -71,6 +72,7 @@ private:
     QCheckBox * preserveAspectRatioCheckBox_;
     QCheckBox * exportSequenceCheckBox_;
     QCheckBox * useViewSettings_;
+    QCheckBox * useSoftwareRendering_;
 
     QCheckBox * motionBlurCheckBox_;
     QSpinBox * motionBlurNumSamplesSpinBox_;
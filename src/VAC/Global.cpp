@@ -100,6 +100,15 @@ Qt::KeyboardModifiers Global::keyboardModifiers()
     return keyboardModifiers_;
 }
 
+void Global::setKeyboardModifiers(Qt::KeyboardModifiers modifiers)
+{
+    if(keyboardModifiers_ != modifiers)
+    {
+        keyboardModifiers_ = modifiers;
+        emit keyboardModifiersChanged();
+    }
+}
+
 void Global::updateModifiers()
 {
     Qt::KeyboardModifiers keyboardModifiers = QGuiApplication::queryKeyboardModifiers();
@@ -868,11 +877,23 @@ bool Global::planarMapMode() const
     return actionPlanarMapMode_->isChecked();
 }
 
+void Global::setPlanarMapMode(bool b)
+{
+    if(planarMapMode() != b)
+        actionPlanarMapMode_->trigger();
+}
+
 bool Global::snapMode() const
 {
     return actionSnapMode_->isChecked();
 }
 
+void Global::setSnapMode(bool b)
+{
+    if(snapMode() != b)
+        actionSnapMode_->trigger();
+}
+
 double Global::snapThreshold() const
 {
     return snapThreshold_->value();
@@ -78,8 +78,10 @@ public:
     // Menus
     void addSelectionActions(QMenu * selectionMenu);
 
-    // Keyboard state
+    // Keyboard state. The setter overrides the state until the next
+    // keyboard event, which is useful to replay recorded input.
     Qt::KeyboardModifiers keyboardModifiers();
+    void setKeyboardModifiers(Qt::KeyboardModifiers modifiers);
 
     // Tablet pressure
     bool useTabletPressure() const;
@@ -90,9 +92,11 @@ public:
 
     // Planar map mode
     bool planarMapMode() const;
+    void setPlanarMapMode(bool b);
 
     // snapping
     bool snapMode() const;
+    void setSnapMode(bool b);
     double snapThreshold() const;
     void setSnapThreshold(double newSnapThreshold);
 
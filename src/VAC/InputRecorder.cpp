@@ -0,0 +1,371 @@
+// Copyright (C) 2012-2019 The VPaint Developers.
+// See the COPYRIGHT file at the top-level directory of this distribution
+// and at https://github.com/dalboris/vpaint/blob/master/COPYRIGHT
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "InputRecorder.h"
+
+#include "DocumentSaver.h"
+#include "Global.h"
+#include "Layer.h"
+#include "Scene.h"
+#include "Timeline.h"
+#include "XmlStreamWriter.h"
+#include "VectorAnimationComplex/VAC.h"
+
+#include <QBuffer>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QtDebug>
+
+namespace
+{
+
+// Version of the file format
+const int VERSION = 1;
+
+// Maximum number of recorded events (about one hour of continuous drawing
+// at 200 Hz). Later events are discarded.
+const size_t MAX_NUM_EVENTS = 1 << 20;
+
+const char * TYPE_NAMES[] = {
+    "sketchBegin", "sketchContinue", "sketchEnd",
+    "dragBegin", "dragContinue", "dragEnd",
+    "transformBegin", "transformContinue", "transformEnd",
+    "rectangleBegin", "rectangleContinue", "rectangleEnd",
+    "sculptUpdate",
+    "sculptDeformBegin", "sculptDeformContinue", "sculptDeformEnd",
+    "sculptWidthBegin", "sculptWidthContinue", "sculptWidthEnd",
+    "sculptSmoothBegin", "sculptSmoothContinue", "sculptSmoothEnd",
+    "split",
+    "paintUpdate", "paint",
+    "select", "addSelect", "deselect", "toggleSelect", "deselectAll"
+};
+static_assert(sizeof(TYPE_NAMES) / sizeof(TYPE_NAMES[0]) == InputEvent::NumTypes,
+              "TYPE_NAMES must have one name per InputEvent::Type");
+
+const char * TOOL_NAMES[] = { "select", "sketch", "paint", "sculpt" };
+const char * EDIT_CANVAS_SIZE_NAME = "editCanvasSize";
+
+QByteArray document;
+std::vector<InputEvent> events;
+QElapsedTimer timer;
+
+// Returns whether the event has a position
+bool hasPosition_(InputEvent::Type type)
+{
+    switch (type)
+    {
+    case InputEvent::SketchEnd:
+    case InputEvent::DragEnd:
+    case InputEvent::TransformEnd:
+    case InputEvent::RectangleEnd:
+    case InputEvent::SculptDeformEnd:
+    case InputEvent::SculptWidthEnd:
+    case InputEvent::SculptSmoothEnd:
+    case InputEvent::DeselectAll:
+        return false;
+    default:
+        return true;
+    }
+}
+
+QString toolName_(int toolMode)
+{
+    if (toolMode >= 0 && toolMode < Global::NUMBER_OF_TOOL_MODES)
+        return TOOL_NAMES[toolMode];
+    else
+        return EDIT_CANVAS_SIZE_NAME;
+}
+
+int toolMode_(const QString & name)
+{
+    for (int i = 0; i < Global::NUMBER_OF_TOOL_MODES; ++i)
+        if (name == TOOL_NAMES[i])
+            return i;
+    return Global::EDIT_CANVAS_SIZE;
+}
+
+QJsonObject write_(const InputEvent & event, const InputEvent * previous)
+{
+    QJsonObject res;
+    res["t"] = event.timestamp * 1e-6;
+    res["type"] = InputEvent::typeName(event.type);
+    if (hasPosition_(event.type))
+    {
+        res["x"] = event.x;
+        res["y"] = event.y;
+    }
+    if (event.type == InputEvent::SketchBegin || event.type == InputEvent::SketchContinue)
+        res["w"] = event.w;
+    if (event.hovered >= 0)
+        res["hovered"] = event.hovered;
+
+    // State, only if changed
+    if (!previous || event.toolMode != previous->toolMode)
+        res["tool"] = toolName_(event.toolMode);
+    if (!previous || event.modifiers != previous->modifiers)
+        res["modifiers"] = event.modifiers;
+    if (!previous || event.planarMapMode != previous->planarMapMode)
+        res["planarMapMode"] = event.planarMapMode;
+    if (!previous || event.snapMode != previous->snapMode)
+        res["snapMode"] = event.snapMode;
+    if (!previous || event.snapThreshold != previous->snapThreshold)
+        res["snapThreshold"] = event.snapThreshold;
+    if (!previous || event.sculptRadius != previous->sculptRadius)
+        res["sculptRadius"] = event.sculptRadius;
+    if (!previous || event.time != previous->time)
+        res["time"] = event.time.floatTime();
+    if (!previous || event.layer != previous->layer)
+        res["layer"] = event.layer;
+
+    return res;
+}
+
+// Reads an event, taking the state not written from the previous event
+bool read_(const QJsonObject & json, InputEvent & event)
+{
+    const QString typeName = json["type"].toString();
+    int type = 0;
+    while (type < InputEvent::NumTypes && typeName != TYPE_NAMES[type])
+        ++type;
+    if (type == InputEvent::NumTypes)
+    {
+        qDebug() << "Error: unknown input event type" << typeName;
+        return false;
+    }
+
+    event.type = static_cast<InputEvent::Type>(type);
+    event.timestamp = static_cast<qint64>(json["t"].toDouble() * 1e6);
+    event.x = json["x"].toDouble();
+    event.y = json["y"].toDouble();
+    event.w = json["w"].toDouble();
+    event.hovered = json["hovered"].toInt(-1);
+
+    if (json.contains("tool"))
+        event.toolMode = toolMode_(json["tool"].toString());
+    event.modifiers = json["modifiers"].toInt(event.modifiers);
+    event.planarMapMode = json["planarMapMode"].toBool(event.planarMapMode);
+    event.snapMode = json["snapMode"].toBool(event.snapMode);
+    event.snapThreshold = json["snapThreshold"].toDouble(event.snapThreshold);
+    event.sculptRadius = json["sculptRadius"].toDouble(event.sculptRadius);
+    if (json.contains("time"))
+        event.time = Time(json["time"].toDouble());
+    event.layer = json["layer"].toInt(event.layer);
+
+    return true;
+}
+
+}
+
+InputEvent::InputEvent() :
+    type(SketchBegin),
+    timestamp(0),
+    x(0), y(0), w(0),
+    time(),
+    layer(0),
+    hovered(-1),
+    toolMode(Global::SELECT),
+    modifiers(0),
+    planarMapMode(true),
+    snapMode(true),
+    snapThreshold(0),
+    sculptRadius(0)
+{
+}
+
+QString InputEvent::typeName(Type type)
+{
+    return TYPE_NAMES[type];
+}
+
+bool InputRecorder::recording_ = false;
+
+void InputRecorder::start(Scene * scene, const PlaybackSettings & playback)
+{
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    {
+        XmlStreamWriter xml(&buffer);
+        DocumentSaver::write(xml, scene, playback);
+    }
+
+    document = buffer.data();
+    events.clear();
+    timer.start();
+    recording_ = true;
+}
+
+void InputRecorder::stop()
+{
+    recording_ = false;
+}
+
+void InputRecorder::record(InputEvent::Type type, int layer, int hovered, Time time,
+                           double x, double y, double w)
+{
+    if (!recording_)
+        return;
+
+    if (events.size() >= MAX_NUM_EVENTS)
+    {
+        qDebug() << "Error: too many input events, recording stopped";
+        recording_ = false;
+        return;
+    }
+
+    InputEvent event;
+    event.type = type;
+    event.timestamp = timer.nsecsElapsed();
+    event.x = x;
+    event.y = y;
+    event.w = w;
+    event.time = time;
+    event.layer = layer;
+    event.hovered = hovered;
+    event.toolMode = global()->toolMode();
+    event.modifiers = static_cast<int>(global()->keyboardModifiers());
+    event.planarMapMode = global()->planarMapMode();
+    event.snapMode = global()->snapMode();
+    event.snapThreshold = global()->snapThreshold();
+    event.sculptRadius = global()->sculptRadius();
+    events.push_back(event);
+}
+
+bool InputRecorder::save(const QString & filePath)
+{
+    QJsonArray jsonEvents;
+    for (size_t i = 0; i < events.size(); ++i)
+        jsonEvents.append(write_(events[i], i > 0 ? &events[i-1] : nullptr));
+
+    QJsonObject json;
+    json["version"] = VERSION;
+    json["application"] = qApp->applicationVersion();
+    json["document"] = QString::fromUtf8(document);
+    json["events"] = jsonEvents;
+
+    QSaveFile file(filePath);
+    if (!file.open(QFile::WriteOnly))
+    {
+        qDebug() << "Error: cannot open file" << filePath;
+        return false;
+    }
+    file.write(QJsonDocument(json).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
+
+bool InputRecorder::read(const QByteArray & data, QByteArray & document,
+                         std::vector<InputEvent> & events)
+{
+    QJsonObject json = QJsonDocument::fromJson(data).object();
+    if (json["version"].toInt() != VERSION || !json.contains("document"))
+    {
+        qDebug() << "Error: not an input recording, or unsupported version";
+        return false;
+    }
+
+    document = json["document"].toString().toUtf8();
+
+    QJsonArray jsonEvents = json["events"].toArray();
+    events.clear();
+    events.reserve(jsonEvents.size());
+    InputEvent event;
+    foreach (const QJsonValue & jsonEvent, jsonEvents)
+    {
+        if (!read_(jsonEvent.toObject(), event))
+            return false;
+        events.push_back(event);
+    }
+
+    return true;
+}
+
+void InputRecorder::restoreState(const InputEvent & event, Scene * scene)
+{
+    Global * g = global();
+    if (event.toolMode < Global::NUMBER_OF_TOOL_MODES && event.toolMode != g->toolMode())
+        g->setToolMode(static_cast<Global::ToolMode>(event.toolMode));
+    g->setKeyboardModifiers(static_cast<Qt::KeyboardModifiers>(event.modifiers));
+    g->setPlanarMapMode(event.planarMapMode);
+    g->setSnapMode(event.snapMode);
+    if (event.snapThreshold != g->snapThreshold())
+        g->setSnapThreshold(event.snapThreshold);
+    if (event.sculptRadius != g->sculptRadius())
+        g->setSculptRadius(event.sculptRadius);
+
+    if (event.layer < 0 || event.layer >= scene->numLayers())
+        return;
+    if (event.hovered >= 0)
+        scene->setHoveredObject(event.time, event.layer, event.hovered);
+    else
+        scene->setNoHoveredObject();
+
+    // View always updates the face to be painted before painting, but the
+    // recording may have started just before the click
+    if (event.type == InputEvent::Paint)
+        scene->layer(event.layer)->vac()->updateToBePaintedFace(event.x, event.y, event.time);
+}
+
+void InputRecorder::replay(const InputEvent & event, Scene * scene)
+{
+    using namespace VectorAnimationComplex;
+
+    if (event.layer < 0 || event.layer >= scene->numLayers())
+        return;
+
+    VAC * vac = scene->layer(event.layer)->vac();
+    const double x = event.x;
+    const double y = event.y;
+    const Time t = event.time;
+
+    switch (event.type)
+    {
+    case InputEvent::SketchBegin: vac->beginSketchEdge(x, y, event.w, t); break;
+    case InputEvent::SketchContinue: vac->continueSketchEdge(x, y, event.w); break;
+    case InputEvent::SketchEnd: vac->endSketchEdge(); break;
+    case InputEvent::DragBegin: vac->prepareDragAndDrop(x, y, t); break;
+    case InputEvent::DragContinue: vac->performDragAndDrop(x, y); break;
+    case InputEvent::DragEnd: vac->completeDragAndDrop(); break;
+    case InputEvent::TransformBegin: vac->beginTransformSelection(x, y, t); break;
+    case InputEvent::TransformContinue: vac->continueTransformSelection(x, y); break;
+    case InputEvent::TransformEnd: vac->endTransformSelection(); break;
+    case InputEvent::RectangleBegin: vac->beginRectangleOfSelection(x, y, t); break;
+    case InputEvent::RectangleContinue: vac->continueRectangleOfSelection(x, y); break;
+    case InputEvent::RectangleEnd: vac->endRectangleOfSelection(); break;
+    case InputEvent::SculptUpdate: vac->updateSculpt(x, y, t); break;
+    case InputEvent::SculptDeformBegin: vac->beginSculptDeform(x, y); break;
+    case InputEvent::SculptDeformContinue: vac->continueSculptDeform(x, y); break;
+    case InputEvent::SculptDeformEnd: vac->endSculptDeform(); break;
+    case InputEvent::SculptWidthBegin: vac->beginSculptEdgeWidth(x, y); break;
+    case InputEvent::SculptWidthContinue: vac->continueSculptEdgeWidth(x, y); break;
+    case InputEvent::SculptWidthEnd: vac->endSculptEdgeWidth(); break;
+    case InputEvent::SculptSmoothBegin: vac->beginSculptSmooth(x, y); break;
+    case InputEvent::SculptSmoothContinue: vac->continueSculptSmooth(x, y); break;
+    case InputEvent::SculptSmoothEnd: vac->endSculptSmooth(); break;
+    case InputEvent::Split: vac->split(x, y, t, true); break;
+    case InputEvent::PaintUpdate: vac->updateToBePaintedFace(x, y, t); break;
+    case InputEvent::Paint: vac->paint(x, y, t); break;
+    case InputEvent::Select: scene->deselectAll(); scene->select(t, event.layer, event.hovered); break;
+    case InputEvent::AddSelect: scene->select(t, event.layer, event.hovered); break;
+    case InputEvent::Deselect: scene->deselect(t, event.layer, event.hovered); break;
+    case InputEvent::ToggleSelect: scene->toggle(t, event.layer, event.hovered); break;
+    case InputEvent::DeselectAll: scene->deselectAll(); break;
+    case InputEvent::NumTypes: break;
+    }
+}
@@ -0,0 +1,140 @@
+// Copyright (C) 2012-2019 The VPaint Developers.
+// See the COPYRIGHT file at the top-level directory of this distribution
+// and at https://github.com/dalboris/vpaint/blob/master/COPYRIGHT
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef INPUT_RECORDER_H
+#define INPUT_RECORDER_H
+
+#include "TimeDef.h"
+
+#include <QByteArray>
+#include <QString>
+#include <QtGlobal>
+
+#include <vector>
+
+class PlaybackSettings;
+class Scene;
+
+// A tool-level input event, that is, one call from View to the VAC. Events
+// store the state they depend on (tool mode, keyboard modifiers, tool
+// settings, and hovered object), so that they can be replayed without a
+// View, since picking requires OpenGL.
+//
+struct InputEvent
+{
+    enum Type {
+        SketchBegin, SketchContinue, SketchEnd,
+        DragBegin, DragContinue, DragEnd,
+        TransformBegin, TransformContinue, TransformEnd,
+        RectangleBegin, RectangleContinue, RectangleEnd,
+        SculptUpdate,
+        SculptDeformBegin, SculptDeformContinue, SculptDeformEnd,
+        SculptWidthBegin, SculptWidthContinue, SculptWidthEnd,
+        SculptSmoothBegin, SculptSmoothContinue, SculptSmoothEnd,
+        Split,
+        PaintUpdate, Paint,
+        Select, AddSelect, Deselect, ToggleSelect, DeselectAll,
+        NumTypes // Keep this one last
+    };
+
+    InputEvent();
+
+    Type type;
+    qint64 timestamp; // nanoseconds since the recording started
+    double x, y;      // scene coordinates, if any
+    double w;         // edge width, for sketching only
+    Time time;
+    int layer;        // index of the layer acted on
+    int hovered;      // ID of the hovered object, or -1 if none
+
+    int toolMode;
+    int modifiers;
+    bool planarMapMode;
+    bool snapMode;
+    double snapThreshold;
+    double sculptRadius;
+
+    // Name of the given type, as written in recordings (e.g., "sketchBegin")
+    static QString typeName(Type type);
+};
+
+// Records tool-level input events into a file that can be attached to bug
+// reports, and replayed headlessly by Benchmark to measure the latency of
+// each event (see VPaint --benchmark-replay).
+//
+// A recording starts with a copy of the document, so that it can be replayed
+// from the exact same state. Then, View calls record() just before each VAC
+// operation triggered by the mouse or tablet. It is enabled via the "record
+// input" dev setting.
+//
+// Recordings are JSON:
+//
+//     {
+//       "version": 1,
+//       "document": "<?xml ...",
+//       "events": [
+//         { "t": 0, "type": "sketchBegin", "x": 10, "y": 20, "w": 3,
+//           "tool": "sketch", "layer": 0, "time": 0, ... },
+//         { "t": 4.98, "type": "sketchContinue", "x": 11, "y": 20, "w": 3 },
+//         ...
+//       ]
+//     }
+//
+// where "t" is in milliseconds, and the state of an event (tool mode,
+// modifiers, tool settings, time and layer) is only written when it differs
+// from the previous event.
+//
+// All functions must be called from the GUI thread.
+//
+class InputRecorder
+{
+public:
+    // Starts a new recording, with a copy of the given document
+    static void start(Scene * scene, const PlaybackSettings & playback);
+
+    // Stops recording. Doesn't clear recorded events.
+    static void stop();
+
+    // Returns whether events are being recorded
+    static bool isRecording() { return recording_; }
+
+    // Records an event of the given type. The timestamp, tool mode, modifiers
+    // and tool settings are taken from the current state of the application.
+    static void record(InputEvent::Type type, int layer, int hovered, Time time,
+                       double x = 0, double y = 0, double w = 0);
+
+    // Writes the recording to the given file. Returns false if the file
+    // couldn't be written.
+    static bool save(const QString & filePath);
+
+    // Parses a recording. Returns false if the data is not a valid recording.
+    static bool read(const QByteArray & data, QByteArray & document,
+                     std::vector<InputEvent> & events);
+
+    // Restores the state of the application and of the given scene the event
+    // depends on: tool mode, modifiers, tool settings, and hovered object
+    static void restoreState(const InputEvent & event, Scene * scene);
+
+    // Performs the VAC operation of the event on the given scene. Call
+    // restoreState() first.
+    static void replay(const InputEvent & event, Scene * scene);
+
+private:
+    static bool recording_;
+};
+
+#endif // INPUT_RECORDER_H
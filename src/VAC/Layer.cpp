@@ -96,6 +96,14 @@ void Layer::draw(Time time, ViewSettings & viewSettings)
     }
 }
 
+void Layer::rasterize(Time time, VectorAnimationComplex::Rasterizer & rasterizer)
+{
+    // Same as draw(), but using the software rasterizer
+    if (isVisible()) {
+        vac()->rasterize(time, rasterizer);
+    }
+}
+
 void Layer::drawPick(Time time, ViewSettings & viewSettings)
 {
     if (isVisible()) {
@@ -103,6 +111,14 @@ void Layer::drawPick(Time time, ViewSettings & viewSettings)
     }
 }
 
+void Layer::drawPick(Time time, ViewSettings & viewSettings,
+                     const VectorAnimationComplex::BoundingBox & region)
+{
+    if (isVisible()) {
+        vac()->drawPick(time, viewSettings, &region);
+    }
+}
+
 void Layer::setHoveredObject(Time time, int id)
 {
     vac()->setHoveredObject(time, id);
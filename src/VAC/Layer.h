@@ -20,7 +20,7 @@
 #include "SceneObject.h"
 
 class Background;
-namespace VectorAnimationComplex { class VAC; }
+namespace VectorAnimationComplex { class VAC; class Rasterizer; class BoundingBox; }
 class XmlStreamReader;
 class XmlStreamWriter;
 
@@ -49,6 +49,9 @@ public:
     
     void draw(Time time, ViewSettings & viewSettings) override;
     void drawPick(Time time, ViewSettings & viewSettings) override;
+    void drawPick(Time time, ViewSettings & viewSettings,
+                  const VectorAnimationComplex::BoundingBox & region);
+    void rasterize(Time time, VectorAnimationComplex::Rasterizer & rasterizer);
 
     void setHoveredObject(Time time, int id) override;
     void setNoHoveredObject() override;
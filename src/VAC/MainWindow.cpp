@@ -24,6 +24,7 @@
 #include "MultiView.h"
 #include "Timeline.h"
 #include "DevSettings.h"
+#include "Profiler.h"
 #include "ObjectPropertiesWidget.h"
 #include "AnimatedCycleWidget.h"
 #include "EditCanvasSizeDialog.h"
@@ -33,10 +34,13 @@
 #include "Background/BackgroundWidget.h"
 #include "VectorAnimationComplex/VAC.h"
 #include "VectorAnimationComplex/InbetweenFace.h"
+#include "VectorAnimationComplex/Rasterizer.h"
 #include "LayersWidget.h"
 #include "Layer.h"
 #include "SvgParser.h"
 #include "SvgImportDialog.h"
+#include "SvgWriter.h"
+#include "DocumentSaver.h"
 
 #include "IO/FileVersionConverter.h"
 #include "XmlStreamWriter.h"
@@ -59,6 +63,7 @@
 #include <QProgressDialog>
 #include <QDesktopServices>
 #include <QShortcut>
+#include <QInputDialog>
 
 
 /*********************************************************************
@@ -86,6 +91,8 @@ MainWindow::MainWindow() :
     autosaveIndex_(0),
     autosaveOn_(true),
     autosaveDir_(),
+    saver_(0),
+    pendingSaves_(),
 
     clipboard_(0),
 
@@ -201,6 +208,12 @@ MainWindow::MainWindow() :
     // Set initial focus
     multiView_->setFocus(Qt::OtherFocusReason);
 
+    // Saving, in a worker thread
+    saver_ = new DocumentSaver(this);
+    connect(saver_, SIGNAL(progress(int,QString,int,int)), this, SLOT(onSaveProgress_(int,QString,int,int)));
+    connect(saver_, SIGNAL(saved(int,QString)), this, SLOT(onSaved_(int,QString)));
+    connect(saver_, SIGNAL(failed(int,QString,QString)), this, SLOT(onSaveFailed_(int,QString,QString)));
+
     // Autosave
     autosaveBegin();
 }
@@ -238,7 +251,11 @@ bool MainWindow::isShowCanvasChecked() const
 }
 void MainWindow::autosave()
 {
-    save_(autosaveDir_.absoluteFilePath(autosaveFilename_));
+    // Don't pile up autosaves if writing is slower than the autosave interval
+    if(saver_->isSaving())
+        return;
+
+    save_(autosaveDir_.absoluteFilePath(autosaveFilename_), SaveType::Autosave);
 }
 
 void MainWindow::autosaveBegin()
@@ -359,6 +376,8 @@ Scene * MainWindow::scene() const
 
 void MainWindow::addToUndoStack()
 {
+    ProfilerScope profilerScope("MainWindow::addToUndoStack");
+
     undoIndex_++;
     for(int j=undoStack_.size()-1; j>=undoIndex_; j--)
     {
@@ -411,6 +430,8 @@ void MainWindow::goToUndoIndex_(int undoIndex)
 
 void MainWindow::undo()
 {
+    scene_->completePendingSketches();
+
     if(undoIndex_>0)
     {
         goToUndoIndex_(undoIndex_ - 1);
@@ -423,6 +444,8 @@ void MainWindow::undo()
 
 void MainWindow::redo()
 {
+    scene_->completePendingSketches();
+
     if(undoIndex_<undoStack_.size()-1)
     {
         goToUndoIndex_(undoIndex_ + 1);
@@ -545,6 +568,21 @@ void MainWindow::editCanvasSize()
     editCanvasSizeDialog_->show();
 }
 
+void MainWindow::editSamplingTolerance()
+{
+    bool ok = false;
+    double tolerance = QInputDialog::getDouble(
+                this, tr("Sampling tolerance"),
+                tr("Maximum deviation, in pixels, of imported and sculpted\n"
+                   "edges from their dense sampling (0 for uniform sampling):"),
+                scene_->samplingTolerance(), 0.0, 100.0, 2, &ok);
+    if(ok && tolerance != scene_->samplingTolerance())
+    {
+        scene_->setSamplingTolerance(tolerance);
+        scene_->emitCheckpoint();
+    }
+}
+
 /*********************************************************************
  *                       Overloaded event methods
  */
@@ -619,7 +657,14 @@ bool MainWindow::maybeSave_()
                                       "Do you want to save your changes?"),
                                    QMessageBox::Save | QMessageBox::Discard | QMessageBox::Cancel);
         if (ret == QMessageBox::Save)
-            return save();
+        {
+            // The document is about to be closed, so we wait for the save
+            // to finish, which marks the document as unmodified on success
+            if (!save())
+                return false;
+            saver_->waitForDone();
+            return !isModified_();
+        }
         else if (ret == QMessageBox::Cancel)
             return false;
     }
@@ -672,19 +717,8 @@ bool MainWindow::save()
     }
     else
     {
-        bool success = save_(documentFilePath_);
-
-        if(success)
-        {
-            statusBar()->showMessage(tr("File %1 successfully saved.").arg(documentFilePath_));
-            setUnmodified_();
-            return true;
-        }
-        else
-        {
-            QMessageBox::warning(this, tr("Error"), tr("File %1 not saved: couldn't write file").arg(documentFilePath_));
-            return false;
-        }
+        save_(documentFilePath_, SaveType::Save);
+        return true;
     }
 }
 
@@ -698,14 +732,63 @@ bool MainWindow::saveAs()
     if(!filename.endsWith(".vec"))
         filename.append(".vec");
 
-    bool relativeRemap = true;
-    bool success = save_(filename, relativeRemap);
+    save_(filename, SaveType::SaveAs);
+    return true;
+}
+
+void MainWindow::onSaveProgress_(int id, const QString & filePath, int numLayersWritten, int numLayers)
+{
+    // Autosaves are silent
+    if(pendingSaves_.value(id).type != SaveType::Autosave)
+    {
+        statusBar()->showMessage(tr("Saving %1... (%2/%3 layers)")
+                                 .arg(filePath).arg(numLayersWritten).arg(numLayers));
+    }
+}
+
+void MainWindow::onSaved_(int id, const QString & filePath)
+{
+    PendingSave pendingSave = pendingSaves_.take(id);
+    if(pendingSave.type == SaveType::Autosave)
+        return;
+
+    statusBar()->showMessage(tr("File %1 successfully saved.").arg(filePath));
+    if(pendingSave.type == SaveType::SaveAs)
+        setDocumentFilePath_(filePath);
+
+    // The document may have been modified since the snapshot was taken
+    savedUndoIndex_ = pendingSave.undoIndex;
+    updateWindowTitle_();
+}
+
+void MainWindow::onSaveFailed_(int id, const QString & filePath, const QString & errorString)
+{
+    PendingSave pendingSave = pendingSaves_.take(id);
+    if(pendingSave.type == SaveType::Autosave)
+    {
+        statusBar()->showMessage(tr("Autosave to %1 failed: %2").arg(filePath, errorString));
+    }
+    else
+    {
+        statusBar()->clearMessage();
+        QMessageBox::warning(this, tr("Error"), tr("File %1 not saved: %2").arg(filePath, errorString));
+    }
+}
+
+
+bool MainWindow::exportSVG()
+{
+    QString filename = QFileDialog::getSaveFileName(this, tr("Export as SVG"), global()->documentDir().path());
+    if (filename.isEmpty())
+        return false;
+
+    if(!filename.endsWith(".svg"))
+        filename.append(".svg");
+
+    bool success = doExportSVG(filename);
 
     if(success)
     {
-        statusBar()->showMessage(tr("File %1 successfully saved.").arg(filename));
-        setUnmodified_();
-        setDocumentFilePath_(filename);
         return true;
     }
     else
@@ -715,17 +798,38 @@ bool MainWindow::saveAs()
     }
 }
 
+bool MainWindow::exportSVGSequence()
+{
+    QString filename = QFileDialog::getSaveFileName(this, tr("Export as SVG sequence"), global()->documentDir().path());
+    if (filename.isEmpty())
+        return false;
 
-bool MainWindow::exportSVG()
+    if(!filename.endsWith(".svg"))
+        filename.append(".svg");
+
+    bool success = doExportSVGSequence(filename);
+
+    if(success)
+    {
+        return true;
+    }
+    else
+    {
+        QMessageBox::warning(this, tr("Error"), tr("Files %1 not all saved: couldn't write file or aborted").arg(filename));
+        return false;
+    }
+}
+
+bool MainWindow::exportSVGAnimation()
 {
-    QString filename = QFileDialog::getSaveFileName(this, tr("Export as SVG"), global()->documentDir().path());
+    QString filename = QFileDialog::getSaveFileName(this, tr("Export as animated SVG"), global()->documentDir().path());
     if (filename.isEmpty())
         return false;
 
     if(!filename.endsWith(".svg"))
         filename.append(".svg");
 
-    bool success = doExportSVG(filename);
+    bool success = doExportSVGAnimation(filename);
 
     if(success)
     {
@@ -868,6 +972,8 @@ void MainWindow::updateWindowTitle_()
 
 void MainWindow::open_(const QString & filePath)
 {
+    ProfilerScope profilerScope("MainWindow::open_");
+
     // Convert to newest version if necessary
     bool conversionSuccessful = FileVersionConverter(filePath).convertToVersion(qApp->applicationVersion(), this);
 
@@ -922,22 +1028,15 @@ void MainWindow::doImportSvg(const QString & filePath)
     scene_->emitCheckpoint();
 }
 
-bool MainWindow::save_(const QString & filePath, bool relativeRemap)
+void MainWindow::save_(const QString & filePath, SaveType type)
 {
-    // Open file to save to
-    QFile file(filePath);
-    if (!file.open(QIODevice::WriteOnly | QFile::Truncate | QFile::Text))
-    {
-        qWarning("Couldn't write file.");
-        return false;
-    }
+    ProfilerScope profilerScope("MainWindow::save_");
 
     // Remap relative paths if need be
-    if (relativeRemap)
+    if (type == SaveType::SaveAs)
     {
-        QFileInfo fileInfo(file);
         QDir oldDocumentDir = global()->documentDir();
-        QDir newDocumentDir = fileInfo.dir();
+        QDir newDocumentDir = QFileInfo(filePath).dir();
         if (oldDocumentDir != newDocumentDir)
         {
             global()->setDocumentDir(newDocumentDir);
@@ -945,15 +1044,16 @@ bool MainWindow::save_(const QString & filePath, bool relativeRemap)
         }
     }
 
-    // Write to file
-    XmlStreamWriter xmlStream(&file);
-    write(xmlStream);
+    // Take a snapshot of the document, and write it in a worker thread
+    scene()->completePendingSketches();
+    PendingSave pendingSave;
+    pendingSave.type = type;
+    pendingSave.undoIndex = undoIndex_;
+    int id = saver_->save(scene(), timeline()->playbackSettings(), filePath);
+    pendingSaves_.insert(id, pendingSave);
 
-    // Close file
-    file.close();
-
-    // Success
-    return true;
+    if (type != SaveType::Autosave)
+        statusBar()->showMessage(tr("Saving %1...").arg(filePath));
 }
 
 void MainWindow::read_DEPRECATED(QTextStream & in)
@@ -999,58 +1099,10 @@ void MainWindow::write_DEPRECATED(QTextStream & out)
     out << Save::closeCurlyBrackets();
 }
 
-void MainWindow::write(XmlStreamWriter &xml)
-{
-    // Start XML Document
-    xml.writeStartDocument();
-
-    // Header
-    xml.writeComment(" Created with VPaint (http://www.vpaint.org) ");
-    xml.writeCharacters("\n\n");
-
-    // Document
-    xml.writeStartElement("vec");
-    {
-        Version version(qApp->applicationVersion());
-        bool ignorePatch = true;
-        xml.writeAttribute("version", version.toString(ignorePatch));
-
-        // Metadata such as author and license? Different options:
-        //   1) as comments in header (issue: not part of document or XML spec, cross-editor compatibility issues)
-        //   2) as attributes of vec
-        //   3) as its own XML element
-        // "metadata" or "properties"? Probably metadata. even in PDF when this info is often accessed
-        // in File > Properties, it is still sotred as "metadata"
-        // Resources:
-        //   https://helpx.adobe.com/acrobat/using/pdf-properties-metadata.html)
-        //   http://www.w3.org/TR/SVG/metadata.html
-        //xmlStream.writeStartElement("metadata");
-        //xmlStream.writeAttribute("author", "Boris Dalstein");
-        //xmlStream.writeAttribute("license", "CC BY-SA");
-        //xmlStream.writeEndElement();
-
-        // Playback
-        xml.writeStartElement("playback");
-        timeline()->write(xml);
-        xml.writeEndElement();
-
-        // Canvas
-        xml.writeStartElement("canvas");
-        scene()->writeCanvas(xml);
-        xml.writeEndElement();
-
-        // Layers
-        scene()->writeAllLayers(xml);
-    }
-    xml.writeEndElement();
-
-    // End XML Document
-    xml.writeEndDocument();
-}
-
 void MainWindow::read(XmlStreamReader & xml)
 {
     scene_->clear();
+    scene_->setSamplingTolerance(0.0); // unless given by the file
 
     if (xml.readNextStartElement())
     {
@@ -1076,6 +1128,12 @@ void MainWindow::read(XmlStreamReader & xml)
                 scene_->readCanvas(xml);
             }
 
+            // Sampling
+            else if (xml.name() == "sampling")
+            {
+                scene_->readSampling(xml);
+            }
+
             // Layer
             else if (xml.name() == "layer")
             {
@@ -1093,43 +1151,87 @@ void MainWindow::read(XmlStreamReader & xml)
 
 bool MainWindow::doExportSVG(const QString & filename)
 {
-    QFile data(filename);
-    if (data.open(QFile::WriteOnly | QFile::Truncate | QFile::Text)) {
-
-        QTextStream out(&data);
-
-        QString header = QString(
-                "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\"?>\n"
-                "<!-- Created with VPaint (http://www.vpaint.org/) -->\n\n"
+    SvgWriter writer(scene_);
+    if (writer.writeFrame(multiView_->activeView()->activeTime(), filename))
+    {
+        statusBar()->showMessage(tr("File %1 successfully saved.").arg(filename));
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
 
-                "<!DOCTYPE svg PUBLIC \"-//W3C//DTD SVG 1.1//EN\"\n"
-                "  \"http://www.w3.org/Graphics/SVG/1.1/DTD/svg11.dtd\">\n"
-                "<svg \n"
-                "  viewBox=\"%1 %2 %3 %4\"\n"
-                "  xmlns=\"http://www.w3.org/2000/svg\"\n"
-                "  xmlns:xlink=\"http://www.w3.org/1999/xlink\">\n")
+bool MainWindow::doExportSVGSequence(const QString & filename)
+{
+    QVector<Time> times;
+    QStringList filenames;
+    sequenceFilePaths_(filename, times, filenames);
 
-                .arg(scene_->left())
-                .arg(scene_->top())
-                .arg(scene_->width())
-                .arg(scene_->height());
+    QProgressDialog progress("Exporting...", "Abort", 0, times.size(), this);
+    progress.setWindowModality(Qt::WindowModal);
 
-        QString footer = "</svg>";
+    SvgWriter writer(scene_);
+    bool success = writer.writeSequence(times, filenames, [&progress](int numFramesWritten)
+    {
+        progress.setValue(numFramesWritten);
+        return !progress.wasCanceled();
+    });
+    progress.setValue(times.size());
 
-        out << header;
-        scene_->exportSVG(multiView_->activeView()->activeTime(), out);
-        out << footer;
+    if (success)
+        statusBar()->showMessage(tr("%1 files successfully saved.").arg(filenames.size()));
+    return success;
+}
 
+bool MainWindow::doExportSVGAnimation(const QString & filename)
+{
+    SvgWriter writer(scene_);
+    if (writer.writeAnimation(timeline()->firstFrame(), timeline()->lastFrame(),
+                              timeline()->fps(), filename))
+    {
         statusBar()->showMessage(tr("File %1 successfully saved.").arg(filename));
         return true;
     }
     else
     {
-        qDebug() << "Error: cannot open file";
         return false;
     }
 }
 
+void MainWindow::sequenceFilePaths_(const QString & filename, QVector<Time> & times, QStringList & filenames) const
+{
+    // Decompose filename into basename + suffix. Example:
+    //     abc_1234_5678.de.png  ->   abc_1234  +  de.png
+    QFileInfo info(filename);
+    QString baseName = info.baseName();
+    QString suffix = info.suffix();
+    // Decompose basename into cleanedbasename + numbering. Examples:
+    //     abc_1234_5678  ->     abc_1234 + 5678
+    int iNumbering = baseName.indexOf(QRegExp("_[0-9]*$"));
+    if(iNumbering != -1)
+    {
+        baseName.chop(baseName.length() - iNumbering);
+    }
+
+    // Get dir
+    QDir dir = info.absoluteDir();
+
+    // Get frame numbers to export
+    int firstFrame = timeline()->firstFrame();
+    int lastFrame = timeline()->lastFrame();
+    for(int i = firstFrame; i <= lastFrame; ++i)
+    {
+        QString number = QString("%1").arg(i, 4, 10, QChar('0'));
+        QString filePath = dir.absoluteFilePath(
+                    baseName + QString("_") + number + QString(".") + suffix);
+
+        times.append(Time(i));
+        filenames.append(filePath);
+    }
+}
+
 bool MainWindow::doExportPNG(const QString & filename)
 {
     QVector<Time> times;
@@ -1142,34 +1244,7 @@ bool MainWindow::doExportPNG(const QString & filename)
     }
     else
     {
-        // Decompose filename into basename + suffix. Example:
-        //     abc_1234_5678.de.png  ->   abc_1234  +  de.png
-        QFileInfo info(filename);
-        QString baseName = info.baseName();
-        QString suffix = info.suffix();
-        // Decompose basename into cleanedbasename + numbering. Examples:
-        //     abc_1234_5678  ->     abc_1234 + 5678
-        int iNumbering = baseName.indexOf(QRegExp("_[0-9]*$"));
-        if(iNumbering != -1)
-        {
-            baseName.chop(baseName.length() - iNumbering);
-        }
-
-        // Get dir
-        QDir dir = info.absoluteDir();
-
-        // Get frame numbers to export
-        int firstFrame = timeline()->firstFrame();
-        int lastFrame = timeline()->lastFrame();
-        for(int i = firstFrame; i <= lastFrame; ++i)
-        {
-            QString number = QString("%1").arg(i, 4, 10, QChar('0'));
-            QString filePath = dir.absoluteFilePath(
-                        baseName + QString("_") + number + QString(".") + suffix);
-
-            times.append(Time(i));
-            filenames.append(filePath);
-        }
+        sequenceFilePaths_(filename, times, filenames);
     }
 
     // Create Progress dialog for feedback
@@ -1185,9 +1260,12 @@ bool MainWindow::doExportPNG(const QString & filename)
     // Create image buffer
     int w = exportPngDialog_->pngWidth();
     int h = exportPngDialog_->pngHeight();
+    bool softwareRendering = exportPngDialog_->useSoftwareRendering();
     double* buf = nullptr;
     QImage res;
-    if (numSamples > 1) {
+    VectorAnimationComplex::Rasterizer accumulator(softwareRendering ? w : 0,
+                                                   softwareRendering ? h : 0);
+    if (numSamples > 1 && !softwareRendering) {
         buf = new double[4*w*h];
         for (int j = 0; j < 4*w*h; ++j) {
             buf[j] = 0.0;
@@ -1201,7 +1279,10 @@ bool MainWindow::doExportPNG(const QString & filename)
         if (progress.wasCanceled())
             break;
 
-        if (numSamples > 1) {
+        if (softwareRendering) {
+            accumulator.clear();
+        }
+        else if (numSamples > 1) {
             for (int j = 0; j < 4*w*h; ++j) {
                 buf[j] = 0.0;
             }
@@ -1213,6 +1294,26 @@ bool MainWindow::doExportPNG(const QString & filename)
             if (progress.wasCanceled())
                 break;
 
+            // Software rendering: accumulate samples directly in the
+            // premultiplied floating point buffer of the rasterizer
+            if (softwareRendering)
+            {
+                VectorAnimationComplex::Rasterizer rasterizer(w, h);
+                rasterizer.setViewport(scene()->left(), scene()->top(), scene()->width(), scene()->height());
+                scene()->rasterize(Time(times[i] - k * numSamplesInv), rasterizer,
+                                   scene()->left(), scene()->left() + scene()->width(),
+                                   scene()->top(), scene()->top() + scene()->height());
+                if (numSamples > 1) {
+                    accumulator.accumulate(rasterizer, numSamplesInv);
+                }
+                else {
+                    res = rasterizer.toImage();
+                }
+
+                progress.setValue(i * numSamples + k + 1);
+                continue;
+            }
+
             QImage img = multiView_->activeView()->drawToImage(
                         Time(times[i] - k * numSamplesInv),
                         scene()->left(), scene()->top(), scene()->width(), scene()->height(),
@@ -1242,7 +1343,12 @@ bool MainWindow::doExportPNG(const QString & filename)
         }
 
         // Convert double-precision buffer to QImage
-        if (numSamples > 1) {
+        if (softwareRendering) {
+            if (numSamples > 1) {
+                res = accumulator.toImage();
+            }
+        }
+        else if (numSamples > 1) {
             for (int y = 0; y < h; ++y) {
                 for (int x = 0; x < w; ++x) {
                     int r = std::round(buf[4*(y*w + x) + 0] * 255);
@@ -1531,6 +1637,16 @@ void MainWindow::createActions()
     //actionExportSVG->setShortcut(QKeySequence(Qt::CTRL + Qt::Key_E));
     connect(actionExportSVG, SIGNAL(triggered()), this, SLOT(exportSVG()));
 
+    // Export SVG sequence
+    actionExportSVGSequence = new QAction(tr("SVG (sequence) [Beta]"), this);
+    actionExportSVGSequence->setStatusTip(tr("Save all frames of the animation as a sequence of SVG files."));
+    connect(actionExportSVGSequence, SIGNAL(triggered()), this, SLOT(exportSVGSequence()));
+
+    // Export animated SVG
+    actionExportSVGAnimation = new QAction(tr("SVG (animated) [Beta]"), this);
+    actionExportSVGAnimation->setStatusTip(tr("Save all frames of the animation as a single animated SVG file."));
+    connect(actionExportSVGAnimation, SIGNAL(triggered()), this, SLOT(exportSVGAnimation()));
+
     // Export PNG
     actionExportPNG = new QAction(/*QIcon(":/iconSave"),*/ tr("PNG (frame or sequence)"), this);
     actionExportPNG->setStatusTip(tr("Save the current illustration in the PNG file format."));
@@ -1640,6 +1756,10 @@ void MainWindow::createActions()
     //actionEditCanvasSize->setShortcutContext(Qt::ApplicationShortcut);
     connect(actionEditCanvasSize, SIGNAL(triggered()), this, SLOT(editCanvasSize()));
 
+    actionEditSamplingTolerance = new QAction(tr("Sampling tolerance..."), this);
+    actionEditSamplingTolerance->setStatusTip(tr("Edit how finely imported and sculpted edges are sampled."));
+    connect(actionEditSamplingTolerance, SIGNAL(triggered()), this, SLOT(editSamplingTolerance()));
+
     // Fit Illustration In Window
     actionFitAllInWindow = new QAction(tr("Fit illustration in window"), this);
     actionFitAllInWindow->setStatusTip(tr("Automatically select an appropriate zoom to see the whole illustration."));
@@ -2057,6 +2177,8 @@ void MainWindow::createMenus()
     QMenu * exportMenu = menuFile->addMenu(tr("Export")); {
         exportMenu->addAction(actionExportPNG);
         exportMenu->addAction(actionExportSVG);
+        exportMenu->addAction(actionExportSVGSequence);
+        exportMenu->addAction(actionExportSVGAnimation);
     }
     //menuFile->addSeparator();
     //menuFile->addAction(actionPreferences);
@@ -2076,6 +2198,8 @@ void MainWindow::createMenus()
     menuEdit->addSeparator();
     menuEdit->addAction(actionSmartDelete);
     menuEdit->addAction(actionHardDelete);
+    menuEdit->addSeparator();
+    menuEdit->addAction(actionEditSamplingTolerance);
     //menuEdit->addAction(actionTest);
     menuBar()->addMenu(menuEdit);
 
@@ -18,11 +18,14 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
+#include <QHash>
 #include <QList>
 #include <QString>
+#include <QStringList>
 #include <QTextBrowser>
 #include <QTimer>
 #include <QDir>
+#include <QVector>
 
 class QScrollArea;
 class Scene;
@@ -31,6 +34,7 @@ class MultiView;
 class View;
 class View3D;
 class Timeline;
+class Time;
 class DevSettings;
 class SettingsDialog;
 class XmlStreamWriter;
@@ -51,6 +55,7 @@ class InbetweenFace;
 class SelectionInfoWidget;
 class ObjectPropertiesWidget;
 class AnimatedCycleWidget;
+class DocumentSaver;
 
 class MainWindow : public QMainWindow
 {
@@ -93,7 +98,12 @@ private slots:
     bool save();
     void autosave();
     bool saveAs();
+    void onSaveProgress_(int id, const QString & filePath, int numLayersWritten, int numLayers);
+    void onSaved_(int id, const QString & filePath);
+    void onSaveFailed_(int id, const QString & filePath, const QString & errorString);
     bool exportSVG();
+    bool exportSVGSequence();
+    bool exportSVGAnimation();
     bool exportPNG();
     bool exportMesh();
     bool exportPNG3D();
@@ -115,6 +125,7 @@ private slots:
     void setDisplayModeOutline();
     void toggleShowCanvas(bool);
     void editCanvasSize();
+    void editSamplingTolerance();
 
     void setOnionSkinningEnabled(bool enabled);
 
@@ -187,15 +198,21 @@ private:
     void updateWindowTitle_();
     void setDocumentFilePath_(const QString & filePath);
     bool maybeSave_();
-    bool save_(const QString & filePath, bool relativeRemap = false);
+    enum class SaveType { Save, SaveAs, Autosave };
+    struct PendingSave { SaveType type; int undoIndex; };
+    DocumentSaver * saver_;
+    QHash<int, PendingSave> pendingSaves_; // by DocumentSaver ID
+    void save_(const QString & filePath, SaveType type);
     void doImportSvg(const QString & filename);
     bool doExportSVG(const QString & filename);
+    bool doExportSVGSequence(const QString & filename);
+    bool doExportSVGAnimation(const QString & filename);
+    void sequenceFilePaths_(const QString & filename, QVector<Time> & times, QStringList & filenames) const;
     bool doExportPNG(const QString & filename);
     bool doExportPNG3D(const QString & filename);
     void read_DEPRECATED(QTextStream & in);
     void write_DEPRECATED(QTextStream & out);
     void read(XmlStreamReader & xml);
-    void write(XmlStreamWriter & xml);
     void autosaveBegin();
     void autosaveEnd();
     // Copy-pasting
@@ -224,6 +241,8 @@ private:
       QAction * actionSaveAs;
       QAction * actionPreferences;
       QAction * actionExportSVG;
+      QAction * actionExportSVGSequence;
+      QAction * actionExportSVGAnimation;
       QAction * actionExportPNG;
       QAction * actionQuit;
     // EDIT
@@ -242,6 +261,7 @@ private:
       QAction * actionZoomOut;
       QAction * actionShowCanvas;
       QAction * actionEditCanvasSize;
+      QAction * actionEditSamplingTolerance;
       QAction * actionFitAllInWindow;
       QAction * actionFitSelectionInWindow;
       QAction * actionDisplayModeNormal;
@@ -0,0 +1,619 @@
+// Copyright (C) 2012-2019 The VPaint Developers.
+// See the COPYRIGHT file at the top-level directory of this distribution
+// and at https://github.com/dalboris/vpaint/blob/master/COPYRIGHT
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "MeshWriter.h"
+
+#include "View3DSettings.h"
+#include "VectorAnimationComplex/VAC.h"
+#include "VectorAnimationComplex/InbetweenEdge.h"
+#include "VectorAnimationComplex/InbetweenFace.h"
+
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPair>
+#include <QSaveFile>
+#include <QTemporaryFile>
+#include <QTextStream>
+#include <QVector>
+#include <QtDebug>
+#include <QtEndian>
+
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+namespace
+{
+
+using namespace VectorAnimationComplex;
+
+// Size of the blocks read when copying a temporary file to the output
+const qint64 COPY_BLOCK_SIZE = 1 << 20;
+
+// Constants from the glTF specification
+const int GLTF_FLOAT = 5126;
+const int GLTF_UNSIGNED_INT = 5125;
+const int GLTF_ARRAY_BUFFER = 34962;
+const int GLTF_ELEMENT_ARRAY_BUFFER = 34963;
+const int GLTF_TRIANGLES = 4;
+
+// Part of the mesh generated and written at once
+struct Chunk
+{
+    QVector<Eigen::Vector3d> positions;
+    QVector<Eigen::Vector3d> normals; // unit length
+    QVector<quint32> quads;           // 4 vertex indices per quad
+    QVector<quint32> triangles;       // 3 vertex indices per triangle
+
+    void clear()
+    {
+        positions.resize(0);
+        normals.resize(0);
+        quads.resize(0);
+        triangles.resize(0);
+    }
+
+    bool isEmpty() const
+    {
+        return quads.isEmpty() && triangles.isEmpty();
+    }
+};
+
+Eigen::Vector3d unitNormal_(const Eigen::Vector3d & n)
+{
+    double norm = n.norm();
+    return norm > 0 ? Eigen::Vector3d(n / norm) : Eigen::Vector3d(0, 0, 1);
+}
+
+// Space-time surface of an inbetween edge, as quads
+void makeEdgeChunk_(InbetweenEdge * edge, const View3DSettings & viewSettings, Chunk & chunk)
+{
+    chunk.clear();
+
+    const InbetweenEdge::SpaceTimeSurface & surf = edge->spaceTimeSurface(viewSettings);
+    const int m = surf.numRows;
+    const int n = surf.numCols;
+    if(m < 2 || n < 2)
+        return;
+
+    const double s = viewSettings.spaceScale();
+    chunk.positions.reserve(m*n);
+    chunk.normals.reserve(m*n);
+    for(int k=0; k<m*n; ++k)
+    {
+        chunk.positions << s * surf.positions[k];
+        chunk.normals << unitNormal_(surf.normals[k]);
+    }
+
+    chunk.quads.reserve(4*(m-1)*(n-1));
+    for(int i=m-2; i>=0; --i)
+    {
+        for(int j=1; j<n; ++j)
+            chunk.quads << i*n + j-1 << (i+1)*n + j-1 << (i+1)*n + j << i*n + j;
+    }
+}
+
+// Triangulation of an inbetween face at the given time, with duplicate
+// vertices merged
+void makeFaceChunk_(InbetweenFace * face, Time time, const View3DSettings & viewSettings, Chunk & chunk)
+{
+    chunk.clear();
+
+    const double s = viewSettings.spaceScale();
+    const double z = s * viewSettings.zFromT(time);
+    QHash<QPair<double, double>, quint32> vertexIndices;
+    auto vertexIndex = [&](const Eigen::Vector2d & p) -> quint32
+    {
+        QPair<double, double> key(p[0], p[1]);
+        auto it = vertexIndices.constFind(key);
+        if(it != vertexIndices.constEnd())
+            return it.value();
+
+        quint32 index = chunk.positions.size();
+        chunk.positions << Eigen::Vector3d(s * viewSettings.xFromX2D(p[0]),
+                                           s * viewSettings.yFromY2D(p[1]), z);
+        chunk.normals << Eigen::Vector3d(0, 0, 1);
+        vertexIndices.insert(key, index);
+        return index;
+    };
+
+    const Triangles & triangles = face->triangles(time);
+    chunk.triangles.reserve(3 * triangles.size());
+    for(int i=0; i<triangles.size(); ++i)
+    {
+        const Triangle & t = triangles[i];
+        chunk.triangles << vertexIndex(t.a) << vertexIndex(t.b) << vertexIndex(t.c);
+    }
+}
+
+// Splits each quad into two triangles
+void triangulateQuads_(Chunk & chunk)
+{
+    for(int i=0; i<chunk.quads.size(); i+=4)
+    {
+        const quint32 * q = &chunk.quads[i];
+        chunk.triangles << q[0] << q[1] << q[2] << q[0] << q[2] << q[3];
+    }
+    chunk.quads.resize(0);
+}
+
+// Gives each face its own vertices, in the order of the faces
+void unindex_(Chunk & chunk)
+{
+    Chunk res;
+    auto copyVertex = [&](quint32 k) -> quint32
+    {
+        res.positions << chunk.positions[k];
+        res.normals << chunk.normals[k];
+        return res.positions.size() - 1;
+    };
+    foreach(quint32 k, chunk.quads)
+        res.quads << copyVertex(k);
+    foreach(quint32 k, chunk.triangles)
+        res.triangles << copyVertex(k);
+    chunk = std::move(res);
+}
+
+void appendUInt32_(QByteArray & data, quint32 x)
+{
+    char bytes[4];
+    qToLittleEndian(x, bytes);
+    data.append(bytes, 4);
+}
+
+void appendFloat_(QByteArray & data, double x)
+{
+    float f = static_cast<float>(x);
+    quint32 bits;
+    std::memcpy(&bits, &f, 4);
+    appendUInt32_(data, bits);
+}
+
+// Appends the whole content of the given file to out
+bool copyFile_(QFile & file, QIODevice * out)
+{
+    if(!file.seek(0))
+        return false;
+
+    QByteArray block;
+    while(!file.atEnd())
+    {
+        block = file.read(COPY_BLOCK_SIZE);
+        if(block.isEmpty() || out->write(block) != block.size())
+            return false;
+    }
+    return true;
+}
+
+class ChunkWriter
+{
+public:
+    virtual ~ChunkWriter() {}
+
+    // Each method returns false if an error occured
+    virtual bool begin(QIODevice * out) = 0;
+    virtual bool write(const Chunk & chunk) = 0;
+    virtual bool end() = 0;
+};
+
+// Vertices and faces of each chunk are written right away, since OBJ allows
+// to interleave them
+class ObjWriter: public ChunkWriter
+{
+public:
+    ObjWriter() : numVertices_(0) {}
+
+    bool begin(QIODevice * out)
+    {
+        out_.setDevice(out);
+        out_.setLocale(QLocale::c());
+        out_.setRealNumberNotation(QTextStream::FixedNotation);
+        out_.setRealNumberPrecision(6);
+        return true;
+    }
+
+    bool write(const Chunk & chunk)
+    {
+        foreach(const Eigen::Vector3d & p, chunk.positions)
+            out_ << "v " << p[0] << " " << p[1] << " " << p[2] << "\n";
+        foreach(const Eigen::Vector3d & p, chunk.normals)
+            out_ << "vn " << p[0] << " " << p[1] << " " << p[2] << "\n";
+
+        // OBJ indices start at 1
+        const quint32 offset = numVertices_ + 1;
+        for(int i=0; i<chunk.quads.size(); i+=4)
+        {
+            out_ << "f";
+            for(int j=i; j<i+4; ++j)
+                out_ << " " << chunk.quads[j] + offset << "//" << chunk.quads[j] + offset;
+            out_ << "\n";
+        }
+        for(int i=0; i<chunk.triangles.size(); i+=3)
+        {
+            out_ << "f";
+            for(int j=i; j<i+3; ++j)
+                out_ << " " << chunk.triangles[j] + offset << "//" << chunk.triangles[j] + offset;
+            out_ << "\n";
+        }
+        numVertices_ += chunk.positions.size();
+
+        return out_.status() == QTextStream::Ok;
+    }
+
+    bool end()
+    {
+        out_.flush();
+        return out_.status() == QTextStream::Ok;
+    }
+
+private:
+    QTextStream out_;
+    quint32 numVertices_;
+};
+
+// Vertices are written right after the header, while faces are written to
+// a temporary file, appended at the end. The header is written twice: first
+// with placeholder counts, then with the actual counts, padded to the same
+// length.
+class PlyWriter: public ChunkWriter
+{
+public:
+    PlyWriter() : out_(0), numVertices_(0), numFaces_(0) {}
+
+    bool begin(QIODevice * out)
+    {
+        out_ = out;
+        if(!faces_.open())
+            return false;
+        QByteArray header = header_();
+        return out_->write(header) == header.size();
+    }
+
+    bool write(const Chunk & chunk)
+    {
+        buffer_.resize(0);
+        for(int k=0; k<chunk.positions.size(); ++k)
+        {
+            const Eigen::Vector3d & p = chunk.positions[k];
+            const Eigen::Vector3d & n = chunk.normals[k];
+            appendFloat_(buffer_, p[0]);
+            appendFloat_(buffer_, p[1]);
+            appendFloat_(buffer_, p[2]);
+            appendFloat_(buffer_, n[0]);
+            appendFloat_(buffer_, n[1]);
+            appendFloat_(buffer_, n[2]);
+        }
+        if(out_->write(buffer_) != buffer_.size())
+            return false;
+
+        buffer_.resize(0);
+        for(int i=0; i<chunk.quads.size(); i+=4)
+        {
+            buffer_.append(char(4));
+            for(int j=i; j<i+4; ++j)
+                appendUInt32_(buffer_, chunk.quads[j] + numVertices_);
+        }
+        for(int i=0; i<chunk.triangles.size(); i+=3)
+        {
+            buffer_.append(char(3));
+            for(int j=i; j<i+3; ++j)
+                appendUInt32_(buffer_, chunk.triangles[j] + numVertices_);
+        }
+        if(faces_.write(buffer_) != buffer_.size())
+            return false;
+
+        numVertices_ += chunk.positions.size();
+        numFaces_ += chunk.quads.size() / 4 + chunk.triangles.size() / 3;
+        return true;
+    }
+
+    bool end()
+    {
+        if(!copyFile_(faces_, out_))
+            return false;
+
+        QByteArray header = header_();
+        return out_->seek(0) && out_->write(header) == header.size();
+    }
+
+private:
+    QIODevice * out_;
+    QTemporaryFile faces_;
+    quint32 numVertices_;
+    quint32 numFaces_;
+    QByteArray buffer_;
+
+    QByteArray header_() const
+    {
+        // Counts are padded to the number of digits of the largest quint32
+        const int width = 10;
+        QByteArray res;
+        res += "ply\n";
+        res += "format binary_little_endian 1.0\n";
+        res += "comment Generated by VPaint\n";
+        res += "element vertex " + QByteArray::number(numVertices_).leftJustified(width) + "\n";
+        res += "property float x\n";
+        res += "property float y\n";
+        res += "property float z\n";
+        res += "property float nx\n";
+        res += "property float ny\n";
+        res += "property float nz\n";
+        res += "element face " + QByteArray::number(numFaces_).leftJustified(width) + "\n";
+        res += "property list uchar uint vertex_indices\n";
+        res += "end_header\n";
+        return res;
+    }
+};
+
+// The binary buffer is written to a temporary file, while the JSON
+// description of each chunk is kept in memory. Both are written at the end,
+// JSON first, as required by the GLB container. Each chunk is a primitive of
+// a single mesh, whose vertices (interleaved positions and normals) and
+// indices have their own buffer views. Chunks must only have triangles.
+class GlbWriter: public ChunkWriter
+{
+public:
+    GlbWriter(bool isIndexed) : out_(0), isIndexed_(isIndexed), binLength_(0) {}
+
+    bool begin(QIODevice * out)
+    {
+        out_ = out;
+        return bin_.open();
+    }
+
+    bool write(const Chunk & chunk)
+    {
+        // Vertices
+        const int numVertices = chunk.positions.size();
+        Eigen::Vector3d min;
+        Eigen::Vector3d max;
+        buffer_.resize(0);
+        for(int k=0; k<numVertices; ++k)
+        {
+            const Eigen::Vector3d & p = chunk.positions[k];
+            const Eigen::Vector3d & n = chunk.normals[k];
+            for(int d=0; d<3; ++d)
+            {
+                // Bounds must be those of the stored floats
+                double x = static_cast<float>(p[d]);
+                if(k == 0 || x < min[d])
+                    min[d] = x;
+                if(k == 0 || x > max[d])
+                    max[d] = x;
+            }
+            appendFloat_(buffer_, p[0]);
+            appendFloat_(buffer_, p[1]);
+            appendFloat_(buffer_, p[2]);
+            appendFloat_(buffer_, n[0]);
+            appendFloat_(buffer_, n[1]);
+            appendFloat_(buffer_, n[2]);
+        }
+        QJsonObject attributes;
+        attributes["POSITION"] = accessors_.size();
+        attributes["NORMAL"] = accessors_.size() + 1;
+        accessors_.append(QJsonObject{
+            {"bufferView", bufferViews_.size()},
+            {"byteOffset", 0},
+            {"componentType", GLTF_FLOAT},
+            {"count", numVertices},
+            {"type", "VEC3"},
+            {"min", QJsonArray{min[0], min[1], min[2]}},
+            {"max", QJsonArray{max[0], max[1], max[2]}}});
+        accessors_.append(QJsonObject{
+            {"bufferView", bufferViews_.size()},
+            {"byteOffset", 12},
+            {"componentType", GLTF_FLOAT},
+            {"count", numVertices},
+            {"type", "VEC3"}});
+        if(!writeBufferView_(24, GLTF_ARRAY_BUFFER))
+            return false;
+
+        QJsonObject primitive;
+        primitive["attributes"] = attributes;
+        primitive["mode"] = GLTF_TRIANGLES;
+
+        // Indices
+        if(isIndexed_)
+        {
+            buffer_.resize(0);
+            foreach(quint32 k, chunk.triangles)
+                appendUInt32_(buffer_, k);
+            primitive["indices"] = accessors_.size();
+            accessors_.append(QJsonObject{
+                {"bufferView", bufferViews_.size()},
+                {"byteOffset", 0},
+                {"componentType", GLTF_UNSIGNED_INT},
+                {"count", chunk.triangles.size()},
+                {"type", "SCALAR"}});
+            if(!writeBufferView_(0, GLTF_ELEMENT_ARRAY_BUFFER))
+                return false;
+        }
+
+        primitives_.append(primitive);
+        return true;
+    }
+
+    bool end()
+    {
+        // JSON description
+        QJsonObject json;
+        json["asset"] = QJsonObject{{"version", "2.0"}, {"generator", "VPaint"}};
+        json["scene"] = 0;
+        if(primitives_.isEmpty())
+        {
+            json["scenes"] = QJsonArray{QJsonObject()};
+        }
+        else
+        {
+            json["scenes"] = QJsonArray{QJsonObject{{"nodes", QJsonArray{0}}}};
+            json["nodes"] = QJsonArray{QJsonObject{{"mesh", 0}}};
+            json["meshes"] = QJsonArray{QJsonObject{{"primitives", primitives_}}};
+            json["buffers"] = QJsonArray{QJsonObject{{"byteLength", binLength_}}};
+            json["bufferViews"] = bufferViews_;
+            json["accessors"] = accessors_;
+        }
+        QByteArray jsonData = QJsonDocument(json).toJson(QJsonDocument::Compact);
+        while(jsonData.size() % 4 != 0)
+            jsonData.append(' ');
+
+        // Binary buffer, padded with zeros
+        const bool hasBin = !primitives_.isEmpty();
+        const qint64 binPadding = (4 - binLength_ % 4) % 4;
+        const qint64 binChunkLength = binLength_ + binPadding;
+
+        // Header and chunks
+        const qint64 length = 12 + 8 + jsonData.size() + (hasBin ? 8 + binChunkLength : 0);
+        QByteArray header;
+        appendUInt32_(header, 0x46546C67); // "glTF"
+        appendUInt32_(header, 2);
+        appendUInt32_(header, length);
+        appendUInt32_(header, jsonData.size());
+        appendUInt32_(header, 0x4E4F534A); // "JSON"
+        header += jsonData;
+        if(hasBin)
+        {
+            appendUInt32_(header, binChunkLength);
+            appendUInt32_(header, 0x004E4942); // "BIN"
+        }
+        if(out_->write(header) != header.size())
+            return false;
+
+        if(hasBin)
+        {
+            if(!copyFile_(bin_, out_))
+                return false;
+            QByteArray padding(binPadding, '\0');
+            if(out_->write(padding) != padding.size())
+                return false;
+        }
+
+        return true;
+    }
+
+private:
+    QIODevice * out_;
+    QTemporaryFile bin_;
+    bool isIndexed_;
+    qint64 binLength_;
+    QByteArray buffer_;
+    QJsonArray bufferViews_;
+    QJsonArray accessors_;
+    QJsonArray primitives_;
+
+    // Appends buffer_ to the binary buffer, as a new buffer view. Its
+    // length is always a multiple of 4, so alignment is preserved.
+    bool writeBufferView_(int byteStride, int target)
+    {
+        QJsonObject bufferView{
+            {"buffer", 0},
+            {"byteOffset", binLength_},
+            {"byteLength", buffer_.size()},
+            {"target", target}};
+        if(byteStride > 0)
+            bufferView["byteStride"] = byteStride;
+        bufferViews_.append(bufferView);
+
+        binLength_ += buffer_.size();
+        return bin_.write(buffer_) == buffer_.size();
+    }
+};
+
+}
+
+MeshWriter::Format MeshWriter::formatFromFilePath(const QString & filePath)
+{
+    QString suffix = QFileInfo(filePath).suffix().toLower();
+    if(suffix == "ply")
+        return PLY;
+    else if(suffix == "glb")
+        return GLB;
+    else
+        return OBJ;
+}
+
+MeshWriter::MeshWriter(Format format, bool isIndexed) :
+    format_(format),
+    isIndexed_(isIndexed)
+{
+}
+
+bool MeshWriter::write(VAC * vac, const View3DSettings & viewSettings, const QString & filePath)
+{
+    QSaveFile file(filePath);
+    QIODevice::OpenMode mode = QIODevice::WriteOnly;
+    if(format_ == OBJ)
+        mode |= QIODevice::Text;
+    if(!file.open(mode))
+    {
+        qDebug() << "Error: cannot open" << filePath << "for writing";
+        return false;
+    }
+
+    std::unique_ptr<ChunkWriter> writer;
+    switch(format_)
+    {
+    case OBJ: writer.reset(new ObjWriter()); break;
+    case PLY: writer.reset(new PlyWriter()); break;
+    case GLB: writer.reset(new GlbWriter(isIndexed_)); break;
+    }
+
+    Chunk chunk;
+    auto writeChunk = [&]() -> bool
+    {
+        if(chunk.isEmpty())
+            return true;
+        if(format_ == GLB)
+            triangulateQuads_(chunk);
+        if(!isIndexed_)
+            unindex_(chunk);
+        return writer->write(chunk);
+    };
+
+    bool ok = writer->begin(&file);
+    const ZOrderedCells & cells = vac->zOrdering();
+    for(auto it = cells.cbegin(); ok && it != cells.cend(); ++it)
+    {
+        if(InbetweenEdge * edge = (*it)->toInbetweenEdge())
+        {
+            makeEdgeChunk_(edge, viewSettings, chunk);
+            ok = writeChunk();
+        }
+        else if(InbetweenFace * face = (*it)->toInbetweenFace())
+        {
+            // Frames strictly inbetween, as drawn by View3D
+            int f1 = std::floor(face->beforeTime().floatTime());
+            int f2 = std::ceil(face->afterTime().floatTime());
+            for(int f = f1 + 1; ok && f < f2; ++f)
+            {
+                makeFaceChunk_(face, Time(f), viewSettings, chunk);
+                ok = writeChunk();
+            }
+        }
+    }
+    ok = ok && writer->end();
+
+    if(!ok)
+    {
+        qDebug() << "Error: cannot write mesh to" << filePath;
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
@@ -0,0 +1,62 @@
+// Copyright (C) 2012-2019 The VPaint Developers.
+// See the COPYRIGHT file at the top-level directory of this distribution
+// and at https://github.com/dalboris/vpaint/blob/master/COPYRIGHT
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MESH_WRITER_H
+#define MESH_WRITER_H
+
+#include <QString>
+
+class View3DSettings;
+namespace VectorAnimationComplex { class VAC; }
+
+// Writes the space-time mesh of a VAC, as drawn by View3D, to a Wavefront
+// OBJ, binary PLY, or binary glTF (.glb) file. The mesh is made of:
+//   - the space-time surface of each inbetween edge, as quads
+//   - the triangulation of each inbetween face at each frame it spans
+//
+// The mesh is generated and written one chunk at a time (one edge surface,
+// or one face at one frame), so it is never held in memory as a whole. PLY
+// and glTF files store data at the beginning which is only known at the
+// end (face list, or JSON header), so these parts are streamed to a
+// temporary file and put in place once all chunks are written.
+//
+// If isIndexed is true, vertices are shared by the faces of each chunk,
+// with duplicate vertices merged. Otherwise, each face has its own
+// vertices, which makes files larger but simpler to process.
+//
+class MeshWriter
+{
+public:
+    enum Format { OBJ, PLY, GLB };
+
+    // Returns the format matching the suffix of the given file path, or OBJ
+    // if the suffix is not known
+    static Format formatFromFilePath(const QString & filePath);
+
+    MeshWriter(Format format, bool isIndexed);
+
+    // Writes the mesh to the given file. Returns false if an error occured,
+    // in which case the file is left untouched.
+    bool write(VectorAnimationComplex::VAC * vac,
+               const View3DSettings & viewSettings,
+               const QString & filePath);
+
+private:
+    Format format_;
+    bool isIndexed_;
+};
+
+#endif // MESH_WRITER_H
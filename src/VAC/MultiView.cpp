@@ -20,6 +20,7 @@
 #include "Scene.h"
 #include "Timeline.h"
 #include "Global.h"
+#include "Profiler.h"
 
 #include <QKeyEvent>
 #include <QtDebug>
@@ -382,6 +383,12 @@ MultiView::~MultiView()
 
 void MultiView::update()
 {
+    // A profiler frame covers the repaint of all views, and whatever
+    // happened since the previous update (e.g., picking). Ending it here
+    // rather than in each View::paintGL() doesn't split it between views.
+    if(Profiler::isEnabled())
+        Profiler::endFrame();
+
     foreach(ViewWidget * viewWidget, views_)
     {
         View * view = viewFromViewWidget_(viewWidget);
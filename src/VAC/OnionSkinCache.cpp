@@ -0,0 +1,349 @@
+// Copyright (C) 2012-2019 The VPaint Developers.
+// See the COPYRIGHT file at the top-level directory of this distribution
+// and at https://github.com/dalboris/vpaint/blob/master/COPYRIGHT
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "OnionSkinCache.h"
+
+#include "Global.h"
+#include "ViewSettings.h"
+#include "VectorAnimationComplex/VAC.h"
+
+#include <QtDebug>
+
+#include <algorithm>
+
+namespace
+{
+
+// Number of textures kept for onion skins which were not drawn in the last
+// frame, e.g. to be reused when scrubbing back and forth
+const int MAX_UNUSED_ENTRIES = 4;
+
+}
+
+bool OnionSkinCache::State::operator==(const State & other) const
+{
+    return std::equal(viewport, viewport + 4, other.viewport) &&
+           std::equal(projection, projection + 16, other.projection) &&
+           std::equal(modelview, modelview + 16, other.modelview) &&
+           toolMode == other.toolMode &&
+           globalDisplayMode == other.globalDisplayMode &&
+           displayMode == other.displayMode &&
+           drawCursor == other.drawCursor &&
+           vertexTopologySize == other.vertexTopologySize &&
+           edgeTopologyWidth == other.edgeTopologyWidth &&
+           drawTopologyFaces == other.drawTopologyFaces &&
+           screenRelative == other.screenRelative &&
+           zoom == other.zoom;
+}
+
+OnionSkinCache::OnionSkinCache() :
+    state_(),
+    isCaching_(false),
+    entries_(),
+    frame_(0),
+    samples_(0),
+    msFboId_(0),
+    msColorBufferId_(0),
+    msWidth_(0),
+    msHeight_(0),
+    gl_(0),
+    glFbo_(0),
+    viewFboId_(0)
+{
+}
+
+OnionSkinCache::~OnionSkinCache()
+{
+}
+
+OnionSkinCache::State OnionSkinCache::currentState_(const ViewSettings & viewSettings)
+{
+    State res;
+    glGetIntegerv(GL_VIEWPORT, res.viewport);
+    glGetDoublev(GL_PROJECTION_MATRIX, res.projection);
+    glGetDoublev(GL_MODELVIEW_MATRIX, res.modelview);
+    res.toolMode = global()->toolMode();
+    res.globalDisplayMode = global()->displayMode();
+    res.displayMode = viewSettings.displayMode();
+    res.drawCursor = viewSettings.drawCursor();
+    res.vertexTopologySize = viewSettings.vertexTopologySize();
+    res.edgeTopologyWidth = viewSettings.edgeTopologyWidth();
+    res.drawTopologyFaces = viewSettings.drawTopologyFaces();
+    res.screenRelative = viewSettings.screenRelative();
+    res.zoom = viewSettings.zoom();
+    return res;
+}
+
+void OnionSkinCache::beginFrame(OpenGLFunctions * gl,
+                                QOpenGLExtension_ARB_framebuffer_object * glFbo,
+                                const ViewSettings & viewSettings)
+{
+    gl_ = gl;
+    glFbo_ = glFbo;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &viewFboId_);
+    glGetIntegerv(GL_SAMPLES, &samples_);
+
+    State state = currentState_(viewSettings);
+    isCaching_ = (state == state_);
+    if(!isCaching_)
+    {
+        clear();
+        state_ = state;
+    }
+
+    ++frame_;
+}
+
+void OnionSkinCache::draw(VectorAnimationComplex::VAC * vac, Time time, double dx, double dy,
+                          ViewSettings & viewSettings)
+{
+    if(!isCaching_)
+    {
+        drawDirectly_(vac, time, dx, dy, viewSettings);
+        return;
+    }
+
+    int index = -1;
+    for(int i=0; i<entries_.size(); ++i)
+    {
+        const Entry & e = entries_[i];
+        if(e.vac == vac && e.time == time && e.dx == dx && e.dy == dy)
+        {
+            index = i;
+            break;
+        }
+    }
+
+    if(index == -1)
+    {
+        Entry e;
+        e.vac = vac;
+        e.time = time;
+        e.dx = dx;
+        e.dy = dy;
+        e.revision = 0;
+        createEntryTexture_(e);
+        if(!e.fboId)
+        {
+            // Can't render to texture: don't try again for this frame
+            isCaching_ = false;
+            drawDirectly_(vac, time, dx, dy, viewSettings);
+            return;
+        }
+        entries_ << e;
+        index = entries_.size() - 1;
+        renderEntry_(entries_[index], viewSettings);
+    }
+    else if(vac->isDrawingChangedSince(entries_[index].revision, time))
+    {
+        renderEntry_(entries_[index], viewSettings);
+    }
+
+    entries_[index].lastUse = frame_;
+    compositeEntry_(entries_[index]);
+}
+
+void OnionSkinCache::endFrame()
+{
+    int numUnused = 0;
+    for(int i=0; i<entries_.size(); ++i)
+    {
+        if(entries_[i].lastUse != frame_)
+            ++numUnused;
+    }
+
+    // Release least recently used first
+    for(; numUnused > MAX_UNUSED_ENTRIES; --numUnused)
+    {
+        int oldest = -1;
+        for(int i=0; i<entries_.size(); ++i)
+        {
+            if(oldest == -1 || entries_[i].lastUse < entries_[oldest].lastUse)
+                oldest = i;
+        }
+        releaseEntryTexture_(entries_[oldest]);
+        entries_.removeAt(oldest);
+    }
+}
+
+void OnionSkinCache::clear()
+{
+    for(int i=0; i<entries_.size(); ++i)
+        releaseEntryTexture_(entries_[i]);
+    entries_.clear();
+    releaseMultisampleFramebuffer_();
+}
+
+void OnionSkinCache::drawDirectly_(VectorAnimationComplex::VAC * vac, Time time, double dx, double dy,
+                                   ViewSettings & viewSettings)
+{
+    glPushMatrix();
+    glTranslated(dx, dy, 0);
+    vac->draw(time, viewSettings);
+    glPopMatrix();
+}
+
+void OnionSkinCache::createEntryTexture_(Entry & entry)
+{
+    const GLsizei w = state_.viewport[2];
+    const GLsizei h = state_.viewport[3];
+
+    // Texture, of the size of the viewport, so no filtering is needed
+    glGenTextures(1, &entry.textureId);
+    glBindTexture(GL_TEXTURE_2D, entry.textureId);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Framebuffer to render to the texture
+    glFbo_->glGenFramebuffers(1, &entry.fboId);
+    glFbo_->glBindFramebuffer(GL_FRAMEBUFFER, entry.fboId);
+    glFbo_->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                   GL_TEXTURE_2D, entry.textureId, 0);
+    GLenum status = glFbo_->glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glFbo_->glBindFramebuffer(GL_FRAMEBUFFER, viewFboId_);
+
+    if(status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        qDebug() << "Error: onion skin FBO status != GL_FRAMEBUFFER_COMPLETE. Onion skins are not cached.";
+        releaseEntryTexture_(entry);
+    }
+}
+
+void OnionSkinCache::releaseEntryTexture_(Entry & entry)
+{
+    if(entry.fboId)
+        glFbo_->glDeleteFramebuffers(1, &entry.fboId);
+    if(entry.textureId)
+        glDeleteTextures(1, &entry.textureId);
+    entry.fboId = 0;
+    entry.textureId = 0;
+}
+
+void OnionSkinCache::renderEntry_(Entry & entry, ViewSettings & viewSettings)
+{
+    const GLsizei w = state_.viewport[2];
+    const GLsizei h = state_.viewport[3];
+
+    // (Re)create the multisample framebuffer if needed
+    if(samples_ > 1 && !(msFboId_ && msWidth_ == w && msHeight_ == h))
+    {
+        releaseMultisampleFramebuffer_();
+        glFbo_->glGenFramebuffers(1, &msFboId_);
+        glFbo_->glBindFramebuffer(GL_FRAMEBUFFER, msFboId_);
+        glFbo_->glGenRenderbuffers(1, &msColorBufferId_);
+        glFbo_->glBindRenderbuffer(GL_RENDERBUFFER, msColorBufferId_);
+        glFbo_->glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples_, GL_RGBA8, w, h);
+        glFbo_->glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glFbo_->glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                          GL_RENDERBUFFER, msColorBufferId_);
+        msWidth_ = w;
+        msHeight_ = h;
+        if(glFbo_->glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            // Fall back to drawing without antialiasing
+            releaseMultisampleFramebuffer_();
+            samples_ = 0;
+        }
+    }
+    const bool isMultisampled = (msFboId_ != 0);
+
+    // Draw to a fully transparent buffer. With the blending function set in
+    // GLWidget::initializeGL(), this gives premultiplied colors, see
+    // View::drawToImage() and compositeEntry_()
+    // The whole onion skin is rendered, even when the view only redraws a
+    // part of itself
+    const GLboolean isScissorEnabled = glIsEnabled(GL_SCISSOR_TEST);
+    glDisable(GL_SCISSOR_TEST);
+
+    glFbo_->glBindFramebuffer(GL_FRAMEBUFFER, isMultisampled ? msFboId_ : entry.fboId);
+    glViewport(0, 0, w, h);
+    GLfloat clearColor[4];
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+    glClearColor(0.0, 0.0, 0.0, 0.0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+
+    entry.revision = entry.vac->drawingRevision();
+    drawDirectly_(entry.vac, entry.time, entry.dx, entry.dy, viewSettings);
+
+    // Resolve multisample buffer to texture
+    if(isMultisampled)
+    {
+        glFbo_->glBindFramebuffer(GL_READ_FRAMEBUFFER, msFboId_);
+        glFbo_->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, entry.fboId);
+        glFbo_->glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    }
+
+    glFbo_->glBindFramebuffer(GL_FRAMEBUFFER, viewFboId_);
+    glViewport(state_.viewport[0], state_.viewport[1], state_.viewport[2], state_.viewport[3]);
+    if(isScissorEnabled)
+        glEnable(GL_SCISSOR_TEST);
+}
+
+void OnionSkinCache::compositeEntry_(const Entry & entry)
+{
+    // Draw a quad covering the viewport
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    // Colors in the texture are premultiplied
+    gl_->glBlendFuncSeparate(GL_ONE, GL_ONE_MINUS_SRC_ALPHA,
+                             GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, entry.textureId);
+    glColor4d(1.0, 1.0, 1.0, 1.0);
+    glBegin(GL_QUADS);
+    {
+        glTexCoord2d(0, 0); glVertex2d(-1, -1);
+        glTexCoord2d(1, 0); glVertex2d( 1, -1);
+        glTexCoord2d(1, 1); glVertex2d( 1,  1);
+        glTexCoord2d(0, 1); glVertex2d(-1,  1);
+    }
+    glEnd();
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDisable(GL_TEXTURE_2D);
+
+    // Restore blending function. See GLWidget::initializeGL()
+    gl_->glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA,
+                             GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+}
+
+void OnionSkinCache::releaseMultisampleFramebuffer_()
+{
+    if(msFboId_)
+        glFbo_->glDeleteFramebuffers(1, &msFboId_);
+    if(msColorBufferId_)
+        glFbo_->glDeleteRenderbuffers(1, &msColorBufferId_);
+    msFboId_ = 0;
+    msColorBufferId_ = 0;
+    msWidth_ = 0;
+    msHeight_ = 0;
+}
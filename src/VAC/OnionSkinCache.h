@@ -0,0 +1,129 @@
+// Copyright (C) 2012-2019 The VPaint Developers.
+// See the COPYRIGHT file at the top-level directory of this distribution
+// and at https://github.com/dalboris/vpaint/blob/master/COPYRIGHT
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef ONION_SKIN_CACHE_H
+#define ONION_SKIN_CACHE_H
+
+#include "OpenGL.h"
+#include "TimeDef.h"
+
+#include <QList>
+
+class ViewSettings;
+namespace VectorAnimationComplex { class VAC; }
+
+// Caches the onion skins drawn by a View as textures of the size of its
+// viewport, one per layer and onion skin time. This way, repaints which
+// don't change onion skins (hovering, editing the active frame, scrubbing
+// to a neighbouring frame...) only composite them, instead of drawing the
+// VAC once more per onion skin.
+//
+// A cached onion skin is redrawn when its VAC has changed at its time (see
+// VAC::isDrawingChangedSince()). All onion skins are redrawn when anything
+// else which affects drawing has changed: the viewport, the view transform,
+// the view settings, or the tool and display modes. While these change from
+// one frame to the next (e.g., while panning or zooming), onion skins are
+// drawn directly, since cached textures wouldn't be reused anyway.
+//
+// All methods must be called with the OpenGL context of the view current.
+//
+class OnionSkinCache
+{
+public:
+    OnionSkinCache();
+
+    // Does not release textures, since it may not be called with the OpenGL
+    // context current. Call clear() first.
+    ~OnionSkinCache();
+
+    // Starts drawing onion skins for a new frame of the view, with the given
+    // settings and the current OpenGL viewport and matrices
+    void beginFrame(OpenGLFunctions * gl,
+                    QOpenGLExtension_ARB_framebuffer_object * glFbo,
+                    const ViewSettings & viewSettings);
+
+    // Draws the given VAC at the given time, translated by (dx, dy), either
+    // from the cache or directly
+    void draw(VectorAnimationComplex::VAC * vac, Time time, double dx, double dy,
+              ViewSettings & viewSettings);
+
+    // Ends drawing the frame, and releases the textures of onion skins which
+    // are not likely to be drawn anymore
+    void endFrame();
+
+    // Releases all textures
+    void clear();
+
+private:
+    // Everything which affects drawing, apart from the VAC itself
+    struct State
+    {
+        GLint viewport[4];
+        GLdouble projection[16];
+        GLdouble modelview[16];
+        int toolMode;
+        int globalDisplayMode;
+        int displayMode;
+        bool drawCursor;
+        int vertexTopologySize;
+        int edgeTopologyWidth;
+        bool drawTopologyFaces;
+        bool screenRelative;
+        double zoom;
+
+        bool operator==(const State & other) const;
+    };
+    State state_;
+    bool isCaching_;
+
+    struct Entry
+    {
+        VectorAnimationComplex::VAC * vac; // only compared, may be dangling
+        Time time;
+        double dx;
+        double dy;
+        quint64 revision;
+        GLuint textureId;
+        GLuint fboId;
+        int lastUse;
+    };
+    QList<Entry> entries_;
+    int frame_;
+
+    // Multisample framebuffer where onion skins are drawn before being
+    // resolved to their texture, so that they are antialiased as the view
+    GLint samples_;
+    GLuint msFboId_;
+    GLuint msColorBufferId_;
+    GLsizei msWidth_;
+    GLsizei msHeight_;
+
+    OpenGLFunctions * gl_;
+    QOpenGLExtension_ARB_framebuffer_object * glFbo_;
+    GLint viewFboId_;
+
+    static State currentState_(const ViewSettings & viewSettings);
+    void drawDirectly_(VectorAnimationComplex::VAC * vac, Time time, double dx, double dy,
+                       ViewSettings & viewSettings);
+    void createEntryTexture_(Entry & entry);
+    void releaseEntryTexture_(Entry & entry);
+    void renderEntry_(Entry & entry, ViewSettings & viewSettings);
+    void compositeEntry_(const Entry & entry);
+    void releaseMultisampleFramebuffer_();
+};
+
+#endif // ONION_SKIN_CACHE_H
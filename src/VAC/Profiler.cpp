@@ -0,0 +1,231 @@
+// Copyright (C) 2012-2019 The VPaint Developers.
+// See the COPYRIGHT file at the top-level directory of this distribution
+// and at https://github.com/dalboris/vpaint/blob/master/COPYRIGHT
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Profiler.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTextStream>
+#include <QThread>
+
+#include <cstring>
+#include <deque>
+#include <map>
+
+namespace
+{
+
+// Maximum number of events kept in history (oldest are discarded first)
+const size_t MAX_HISTORY_SIZE = 1000000;
+
+struct Event
+{
+    enum Type { Scope, Counter };
+    Type type;
+    const char * name;
+    qint64 start;    // nanoseconds
+    qint64 value;    // duration in nanoseconds for scopes, count for counters
+    quintptr thread;
+};
+
+struct Stat
+{
+    Stat() : count(0), total(0) {}
+    int count;
+    qint64 total;
+};
+
+struct NameLess
+{
+    bool operator()(const char * a, const char * b) const
+    {
+        return std::strcmp(a, b) < 0;
+    }
+};
+
+typedef std::map<const char *, Stat, NameLess> StatMap;
+
+// All data is protected by this mutex, except the timer which is started
+// once on first use (thread-safe since C++11 for function-local statics)
+QMutex mutex;
+std::deque<Event> history;
+StatMap currentScopes;
+StatMap currentCounters;
+StatMap lastScopes;
+StatMap lastCounters;
+
+const QElapsedTimer & timer()
+{
+    static QElapsedTimer * t = []() {
+        QElapsedTimer * res = new QElapsedTimer();
+        res->start();
+        return res;
+    }();
+    return *t;
+}
+
+void addToHistory_(const Event & e)
+{
+    history.push_back(e);
+    if (history.size() > MAX_HISTORY_SIZE)
+        history.pop_front();
+}
+
+QString escapeJson_(const char * s)
+{
+    QString res(s);
+    res.replace("\\", "\\\\");
+    res.replace("\"", "\\\"");
+    return res;
+}
+
+}
+
+std::atomic<bool> Profiler::enabled_(false);
+
+void Profiler::setEnabled(bool enabled)
+{
+    enabled_ = enabled;
+}
+
+qint64 Profiler::now()
+{
+    return timer().nsecsElapsed();
+}
+
+void Profiler::addEvent(const char * name, qint64 start, qint64 duration)
+{
+    Event e;
+    e.type = Event::Scope;
+    e.name = name;
+    e.start = start;
+    e.value = duration;
+    e.thread = (quintptr) QThread::currentThreadId();
+
+    QMutexLocker locker(&mutex);
+    Stat & s = currentScopes[name];
+    s.count += 1;
+    s.total += duration;
+    addToHistory_(e);
+}
+
+void Profiler::addCount(const char * name, int n)
+{
+    if (!isEnabled())
+        return;
+
+    QMutexLocker locker(&mutex);
+    Stat & s = currentCounters[name];
+    s.count += 1;
+    s.total += n;
+}
+
+void Profiler::endFrame()
+{
+    const qint64 t = now();
+
+    QMutexLocker locker(&mutex);
+
+    // Counters are stored in history once per frame, as Chrome trace
+    // counter events
+    for (StatMap::const_iterator it = currentCounters.begin(); it != currentCounters.end(); ++it)
+    {
+        Event e;
+        e.type = Event::Counter;
+        e.name = it->first;
+        e.start = t;
+        e.value = it->second.total;
+        e.thread = 0;
+        addToHistory_(e);
+    }
+
+    lastScopes.swap(currentScopes);
+    lastCounters.swap(currentCounters);
+    currentScopes.clear();
+    currentCounters.clear();
+}
+
+QString Profiler::lastFrameReport()
+{
+    QString res;
+    QTextStream out(&res);
+
+    QMutexLocker locker(&mutex);
+    for (StatMap::const_iterator it = lastScopes.begin(); it != lastScopes.end(); ++it)
+    {
+        out << it->first << ": "
+            << QString::number(it->second.total * 1e-6, 'f', 2) << " ms";
+        if (it->second.count > 1)
+            out << " (" << it->second.count << " calls)";
+        out << "\n";
+    }
+    for (StatMap::const_iterator it = lastCounters.begin(); it != lastCounters.end(); ++it)
+    {
+        out << it->first << ": " << it->second.total << "\n";
+    }
+
+    out.flush();
+    return res;
+}
+
+bool Profiler::exportChromeTrace(const QString & filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QFile::Truncate | QFile::Text))
+        return false;
+
+    QTextStream out(&file);
+    out << "{\"traceEvents\":[\n";
+
+    QMutexLocker locker(&mutex);
+    bool first = true;
+    for (const Event & e: history)
+    {
+        if (!first)
+            out << ",\n";
+        first = false;
+
+        // Chrome trace timestamps are in microseconds
+        out << "{\"name\":\"" << escapeJson_(e.name) << "\",\"pid\":1"
+            << ",\"tid\":" << e.thread
+            << ",\"ts\":" << QString::number(e.start * 1e-3, 'f', 3);
+        if (e.type == Event::Scope)
+        {
+            out << ",\"ph\":\"X\",\"dur\":" << QString::number(e.value * 1e-3, 'f', 3) << "}";
+        }
+        else
+        {
+            out << ",\"ph\":\"C\",\"args\":{\"count\":" << e.value << "}}";
+        }
+    }
+
+    out << "\n]}\n";
+    out.flush();
+    file.close();
+    return true;
+}
+
+void Profiler::clear()
+{
+    QMutexLocker locker(&mutex);
+    history.clear();
+    currentScopes.clear();
+    currentCounters.clear();
+    lastScopes.clear();
+    lastCounters.clear();
+}
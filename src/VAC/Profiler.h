@@ -0,0 +1,108 @@
+// Copyright (C) 2012-2019 The VPaint Developers.
+// See the COPYRIGHT file at the top-level directory of this distribution
+// and at https://github.com/dalboris/vpaint/blob/master/COPYRIGHT
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <QString>
+#include <QtGlobal>
+
+#include <atomic>
+
+// Lightweight instrumentation of hot paths, for development. It is always
+// compiled in, but disabled by default: when disabled, a ProfilerScope costs
+// a single boolean test. It is enabled via the "profiler" dev setting.
+//
+// Usage:
+//
+//     void VAC::draw(Time time, ViewSettings & viewSettings)
+//     {
+//         ProfilerScope profilerScope("VAC::draw");
+//         ...
+//     }
+//
+//     Profiler::addCount("Cell::triangles cache miss");
+//
+// Names must be string literals (only the pointer is stored). Recorded scopes
+// and counters are:
+//   - aggregated between two calls of endFrame(), which MultiView calls once
+//     per update of all its views, and displayed by each view as an
+//     overlay, and
+//   - kept in a bounded history, which can be exported as a Chrome trace
+//     (open it in chrome://tracing or https://ui.perfetto.dev).
+//
+// All functions are thread-safe.
+//
+class Profiler
+{
+public:
+    // Enables or disables recording. Disabling doesn't clear recorded data.
+    static bool isEnabled() { return enabled_.load(std::memory_order_relaxed); }
+    static void setEnabled(bool enabled);
+
+    // Current time in nanoseconds, since an arbitrary origin
+    static qint64 now();
+
+    // Records a scope named `name` that started at `start` and lasted
+    // `duration` nanoseconds. Typically, use ProfilerScope instead.
+    static void addEvent(const char * name, qint64 start, qint64 duration);
+
+    // Increments the counter named `name` by n
+    static void addCount(const char * name, int n = 1);
+
+    // Ends the current frame: the scopes and counters recorded since the
+    // previous call become the ones reported by lastFrameReport()
+    static void endFrame();
+
+    // Human-readable summary of the last frame, one line per scope or counter
+    static QString lastFrameReport();
+
+    // Writes the recorded history as a Chrome trace JSON file. Returns false
+    // if the file couldn't be written.
+    static bool exportChromeTrace(const QString & filePath);
+
+    // Clears all recorded data
+    static void clear();
+
+private:
+    static std::atomic<bool> enabled_;
+};
+
+// Records the lifetime of this object as a scope of the profiler
+class ProfilerScope
+{
+public:
+    explicit ProfilerScope(const char * name) :
+        name_(Profiler::isEnabled() ? name : nullptr),
+        start_(name_ ? Profiler::now() : 0)
+    {
+    }
+
+    ~ProfilerScope()
+    {
+        if (name_)
+            Profiler::addEvent(name_, start_, Profiler::now() - start_);
+    }
+
+private:
+    const char * name_;
+    qint64 start_;
+
+    ProfilerScope(const ProfilerScope &);
+    ProfilerScope & operator=(const ProfilerScope &);
+};
+
+#endif // PROFILER_H
@@ -21,7 +21,9 @@
 
 #include "VectorAnimationComplex/VAC.h"
 #include "VectorAnimationComplex/InbetweenFace.h"
+#include "VectorAnimationComplex/Rasterizer.h"
 #include "Background/Background.h"
+#include "Background/BackgroundRenderer.h"
 
 #include <QtDebug>
 
@@ -42,7 +44,8 @@ Scene::Scene() :
     left_(0),
     top_(0),
     width_(1280),
-    height_(720)
+    height_(720),
+    samplingTolerance_(0.0)
 {
     indexHovered_ = -1;
 }
@@ -99,6 +102,18 @@ void Scene::setHeight(double h)
     emitChanged();
 }
 
+double Scene::samplingTolerance() const
+{
+    return samplingTolerance_;
+}
+
+void Scene::setSamplingTolerance(double tolerance)
+{
+    samplingTolerance_ = tolerance;
+    foreach(Layer * layer, layers_)
+        layer->vac()->setSamplingTolerance(tolerance);
+}
+
 void Scene::setCanvasDefaultValues()
 {
     left_ = 0;
@@ -120,6 +135,7 @@ void Scene::copyFrom(Scene * other)
     clear(true);
 
     // Copy layers
+    samplingTolerance_ = other->samplingTolerance_;
     foreach(Layer * layer, other->layers_)
         addLayer_(layer->clone(), true);
     activeLayerIndex_ = other->activeLayerIndex_;
@@ -287,6 +303,19 @@ void Scene::writeCanvas(XmlStreamWriter & xml)
     xml.writeAttribute("size", QString().setNum(width()) + " " + QString().setNum(height()));
 }
 
+void Scene::readSampling(XmlStreamReader & xml)
+{
+    if(xml.attributes().hasAttribute("tolerance"))
+        setSamplingTolerance(xml.attributes().value("tolerance").toDouble());
+
+    xml.skipCurrentElement();
+}
+
+void Scene::writeSampling(XmlStreamWriter & xml)
+{
+    xml.writeAttribute("tolerance", QString().setNum(samplingTolerance()));
+}
+
 void Scene::relativeRemap(const QDir & oldDir, const QDir & newDir)
 {
     foreach(Layer * layer, layers_)
@@ -352,6 +381,24 @@ void Scene::draw(Time time, ViewSettings & viewSettings)
     }
 }
 
+void Scene::rasterize(Time time, VectorAnimationComplex::Rasterizer & rasterizer,
+                      double xSceneMin, double xSceneMax,
+                      double ySceneMin, double ySceneMax)
+{
+    foreach(Layer * layer, layers_)
+    {
+        if (layer->isVisible())
+        {
+            BackgroundRenderer::rasterize(
+                        layer->background(), rasterizer,
+                        time.frame(), global()->showCanvas(),
+                        left(), top(), width(), height(),
+                        xSceneMin, xSceneMax, ySceneMin, ySceneMax);
+            layer->rasterize(time, rasterizer);
+        }
+    }
+}
+
 void Scene::drawPick(Time time, ViewSettings & viewSettings)
 {
     // Find which layer to pick
@@ -374,6 +421,17 @@ void Scene::drawPick(Time time, ViewSettings & viewSettings)
     }
 }
 
+void Scene::drawPick(Time time, ViewSettings & viewSettings,
+                     const VectorAnimationComplex::BoundingBox & region)
+{
+    Layer * layer = activeLayer();
+    if (layer)
+    {
+        Picking::setIndex(activeLayerIndex());
+        layer->drawPick(time, viewSettings, region);
+    }
+}
+
 
 // ---------------- Highlighting and Selecting -----------------------
     
@@ -680,6 +738,7 @@ void Scene::keyReleaseEvent(QKeyEvent *event)
 void Scene::addLayer_(Layer * layer, bool silent)
 {
     layers_ << layer;
+    layer->vac()->setSamplingTolerance(samplingTolerance_);
     if (activeLayerIndex_ < 0) {
         activeLayerIndex_ = 0;
     }
@@ -730,6 +789,14 @@ void Scene::smartDelete()
     }
 }
 
+void Scene::completePendingSketches()
+{
+    foreach(Layer * layer, layers_)
+    {
+        layer->vac()->completePendingSketch();
+    }
+}
+
 int Scene::numLayers() const
 {
     return layers_.size();
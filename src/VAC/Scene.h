@@ -37,6 +37,8 @@ namespace VectorAnimationComplex
 {
 class VAC;
 class InbetweenFace;
+class Rasterizer;
+class BoundingBox;
 }
 class QDir;
 class Layer;
@@ -72,6 +74,18 @@ public:
     void draw(Time time, ViewSettings & viewSettings);
     void drawPick(Time time, ViewSettings & viewSettings);
 
+    // Same as drawPick(), but skips the cells which are not drawn in the
+    // given region. See VectorAnimationComplex::VAC::drawPick().
+    void drawPick(Time time, ViewSettings & viewSettings,
+                  const VectorAnimationComplex::BoundingBox & region);
+
+    // Software rendering of all visible layers, including their background,
+    // as in illustration mode. The given scene rectangle is the one covered
+    // by the rasterizer's viewport.
+    void rasterize(Time time, VectorAnimationComplex::Rasterizer & rasterizer,
+                   double xSceneMin, double xSceneMax,
+                   double ySceneMin, double ySceneMax);
+
     // XXX todo: there should be draw3D here too (not only in VAC),
     //           responsible for instance to draw the canvas
 
@@ -87,6 +101,11 @@ public:
     void emitChanged() {emit changed();}
     void emitCheckpoint() {emit checkpoint();}
 
+    // Inserts edges whose sketch has ended but whose intersections are
+    // still being computed. Must be called before using the scene as a
+    // whole, e.g., to save it or to undo.
+    void completePendingSketches();
+
     // Save and load
     void exportSVG(Time t, QTextStream & out);
     void save(QTextStream & out);
@@ -95,6 +114,8 @@ public:
     void readOneLayer(XmlStreamReader & xml);
     void readCanvas(XmlStreamReader & xml);
     void writeCanvas(XmlStreamWriter & xml);
+    void readSampling(XmlStreamReader & xml);
+    void writeSampling(XmlStreamWriter & xml);
     void relativeRemap(const QDir & oldDir, const QDir & newDir);
 
     // Get layer from index
@@ -135,6 +156,12 @@ public:
     void setWidth(double w);
     void setHeight(double h);
     void setCanvasDefaultValues();
+
+    // Tolerance of the adaptive sampling of imported and sculpted edges, in
+    // pixels, or 0 for uniform sampling (see SculptCurve). Existing edges
+    // are not resampled when it changes.
+    double samplingTolerance() const;
+    void setSamplingTolerance(double tolerance);
     
 public slots:
     // --------- Tools ----------
@@ -228,6 +255,8 @@ private:
     double top_;
     double width_;
     double height_;
+
+    double samplingTolerance_;
 };
     
 #endif
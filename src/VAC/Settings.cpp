@@ -31,6 +31,9 @@ void Settings::readFromDisk(QSettings & settings)
     dontNotifyConversion_ = settings.value("general-dontnotifyconversion", false).toBool();
     checkVersion_ = Version(settings.value("general-checkversion", qApp->applicationVersion()).toString());
     svgImportVertexMode_ = toSvgImportVertexMode(settings.value("svgimport-vertexmode", toString(defaultSvgImportVertexMode)).toString());
+    backgroundImageMemoryBudget_ = settings.value("background-imagememorybudget", 1024).toInt();
+    backgroundTextureMemoryBudget_ = settings.value("background-texturememorybudget", 512).toInt();
+    backgroundProxiesWhileScrubbing_ = settings.value("background-proxieswhilescrubbing", true).toBool();
 }
 
 void Settings::writeToDisk(QSettings & settings)
@@ -41,6 +44,9 @@ void Settings::writeToDisk(QSettings & settings)
     settings.setValue("general-dontnotifyconversion", dontNotifyConversion_);
     settings.setValue("general-checkversion", checkVersion_.toString());
     settings.setValue("svgimport-vertexmode", toString(svgImportVertexMode_));
+    settings.setValue("background-imagememorybudget", backgroundImageMemoryBudget_);
+    settings.setValue("background-texturememorybudget", backgroundTextureMemoryBudget_);
+    settings.setValue("background-proxieswhilescrubbing", backgroundProxiesWhileScrubbing_);
 }
 
 // Edge width
@@ -65,3 +71,13 @@ void Settings::setCheckVersion(Version value) { checkVersion_ = value; }
 // Import preferences
 SvgImportVertexMode Settings::svgImportVertexMode() const { return svgImportVertexMode_; }
 void Settings::setSvgImportVertexMode(SvgImportVertexMode value) { svgImportVertexMode_ = value; }
+
+// Background images
+int Settings::backgroundImageMemoryBudget() const { return backgroundImageMemoryBudget_; }
+void Settings::setBackgroundImageMemoryBudget(int value) { backgroundImageMemoryBudget_ = value; }
+
+int Settings::backgroundTextureMemoryBudget() const { return backgroundTextureMemoryBudget_; }
+void Settings::setBackgroundTextureMemoryBudget(int value) { backgroundTextureMemoryBudget_ = value; }
+
+bool Settings::backgroundProxiesWhileScrubbing() const { return backgroundProxiesWhileScrubbing_; }
+void Settings::setBackgroundProxiesWhileScrubbing(bool value) { backgroundProxiesWhileScrubbing_ = value; }
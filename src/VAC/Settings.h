@@ -55,6 +55,16 @@ public:
     SvgImportVertexMode svgImportVertexMode() const;
     void setSvgImportVertexMode(SvgImportVertexMode value);
 
+    // Background images (memory budgets in megabytes)
+    int backgroundImageMemoryBudget() const;
+    void setBackgroundImageMemoryBudget(int value);
+
+    int backgroundTextureMemoryBudget() const;
+    void setBackgroundTextureMemoryBudget(int value);
+
+    bool backgroundProxiesWhileScrubbing() const;
+    void setBackgroundProxiesWhileScrubbing(bool value);
+
 private:
     double edgeWidth_;
     bool showAboutDialogAtStartup_;
@@ -62,6 +72,9 @@ private:
     bool dontNotifyConversion_;
     Version checkVersion_;
     SvgImportVertexMode svgImportVertexMode_;
+    int backgroundImageMemoryBudget_;
+    int backgroundTextureMemoryBudget_;
+    bool backgroundProxiesWhileScrubbing_;
 };
 
 #endif
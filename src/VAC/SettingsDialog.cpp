@@ -17,6 +17,7 @@
 #include "SettingsDialog.h"
 #include "Global.h"
 
+#include <QFormLayout>
 #include <QVBoxLayout>
 
 //////////////////////////////////////////////////////////////////
@@ -30,11 +31,26 @@ SettingsDialog::SettingsDialog(QWidget * parent) :
     edgeWidth_ = new QDoubleSpinBox();
     edgeWidth_->setRange(0.0, 999.99);
 
+    backgroundImageMemoryBudget_ = new QSpinBox();
+    backgroundImageMemoryBudget_->setRange(64, 65536);
+    backgroundImageMemoryBudget_->setSuffix(" MB");
+
+    backgroundTextureMemoryBudget_ = new QSpinBox();
+    backgroundTextureMemoryBudget_->setRange(64, 65536);
+    backgroundTextureMemoryBudget_->setSuffix(" MB");
+
+    backgroundProxiesWhileScrubbing_ = new QCheckBox(tr("Use low-resolution images while scrubbing"));
 
     // setup layout
     QVBoxLayout * mainLayout = new QVBoxLayout(this);
     mainLayout->addWidget(edgeWidth_);
 
+    QFormLayout * backgroundLayout = new QFormLayout();
+    backgroundLayout->addRow(tr("Background images memory:"), backgroundImageMemoryBudget_);
+    backgroundLayout->addRow(tr("Background images video memory:"), backgroundTextureMemoryBudget_);
+    backgroundLayout->addRow(backgroundProxiesWhileScrubbing_);
+    mainLayout->addLayout(backgroundLayout);
+
     // Preference dialog buttons
     dialogButtons_ = new QDialogButtonBox(QDialogButtonBox::Ok |
                                           QDialogButtonBox::Cancel |
@@ -53,12 +69,18 @@ Settings SettingsDialog::preferencesFromWidgetValues() const
 {
     Settings preferences = preferencesBak;
     preferences.setEdgeWidth( edgeWidth_->value() );
+    preferences.setBackgroundImageMemoryBudget( backgroundImageMemoryBudget_->value() );
+    preferences.setBackgroundTextureMemoryBudget( backgroundTextureMemoryBudget_->value() );
+    preferences.setBackgroundProxiesWhileScrubbing( backgroundProxiesWhileScrubbing_->isChecked() );
     return preferences;
 }
 
 void SettingsDialog::setWidgetValuesFromPreferences(const Settings & preferences)
 {
     edgeWidth_->setValue( preferences.edgeWidth() );
+    backgroundImageMemoryBudget_->setValue( preferences.backgroundImageMemoryBudget() );
+    backgroundTextureMemoryBudget_->setValue( preferences.backgroundTextureMemoryBudget() );
+    backgroundProxiesWhileScrubbing_->setChecked( preferences.backgroundProxiesWhileScrubbing() );
 }
 
 
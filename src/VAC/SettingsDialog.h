@@ -20,8 +20,10 @@
 #include <QDialog>
 #include "Settings.h"
 
+#include <QCheckBox>
 #include <QDialogButtonBox>
 #include <QDoubleSpinBox>
+#include <QSpinBox>
 
 class SettingsDialog: public QDialog
 {
@@ -51,6 +53,9 @@ private:
     void setWidgetValuesFromPreferences(const Settings & preferences);
 
     QDoubleSpinBox * edgeWidth_;
+    QSpinBox * backgroundImageMemoryBudget_;
+    QSpinBox * backgroundTextureMemoryBudget_;
+    QCheckBox * backgroundProxiesWhileScrubbing_;
 
 
     QDialogButtonBox * dialogButtons_;
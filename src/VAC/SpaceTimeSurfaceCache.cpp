@@ -0,0 +1,223 @@
+// Copyright (C) 2012-2019 The VPaint Developers.
+// See the COPYRIGHT file at the top-level directory of this distribution
+// and at https://github.com/dalboris/vpaint/blob/master/COPYRIGHT
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "SpaceTimeSurfaceCache.h"
+
+#include "View3DSettings.h"
+
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+// Below this number of edges, surfaces are computed in the GUI thread
+const int MIN_EDGES_FOR_PARALLEL = 4;
+
+// Each vertex is made of a position and a normal
+const int FLOATS_PER_VERTEX = 6;
+
+}
+
+SpaceTimeSurfaceCache::SpaceTimeSurfaceCache() :
+    entries_(),
+    frame_(0),
+    gl_(0)
+{
+}
+
+SpaceTimeSurfaceCache::~SpaceTimeSurfaceCache()
+{
+}
+
+void SpaceTimeSurfaceCache::beginFrame(OpenGLFunctions * gl,
+                                       const View3DSettings & viewSettings,
+                                       const QVector<VectorAnimationComplex::InbetweenEdge *> & edges,
+                                       int timeStride, int sampleStride)
+{
+    using VectorAnimationComplex::InbetweenEdge;
+
+    ++frame_;
+    gl_ = gl;
+
+    // Compute surfaces which are not up to date. This only reads the VAC
+    // (curves compute their arclengths eagerly), and each edge only writes
+    // its own cache.
+    if(edges.size() >= MIN_EDGES_FOR_PARALLEL)
+    {
+        QVector<InbetweenEdge *> edgesToCompute = edges;
+        QtConcurrent::blockingMap(edgesToCompute, [&viewSettings, timeStride, sampleStride](InbetweenEdge * edge)
+        {
+            edge->spaceTimeSurface(viewSettings, timeStride, sampleStride);
+        });
+    }
+
+    // Upload them
+    foreach(InbetweenEdge * edge, edges)
+    {
+        auto it = entries_.find(edge);
+        if(it == entries_.end())
+        {
+            Entry entry;
+            entry.revision = 0;
+            entry.vertexBufferId = 0;
+            entry.indexBufferId = 0;
+            entry.numRows = 0;
+            entry.numCols = 0;
+            entry.tMin = 0;
+            entry.tMax = 0;
+            entry.lastUse = 0;
+            it = entries_.insert(edge, entry);
+        }
+
+        const InbetweenEdge::SpaceTimeSurface & surf =
+                edge->spaceTimeSurface(viewSettings, timeStride, sampleStride);
+        if(it->revision != surf.revision)
+            upload_(*it, surf);
+        it->lastUse = frame_;
+    }
+}
+
+void SpaceTimeSurfaceCache::draw(VectorAnimationComplex::InbetweenEdge * edge, double t1, double t2)
+{
+    auto it = entries_.find(edge);
+    if(it == entries_.end() || !it->vertexBufferId)
+        return;
+
+    const Entry & entry = *it;
+
+    // Bands of quads overlapping [t1, t2]. Bands partially outside are
+    // clipped by the caller.
+    int numBands = entry.numRows - 1;
+    int firstBand = 0;
+    int lastBand = numBands - 1;
+    double dt = (entry.tMax - entry.tMin) / numBands;
+    if(dt > 0)
+    {
+        firstBand = std::floor((t1 - entry.tMin) / dt);
+        lastBand = std::ceil((t2 - entry.tMin) / dt) - 1;
+        firstBand = std::max(0, std::min(firstBand, numBands - 1));
+        lastBand = std::max(firstBand, std::min(lastBand, numBands - 1));
+    }
+
+    // Bands are stored from the last one to the first one
+    const int indicesPerBand = 4 * (entry.numCols - 1);
+    const int offset = (numBands - 1 - lastBand) * indicesPerBand;
+    const int count = (lastBand - firstBand + 1) * indicesPerBand;
+
+    const GLsizei stride = FLOATS_PER_VERTEX * sizeof(GLfloat);
+    gl_->glBindBuffer(GL_ARRAY_BUFFER, entry.vertexBufferId);
+    gl_->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, entry.indexBufferId);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glVertexPointer(3, GL_FLOAT, stride, 0);
+    glNormalPointer(GL_FLOAT, stride, reinterpret_cast<const GLvoid *>(3 * sizeof(GLfloat)));
+    glDrawElements(GL_QUADS, count, GL_UNSIGNED_INT,
+                   reinterpret_cast<const GLvoid *>(offset * sizeof(GLuint)));
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    gl_->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    gl_->glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void SpaceTimeSurfaceCache::endFrame()
+{
+    for(auto it = entries_.begin(); it != entries_.end();)
+    {
+        if(it->lastUse != frame_)
+        {
+            releaseEntryBuffers_(*it);
+            it = entries_.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void SpaceTimeSurfaceCache::clear()
+{
+    for(auto it = entries_.begin(); it != entries_.end(); ++it)
+        releaseEntryBuffers_(*it);
+    entries_.clear();
+}
+
+void SpaceTimeSurfaceCache::upload_(Entry & entry,
+                                    const VectorAnimationComplex::InbetweenEdge::SpaceTimeSurface & surf)
+{
+    entry.revision = surf.revision;
+    entry.numRows = surf.numRows;
+    entry.numCols = surf.numCols;
+    entry.tMin = surf.tMin;
+    entry.tMax = surf.tMax;
+
+    const int m = surf.numRows;
+    const int n = surf.numCols;
+    if(m < 2 || n < 2)
+    {
+        releaseEntryBuffers_(entry);
+        return;
+    }
+
+    // Interleaved positions and normals
+    QVector<GLfloat> vertices;
+    vertices.reserve(FLOATS_PER_VERTEX * m * n);
+    for(int k=0; k<m*n; ++k)
+    {
+        const Eigen::Vector3d & p = surf.positions[k];
+        const Eigen::Vector3d & nor = surf.normals[k];
+        vertices << p[0] << p[1] << p[2] << nor[0] << nor[1] << nor[2];
+    }
+
+    // Quads, band by band, starting with the last one
+    QVector<GLuint> indices;
+    indices.reserve(4 * (m-1) * (n-1));
+    for(int i=m-2; i>=0; --i)
+    {
+        for(int j=1; j<n; ++j)
+        {
+            indices << i*n + j-1 << (i+1)*n + j-1 << (i+1)*n + j << i*n + j;
+        }
+    }
+
+    if(!entry.vertexBufferId)
+        gl_->glGenBuffers(1, &entry.vertexBufferId);
+    if(!entry.indexBufferId)
+        gl_->glGenBuffers(1, &entry.indexBufferId);
+
+    gl_->glBindBuffer(GL_ARRAY_BUFFER, entry.vertexBufferId);
+    gl_->glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat),
+                      vertices.constData(), GL_STATIC_DRAW);
+    gl_->glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    gl_->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, entry.indexBufferId);
+    gl_->glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint),
+                      indices.constData(), GL_STATIC_DRAW);
+    gl_->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void SpaceTimeSurfaceCache::releaseEntryBuffers_(Entry & entry)
+{
+    if(entry.vertexBufferId)
+        gl_->glDeleteBuffers(1, &entry.vertexBufferId);
+    if(entry.indexBufferId)
+        gl_->glDeleteBuffers(1, &entry.indexBufferId);
+    entry.vertexBufferId = 0;
+    entry.indexBufferId = 0;
+}
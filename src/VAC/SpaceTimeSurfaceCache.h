@@ -0,0 +1,88 @@
+// Copyright (C) 2012-2019 The VPaint Developers.
+// See the COPYRIGHT file at the top-level directory of this distribution
+// and at https://github.com/dalboris/vpaint/blob/master/COPYRIGHT
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SPACE_TIME_SURFACE_CACHE_H
+#define SPACE_TIME_SURFACE_CACHE_H
+
+#include "OpenGL.h"
+#include "VectorAnimationComplex/InbetweenEdge.h"
+
+#include <QHash>
+#include <QVector>
+
+class View3DSettings;
+
+// Caches the space-time surfaces of inbetween edges drawn by a View3D as
+// vertex and index buffers. Surfaces are computed in parallel at the
+// beginning of each frame, and uploaded again only when they have been
+// recomputed, that is, after the geometry of the edge has changed, or the
+// View3DSettings or level of detail have changed.
+//
+// Quads of a surface are stored one band of consecutive rows after the
+// other, starting with the last band, so that drawing a time range only
+// draws the bands it overlaps, still from the rear to the front.
+//
+// All methods must be called with the OpenGL context of the view current.
+//
+class SpaceTimeSurfaceCache
+{
+public:
+    SpaceTimeSurfaceCache();
+
+    // Does not release buffers, since it may not be called with the OpenGL
+    // context current. Call clear() first.
+    ~SpaceTimeSurfaceCache();
+
+    // Starts a new frame of the view. Computes the surfaces of the given
+    // edges which are not up to date, sampled every timeStride/k1 frame and
+    // every sampleStride*k2 sample, and uploads them.
+    void beginFrame(OpenGLFunctions * gl,
+                    const View3DSettings & viewSettings,
+                    const QVector<VectorAnimationComplex::InbetweenEdge *> & edges,
+                    int timeStride, int sampleStride);
+
+    // Draws the part of the surface of the given edge between t1 and t2.
+    // The edge must have been given to beginFrame().
+    void draw(VectorAnimationComplex::InbetweenEdge * edge, double t1, double t2);
+
+    // Ends the frame, and releases the buffers of edges not drawn in it
+    void endFrame();
+
+    // Releases all buffers
+    void clear();
+
+private:
+    struct Entry
+    {
+        quint64 revision;
+        GLuint vertexBufferId;
+        GLuint indexBufferId;
+        int numRows;
+        int numCols;
+        double tMin;
+        double tMax;
+        int lastUse;
+    };
+    QHash<VectorAnimationComplex::InbetweenEdge *, Entry> entries_; // keys may be dangling
+    int frame_;
+
+    OpenGLFunctions * gl_;
+
+    void upload_(Entry & entry, const VectorAnimationComplex::InbetweenEdge::SpaceTimeSurface & surf);
+    void releaseEntryBuffers_(Entry & entry);
+};
+
+#endif // SPACE_TIME_SURFACE_CACHE_H
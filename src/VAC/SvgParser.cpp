@@ -1018,6 +1018,7 @@ void finishSubpath(
         // Create closed edge
         samples.push_back(samples.front());
         LinearSpline* geometry = new LinearSpline(samples, true);
+        geometry->setSamplingTolerance(vac->samplingTolerance());
         KeyEdge* edge = vac->newKeyEdge(time, geometry);
         edge->setColor(pa.stroke.color);
         halfedges.push_back(KeyHalfedge(edge, true));
@@ -1045,6 +1046,7 @@ void finishSubpath(
                 edgeSamples.push_back(samples[j % numSamples]);
             }
             LinearSpline* geometry = new LinearSpline(edgeSamples);
+            geometry->setSamplingTolerance(vac->samplingTolerance());
             KeyEdge* edge = vac->newKeyEdge(time, v1, v2, geometry);
             edge->setColor(pa.stroke.color);
             halfedges.push_back(KeyHalfedge(edge, true));
@@ -1938,6 +1940,9 @@ void SvgParser::readSvg(XmlStreamReader & xml, const SvgImportParams& params)
     VAC* vac = global()->scene()->activeVAC();
     Time t = global()->activeTime();
 
+    // Defer the insertion of created cells in the z-ordering, and signals
+    VAC::BatchEdit batchEdit(vac);
+
     // Iterate over all XML tokens, including the <svg> start element
     // which may have style attributes or transforms
     while (!xml.atEnd())
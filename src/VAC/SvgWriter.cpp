@@ -0,0 +1,377 @@
+// Copyright (C) 2012-2019 The VPaint Developers.
+// See the COPYRIGHT file at the top-level directory of this distribution
+// and at https://github.com/dalboris/vpaint/blob/master/COPYRIGHT
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "SvgWriter.h"
+
+#include "Scene.h"
+#include "Layer.h"
+#include "Background/Background.h"
+#include "VectorAnimationComplex/VAC.h"
+#include "VectorAnimationComplex/KeyCell.h"
+#include "VectorAnimationComplex/KeyEdge.h"
+#include "VectorAnimationComplex/InbetweenCell.h"
+#include "VectorAnimationComplex/EdgeGeometry.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QThread>
+#include <QtConcurrent>
+#include <QtDebug>
+
+#include <algorithm>
+#include <atomic>
+
+using namespace VectorAnimationComplex;
+
+namespace
+{
+
+// Number of frames per thread in each batch when writing sequences
+const int FRAMES_PER_THREAD = 4;
+
+// Number of cells generated concurrently when writing animations. This
+// bounds the number of shapes held in memory before being deduplicated.
+const int CELLS_PER_BATCH = 256;
+
+const char * FOOTER = "</svg>\n";
+
+bool writeToFile_(const QByteArray & data, const QString & filePath)
+{
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        qDebug() << "Error: cannot open file" << filePath;
+        return false;
+    }
+    file.write(data);
+    return file.commit();
+}
+
+// The shapes of one cell (or one background) at consecutive frames, relative
+// to the first frame of the animation. A shape is empty if there is nothing
+// to draw at this frame.
+struct Track
+{
+    Track() : cell(nullptr), firstFrame(0) {}
+    Cell * cell;
+    int firstFrame;
+    QVector<QString> shapes;
+};
+
+// Assigns an ID to each distinct shape, and writes it to defs the first
+// time it is seen
+class ShapeTable
+{
+public:
+    ShapeTable(QTextStream & defs) : defs_(defs) {}
+
+    int id(const QString & shape, bool isBackground)
+    {
+        auto it = ids_.constFind(shape);
+        if (it != ids_.cend())
+            return it.value();
+
+        const int res = ids_.size();
+        ids_.insert(shape, res);
+
+        QString def = shape;
+        if (isBackground)
+        {
+            // Background::exportSVG() uses fixed IDs, which must be made
+            // unique in the document
+            const QString suffix = QString("_s%1").arg(res);
+            def.replace("id=\"backgroundpattern\"", "id=\"backgroundpattern" + suffix + "\"");
+            def.replace("url(#backgroundpattern)", "url(#backgroundpattern" + suffix + ")");
+            def.replace("id=\"backgroundcolor\"", "id=\"backgroundcolor" + suffix + "\"");
+            def.replace("id=\"backgroundimage\"", "id=\"backgroundimage" + suffix + "\"");
+        }
+        defs_ << "<g id=\"s" << res << "\">\n" << def << "</g>\n";
+
+        return res;
+    }
+
+private:
+    QTextStream & defs_;
+    QHash<QString, int> ids_;
+};
+
+// Writes a <use> of the given shape, visible only at the given frames, which
+// must be sorted, in an animation of numFrames frames looping every
+// duration seconds
+void writeUse_(QTextStream & out, int shapeId, const QVector<int> & frames,
+               int numFrames, double duration)
+{
+    out << "<use xlink:href=\"#s" << shapeId << "\"";
+    if (frames.size() == numFrames)
+    {
+        out << " />\n";
+        return;
+    }
+
+    // Discrete keyframes of visibility, one at each start and end of a run
+    // of consecutive frames
+    QStringList values("hidden");
+    QStringList keyTimes("0");
+    for (int i = 0; i < frames.size();)
+    {
+        const int begin = frames[i];
+        int end = begin + 1;
+        while (++i < frames.size() && frames[i] == end)
+            ++end;
+
+        if (begin == 0)
+        {
+            values[0] = "visible";
+        }
+        else
+        {
+            values << "visible";
+            keyTimes << QString::number(double(begin) / numFrames, 'g', 10);
+        }
+        if (end < numFrames)
+        {
+            values << "hidden";
+            keyTimes << QString::number(double(end) / numFrames, 'g', 10);
+        }
+    }
+
+    out << " visibility=\"hidden\">\n"
+        << "  <animate attributeName=\"visibility\" calcMode=\"discrete\""
+        << " dur=\"" << duration << "s\" repeatCount=\"indefinite\"\n"
+        << "    values=\"" << values.join(';') << "\"\n"
+        << "    keyTimes=\"" << keyTimes.join(';') << "\" />\n"
+        << "</use>\n";
+}
+
+// Writes the <use> elements of the given track, one per distinct shape,
+// in order of first appearance
+void writeTrack_(QTextStream & out, ShapeTable & shapeTable, const Track & track,
+                 bool isBackground, int numFrames, double duration)
+{
+    QVector<int> ids;
+    QHash<int, QVector<int>> framesById;
+    for (int i = 0; i < track.shapes.size(); ++i)
+    {
+        const QString & shape = track.shapes[i];
+        if (shape.isEmpty())
+            continue;
+
+        const int id = shapeTable.id(shape, isBackground);
+        QVector<int> & frames = framesById[id];
+        if (frames.isEmpty())
+            ids << id;
+        frames << track.firstFrame + i;
+    }
+
+    for (int id: ids)
+        writeUse_(out, id, framesById[id], numFrames, duration);
+}
+
+// Generates the shapes of track.cell at each frame from firstFrame to
+// lastFrame where it exists
+void generateCellTrack_(Track & track, int firstFrame, int lastFrame)
+{
+    Cell * cell = track.cell;
+    int begin = firstFrame;
+    int end = lastFrame;
+    if (KeyCell * keyCell = cell->toKeyCell())
+    {
+        begin = std::max(begin, keyCell->time().frame());
+        end = std::min(end, keyCell->time().frame());
+    }
+    else if (InbetweenCell * inbetweenCell = cell->toInbetweenCell())
+    {
+        begin = std::max(begin, inbetweenCell->beforeTime().frame());
+        end = std::min(end, inbetweenCell->afterTime().frame());
+    }
+
+    track.firstFrame = begin - firstFrame;
+    track.shapes.clear();
+    for (int f = begin; f <= end; ++f)
+    {
+        QString shape;
+        if (cell->exists(Time(f)))
+        {
+            QTextStream out(&shape);
+            cell->exportSVG(Time(f), out);
+        }
+        track.shapes << shape;
+    }
+}
+
+}
+
+SvgWriter::SvgWriter(Scene * scene) :
+    scene_(scene)
+{
+}
+
+void SvgWriter::writeHeader_(QTextStream & out) const
+{
+    out << QString(
+               "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\"?>\n"
+               "<!-- Created with VPaint (http://www.vpaint.org/) -->\n\n"
+
+               "<!DOCTYPE svg PUBLIC \"-//W3C//DTD SVG 1.1//EN\"\n"
+               "  \"http://www.w3.org/Graphics/SVG/1.1/DTD/svg11.dtd\">\n"
+               "<svg \n"
+               "  viewBox=\"%1 %2 %3 %4\"\n"
+               "  xmlns=\"http://www.w3.org/2000/svg\"\n"
+               "  xmlns:xlink=\"http://www.w3.org/1999/xlink\">\n")
+
+           .arg(scene_->left())
+           .arg(scene_->top())
+           .arg(scene_->width())
+           .arg(scene_->height());
+}
+
+void SvgWriter::prepareConcurrentExport_()
+{
+    // Exporting a cell only reads the scene, except for the sampling of key
+    // edges and the resolved file paths of backgrounds, which are computed
+    // lazily on first use. We compute them now, so that cells can then be
+    // exported from several threads.
+    for (int i = 0; i < scene_->numLayers(); ++i)
+    {
+        Layer * layer = scene_->layer(i);
+        layer->background()->resolvedImageFilePath(0);
+
+        const ZOrderedCells & cells = layer->vac()->zOrdering();
+        for (auto it = cells.cbegin(); it != cells.cend(); ++it)
+        {
+            if (KeyEdge * edge = (*it)->toKeyEdge())
+                edge->geometry()->sampling();
+        }
+    }
+}
+
+bool SvgWriter::writeFrame(Time t, const QString & filePath)
+{
+    QByteArray data;
+    QTextStream out(&data, QIODevice::WriteOnly);
+    out.setCodec("UTF-8");
+
+    writeHeader_(out);
+    scene_->exportSVG(t, out);
+    out << FOOTER;
+    out.flush();
+
+    return writeToFile_(data, filePath);
+}
+
+bool SvgWriter::writeSequence(const QVector<Time> & times, const QStringList & filePaths,
+                              const ProgressCallback & progress)
+{
+    Q_ASSERT(times.size() == filePaths.size());
+
+    prepareConcurrentExport_();
+
+    const int n = times.size();
+    const int batchSize = std::max(1, QThread::idealThreadCount()) * FRAMES_PER_THREAD;
+    std::atomic<bool> ok(true);
+    for (int begin = 0; begin < n; begin += batchSize)
+    {
+        const int end = std::min(n, begin + batchSize);
+        QVector<int> indices;
+        for (int i = begin; i < end; ++i)
+            indices << i;
+
+        QtConcurrent::blockingMap(indices, [this, &times, &filePaths, &ok](int i)
+        {
+            if (!writeFrame(times[i], filePaths[i]))
+                ok = false;
+        });
+
+        if (!ok || (progress && !progress(end)))
+            return false;
+    }
+
+    return ok;
+}
+
+bool SvgWriter::writeAnimation(int firstFrame, int lastFrame, int fps, const QString & filePath)
+{
+    if (lastFrame < firstFrame || fps <= 0)
+    {
+        qDebug() << "Error: invalid frame range or frame rate";
+        return false;
+    }
+
+    prepareConcurrentExport_();
+
+    const int numFrames = lastFrame - firstFrame + 1;
+    const double duration = double(numFrames) / fps;
+
+    // Shapes are written to defs as they are discovered, and the <use>
+    // elements referencing them to body, in drawing order
+    QString defs;
+    QString body;
+    QTextStream defsOut(&defs);
+    QTextStream bodyOut(&body);
+    ShapeTable shapeTable(defsOut);
+
+    for (int i = 0; i < scene_->numLayers(); ++i)
+    {
+        Layer * layer = scene_->layer(i);
+
+        // Background
+        Track background;
+        for (int f = firstFrame; f <= lastFrame; ++f)
+        {
+            QString shape;
+            QTextStream out(&shape);
+            layer->background()->exportSVG(f, out, scene_->left(), scene_->top(),
+                                           scene_->width(), scene_->height());
+            background.shapes << shape;
+        }
+        writeTrack_(bodyOut, shapeTable, background, true, numFrames, duration);
+
+        // Cells, in batches
+        const ZOrderedCells & cells = layer->vac()->zOrdering();
+        auto it = cells.cbegin();
+        while (it != cells.cend())
+        {
+            QVector<Track> tracks;
+            for (; it != cells.cend() && tracks.size() < CELLS_PER_BATCH; ++it)
+            {
+                tracks << Track();
+                tracks.last().cell = *it;
+            }
+
+            QtConcurrent::blockingMap(tracks, [firstFrame, lastFrame](Track & track)
+            {
+                generateCellTrack_(track, firstFrame, lastFrame);
+            });
+
+            for (const Track & track: tracks)
+                writeTrack_(bodyOut, shapeTable, track, false, numFrames, duration);
+        }
+    }
+
+    defsOut.flush();
+    bodyOut.flush();
+
+    QByteArray data;
+    QTextStream out(&data, QIODevice::WriteOnly);
+    out.setCodec("UTF-8");
+    writeHeader_(out);
+    out << "<defs>\n" << defs << "</defs>\n" << body << FOOTER;
+    out.flush();
+
+    return writeToFile_(data, filePath);
+}
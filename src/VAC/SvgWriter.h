@@ -0,0 +1,76 @@
+// Copyright (C) 2012-2019 The VPaint Developers.
+// See the COPYRIGHT file at the top-level directory of this distribution
+// and at https://github.com/dalboris/vpaint/blob/master/COPYRIGHT
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SVG_WRITER_H
+#define SVG_WRITER_H
+
+#include "TimeDef.h"
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <functional>
+
+class Scene;
+class QTextStream;
+
+// Writes a scene to SVG files, either:
+//   - one frame to one file
+//   - a sequence of frames, one file per frame
+//   - a range of frames to a single animated SVG file
+//
+// Sequences are written in batches of frames. The frames of a batch are
+// generated concurrently, each into its own memory buffer which is then
+// written to disk in one go by the same worker thread.
+//
+// Animated SVG files store each distinct shape only once, in <defs>, and
+// show it with <use> elements whose visibility is animated with SMIL. A
+// cell which looks the same at several frames, for instance a drawing held
+// over several key frames, is therefore stored once, and the file size
+// grows with the number of changes rather than with the number of frames
+// times the number of cells.
+//
+class SvgWriter
+{
+public:
+    SvgWriter(Scene * scene);
+
+    // Writes the given frame to the given file. Returns false if the file
+    // couldn't be written.
+    bool writeFrame(Time t, const QString & filePath);
+
+    // Writes times[i] to filePaths[i] for all i. The progress callback, if
+    // any, is called from the calling thread after each batch with the
+    // number of frames written so far, and may return false to abort.
+    // Returns false if aborted or if a file couldn't be written.
+    typedef std::function<bool(int numFramesWritten)> ProgressCallback;
+    bool writeSequence(const QVector<Time> & times, const QStringList & filePaths,
+                       const ProgressCallback & progress = ProgressCallback());
+
+    // Writes the frames from firstFrame to lastFrame, both included, to a
+    // single SVG file which plays them in a loop at the given frame rate.
+    // Returns false if the file couldn't be written.
+    bool writeAnimation(int firstFrame, int lastFrame, int fps, const QString & filePath);
+
+private:
+    Scene * scene_;
+
+    void writeHeader_(QTextStream & out) const;
+    void prepareConcurrentExport_();
+};
+
+#endif // SVG_WRITER_H
@@ -708,6 +708,11 @@ void Timeline::paintEvent(QPaintEvent * event)
 }
 
 
+const PlaybackSettings & Timeline::playbackSettings() const
+{
+    return settings_;
+}
+
 int Timeline::firstFrame() const
 {
     return settings_.firstFrame();
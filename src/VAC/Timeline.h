@@ -141,6 +141,7 @@ public:
     void removeView(View * view);
 
     // Get playback settings
+    const PlaybackSettings & playbackSettings() const;
     int firstFrame() const;
     int lastFrame() const;
     int fps() const;
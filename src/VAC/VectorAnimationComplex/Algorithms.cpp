@@ -18,8 +18,10 @@
 #include "Cell.h"
 #include "KeyEdge.h"
 
-#include <QStack>
-#include <QMap>
+#include <QHash>
+#include <QVector>
+
+#include <utility>
 
 namespace VectorAnimationComplex
 {
@@ -97,82 +99,91 @@ CellSet fullstar(const CellSet & cells)
     return res;
 }
 
-// decompose `cells` in a list of connected, mutually disconnected, cells
-QList<KeyEdgeSet> connectedComponents(const KeyEdgeSet & cells)
+namespace
 {
-    // ---- Detect connected components ----
 
-    // Initialize data structure for algorithm
-
-    QMap<KeyEdge *, bool> isMarked;
-    foreach(KeyEdge * edge, cells)
-        isMarked[edge] = false;
-
-    QMap<KeyEdge *, int> component;
-    foreach(KeyEdge * edge, cells)
-        component[edge] = -1;
-
-    int numComponents = 0;
+// Returns the representative of i, halving the path on the way
+int findRoot_(QVector<int> & parent, int i)
+{
+    while(parent[i] != i)
+    {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
 
+void unite_(QVector<int> & parent, QVector<int> & rank, int i, int j)
+{
+    i = findRoot_(parent, i);
+    j = findRoot_(parent, j);
+    if(i == j)
+        return;
+
+    if(rank[i] < rank[j])
+        std::swap(i, j);
+    parent[j] = i;
+    if(rank[i] == rank[j])
+        ++rank[i];
+}
 
-    // Execute algorithm
+}
 
+// decompose `cells` in a list of connected, mutually disconnected, cells
+QList<KeyEdgeSet> connectedComponents(const KeyEdgeSet & cells)
+{
+    // Dense numbering of the edges, in iteration order of the set
+    const int n = cells.size();
+    QVector<KeyEdge *> edges;
+    edges.reserve(n);
     foreach(KeyEdge * edge, cells)
+        edges << edge;
+
+    // Union-find over this numbering. Two edges are incident if they
+    // share a vertex, so it is enough to unite each open edge with the
+    // first edge found incident to each of its end vertices. Closed edges
+    // have no vertices, and therefore are their own component.
+    QVector<int> parent(n);
+    QVector<int> rank(n, 0);
+    for(int i=0; i<n; ++i)
+        parent[i] = i;
+
+    QHash<KeyVertex *, int> firstEdgeAtVertex;
+    firstEdgeAtVertex.reserve(n);
+    for(int i=0; i<n; ++i)
     {
-        // if has already been assigned a connected component, do nothing
-        if(!isMarked[edge])
-        {
-            // create a new connected component
-            numComponents++;
-
-            // create the stack of unvisited but marked edges to visit
-            QStack<KeyEdge *> stack;
-
-            // add the first edge of connected component as marked
-            isMarked[edge] = true;
-            stack.push(edge);
-
-            // While there are edges to visit
-            while(!stack.isEmpty())
-            {
-                // get unvisited edge
-                KeyEdge * edgeToVisit = stack.pop();
+        KeyEdge * edge = edges[i];
+        if(edge->isClosed())
+            continue;
 
-                // Note: edgeToVisit is already marked.
-
-                // visit edge:
-                //  1) assign it a connected component
-                //  2) find other edges to visit
-
-                // Assign connected component
-                component[edgeToVisit] = numComponents-1;
-
-                //  Find other edges to visit
-                foreach(KeyEdge * other, cells)
-                {
-                    if(!isMarked[other]) // note: this exlude other == edgeToVisit
-                    {
-                        if(areIncident(edgeToVisit,other))
-                        {
-                            // mark other, insert it in stack
-                            isMarked[other] = true;
-                            stack.push(other);
-                        }
-                    }
-                }
-            }
+        KeyVertex * vertices[2] = {edge->startVertex(), edge->endVertex()};
+        for(KeyVertex * vertex: vertices)
+        {
+            QHash<KeyVertex *, int>::const_iterator it = firstEdgeAtVertex.constFind(vertex);
+            if(it == firstEdgeAtVertex.constEnd())
+                firstEdgeAtVertex.insert(vertex, i);
+            else
+                unite_(parent, rank, i, it.value());
         }
     }
 
 
     // ---- Convert to output ----
 
+    // Components are numbered in order of their first edge in the input
+    // set, as the former depth-first search did
+    QVector<int> component(n, -1);
     QList<KeyEdgeSet> res;
-    for(int i=0; i<numComponents; ++i)
-        res << KeyEdgeSet();
-
-    foreach(KeyEdge * edge, cells)
-        res[component[edge]] << edge;
+    for(int i=0; i<n; ++i)
+    {
+        int root = findRoot_(parent, i);
+        if(component[root] == -1)
+        {
+            component[root] = res.size();
+            res << KeyEdgeSet();
+        }
+        res[component[root]] << edges[i];
+    }
 
     return res;
 }
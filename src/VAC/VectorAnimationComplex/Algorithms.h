@@ -30,7 +30,8 @@ CellSet connected(const CellSet & cells);
 
 // decompose the set of edges in a list of connected components
 // here, "connected" is in the sense that two edges are said "connected" if
-// they share a common vertex.
+// they share a common vertex. Components are listed in order of their first
+// edge in the iteration order of `edges`. Runs in near-linear time.
 QList<KeyEdgeSet> connectedComponents(const KeyEdgeSet & edges);
 
 // returns the closure of a cell
@@ -21,6 +21,7 @@
 #include "../Picking.h"
 #include "../DevSettings.h"
 #include "../Global.h"
+#include "../Profiler.h"
 
 #include "Cell.h"
 
@@ -46,6 +47,30 @@
 
 #include "../CssColor.h"
 
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+// Level of detail k is drawn within LOD_ERROR * 2^k, in scene units, which
+// is within LOD_ERROR pixels for zooms up to 2^-k. Level 0 is the exact
+// geometry, negative levels are finer, and positive levels are coarser.
+const double LOD_ERROR = 0.5;
+const int MIN_LOD_LEVEL = -3;
+const int MAX_LOD_LEVEL = 8;
+
+int levelOfDetail_(double zoom)
+{
+    if(!(zoom > 0))
+        return MAX_LOD_LEVEL;
+
+    const int level = static_cast<int>(std::floor(-std::log2(zoom)));
+    return std::max(MIN_LOD_LEVEL, std::min(MAX_LOD_LEVEL, level));
+}
+
+}
+
 namespace VectorAnimationComplex
 {
 
@@ -378,9 +403,9 @@ void Cell::draw(Time time, ViewSettings & viewSettings)
     drawRaw(time, viewSettings);
 }
 
-void Cell::drawRaw(Time time, ViewSettings & /*viewSettings*/)
+void Cell::drawRaw(Time time, ViewSettings & viewSettings)
 {
-    triangles(time).draw();
+    triangles(time, viewSettings.zoom()).draw();
 }
 
 void Cell::drawPick(Time time, ViewSettings & viewSettings)
@@ -398,7 +423,11 @@ void Cell::drawPick(Time time, ViewSettings & viewSettings)
 
 void Cell::drawPickCustom(Time time, ViewSettings & viewSettings)
 {
-    drawRaw(time, viewSettings);
+    // Pick the exact geometry, not the level of detail drawn by drawRaw()
+    if(hasLevelsOfDetail_())
+        triangles(time).draw();
+    else
+        drawRaw(time, viewSettings);
 }
 
 
@@ -799,12 +828,48 @@ const Triangles & Cell::triangles(Time t) const
 
     // Compute triangles if not yet cached
     if(!triangles_.contains(key))
+    {
+        ProfilerScope profilerScope("Cell::triangulate_");
+        Profiler::addCount("Cell::triangles cache misses");
         triangulate_(t, triangles_[key]);
+    }
 
     // Return cached triangles
     return triangles_[key];
 }
 
+const Triangles & Cell::triangles(Time t, double zoom) const
+{
+    // Use exact triangles at 100% zoom, or if there's no level of detail
+    int level = levelOfDetail_(zoom);
+    if(level == 0 || !hasLevelsOfDetail_())
+        return triangles(t);
+
+    // Get cache key
+    QPair<int,int> key = qMakePair(static_cast<int>(std::floor(t.floatTime() * 60 + 0.5)), level);
+
+    // Compute triangles if not yet cached
+    if(!lodTriangles_.contains(key))
+    {
+        ProfilerScope profilerScope("Cell::triangulateApproximation_");
+        Profiler::addCount("Cell::triangles cache misses");
+        triangulateApproximation_(t, LOD_ERROR * std::ldexp(1.0, level), lodTriangles_[key]);
+    }
+
+    // Return cached triangles
+    return lodTriangles_[key];
+}
+
+bool Cell::hasLevelsOfDetail_() const
+{
+    return false;
+}
+
+void Cell::triangulateApproximation_(Time t, double /*error*/, Triangles & out) const
+{
+    out = triangles(t);
+}
+
 const BoundingBox & Cell::boundingBox(Time t) const
 {
     // Get cache key
@@ -831,6 +896,23 @@ const BoundingBox & Cell::outlineBoundingBox(Time t) const
     return outlineBoundingBoxes_[key];
 }
 
+BoundingBox Cell::drawnBoundingBox(Time t, const ViewSettings & viewSettings)
+{
+    switch(viewSettings.displayMode())
+    {
+    case ViewSettings::ILLUSTRATION:
+        return boundingBox(t);
+    case ViewSettings::OUTLINE:
+        if(toFaceCell() && !viewSettings.drawTopologyFaces())
+            return BoundingBox();
+        else
+            return outlineBoundingBox(t);
+    case ViewSettings::ILLUSTRATION_OUTLINE:
+    default:
+        return boundingBox(t).united(outlineBoundingBox(t));
+    }
+}
+
 bool Cell::intersects(Time t, const BoundingBox & bb) const
 {
     return triangles(t).intersects(bb);
@@ -841,11 +923,13 @@ void Cell::processGeometryChanged_()
     CellSet toClearCells = geometryDependentCells_();
     foreach(Cell * cell, toClearCells)
         cell->clearCachedGeometry_();
+    vac()->setDrawingChanged_(toClearCells);
 }
 
 void Cell::clearCachedGeometry_()
 {
     triangles_.clear();
+    lodTriangles_.clear();
     boundingBoxes_.clear();
     outlineBoundingBoxes_.clear();
 }
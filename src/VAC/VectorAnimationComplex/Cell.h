@@ -107,6 +107,8 @@
 #include <QString>
 #include <QRect>
 #include <QColor>
+#include <QMap>
+#include <QPair>
 class QTextStream;
 class XmlStreamWriter;
 class XmlStreamReader;
@@ -384,10 +386,22 @@ public:
     // Get all the triangles to be rendered at given time
     const Triangles & triangles(Time t) const;
 
+    // Same as above, but at a level of detail suitable for the given zoom:
+    // coarser when zoomed out, and finer when zoomed in, within about half a
+    // pixel of the exact geometry. This is what drawRaw() uses. Picking,
+    // selection, and any other geometric query use the exact triangles.
+    const Triangles & triangles(Time t, double zoom) const;
+
     // Get the bounding box of this cell at time t
     const BoundingBox & boundingBox(Time t) const;
     const BoundingBox & outlineBoundingBox(Time t) const;
 
+    // Get the bounding box of what VAC::drawCells() draws for this cell at
+    // time t, given the display mode of the view settings. Outlines are
+    // not accounted for: they are drawn up to half the outline width
+    // outside of it.
+    BoundingBox drawnBoundingBox(Time t, const ViewSettings & viewSettings);
+
     // Get the bounding box of this cell for all time t
     virtual BoundingBox boundingBox() const=0;
     virtual BoundingBox outlineBoundingBox() const=0;
@@ -407,12 +421,19 @@ protected:
 private:
     // Cached triangulations and bounding boxes (the integer represent a 1/60th of frame)
     mutable QMap<int,Triangles> triangles_;
+    mutable QMap<QPair<int,int>,Triangles> lodTriangles_; // (time, level of detail)
     mutable QMap<int,BoundingBox> boundingBoxes_;
     mutable QMap<int,BoundingBox> outlineBoundingBoxes_;
 
     // Compute triangulation for time t (must be implemented by derived classes)
     virtual void triangulate_(Time t, Triangles & out) const=0;
 
+    // Compute triangulation for time t within the given error, in scene
+    // units. Derived classes implementing it must reimplement
+    // hasLevelsOfDetail_() to return true.
+    virtual bool hasLevelsOfDetail_() const;
+    virtual void triangulateApproximation_(Time t, double error, Triangles & out) const;
+
     // Compute outline bounding box for time t (must be implemented by derived classes)
     virtual void computeOutlineBoundingBox_(Time t, BoundingBox & out) const=0;
 
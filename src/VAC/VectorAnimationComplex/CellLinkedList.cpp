@@ -100,9 +100,12 @@ void CellLinkedList::splice( CellLinkedList::Iterator pos, CellLinkedList & othe
 
 CellLinkedList::Iterator CellLinkedList::extractTo(CellLinkedList::Iterator pos, CellLinkedList & other)
 {
-    Cell * c = *pos;
-    other.append(c);
-    return erase(pos);
+    // Splice rather than erase/append, so that the node (and therefore any
+    // iterator pointing to it) remains valid
+    Iterator next = pos;
+    ++next;
+    other.list_.splice(other.list_.end(), list_, pos);
+    return next;
 }
 
 // Reverse methods
@@ -127,9 +130,12 @@ void CellLinkedList::splice(CellLinkedList::ReverseIterator pos, CellLinkedList
 
 CellLinkedList::ReverseIterator CellLinkedList::extractTo(CellLinkedList::ReverseIterator pos, CellLinkedList & other)
 {
-    Cell * c = *pos;
-    other.prepend(c);
-    return erase(pos);
+    // Once *pos is moved out, pos.base() is unchanged and pos now points
+    // to the element that was just before *pos
+    Iterator it = pos.base();
+    --it;
+    other.list_.splice(other.list_.begin(), list_, it);
+    return pos;
 }
 
 }
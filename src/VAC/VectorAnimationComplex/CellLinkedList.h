@@ -49,7 +49,8 @@ public:
     Iterator insert(Iterator pos, Cell * cell);
     Iterator erase(Iterator pos);
     void splice(Iterator pos, CellLinkedList & other );
-    Iterator extractTo(Iterator pos, CellLinkedList & other); // append *pos to other, then return erase(pos)
+    Iterator extractTo(Iterator pos, CellLinkedList & other); // move *pos at the end of other, then return the iterator following pos.
+                                                              // iterators to *pos remain valid, and now refer to an element of other
 
     // Same in reverse
     ReverseIterator insert(ReverseIterator pos, Cell * cell);
@@ -59,7 +60,8 @@ public:
                                                                //       element of other. This is a difference of semantics with
                                                                //       splice(Iterator pos), which does not affect which element
                                                                //       pos points to
-    ReverseIterator extractTo(ReverseIterator pos, CellLinkedList & other); // prepend *pos to other, then return erase(pos)
+    ReverseIterator extractTo(ReverseIterator pos, CellLinkedList & other); // move *pos at the beginning of other, then return the
+                                                                            // reverse iterator following pos. Same validity as above
 
 private:
     std::list<Cell*> list_;
@@ -0,0 +1,142 @@
+// Copyright (C) 2012-2019 The VPaint Developers.
+// See the COPYRIGHT file at the top-level directory of this distribution
+// and at https://github.com/dalboris/vpaint/blob/master/COPYRIGHT
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CellPool.h"
+
+#include "Eigen.h"
+
+#include <QMutexLocker>
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace VectorAnimationComplex
+{
+
+namespace
+{
+
+const std::size_t CACHE_LINE_SIZE = 64;
+
+// A free block stores a pointer to the next free block
+void * & next(void * block)
+{
+    return *static_cast<void**>(block);
+}
+
+// Allocates a chunk aligned on a cache line. Eigen's aligned_malloc only
+// guarantees 16 bytes, so we over-allocate and store the original pointer
+// just before the returned address.
+char * allocateChunk(std::size_t size)
+{
+    void * original = std::malloc(size + CACHE_LINE_SIZE + sizeof(void*));
+    if(!original)
+        throw std::bad_alloc();
+    std::uintptr_t address = reinterpret_cast<std::uintptr_t>(original) + sizeof(void*);
+    address = (address + CACHE_LINE_SIZE - 1) & ~(std::uintptr_t(CACHE_LINE_SIZE) - 1);
+    void * res = reinterpret_cast<void*>(address);
+    static_cast<void**>(res)[-1] = original;
+    return static_cast<char*>(res);
+}
+
+void freeChunk(char * chunk)
+{
+    if(chunk)
+        std::free(reinterpret_cast<void**>(chunk)[-1]);
+}
+
+}
+
+CellPool::CellPool(std::size_t objectSize, int blocksPerChunk) :
+    objectSize_(objectSize),
+    blockSize_((objectSize + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE),
+    blocksPerChunk_(blocksPerChunk),
+    freeList_(0),
+    numAllocated_(0)
+{
+}
+
+CellPool::~CellPool()
+{
+    for(char * chunk: chunks_)
+        freeChunk(chunk);
+}
+
+void * CellPool::allocate(std::size_t size)
+{
+    if(size != objectSize_)
+        return Eigen::internal::aligned_malloc(size);
+
+    QMutexLocker locker(&mutex_);
+    if(!freeList_)
+        addChunk_();
+    void * res = freeList_;
+    freeList_ = next(res);
+    ++numAllocated_;
+    return res;
+}
+
+void CellPool::deallocate(void * p, std::size_t size)
+{
+    if(!p)
+        return;
+
+    if(size != objectSize_)
+    {
+        Eigen::internal::aligned_free(p);
+        return;
+    }
+
+    QMutexLocker locker(&mutex_);
+    next(p) = freeList_;
+    freeList_ = p;
+    --numAllocated_;
+    if(numAllocated_ == 0 && chunks_.size() > 1)
+        releaseChunks_();
+}
+
+void CellPool::addChunk_()
+{
+    char * chunk = allocateChunk(blockSize_ * blocksPerChunk_);
+    chunks_.push_back(chunk);
+    addBlocks_(chunk);
+}
+
+void CellPool::addBlocks_(char * chunk)
+{
+    // Add blocks to the free list, such that they are allocated in order
+    for(int i=blocksPerChunk_-1; i>=0; --i)
+    {
+        void * block = chunk + i * blockSize_;
+        next(block) = freeList_;
+        freeList_ = block;
+    }
+}
+
+void CellPool::releaseChunks_()
+{
+    // Keep one chunk, to avoid releasing and reallocating a chunk
+    // when repeatedly allocating and deallocating a single cell
+    for(size_t i=1; i<chunks_.size(); ++i)
+        freeChunk(chunks_[i]);
+    chunks_.resize(1);
+
+    freeList_ = 0;
+    addBlocks_(chunks_[0]);
+}
+
+}
@@ -0,0 +1,93 @@
+// Copyright (C) 2012-2019 The VPaint Developers.
+// See the COPYRIGHT file at the top-level directory of this distribution
+// and at https://github.com/dalboris/vpaint/blob/master/COPYRIGHT
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef VAC_CELL_POOL_H
+#define VAC_CELL_POOL_H
+
+// CellPool: a pool allocator for the cells of a given concrete type
+//
+// Cells are large (because of the virtual bases of the Cell diamond), and
+// are created and deleted one by one, very often (e.g., cloning the VAC for
+// undo/redo). Allocating them from a pool per type makes this O(1) without
+// going through malloc, and keeps cells of the same type close in memory,
+// which makes loops over e.g. all key edges more cache-friendly.
+//
+// Blocks are allocated by chunks, and recycled via a free list. When all
+// blocks are deallocated, all chunks but one are released. Chunks are
+// aligned on 64-byte cache lines and block sizes are rounded up to a
+// multiple of 64 bytes, so every block starts on a cache line. This also
+// satisfies Eigen alignment requirements (i.e., it can replace
+// EIGEN_MAKE_ALIGNED_OPERATOR_NEW).
+//
+// Usage, for a class Foo:
+//
+//     // Foo.h
+//     static void * operator new(std::size_t size);
+//     static void operator delete(void * p, std::size_t size);
+//
+//     // Foo.cpp
+//     namespace
+//     {
+//     CellPool & pool()
+//     {
+//         static CellPool * res = new CellPool(sizeof(Foo));
+//         return *res;
+//     }
+//     }
+//
+//     void * Foo::operator new(std::size_t size) { return pool().allocate(size); }
+//     void Foo::operator delete(void * p, std::size_t size) { pool().deallocate(p, size); }
+//
+// Allocations of a different size (e.g., a subclass of Foo) are forwarded
+// to Eigen's aligned malloc. All functions are thread-safe.
+
+#include <QMutex>
+#include <cstddef>
+#include <vector>
+
+namespace VectorAnimationComplex
+{
+
+class CellPool
+{
+public:
+    explicit CellPool(std::size_t objectSize, int blocksPerChunk = 64);
+    ~CellPool();
+
+    void * allocate(std::size_t size);
+    void deallocate(void * p, std::size_t size);
+
+private:
+    std::size_t objectSize_;
+    std::size_t blockSize_;
+    int blocksPerChunk_;
+
+    QMutex mutex_;
+    std::vector<char*> chunks_;
+    void * freeList_;
+    int numAllocated_;
+
+    void addChunk_();
+    void addBlocks_(char * chunk);
+    void releaseChunks_();
+
+    CellPool(const CellPool &);
+    CellPool & operator=(const CellPool &);
+};
+
+}
+
+#endif // VAC_CELL_POOL_H
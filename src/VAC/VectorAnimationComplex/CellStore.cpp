@@ -0,0 +1,275 @@
+// Copyright (C) 2012-2019 The VPaint Developers.
+// See the COPYRIGHT file at the top-level directory of this distribution
+// and at https://github.com/dalboris/vpaint/blob/master/COPYRIGHT
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CellStore.h"
+
+#include "Cell.h"
+#include "KeyVertex.h"
+#include "KeyEdge.h"
+#include "KeyFace.h"
+#include "InbetweenVertex.h"
+#include "InbetweenEdge.h"
+#include "InbetweenFace.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace VectorAnimationComplex
+{
+
+namespace
+{
+
+// Dense arrays are not compacted below this number of holes
+const int MIN_HOLES_TO_COMPACT = 32;
+
+// Generations are unique across all stores, so that a handle can't
+// accidentally resolve to a cell of another VAC with the same ID
+std::atomic<quint32> nextGeneration(1);
+
+template <class T>
+bool idLess(T * c1, T * c2)
+{
+    return c1->id() < c2->id();
+}
+
+}
+
+CellStore::CellStore() :
+    slots_(),
+    size_(0),
+    revision_(0)
+{
+}
+
+void CellStore::insert(Cell * cell)
+{
+    int id = cell->id();
+    if(id >= (int)slots_.size())
+        slots_.resize(id+1);
+    else if(slots_[id].cell)
+        remove(slots_[id].cell); // e.g., duplicate IDs in a corrupted file
+
+    Slot & slot = slots_[id];
+    slot.cell = cell;
+    slot.generation = nextGeneration++;
+    ++size_;
+    ++revision_;
+
+    append_(all_, cell, &Slot::index);
+
+    if(KeyVertex * c = cell->toKeyVertex())
+    {
+        slot.type = KeyVertexType;
+        append_(keyVertices_, c, &Slot::typeIndex);
+    }
+    else if(KeyEdge * c = cell->toKeyEdge())
+    {
+        slot.type = KeyEdgeType;
+        append_(keyEdges_, c, &Slot::typeIndex);
+    }
+    else if(KeyFace * c = cell->toKeyFace())
+    {
+        slot.type = KeyFaceType;
+        append_(keyFaces_, c, &Slot::typeIndex);
+    }
+    else if(InbetweenVertex * c = cell->toInbetweenVertex())
+    {
+        slot.type = InbetweenVertexType;
+        append_(inbetweenVertices_, c, &Slot::typeIndex);
+    }
+    else if(InbetweenEdge * c = cell->toInbetweenEdge())
+    {
+        slot.type = InbetweenEdgeType;
+        append_(inbetweenEdges_, c, &Slot::typeIndex);
+    }
+    else if(InbetweenFace * c = cell->toInbetweenFace())
+    {
+        slot.type = InbetweenFaceType;
+        append_(inbetweenFaces_, c, &Slot::typeIndex);
+    }
+}
+
+void CellStore::remove(Cell * cell)
+{
+    int id = cell->id();
+    if(cell != this->cell(id))
+        return;
+
+    erase_(all_, id, &Slot::index);
+    switch(slots_[id].type)
+    {
+    case KeyVertexType:       erase_(keyVertices_, id, &Slot::typeIndex); break;
+    case KeyEdgeType:         erase_(keyEdges_, id, &Slot::typeIndex); break;
+    case KeyFaceType:         erase_(keyFaces_, id, &Slot::typeIndex); break;
+    case InbetweenVertexType: erase_(inbetweenVertices_, id, &Slot::typeIndex); break;
+    case InbetweenEdgeType:   erase_(inbetweenEdges_, id, &Slot::typeIndex); break;
+    case InbetweenFaceType:   erase_(inbetweenFaces_, id, &Slot::typeIndex); break;
+    }
+
+    slots_[id] = Slot();
+    --size_;
+    ++revision_;
+}
+
+void CellStore::clear()
+{
+    slots_.clear();
+    size_ = 0;
+    ++revision_;
+    all_ = Dense<Cell>();
+    keyVertices_ = Dense<KeyVertex>();
+    keyEdges_ = Dense<KeyEdge>();
+    keyFaces_ = Dense<KeyFace>();
+    inbetweenVertices_ = Dense<InbetweenVertex>();
+    inbetweenEdges_ = Dense<InbetweenEdge>();
+    inbetweenFaces_ = Dense<InbetweenFace>();
+}
+
+void CellStore::reserve(int maxId)
+{
+    if(maxId >= (int)slots_.size())
+    {
+        all_.cells.reserve(all_.cells.size() + maxId + 1 - slots_.size());
+        slots_.reserve(maxId + 1);
+    }
+}
+
+Cell * CellStore::cell(int id) const
+{
+    if(id >= 0 && id < (int)slots_.size())
+        return slots_[id].cell;
+    else
+        return 0;
+}
+
+CellHandle CellStore::handle(Cell * cell) const
+{
+    if(cell && cell == this->cell(cell->id()))
+        return CellHandle(cell->id(), slots_[cell->id()].generation);
+    else
+        return CellHandle();
+}
+
+Cell * CellStore::cell(const CellHandle & handle) const
+{
+    Cell * res = cell(handle.id_);
+    if(res && slots_[handle.id_].generation == handle.generation_)
+        return res;
+    else
+        return 0;
+}
+
+void CellStore::copyGenerations(const CellStore & other)
+{
+    for(Cell * c: *this)
+    {
+        int id = c->id();
+        if(other.cell(id))
+            slots_[id].generation = other.slots_[id].generation;
+    }
+}
+
+CellStore::ConstIterator CellStore::begin() const
+{
+    return range_(all_, &Slot::index).begin();
+}
+
+CellStore::ConstIterator CellStore::end() const
+{
+    return range_(all_, &Slot::index).end();
+}
+
+CellStore::Range<KeyVertex> CellStore::keyVertices() const
+{
+    return range_(keyVertices_, &Slot::typeIndex);
+}
+
+CellStore::Range<KeyEdge> CellStore::keyEdges() const
+{
+    return range_(keyEdges_, &Slot::typeIndex);
+}
+
+CellStore::Range<KeyFace> CellStore::keyFaces() const
+{
+    return range_(keyFaces_, &Slot::typeIndex);
+}
+
+CellStore::Range<InbetweenVertex> CellStore::inbetweenVertices() const
+{
+    return range_(inbetweenVertices_, &Slot::typeIndex);
+}
+
+CellStore::Range<InbetweenEdge> CellStore::inbetweenEdges() const
+{
+    return range_(inbetweenEdges_, &Slot::typeIndex);
+}
+
+CellStore::Range<InbetweenFace> CellStore::inbetweenFaces() const
+{
+    return range_(inbetweenFaces_, &Slot::typeIndex);
+}
+
+template <class T>
+void CellStore::append_(Dense<T> & dense, T * cell, int Slot::* index)
+{
+    int id = cell->id();
+    slots_[id].*index = dense.cells.size();
+    dense.cells.push_back(cell);
+    if(id < dense.maxId)
+        dense.isSorted = false;
+    else
+        dense.maxId = id;
+}
+
+template <class T>
+void CellStore::erase_(Dense<T> & dense, int id, int Slot::* index)
+{
+    dense.cells[slots_[id].*index] = 0;
+    slots_[id].*index = -1;
+    ++dense.numHoles;
+    if(dense.numHoles >= MIN_HOLES_TO_COMPACT &&
+       2 * dense.numHoles >= (int)dense.cells.size())
+    {
+        compact_(dense, index);
+    }
+}
+
+template <class T>
+void CellStore::compact_(Dense<T> & dense, int Slot::* index) const
+{
+    std::vector<T*> & cells = dense.cells;
+    cells.erase(std::remove(cells.begin(), cells.end(), static_cast<T*>(0)), cells.end());
+    if(!dense.isSorted)
+        std::sort(cells.begin(), cells.end(), idLess<T>);
+
+    for(int i=0; i<(int)cells.size(); ++i)
+        slots_[cells[i]->id()].*index = i;
+
+    dense.numHoles = 0;
+    dense.maxId = cells.empty() ? -1 : cells.back()->id();
+    dense.isSorted = true;
+}
+
+template <class T>
+CellStore::Range<T> CellStore::range_(Dense<T> & dense, int Slot::* index) const
+{
+    if(!dense.isSorted)
+        compact_(dense, index);
+    return Range<T>(dense.cells);
+}
+
+}
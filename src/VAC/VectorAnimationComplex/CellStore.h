@@ -0,0 +1,204 @@
+// Copyright (C) 2012-2019 The VPaint Developers.
+// See the COPYRIGHT file at the top-level directory of this distribution
+// and at https://github.com/dalboris/vpaint/blob/master/COPYRIGHT
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef VAC_CELL_STORE_H
+#define VAC_CELL_STORE_H
+
+// CellStore: the cells of a VAC, indexed by ID
+//
+// Cells are stored in a slot map, i.e. a vector indexed by cell ID, which
+// makes getting a cell from its ID O(1). In addition, the cells are stored in
+// dense arrays (one for all cells, and one per concrete type), so that
+// iterating over all cells or all key edges is a linear scan of pointers,
+// instead of walking a tree and dynamic_casting every cell.
+//
+// Iteration is by increasing ID, like the QMap<int, Cell*> it replaces.
+// Removing a cell leaves a hole in the dense arrays, skipped by iterators,
+// and holes are compacted once they make up half of an array.
+//
+// Each slot also has a generation number, so that a CellHandle resolves to
+// null once its cell is removed, even if the ID is later reused by another
+// cell (e.g., after the VAC is cleared). Generations are unique across all
+// stores, and are preserved by copyGenerations(), used by VAC::clone(), so
+// that a handle to a cell also resolves to the clone of this cell.
+//
+// A CellStore doesn't own its cells.
+
+#include <QtGlobal>
+#include <vector>
+#include "ForwardDeclaration.h"
+
+namespace VectorAnimationComplex
+{
+
+class CellHandle
+{
+public:
+    CellHandle() : id_(-1), generation_(0) {}
+
+    int id() const { return id_; }
+    bool isNull() const { return id_ < 0; }
+
+    bool operator==(const CellHandle & other) const { return id_ == other.id_ && generation_ == other.generation_; }
+    bool operator!=(const CellHandle & other) const { return !(*this == other); }
+
+private:
+    friend class CellStore;
+    CellHandle(int id, quint32 generation) : id_(id), generation_(generation) {}
+
+    int id_;
+    quint32 generation_;
+};
+
+class CellStore
+{
+public:
+    CellStore();
+
+    // Insert cell at cell->id(), which must be non-negative. If another cell
+    // has the same ID, it is removed from the store.
+    void insert(Cell * cell);
+
+    // Remove cell from the store (no-op if it's not in the store)
+    void remove(Cell * cell);
+
+    // Remove all cells
+    void clear();
+
+    // Reserve memory for cells with IDs up to maxId, to avoid reallocations
+    // when inserting many cells
+    void reserve(int maxId);
+
+    // Number of cells
+    int size() const { return size_; }
+    bool isEmpty() const { return size_ == 0; }
+
+    // Incremented each time a cell is inserted or removed, so that indices
+    // built from this store can tell whether they are out of date
+    quint64 revision() const { return revision_; }
+
+    // Get cell from ID. Returns null if there is no cell with this ID.
+    Cell * cell(int id) const;
+    bool contains(int id) const { return cell(id) != 0; }
+
+    // Get a handle to the given cell, and the cell from a handle. The latter
+    // returns null if the cell has been removed since the handle was created.
+    CellHandle handle(Cell * cell) const;
+    Cell * cell(const CellHandle & handle) const;
+
+    // Set the generation of the cells of this store to the generation of the
+    // cells with the same ID in other
+    void copyGenerations(const CellStore & other);
+
+    // Iteration over non-null pointers of a dense array
+    template <class T>
+    class Range
+    {
+    public:
+        class ConstIterator
+        {
+        public:
+            ConstIterator(T * const * p, T * const * end) : p_(p), end_(end) { skipHoles_(); }
+            T * operator*() const { return *p_; }
+            ConstIterator & operator++() { ++p_; skipHoles_(); return *this; }
+            bool operator==(const ConstIterator & other) const { return p_ == other.p_; }
+            bool operator!=(const ConstIterator & other) const { return p_ != other.p_; }
+
+        private:
+            void skipHoles_() { while(p_ != end_ && !*p_) ++p_; }
+            T * const * p_;
+            T * const * end_;
+        };
+
+        Range(const std::vector<T*> & cells) : begin_(cells.data()), end_(cells.data() + cells.size()) {}
+        ConstIterator begin() const { return ConstIterator(begin_, end_); }
+        ConstIterator end() const { return ConstIterator(end_, end_); }
+
+    private:
+        T * const * begin_;
+        T * const * end_;
+    };
+
+    // All cells, by increasing ID
+    typedef Range<Cell>::ConstIterator ConstIterator;
+    ConstIterator begin() const;
+    ConstIterator end() const;
+
+    // Cells of a given type, by increasing ID. Ranges are invalidated by
+    // inserting or removing cells.
+    Range<KeyVertex> keyVertices() const;
+    Range<KeyEdge> keyEdges() const;
+    Range<KeyFace> keyFaces() const;
+    Range<InbetweenVertex> inbetweenVertices() const;
+    Range<InbetweenEdge> inbetweenEdges() const;
+    Range<InbetweenFace> inbetweenFaces() const;
+
+private:
+    // Dense array, where removed cells leave holes (null pointers)
+    template <class T>
+    struct Dense
+    {
+        Dense() : numHoles(0), maxId(-1), isSorted(true) {}
+        std::vector<T*> cells;
+        int numHoles;
+        int maxId;
+        bool isSorted; // false if cells were not inserted by increasing ID
+    };
+
+    enum Type
+    {
+        KeyVertexType,
+        KeyEdgeType,
+        KeyFaceType,
+        InbetweenVertexType,
+        InbetweenEdgeType,
+        InbetweenFaceType
+    };
+
+    struct Slot
+    {
+        Slot() : cell(0), generation(0), index(-1), typeIndex(-1), type(0) {}
+        Cell * cell;
+        quint32 generation;
+        int index;     // index in all_
+        int typeIndex; // index in the dense array of its type
+        qint8 type;
+    };
+
+    // Mutable since indices of slots are updated when compacting dense arrays
+    mutable std::vector<Slot> slots_;
+    int size_;
+    quint64 revision_;
+
+    // Dense arrays. They are mutable since they are lazily sorted when
+    // cells were not inserted by increasing ID, e.g. when loading a file.
+    mutable Dense<Cell> all_;
+    mutable Dense<KeyVertex> keyVertices_;
+    mutable Dense<KeyEdge> keyEdges_;
+    mutable Dense<KeyFace> keyFaces_;
+    mutable Dense<InbetweenVertex> inbetweenVertices_;
+    mutable Dense<InbetweenEdge> inbetweenEdges_;
+    mutable Dense<InbetweenFace> inbetweenFaces_;
+
+    template <class T> void append_(Dense<T> & dense, T * cell, int Slot::* index);
+    template <class T> void erase_(Dense<T> & dense, int id, int Slot::* index);
+    template <class T> void compact_(Dense<T> & dense, int Slot::* index) const;
+    template <class T> Range<T> range_(Dense<T> & dense, int Slot::* index) const;
+};
+
+}
+
+#endif // VAC_CELL_STORE_H
@@ -144,6 +144,11 @@ void EdgeCell::computeOutlineBoundingBox_(Time t, BoundingBox & out) const
     }
 }
 
+bool EdgeCell::hasLevelsOfDetail_() const
+{
+    return true;
+}
+
 const Triangles & EdgeCell::triangles(double width, Time time) const
 {
     // Get cache key
@@ -188,6 +193,39 @@ EdgeSample EdgeCell::endSample(Time time) const
         return sampling.last();
 }
 
+namespace
+{
+// Unit vector from a to b, or (1,0) if a and b are (almost) equal. Same
+// convention as LinearSpline::der()
+Eigen::Vector2d unitTangent_(const EdgeSample & a, const EdgeSample & b)
+{
+    Eigen::Vector2d d(b.x()-a.x(), b.y()-a.y());
+    double norm = d.norm();
+    if(norm < 1e-10)
+        return Eigen::Vector2d(1,0);
+    return d/norm;
+}
+}
+
+Eigen::Vector2d EdgeCell::startTangent(Time time) const
+{
+    QList<EdgeSample> sampling = getSampling(time);
+    if(sampling.size() < 2)
+        return Eigen::Vector2d(1,0);
+    else
+        return unitTangent_(sampling[0], sampling[1]);
+}
+
+Eigen::Vector2d EdgeCell::endTangent(Time time) const
+{
+    QList<EdgeSample> sampling = getSampling(time);
+    int n = sampling.size();
+    if(n < 2)
+        return Eigen::Vector2d(1,0);
+    else
+        return unitTangent_(sampling[n-2], sampling[n-1]);
+}
+
 void EdgeCell::exportSVG(Time t, QTextStream & out)
 {
     QList<EdgeSample> samples = getSampling(t);
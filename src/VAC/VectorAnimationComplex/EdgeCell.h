@@ -52,6 +52,13 @@ public:
     virtual EdgeSample startSample(Time time) const;
     virtual EdgeSample endSample(Time time) const;
 
+    // Unit tangents at the start and end of the edge, both oriented from the
+    // start to the end. The default implementations of these and of
+    // startSample()/endSample() compute the whole sampling: subclasses
+    // should reimplement them to only evaluate the ends of the geometry.
+    virtual Eigen::Vector2d startTangent(Time time) const;
+    virtual Eigen::Vector2d endTangent(Time time) const;
+
     // Export SVG
     virtual void exportSVG(Time t, QTextStream & out);
 
@@ -69,6 +76,9 @@ private:
 
     virtual bool isPickableCustom(Time time) const;
 
+    // Levels of detail are implemented by both KeyEdge and InbetweenEdge
+    virtual bool hasLevelsOfDetail_() const;
+
     // Implementation of outline bounding box for both KeyVertex and InbetweenVertex
     void computeOutlineBoundingBox_(Time t, BoundingBox & out) const;
 
@@ -71,9 +71,13 @@ EdgeGeometry * EdgeGeometry::clone()
  }
 
  EdgeGeometry * EdgeGeometry::read(XmlStreamReader & xml)
+ {
+     return read(xml.attributes().value("curve"));
+ }
+
+ EdgeGeometry * EdgeGeometry::read(const QStringRef & str)
  {
      // Find curve type and data
-     QStringRef str =  xml.attributes().value("curve");
      int i = str.indexOf('(');
      QStringRef curveType = str.left(i);
      QStringRef curveData = str.mid(i+1, str.length()-i-2);
@@ -81,6 +85,8 @@ EdgeGeometry * EdgeGeometry::clone()
      // Switch on type
      if(curveType == "xywdense")
          return new LinearSpline(curveData);
+     else if(curveType == "xywadaptive")
+         return new LinearSpline(curveData, true);
      else
          return 0;
  }
@@ -119,6 +125,11 @@ void EdgeGeometry::triangulate(Triangles & /*triangles*/)
     // TODO
 }
 
+void EdgeGeometry::triangulateApproximation(double /*error*/, Triangles & triangles)
+{
+    triangulate(triangles);
+}
+
 void EdgeGeometry::draw(double width)
 {
     // assumes sampling is up to date
@@ -276,6 +287,15 @@ void EdgeGeometry::setWidth(double /* newWidth */)
 {
 }
 
+double EdgeGeometry::samplingTolerance() const
+{
+    return 0;
+}
+
+void EdgeGeometry::setSamplingTolerance(double /*tolerance*/)
+{
+}
+
 double EdgeGeometry::updateSculpt(double /*x*/, double /*y*/, double /*radius*/)
 {
     return std::numeric_limits<double>::max();
@@ -368,50 +388,81 @@ void EdgeGeometry::write(XmlStreamWriter & /*xml*/) const
 
 LinearSpline::LinearSpline(double ds) :
     EdgeGeometry(ds),
-    curve_(ds)
+    curveData_(new SharedCurve(ds)),
+    sculptRadius_(0),
+    sculptIndex_(-1),
+    sculptX_(0),
+    sculptY_(0),
+    sculptS_(-1)
 {
 }
 
-LinearSpline::LinearSpline(const std::vector<EdgeSample,Eigen::aligned_allocator<EdgeSample> > & samples, bool loop)
+LinearSpline::LinearSpline(const std::vector<EdgeSample,Eigen::aligned_allocator<EdgeSample> > & samples, bool loop) :
+    curveData_(new SharedCurve()),
+    sculptRadius_(0),
+    sculptIndex_(-1),
+    sculptX_(0),
+    sculptY_(0),
+    sculptS_(-1)
 {
-    curve_.setVertices(samples);
+    SculptCurve::Curve<EdgeSample> & curve = mutableCurve_();
+    curve.setVertices(samples);
     if(loop)
     {
         isClosed_ = true;
-        curve_.makeLoop();
+        curve.makeLoop();
     }
-    curve_.resample();
+    curve.resample();
 }
 
-LinearSpline::LinearSpline(const QList<EdgeSample> & samples, bool loop)
+LinearSpline::LinearSpline(const QList<EdgeSample> & samples, bool loop) :
+    curveData_(new SharedCurve()),
+    sculptRadius_(0),
+    sculptIndex_(-1),
+    sculptX_(0),
+    sculptY_(0),
+    sculptS_(-1)
 {
     std::vector<EdgeSample,Eigen::aligned_allocator<EdgeSample> > stdvector;
     foreach (EdgeSample es, samples)
     {
         stdvector.push_back(es);
     }
-    curve_.setVertices(stdvector);
+    SculptCurve::Curve<EdgeSample> & curve = mutableCurve_();
+    curve.setVertices(stdvector);
     if(loop)
     {
         isClosed_ = true;
-        curve_.makeLoop();
+        curve.makeLoop();
     }
-    curve_.resample();
+    curve.resample();
 }
 
 LinearSpline::LinearSpline(const SculptCurve::Curve<EdgeSample> & other, bool loop) :
-    curve_(other)
-{
+    curveData_(new SharedCurve(other)),
+    sculptRadius_(0),
+    sculptIndex_(-1),
+    sculptX_(0),
+    sculptY_(0),
+    sculptS_(-1)
+{
+    SculptCurve::Curve<EdgeSample> & curve = mutableCurve_();
     if(loop)
     {
         isClosed_ = true;
-        curve_.makeLoop();
+        curve.makeLoop();
     }
-    curve_.resample();
+    curve.resample();
 }
 
 
-LinearSpline::LinearSpline(EdgeGeometry & other)
+LinearSpline::LinearSpline(EdgeGeometry & other) :
+    curveData_(new SharedCurve()),
+    sculptRadius_(0),
+    sculptIndex_(-1),
+    sculptX_(0),
+    sculptY_(0),
+    sculptS_(-1)
 {
     // get vertices of other geometry
     QList<Eigen::Vector2d> & vertices = other.sampling();
@@ -422,19 +473,25 @@ LinearSpline::LinearSpline(EdgeGeometry & other)
         samples << EdgeSample(vertices[i][0], vertices[i][1]);
 
     // set the curve to be this sampling
-    curve_.setVertices(samples);
+    SculptCurve::Curve<EdgeSample> & curve = mutableCurve_();
+    curve.setVertices(samples);
     if(other.isClosed())
     {
         isClosed_ = true;
-        curve_.makeLoop();
+        curve.makeLoop();
     }
-    curve_.resample();
+    curve.resample();
 }
 
 
-LinearSpline::LinearSpline(const QList<Eigen::Vector2d> & vertices, bool loop) //:
+LinearSpline::LinearSpline(const QList<Eigen::Vector2d> & vertices, bool loop) :
     //EdgeGeometry(ds),
-    //curve_(ds)
+    curveData_(new SharedCurve()),
+    sculptRadius_(0),
+    sculptIndex_(-1),
+    sculptX_(0),
+    sculptY_(0),
+    sculptS_(-1)
 {
     // create a sampling with default width values
     std::vector<EdgeSample,Eigen::aligned_allocator<EdgeSample> > samples;
@@ -442,13 +499,14 @@ LinearSpline::LinearSpline(const QList<Eigen::Vector2d> & vertices, bool loop) /
         samples << EdgeSample(vertices[i][0], vertices[i][1]);
 
     // set the curve to be this sampling
-    curve_.setVertices(samples);
+    SculptCurve::Curve<EdgeSample> & curve = mutableCurve_();
+    curve.setVertices(samples);
     if(loop)
     {
         isClosed_ = true;
-        curve_.makeLoop();
+        curve.makeLoop();
     }
-    curve_.resample();
+    curve.resample();
 }
 
 LinearSpline::~LinearSpline()
@@ -457,7 +515,16 @@ LinearSpline::~LinearSpline()
 
 LinearSpline * LinearSpline::clone()
 {
-    return new LinearSpline(curve_, isClosed());
+    // Share the curve instead of copying it
+    LinearSpline * res = new LinearSpline();
+    res->isClosed_ = isClosed_;
+    res->curveData_ = curveData_;
+    res->sculptRadius_ = sculptRadius_;
+    res->sculptIndex_ = sculptIndex_;
+    res->sculptX_ = sculptX_;
+    res->sculptY_ = sculptY_;
+    res->sculptS_ = sculptS_;
+    return res;
 }
 
 // ---------------------- Draw ------------------------
@@ -465,6 +532,27 @@ LinearSpline * LinearSpline::clone()
 namespace // Anonymous namespace for helper methods
 {
 
+// Samples at ds are considered to be within ds/10 of the edge, that is,
+// within half a pixel at 100% zoom for the default ds = 5. Approximations
+// with a smaller error are resampled more finely, up to ds/8.
+const double ERROR_TO_DS = 10.0;
+const double MAX_REFINEMENT = 8.0;
+
+// Number of segments of round caps: 50, or less if fewer segments are
+// enough to approximate a cap of radius r within error
+int numCapSegments(double r, double error)
+{
+    const int maxSegments = 50;
+    const int minSegments = 4;
+    if(error <= 0)
+        return maxSegments;
+    else if(error >= r)
+        return minSegments;
+
+    const double n = 3.14159 / std::acos(1 - error / r);
+    return std::max(minSegments, std::min(maxSegments, static_cast<int>(std::ceil(n))));
+}
+
 // This function assumes that if close = true, then samples.front() ==
 // samples.back, that is, that the first/last sample is duplicated.
 //
@@ -487,7 +575,7 @@ namespace // Anonymous namespace for helper methods
 //     * --- * --- *   ...   * --- *
 //     B0    B1    B2       Bn-2  Bn-1
 //
-void triangulateHelper(const QList<EdgeSample> & samples, Triangles & triangles, bool closed = false)
+void triangulateHelper(const QList<EdgeSample> & samples, Triangles & triangles, bool closed = false, double error = 0)
 {
     // Initialization and basic case
     triangles.clear();
@@ -578,10 +666,10 @@ void triangulateHelper(const QList<EdgeSample> & samples, Triangles & triangles,
     // Start cap
     if (!closed)
     {
-        int m = 50;
         double cx = samples.front().x();
         double cy = samples.front().y();
         double r = 0.5 * samples.front().width();
+        int m = numCapSegments(r, error);
         for(int i=0; i<m; ++i)
         {
             double theta1 = 2 * (double) i * 3.14159 / (double) m ;
@@ -600,10 +688,10 @@ void triangulateHelper(const QList<EdgeSample> & samples, Triangles & triangles,
     // End cap
     if (!closed)
     {
-        int m = 50;
         double cx = samples.back().x();
         double cy = samples.back().y();
         double r = 0.5 * samples.back().width();
+        int m = numCapSegments(r, error);
         for(int i=0; i<m; ++i)
         {
             double theta1 = 2 * (double) i * 3.14159 / (double) m ;
@@ -632,21 +720,59 @@ void LinearSpline::triangulate(Triangles & triangles)
         return;
     }
 
+    const SculptCurve::Curve<EdgeSample> & curve = curve_();
     QList<EdgeSample> samples;
-    for(int i=0; i<curve_.size(); ++i)
+    for(int i=0; i<curve.size(); ++i)
     {
-        samples << curve_[i];
+        samples << curve[i];
     }
 
     triangulateHelper(samples, triangles, isClosed());
 }
 
+void LinearSpline::triangulateApproximation(double error, Triangles & triangles)
+{
+    // Same as triangulate()
+    if(length() < 0.1)
+    {
+        triangles.clear();
+        return;
+    }
+
+    SculptCurve::Curve<EdgeSample> curve = curve_();
+    const double ds = std::max(ERROR_TO_DS * error, curve.ds() / MAX_REFINEMENT);
+    if(ds < curve.ds())
+    {
+        // Zoomed in: resample more finely, unless samples are already close
+        // enough, as is the case for the sampling of inbetween edges
+        if(curve.size() > 1 && ds < curve.length() / (curve.size() - 1))
+        {
+            curve.setDs(ds);
+            curve.resampleUniformly();
+        }
+    }
+    else
+    {
+        // Zoomed out: remove samples, and triangles from caps
+        curve.simplify(error);
+    }
+
+    QList<EdgeSample> samples;
+    for(int i=0; i<curve.size(); ++i)
+    {
+        samples << curve[i];
+    }
+
+    triangulateHelper(samples, triangles, isClosed(), error);
+}
+
 void LinearSpline::triangulate(double width, Triangles & triangles)
 {
+    const SculptCurve::Curve<EdgeSample> & curve = curve_();
     QList<EdgeSample> samples;
-    for(int i=0; i<curve_.size(); ++i)
+    for(int i=0; i<curve.size(); ++i)
     {
-        EdgeSample sample = curve_[i];
+        EdgeSample sample = curve[i];
         sample.setWidth(width);
         samples << sample;
     }
@@ -671,9 +797,14 @@ void LinearSpline::draw(double width)
 
 // ---------------------- Save and Load ------------------------
 
-LinearSpline::LinearSpline(QTextStream & in) //:
+LinearSpline::LinearSpline(QTextStream & in) :
     //EdgeGeometry(ds),
-    //curve_(ds)
+    curveData_(new SharedCurve()),
+    sculptRadius_(0),
+    sculptIndex_(-1),
+    sculptX_(0),
+    sculptY_(0),
+    sculptS_(-1)
 {
     Field field;
     QString bracket, nuple;
@@ -693,36 +824,31 @@ LinearSpline::LinearSpline(QTextStream & in) //:
         vertices << EdgeSample(list[0].toDouble(), list[1].toDouble(), list[2].toDouble());
     }
     in >> bracket;
-    curve_.setVertices(vertices);
+    mutableCurve_().setVertices(vertices);
     clearSampling();
 }
 
 void LinearSpline::save_(QTextStream & out)
 {
-    out << Save::newField("NumVertices") << curve_.size();
+    const SculptCurve::Curve<EdgeSample> & curve = curve_();
+    out << Save::newField("NumVertices") << curve.size();
     out << Save::newField("Vertices") << "[ ";
-    for(int i=0; i<curve_.size(); ++i)
-        out << "(" << curve_[i].x() << "," << curve_[i].y() << "," << curve_[i].width() << ") ";
+    for(int i=0; i<curve.size(); ++i)
+        out << "(" << curve[i].x() << "," << curve[i].y() << "," << curve[i].width() << ") ";
     out << "]";
 }
 
-namespace
-{
-QString double2qstring(double x)
-{
-    const int numDigits = 15; // decimal representations of double precision floating points
-                              // are (typically) meaningless after 15 decimal digits
-    // 15 decimal digits guarantees that decimalstring->double->decimalstring is the identity
-    // 17 decimal digits guarantees that double->decimalstring->double is the identity
-
-    return QString().setNum(x,'g',numDigits);
-}
-}
-
-LinearSpline::LinearSpline(const QStringRef & str)
+LinearSpline::LinearSpline(const QStringRef & str, bool adaptive) :
+    curveData_(new SharedCurve()),
+    sculptRadius_(0),
+    sculptIndex_(-1),
+    sculptX_(0),
+    sculptY_(0),
+    sculptS_(-1)
 {
     // Clear curve
-    curve_.clear();
+    SculptCurve::Curve<EdgeSample> & curve = mutableCurve_();
+    curve.clear();
 
     // Get data from string
     QStringList strList = str.toString() // Expensive, to change by only using QStringRef
@@ -732,18 +858,21 @@ LinearSpline::LinearSpline(const QStringRef & str)
         d << strList[i].toDouble();
 
     // Return if not enough data
-    if(d.size() < 1)
+    int offset = adaptive ? 2 : 1; // ds, and tolerance if adaptive
+    if(d.size() < offset)
         return;
 
     // Get vertices from data
     std::vector<EdgeSample,Eigen::aligned_allocator<EdgeSample> > vertices;
-    int n = (d.size()-1)/3;
+    int n = (d.size()-offset)/3;
     for(int i=0; i<n; i++)
-        vertices << EdgeSample(d[3*i+1], d[3*i+2], d[3*i+3]);
+        vertices << EdgeSample(d[3*i+offset], d[3*i+offset+1], d[3*i+offset+2]);
 
     // Set curve
-    curve_.setDs(d[0]);
-    curve_.setVertices(vertices);
+    curve.setDs(d[0]);
+    if(adaptive)
+        curve.setTolerance(d[1]);
+    curve.setVertices(vertices);
     clearSampling();
 }
 
@@ -780,55 +909,83 @@ LinearSpline::LinearSpline(XmlStreamReader & xml)
 
 void LinearSpline::write(XmlStreamWriter & xml) const
 {
-    QString d;
-    d += double2qstring(curve_.ds()) + " ";
-    const int n = curve_.size();
+    // Doubles are written with 15 significant digits, which guarantees
+    // that decimalstring->double->decimalstring is the identity (see
+    // XmlStreamWriter::appendDouble()). Since curves can have many samples,
+    // they are streamed without building a QString.
+    // Adaptively sampled curves also store their tolerance, which is
+    // needed to resample them without rounding their long segments
+    const SculptCurve::Curve<EdgeSample> & curve = curve_();
+    xml.beginRawAttribute("curve");
+    if(curve.tolerance() > 0)
+    {
+        xml.appendRaw("xywadaptive(");
+        xml.appendDouble(curve.ds());
+        xml.appendRaw(' ');
+        xml.appendDouble(curve.tolerance());
+    }
+    else
+    {
+        xml.appendRaw("xywdense(");
+        xml.appendDouble(curve.ds());
+    }
+    xml.appendRaw(' ');
+    const int n = curve.size();
     for(int i=0; i<n; ++i)
     {
-        d += double2qstring(curve_[i].x()) + "," +
-             double2qstring(curve_[i].y()) + "," +
-             double2qstring(curve_[i].width());
-
-        if(i<n-1) d += " ";
+        const EdgeSample sample = curve[i];
+        xml.appendDouble(sample.x());
+        xml.appendRaw(',');
+        xml.appendDouble(sample.y());
+        xml.appendRaw(',');
+        xml.appendDouble(sample.width());
+
+        if(i<n-1) xml.appendRaw(' ');
     }
-
-    xml.writeAttribute("curve", "xywdense(" + d + ")");
+    xml.appendRaw(')');
+    xml.endRawAttribute();
 }
 
 
 // --------------- Accessing Curve Geometry --------------------
 
-int LinearSpline::size() const { return curve_.size(); }
-EdgeSample LinearSpline::operator[] (int i) const { return curve_[i]; }
-void LinearSpline::beginSketch(const EdgeSample & sample) { curve_.beginSketch(sample); }
-void LinearSpline::continueSketch(const EdgeSample & sample) { curve_.continueSketch(sample); }
-void LinearSpline::endSketch() { curve_.endSketch(); }
+int LinearSpline::size() const { return curve_().size(); }
+EdgeSample LinearSpline::operator[] (int i) const { return curve_()[i]; }
+void LinearSpline::beginSketch(const EdgeSample & sample) { mutableCurve_().beginSketch(sample); }
+void LinearSpline::continueSketch(const EdgeSample & sample) { mutableCurve_().continueSketch(sample); }
+void LinearSpline::endSketch() { mutableCurve_().endSketch(); }
 
 SculptCurve::Curve<EdgeSample> & LinearSpline::curve()
 {
-    return curve_;
+    return mutableCurve_();
+}
+
+const SculptCurve::Curve<EdgeSample> & LinearSpline::constCurve() const
+{
+    return curve_();
 }
 
 EdgeSample LinearSpline::pos(double s) const
 {
-    return curve_(s);
+    return curve_()(s);
 }
 
 EdgeSample LinearSpline::leftPos() const
 {
-    return curve_.start();
+    return curve_().start();
 }
 
 EdgeSample LinearSpline::rightPos() const
 {
-    return curve_.end();
+    return curve_().end();
 }
 
 QList<EdgeSample> LinearSpline::edgeSampling() const
 {
+    const SculptCurve::Curve<EdgeSample> & curve = curve_();
     QList<EdgeSample> res;
-    for(int i=0; i<curve_.size(); ++i)
-        res << curve_[i];
+    for(int i=0; i<curve.size(); ++i)
+        res << curve[i];
     return res;
 }
 
@@ -837,7 +994,7 @@ QList<EdgeSample> LinearSpline::edgeSampling() const
 Eigen::Vector2d LinearSpline::der(double s)
 {
     double ds = 1e-3;
-    EdgeSample dp = curve_(s+ds) - curve_(s-ds);
+    EdgeSample dp = curve_()(s+ds) - curve_()(s-ds);
     Eigen::Vector2d dpe(dp.x(),dp.y());
     double norm = dpe.norm();
 
@@ -849,14 +1006,14 @@ Eigen::Vector2d LinearSpline::der(double s)
 
 double LinearSpline::length() const
 {
-    return curve_.length();
+    return curve_().length();
 }
 
 EdgeGeometry * LinearSpline::trimmed(double from, double to)
 {
     std::vector<double> splitValues;
     splitValues << from << to;
-    return new LinearSpline(curve_.split(splitValues)[0]);
+    return new LinearSpline(curve_().split(splitValues)[0]);
 }
 
 
@@ -864,14 +1021,19 @@ EdgeGeometry * LinearSpline::trimmed(double from, double to)
 
 void LinearSpline::resample_(double ds)
 {
-    curve_.resample(ds);
-    for(int i=0; i<curve_.size(); ++i)
-        sampling_ << Eigen::Vector2d(curve_[i].x(), curve_[i].y());
+    // Don't detach the curve if it is already sampled at this rate
+    if(!curve_().isSampledAt(ds))
+        mutableCurve_().resample(ds);
+
+    const SculptCurve::Curve<EdgeSample> & curve = curve_();
+    for(int i=0; i<curve.size(); ++i)
+        sampling_ << Eigen::Vector2d(curve[i].x(), curve[i].y());
 }
 
 void LinearSpline::makeLoop_()
 {
-    curve_.makeLoop();
+    if(!curve_().isClosed())
+        mutableCurve_().makeLoop();
 }
 
 // --------------------- Manipulating --------------------------
@@ -881,19 +1043,19 @@ void LinearSpline::setLeftRightPos(const Eigen::Vector2d & left,
 {
     if(isClosed())
     {
-        curve_.resample(true);
+        mutableCurve_().resample(true);
     }
     else
     {
-        EdgeSample leftSample = curve_.start();
+        EdgeSample leftSample = curve_().start();
         leftSample.setX(left[0]);
         leftSample.setY(left[1]);
 
-        EdgeSample rightSample = curve_.end();
+        EdgeSample rightSample = curve_().end();
         rightSample.setX(right[0]);
         rightSample.setY(right[1]);
 
-        curve_.setEndPoints(leftSample, rightSample);
+        mutableCurve_().setEndPoints(leftSample, rightSample);
     }
     clearSampling();
 }
@@ -921,18 +1083,19 @@ void LinearSpline::setRightDer(const Eigen::Vector2d & rightDer, double radius,
     if(dtheta >= pi)
         dtheta -= 2*pi;
 
-    double rightX = curve_.end().x();
-    double rightY = curve_.end().y();
+    const SculptCurve::Curve<EdgeSample> & curve = curve_();
+    double rightX = curve.end().x();
+    double rightY = curve.end().y();
 
     std::vector<EdgeSample,Eigen::aligned_allocator<EdgeSample> > newVertices;
-    for(int i=0; i<curve_.size(); ++i)
+    for(int i=0; i<curve.size(); ++i)
     {
         // todo: replace by w(distance, radius), where radius is the remaining sculpt radius
-        double weightedDtheta = dtheta * curve_.w_( curve_.length() - curve_.arclength(i), radius);
+        double weightedDtheta = dtheta * curve.w_( curve.length() - curve.arclength(i), radius);
         double c = std::cos(weightedDtheta);
         double s = std::sin(weightedDtheta);
 
-        EdgeSample sample = curve_[i];
+        EdgeSample sample = curve[i];
         double oldX = sample.x();
         double oldY = sample.y();
         sample.setX( rightX + (oldX-rightX)*c - (oldY-rightY)*s);
@@ -940,9 +1103,9 @@ void LinearSpline::setRightDer(const Eigen::Vector2d & rightDer, double radius,
         newVertices << sample;
     }
 
-    curve_.setVertices(newVertices);
+    mutableCurve_().setVertices(newVertices);
     if(resample)
-        curve_.resample();
+        mutableCurve_().resample();
 
     clearSampling();
 }
@@ -970,18 +1133,19 @@ void LinearSpline::setLeftDer(const Eigen::Vector2d & leftDer, double radius, bo
     if(dtheta >= pi)
         dtheta -= 2*pi;
 
-    double rightX = curve_.start().x();
-    double rightY = curve_.start().y();
+    const SculptCurve::Curve<EdgeSample> & curve = curve_();
+    double rightX = curve.start().x();
+    double rightY = curve.start().y();
 
     std::vector<EdgeSample,Eigen::aligned_allocator<EdgeSample> > newVertices;
-    for(int i=0; i<curve_.size(); ++i)
+    for(int i=0; i<curve.size(); ++i)
     {
         // todom replace by w(distance, radius), where radius is the remaining sculpt radius
-        double weightedDtheta = dtheta * curve_.w_( curve_.arclength(i), radius);
+        double weightedDtheta = dtheta * curve.w_( curve.arclength(i), radius);
         double c = std::cos(weightedDtheta);
         double s = std::sin(weightedDtheta);
 
-        EdgeSample sample = curve_[i];
+        EdgeSample sample = curve[i];
         double oldX = sample.x();
         double oldY = sample.y();
         sample.setX( rightX + (oldX-rightX)*c - (oldY-rightY)*s);
@@ -989,56 +1153,121 @@ void LinearSpline::setLeftDer(const Eigen::Vector2d & leftDer, double radius, bo
         newVertices << sample;
     }
 
-    curve_.setVertices(newVertices);
+    mutableCurve_().setVertices(newVertices);
     if(resample)
-        curve_.resample();
+        mutableCurve_().resample();
 
     clearSampling();
 }
 
 void LinearSpline::setWidth(double newWidth)
 {
+    const SculptCurve::Curve<EdgeSample> & curve = curve_();
     std::vector<EdgeSample,Eigen::aligned_allocator<EdgeSample> > newVertices;
-    for(int i=0; i<curve_.size(); ++i)
+    for(int i=0; i<curve.size(); ++i)
     {
-        EdgeSample sample = curve_[i];
+        EdgeSample sample = curve[i];
         sample.setWidth(newWidth);
         newVertices << sample;
     }
 
-    curve_.setVertices(newVertices);
+    mutableCurve_().setVertices(newVertices);
+}
+
+double LinearSpline::samplingTolerance() const
+{
+    return curve_().tolerance();
+}
+
+void LinearSpline::setSamplingTolerance(double tolerance)
+{
+    // Keep uniformly sampled curves as is
+    if(tolerance <= 0 && curve_().tolerance() <= 0)
+        return;
+
+    SculptCurve::Curve<EdgeSample> & curve = mutableCurve_();
+    curve.setTolerance(std::max(0.0, tolerance));
+    curve.resample(true);
+    clearSampling();
 }
 
 
 double LinearSpline::updateSculpt(double x, double y, double radius)
 {
+    // This is called for all edges when hovering in sculpt mode, so we only
+    // read the curve here. It is prepared for sculpting (and therefore
+    // detached) only when sculpting actually begins, see prepareSculpt_().
+    const SculptCurve::Curve<EdgeSample> & curve = curve_();
+    SculptCurve::Curve<EdgeSample>::ClosestVertex v = curve.findClosestVertex(x,y);
+    sculptIndex_ = v.i;
     sculptRadius_ = radius;
-    return curve_.prepareSculpt(x,y, radius);
+    sculptX_ = x;
+    sculptY_ = y;
+    sculptS_ = -1;
+
+    // Adaptively sampled curves may have long segments near (x, y), without
+    // vertices to sculpt until they are refined. Meanwhile, we use the
+    // closest point on the curve.
+    if(curve.tolerance() > 0 && curve.needsRefinement(x, y, 2*radius))
+    {
+        SculptCurve::Curve<EdgeSample>::ClosestPoint p = curve.findClosestPoint(x,y);
+        sculptS_ = p.s;
+        return p.d;
+    }
+    return v.d;
+}
+
+void LinearSpline::prepareSculpt_()
+{
+    // Split the long segments of adaptively sampled curves near the position
+    // given to updateSculpt(), so that there are vertices to sculpt. Vertices
+    // up to 2*radius away may be moved, since they are within radius of the
+    // sculpted vertex.
+    SculptCurve::Curve<EdgeSample> & curve = mutableCurve_();
+    if(curve.tolerance() > 0 && curve.needsRefinement(sculptX_, sculptY_, 2*sculptRadius_))
+    {
+        curve.refine(sculptX_, sculptY_, 2*sculptRadius_);
+        clearSampling();
+    }
+    curve.prepareSculpt(sculptX_, sculptY_, sculptRadius_);
+    sculptIndex_ = curve.sculptVertexIndex();
+    sculptS_ = -1;
 }
 
 EdgeSample LinearSpline::sculptVertex() const
 {
-    return curve_.sculptVertex();
+    if(sculptS_ >= 0)
+        return curve_()(sculptS_);
+    else if(sculptIndex_>=0 && sculptIndex_<size())
+        return curve_()[sculptIndex_];
+    else
+        return EdgeSample();
 }
 double LinearSpline::arclengthOfSculptVertex() const
 {
-    return curve_.arclengthOfSculptVertex();
+    if(sculptS_ >= 0)
+        return sculptS_;
+    else if(sculptIndex_>=0 && sculptIndex_<size())
+        return curve_().arclength(sculptIndex_);
+    else
+        return 0;
 }
 
 void LinearSpline::beginSculptDeform(double x, double y)
 {
-    curve_.beginSculptDeform(x, y);
+    prepareSculpt_();
+    mutableCurve_().beginSculptDeform(x, y);
 }
 
 void LinearSpline::continueSculptDeform(double x, double y)
 {
-    curve_.continueSculptDeform(x, y);
+    mutableCurve_().continueSculptDeform(x, y);
     clearSampling();
 }
 
 void LinearSpline::endSculptDeform()
 {
-    curve_.endSculptDeform();
+    mutableCurve_().endSculptDeform();
     clearSampling();
 }
 
@@ -1068,15 +1297,17 @@ double LinearSpline::w2_(double d, double r0, double w0) const // cf p 296
 
 void LinearSpline::beginSculptEdgeWidth(double x, double y)
 {
+    prepareSculpt_();
+
     // save the original geometry
+    const SculptCurve::Curve<EdgeSample> & curve = curve_();
     vertices_.clear();
     arclengths_.clear();
-    for(int i=0; i<curve_.size(); ++i)
+    for(int i=0; i<curve.size(); ++i)
     {
-        vertices_ << curve_[i];
-        arclengths_ << curve_.arclength(i);
+        vertices_ << curve[i];
+        arclengths_ << curve.arclength(i);
     }
-    sculptIndex_ = curve_.sculptVertexIndex();
 
     // Store start x and y
     sculptStartX_ = x;
@@ -1173,7 +1404,7 @@ void LinearSpline::continueSculptEdgeWidth(double x, double /*y*/)
         double widthRatio = newSculptWidth / sculptTemp_[0].width;
         vertices_[v.i].setWidth(v.width  * ( 1 + (widthRatio-1) * v.w) );
     }
-    curve_.setVertices(vertices_);
+    mutableCurve_().setVertices(vertices_);
     clearSampling();
 }
 
@@ -1187,12 +1418,16 @@ void LinearSpline::endSculptEdgeWidth()
 
 void LinearSpline::beginSculptSmooth(double /*x*/, double /*y*/)
 {
+    prepareSculpt_();
 }
 
 
 void LinearSpline::continueSculptSmooth(double /*x*/, double /*y*/)
 {
-    curve_.sculptSmooth(0.05);
+    // The sculpt position is updated before each step, see
+    // VAC::continueSculptSmooth()
+    prepareSculpt_();
+    mutableCurve_().sculptSmooth(0.05);
     clearSampling();
 }
 
@@ -1212,7 +1447,7 @@ void LinearSpline::performDragAndDrop(double dx, double dy)
     //if(!isClosed_)
     //    return;
 
-    curve_.translate(dx-dragAndDrop_lastDx_,dy-dragAndDrop_lastDy_);
+    mutableCurve_().translate(dx-dragAndDrop_lastDx_,dy-dragAndDrop_lastDy_);
     dragAndDrop_lastDx_ = dx;
     dragAndDrop_lastDy_ = dy;
 
@@ -1221,19 +1456,22 @@ void LinearSpline::performDragAndDrop(double dx, double dy)
 
 void LinearSpline::prepareAffineTransform()
 {
-    curveBeforeTransform_ = curve_;
+    curveBeforeTransformData_ = curveData_;
 }
 
 void LinearSpline::performAffineTransform(const Eigen::Affine2d & xf)
 {
-    curve_ = curveBeforeTransform_.transformed(xf);
+    SharedCurve * transformed = new SharedCurve(curveBeforeTransformData_.constData()->curve);
+    transformed->curve.transform(xf);
+    curveData_ = transformed;
     clearSampling();
 }
 
 EdgeGeometry::ClosestVertexInfo LinearSpline::closestPoint(double x, double y)
 {
     // Delegate computation
-    SculptCurve::Curve<EdgeSample>::ClosestVertex cv = curve_.findClosestVertex(x,y);
+    const SculptCurve::Curve<EdgeSample> & curve = curve_();
+    SculptCurve::Curve<EdgeSample>::ClosestVertex cv = curve.findClosestVertex(x,y);
 
     // Handle result
     if(cv.i == -1)
@@ -1244,8 +1482,8 @@ EdgeGeometry::ClosestVertexInfo LinearSpline::closestPoint(double x, double y)
     else
     {
         ClosestVertexInfo res;
-        res.p = curve_[cv.i];
-        res.s = curve_.arclength(cv.i);
+        res.p = curve[cv.i];
+        res.s = curve.arclength(cv.i);
         res.d = cv.d;
         return res;
     }
@@ -1255,9 +1493,10 @@ void LinearSpline::exportSVG(QTextStream & out)
 {
     // ---- Compute data to export ----
 
+    const SculptCurve::Curve<EdgeSample> & curve = curve_();
     std::vector<double> ax, ay, bx, by;
 
-    if(curve_.size() < 2)
+    if(curve.size() < 2)
         return;
 
     // helper function
@@ -1270,34 +1509,34 @@ void LinearSpline::exportSVG(QTextStream & out)
         return Eigen::Vector2d(-v[1],v[0]);
     };
 
-    Eigen::Vector2d u = getNormal(curve_[0].x(), curve_[0].y(),
-                                  curve_[1].x(), curve_[1].y());
-    Eigen::Vector2d p( curve_[0].x(), curve_[0].y() );
-    Eigen::Vector2d A = p + curve_[0].width() * 0.5 * u;
-    Eigen::Vector2d B = p - curve_[0].width() * 0.5 * u;
+    Eigen::Vector2d u = getNormal(curve[0].x(), curve[0].y(),
+                                  curve[1].x(), curve[1].y());
+    Eigen::Vector2d p( curve[0].x(), curve[0].y() );
+    Eigen::Vector2d A = p + curve[0].width() * 0.5 * u;
+    Eigen::Vector2d B = p - curve[0].width() * 0.5 * u;
     ax.push_back(A[0]);
     ay.push_back(A[1]);
     bx.push_back(B[0]);
     by.push_back(B[1]);
-    p = Eigen::Vector2d( curve_[1].x(), curve_[1].y() );
-    A = p + curve_[1].width() * 0.5 * u;
-    B = p - curve_[1].width() * 0.5 * u;
+    p = Eigen::Vector2d( curve[1].x(), curve[1].y() );
+    A = p + curve[1].width() * 0.5 * u;
+    B = p - curve[1].width() * 0.5 * u;
     ax.push_back(A[0]);
     ay.push_back(A[1]);
     bx.push_back(B[0]);
     by.push_back(B[1]);
-    int n = curve_.size();
+    int n = curve.size();
     if(isClosed()) // clean junction drawing for loops
     {
         n -= 1;
     }
     for(int i=2; i<n; i++)
     {
-        Eigen::Vector2d u = getNormal(curve_[i-1].x(), curve_[i-1].y(),
-                                      curve_[i].x(), curve_[i].y());
-        p = Eigen::Vector2d( curve_[i].x(), curve_[i].y() );
-        Eigen::Vector2d A = p + curve_[i].width() * 0.5 * u;
-        Eigen::Vector2d B = p - curve_[i].width() * 0.5 * u;
+        Eigen::Vector2d u = getNormal(curve[i-1].x(), curve[i-1].y(),
+                                      curve[i].x(), curve[i].y());
+        p = Eigen::Vector2d( curve[i].x(), curve[i].y() );
+        Eigen::Vector2d A = p + curve[i].width() * 0.5 * u;
+        Eigen::Vector2d B = p - curve[i].width() * 0.5 * u;
         ax.push_back(A[0]);
         ay.push_back(A[1]);
         bx.push_back(B[0]);
@@ -18,6 +18,8 @@
 #define VAC_EDGE_GEOMETRY_H
 
 #include <QList>
+#include <QSharedData>
+#include <QSharedDataPointer>
 #include <QString>
 #include "Eigen.h"
 
@@ -45,6 +47,11 @@ public:
     virtual void draw();
     virtual void triangulate(Triangles & triangles);
 
+    // same as triangulate(triangles), but at a level of detail such that
+    // the edge is drawn within the given error, in scene units (see
+    // Cell::triangles(Time, double)). Default implementation ignores error.
+    virtual void triangulateApproximation(double error, Triangles & triangles);
+
     // draw the edges with a fixed width (ignore stored width)
     virtual void draw(double width);
     virtual void triangulate(double width, Triangles & triangles);
@@ -79,6 +86,10 @@ public:
     virtual void setRightDer(const Eigen::Vector2d & rightDer, double radius, bool resample);
     virtual void setLeftDer(const Eigen::Vector2d & leftDer, double radius, bool resample);
     virtual void setWidth(double newWidth);
+    // adaptive sampling: resamples the edge, keeping only the samples needed
+    // to stay within tolerance of its uniform sampling (0 means uniform)
+    virtual double samplingTolerance() const;
+    virtual void setSamplingTolerance(double tolerance);
     // sculpting
     virtual double updateSculpt(double x, double y, double radius);
     virtual EdgeSample sculptVertex() const;
@@ -106,6 +117,7 @@ public:
     // Save and Load
     static EdgeGeometry * read(QTextStream & in);
     static EdgeGeometry * read(XmlStreamReader & xml);
+    static EdgeGeometry * read(const QStringRef & curve); // value of the "curve" XML attribute
     void save(QTextStream & out);
     virtual void exportSVG(QTextStream & out);
     virtual QString stringType() const {return "EdgeGeometry";}
@@ -144,6 +156,20 @@ private:
 
 };
 
+// Implicitly shared curve of a LinearSpline. Copying a LinearSpline (e.g., when
+// cloning a VAC for undo/redo or copy-paste) only copies a pointer to it: the
+// samples are deep-copied the first time one of the copies is modified.
+class SharedCurve: public QSharedData
+{
+public:
+    SharedCurve(double ds = 5.0) : curve(ds) {}
+    SharedCurve(const SculptCurve::Curve<EdgeSample> & other) : curve(other) {}
+
+    SculptCurve::Curve<EdgeSample> curve;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
 class LinearSpline: public EdgeGeometry
 {
 public:
@@ -161,6 +187,7 @@ public:
     virtual void draw();
     virtual void draw(double width);
     virtual void triangulate(Triangles & triangles);
+    virtual void triangulateApproximation(double error, Triangles & triangles);
     virtual void triangulate(double width, Triangles & triangles);
 
     void exportSVG(QTextStream & out);
@@ -178,6 +205,8 @@ public:
     void setRightDer(const Eigen::Vector2d & rightDer, double radius, bool resample);
     void setLeftDer(const Eigen::Vector2d & leftDer, double radius, bool resample);
     void setWidth(double newWidth);
+    double samplingTolerance() const;
+    void setSamplingTolerance(double tolerance);
 
     // Sculpting
     double updateSculpt(double x, double y, double radius);
@@ -207,10 +236,14 @@ public:
 
     LinearSpline(QTextStream & in);
     //LinearSpline(XmlStreamReader & xml);
-    LinearSpline(const QStringRef & str); // str = curve data from XML, without the type
+    LinearSpline(const QStringRef & str, bool adaptive = false); // str = curve data from XML, without the type
+                                                                 // adaptive = whether the type is xywadaptive
     QString stringType() const {return "LinearSpline";}
 
+    // Note: curve() detaches the curve from other copies of this LinearSpline,
+    // use constCurve() if you don't need to modify it
     SculptCurve::Curve<EdgeSample> & curve();
+    const SculptCurve::Curve<EdgeSample> & constCurve() const;
 
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
@@ -231,10 +264,12 @@ private:
     //double length_;
     //QList<Eigen::Vector2d> vertices_;
 
-    SculptCurve::Curve<EdgeSample> curve_;
+    QSharedDataPointer<SharedCurve> curveData_;
+    const SculptCurve::Curve<EdgeSample> & curve_() const { return curveData_.constData()->curve; }
+    SculptCurve::Curve<EdgeSample> & mutableCurve_() { return curveData_->curve; } // detaches
 
     // Store initial curve for affine tranform
-    SculptCurve::Curve<EdgeSample> curveBeforeTransform_;
+    QSharedDataPointer<SharedCurve> curveBeforeTransformData_;
 
     // Others
     void makeLoop_();
@@ -246,6 +281,10 @@ private:
     std::vector<EdgeSample,Eigen::aligned_allocator<EdgeSample> > vertices_;
     std::vector<double> arclengths_;
     int sculptIndex_;
+    double sculptX_; // position given to updateSculpt()
+    double sculptY_;
+    double sculptS_; // arclength of the sculpt point if not a vertex, else -1
+    void prepareSculpt_();
     double sculptStartX_;
     double sculptStartY_;
     struct SculptTemp
@@ -20,6 +20,10 @@
 #include "../DevSettings.h"
 #include "../Global.h"
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
 
 namespace VectorAnimationComplex
 {
@@ -73,6 +77,61 @@ bool FaceCell::isPickableCustom(Time /*time*/) const
         return false;
 }
 
+bool FaceCell::hasLevelsOfDetail_() const
+{
+    return true;
+}
+
+void FaceCell::simplifyOutline(QList<Eigen::Vector2d> & polyline, double error)
+{
+    const int n = polyline.size();
+    if(n < 3)
+        return;
+
+    std::vector<bool> keep(n, false);
+    keep[0] = true;
+    keep[n-1] = true;
+
+    std::vector< std::pair<int,int> > ranges;
+    ranges.push_back(std::make_pair(0, n-1));
+    while(!ranges.empty())
+    {
+        const int a = ranges.back().first;
+        const int b = ranges.back().second;
+        ranges.pop_back();
+
+        const Eigen::Vector2d & p = polyline[a];
+        const Eigen::Vector2d ab = polyline[b] - p;
+        const double l2 = ab.squaredNorm();
+        double maxError = error;
+        int k = -1;
+        for(int i=a+1; i<b; ++i)
+        {
+            const double u = (l2 > 0) ? std::max(0.0, std::min(1.0, (polyline[i] - p).dot(ab) / l2)) : 0.0;
+            const double d = (p + u*ab - polyline[i]).norm();
+            if(d > maxError)
+            {
+                maxError = d;
+                k = i;
+            }
+        }
+        if(k >= 0)
+        {
+            keep[k] = true;
+            ranges.push_back(std::make_pair(a, k));
+            ranges.push_back(std::make_pair(k, b));
+        }
+    }
+
+    QList<Eigen::Vector2d> res;
+    for(int i=0; i<n; ++i)
+    {
+        if(keep[i])
+            res << polyline[i];
+    }
+    polyline.swap(res);
+}
+
 void FaceCell::computeOutlineBoundingBox_(Time t, BoundingBox & out) const
 {
     out = boundingBox(t);
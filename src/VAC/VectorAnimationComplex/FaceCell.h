@@ -37,6 +37,12 @@ public:
     // Export SVG
     virtual void exportSVG(Time t, QTextStream & out);
 
+    // Removes the vertices of the polyline which are not needed to stay
+    // within error, using the Douglas-Peucker algorithm. Its first and last
+    // vertices are kept. This simplifies the outline of faces before
+    // tessellating them at coarse levels of detail.
+    static void simplifyOutline(QList<Eigen::Vector2d> & polyline, double error);
+
 protected:
     virtual ~FaceCell()=0;
 
@@ -47,6 +53,9 @@ private:
 
     virtual bool isPickableCustom(Time time) const;
 
+    // Levels of detail are implemented by both KeyFace and InbetweenFace
+    virtual bool hasLevelsOfDetail_() const;
+
     // Implementation of outline bounding box for both KeyFace and InbetweenFace
     void computeOutlineBoundingBox_(Time t, BoundingBox & out) const;
 
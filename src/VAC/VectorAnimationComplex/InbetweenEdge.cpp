@@ -15,6 +15,7 @@
 // limitations under the License.
 
 #include "InbetweenEdge.h"
+#include "CellPool.h"
 #include "KeyVertex.h"
 #include "KeyEdge.h"
 #include "InbetweenVertex.h"
@@ -36,10 +37,27 @@
 #include "../XmlStreamReader.h"
 
 #include <assert.h>
+#include <atomic>
+#include <cmath>
 
 namespace VectorAnimationComplex
 {
 
+namespace
+{
+
+// Revisions are shared by all edges, so that a surface never reuses the
+// revision of another one, e.g. of an edge previously allocated at the
+// same address
+std::atomic<quint64> lastSurfaceRevision(0);
+
+quint64 newSurfaceRevision()
+{
+    return ++lastSurfaceRevision;
+}
+
+}
+
 bool InbetweenEdge::isClosed() const
 {
     return !startAnimatedVertex_.isValid();
@@ -158,6 +176,25 @@ InbetweenEdge::InbetweenEdge(VAC * g, QTextStream & in) :
     in >> field >> afterCycle_;
 }
 
+namespace
+{
+CellPool & inbetweenEdgePool()
+{
+    static CellPool * res = new CellPool(sizeof(InbetweenEdge));
+    return *res;
+}
+}
+
+void * InbetweenEdge::operator new(std::size_t size)
+{
+    return inbetweenEdgePool().allocate(size);
+}
+
+void InbetweenEdge::operator delete(void * p, std::size_t size)
+{
+    inbetweenEdgePool().deallocate(p, size);
+}
+
 void InbetweenEdge::read2ndPass()
 {
     // Base classes
@@ -355,109 +392,120 @@ InbetweenEdge::InbetweenEdge(VAC * vac, XmlStreamReader & xml) :
     void InbetweenEdge::clearCachedGeometry_()
     {
         EdgeCell::clearCachedGeometry_();
-        surf_.clear();
-        norm_.clear();
+        surface_ = SpaceTimeSurface();
     }
 
-    void InbetweenEdge::computeInbetweenSurface(View3DSettings & viewSettings)
+    const InbetweenEdge::SpaceTimeSurface & InbetweenEdge::spaceTimeSurface(
+            const View3DSettings & viewSettings, int timeStride, int sampleStride)
     {
-        if(!surf_.isEmpty() &&
-           cacheSpaceScale_ == viewSettings.spaceScale() &&
-           cacheTimeScale_ == viewSettings.timeScale() &&
-           cacheK1_ == viewSettings.k1() &&
-           cacheK2_ == viewSettings.k2())
+        timeStride = std::max(1, timeStride);
+        sampleStride = std::max(1, sampleStride);
+        if(surface_.revision == 0 ||
+           cacheSpaceScale_ != viewSettings.spaceScale() ||
+           cacheTimeScale_ != viewSettings.timeScale() ||
+           cacheK1_ != viewSettings.k1() ||
+           cacheK2_ != viewSettings.k2() ||
+           cacheTimeStride_ != timeStride ||
+           cacheSampleStride_ != sampleStride)
         {
-            return;
+            cacheSpaceScale_ = viewSettings.spaceScale();
+            cacheTimeScale_ = viewSettings.timeScale();
+            cacheK1_ = viewSettings.k1();
+            cacheK2_ = viewSettings.k2();
+            cacheTimeStride_ = timeStride;
+            cacheSampleStride_ = sampleStride;
+            computeSpaceTimeSurface_(viewSettings);
         }
+        return surface_;
+    }
 
-        surf_.clear();
-        norm_.clear();
-        cacheSpaceScale_ = viewSettings.spaceScale();
-        cacheTimeScale_ = viewSettings.timeScale();
-        cacheK1_ = viewSettings.k1();
-        cacheK2_ = viewSettings.k2();
+    void InbetweenEdge::computeSpaceTimeSurface_(const View3DSettings & viewSettings)
+    {
+        surface_ = SpaceTimeSurface();
+        surface_.revision = newSurfaceRevision();
 
         double eps = 1e-5;
         double tMin = beforeTime().floatTime();
         double tMax = afterTime().floatTime();
-        double dt = 1 / (double)cacheK1_;
+        surface_.tMin = tMin;
+        surface_.tMax = tMax;
 
-        // positions
-        for(double t=tMin; t<tMax+eps; t+=dt)
-        {
-            QList<Eigen::Vector3d> geo3D;
+        // Rows, evenly spaced by at most timeStride/k1 frame. The key
+        // geometry doesn't depend on time, so it is sampled only once.
+        double dt = cacheTimeStride_ / (double)cacheK1_;
+        int numIntervals = std::max(1, (int) std::ceil((tMax - tMin) / dt - eps));
+        QList<Eigen::Vector2d> beforeSampling;
+        QList<Eigen::Vector2d> afterSampling;
+        sampleKeyGeometry_(beforeSampling, afterSampling);
 
-            QList<Eigen::Vector2d> geo2D = getGeometry(Time(t));
-            for(int i=0; i< geo2D.size(); ++i)
-            {
-                Eigen::Vector3d pos(
-                        viewSettings.xFromX2D(geo2D[i][0]),
-                        viewSettings.yFromY2D(geo2D[i][1]),
-                        viewSettings.zFromT(t));
-                geo3D << pos;
-            }
+        // Columns, every sampleStride*k2 sample, always including the last one
+        int n = beforeSampling.size();
+        int sampleStep = cacheK2_ * cacheSampleStride_;
+        int numCols = (n - 1 + sampleStep - 1) / sampleStep + 1;
+        if(n < 2)
+            return;
 
-            surf_ << geo3D;
+        // Positions
+        int numRows = numIntervals + 1;
+        surface_.numRows = numRows;
+        surface_.numCols = numCols;
+        surface_.positions.reserve(numRows * numCols);
+        for(int i=0; i<numRows; ++i)
+        {
+            double t = (i == numIntervals) ? tMax : tMin + i * (tMax - tMin) / numIntervals;
+            double z = viewSettings.zFromT(t);
+            QList<Eigen::Vector2d> geo2D = interpolateSamplings_(beforeSampling, afterSampling, Time(t));
+            for(int j=0; j<n; j+=sampleStep)
+                surface_.positions << Eigen::Vector3d(viewSettings.xFromX2D(geo2D[j][0]),
+                                                      viewSettings.yFromY2D(geo2D[j][1]), z);
+            if((n-1) % sampleStep != 0)
+                surface_.positions << Eigen::Vector3d(viewSettings.xFromX2D(geo2D[n-1][0]),
+                                                      viewSettings.yFromY2D(geo2D[n-1][1]), z);
         }
 
-
-        if(surf_.size() < 2)
-            return;
-
-        // normals
-        for(int i=0; i<surf_.size(); i++)
+        // Normals, computed from the next row and column (or the previous
+        // ones for the last row and column)
+        surface_.normals.reserve(numRows * numCols);
+        for(int i=0; i<numRows; ++i)
         {
-            QList<Eigen::Vector3d> list;
-            for(int j=0; j<surf_[0].size(); j++)
+            int i_ = (i == numRows-1) ? i-1 : i;
+            for(int j=0; j<numCols; ++j)
             {
-                int i_=i;
-                int j_=j;
-                if(i==surf_.size()-1)
-                    i_--;
-                if(j==surf_[0].size()-1)
-                    j_--;
-                Eigen::Vector3d a = surf_[i_][j_];
-                Eigen::Vector3d b = surf_[i_][j_+1];
-                Eigen::Vector3d c = surf_[i_+1][j_];
+                int j_ = (j == numCols-1) ? j-1 : j;
+                const Eigen::Vector3d & a = surface_.positions[i_*numCols + j_];
+                const Eigen::Vector3d & b = surface_.positions[i_*numCols + j_+1];
+                const Eigen::Vector3d & c = surface_.positions[(i_+1)*numCols + j_];
                 Eigen::Vector3d u = b-a;
                 Eigen::Vector3d v = c-a;
-                Eigen::Vector3d N = -u.cross(v);
-                list << N;
-                //qDebug() << N[0] << N[1] << N[2];
+                surface_.normals << -u.cross(v);
             }
-            norm_ << list;
         }
     }
 
     void InbetweenEdge::drawRaw3D(View3DSettings & viewSettings)
     {
-        computeInbetweenSurface(viewSettings);
+        const SpaceTimeSurface & surf = spaceTimeSurface(viewSettings);
+        int m = surf.numRows;
+        int n = surf.numCols;
+        if(m < 2 || n < 2)
+            return;
 
         // drawn in  backward order  to improve the  likeliness the
         // polygon are  drawn from rear  to near, and  improve the
         // chance to get the transparency right
-        int n = surf_[0].size();
-        for(int i=surf_.size()-2; i>=0; i--)
+        for(int i=m-2; i>=0; i--)
         {
             glBegin(GL_QUAD_STRIP);
-            for(int j=0; j<n;)
+            for(int j=0; j<n; ++j)
             {
-                //glColor4d(1.0,0.5,0.5,0.2);
-                glNormal3d(norm_[i][j][0],norm_[i][j][1],norm_[i][j][2]);
-                glVertex3d(surf_[i][j][0],surf_[i][j][1],surf_[i][j][2]);
-                glNormal3d(norm_[i+1][j][0],norm_[i+1][j][1],norm_[i+1][j][2]);
-                glVertex3d(surf_[i+1][j][0],surf_[i+1][j][1],surf_[i+1][j][2]);
-
-                if(j == n-1)
-                {
-                    break;
-                }
-                else
-                {
-                    j += cacheK2_;
-                    if(j >= n)
-                        j = n-1;
-                }
+                const Eigen::Vector3d & n0 = surf.normals[i*n + j];
+                const Eigen::Vector3d & p0 = surf.positions[i*n + j];
+                const Eigen::Vector3d & n1 = surf.normals[(i+1)*n + j];
+                const Eigen::Vector3d & p1 = surf.positions[(i+1)*n + j];
+                glNormal3d(n0[0],n0[1],n0[2]);
+                glVertex3d(p0[0],p0[1],p0[2]);
+                glNormal3d(n1[0],n1[1],n1[2]);
+                glVertex3d(p1[0],p1[1],p1[2]);
             }
             glEnd();
         }
@@ -465,7 +513,15 @@ InbetweenEdge::InbetweenEdge(VAC * vac, XmlStreamReader & xml) :
 
     QList<Eigen::Vector2d>  InbetweenEdge::getGeometry(Time time)
     {
+        QList<Eigen::Vector2d> beforeSampling;
+        QList<Eigen::Vector2d> afterSampling;
+        sampleKeyGeometry_(beforeSampling, afterSampling);
+        return interpolateSamplings_(beforeSampling, afterSampling, time);
+    }
 
+    void InbetweenEdge::sampleKeyGeometry_(QList<Eigen::Vector2d> & beforeSampling,
+                                           QList<Eigen::Vector2d> & afterSampling) const
+    {
         // Compute lengths of key paths
         double beforeLength = 0;
         double afterLength = 0;
@@ -483,8 +539,6 @@ InbetweenEdge::InbetweenEdge(VAC * vac, XmlStreamReader & xml) :
         // Compute uniform sampling of key paths
         int minSamples = isClosed() ? 4 : 2;
         int numSamples = std::max(minSamples, (int) (maxLength/5.0) + 2);
-        QList<Eigen::Vector2d> beforeSampling;
-        QList<Eigen::Vector2d> afterSampling;
         if(isClosed())
         {
             beforeCycle_.sample(numSamples,beforeSampling);
@@ -497,18 +551,16 @@ InbetweenEdge::InbetweenEdge(VAC * vac, XmlStreamReader & xml) :
         }
         assert(beforeSampling.size() == numSamples);
         assert(afterSampling.size() == numSamples);
+    }
+
+    QList<Eigen::Vector2d> InbetweenEdge::interpolateSamplings_(
+            const QList<Eigen::Vector2d> & beforeSampling,
+            const QList<Eigen::Vector2d> & afterSampling,
+            Time time) const
+    {
+        int numSamples = beforeSampling.size();
         // Interpolate key paths
-        double t = time.floatTime(); // in [t1,t2]
-        double t1 = beforeTime().floatTime();
-        double t2 = afterTime().floatTime();
-        double dt = t2-t1;
-        double u; // in [0,1]
-        if(dt > 0)
-            u = (t-t1)/dt;
-        else if (t<t1)
-            u = 0;
-        else
-            u = 1;
+        double u = interpolationParameter_(time);
         QList<Eigen::Vector2d> sampling;
         for(int i=0; i<numSamples; ++i)
             sampling << beforeSampling[i] + u * (afterSampling[i]-beforeSampling[i]);
@@ -572,17 +624,7 @@ InbetweenEdge::InbetweenEdge(VAC * vac, XmlStreamReader & xml) :
         assert(afterSampling.size() == numSamples);
 
         // Interpolate key paths
-        double t = time.floatTime(); // in [t1,t2]
-        double t1 = beforeTime().floatTime();
-        double t2 = afterTime().floatTime();
-        double dt = t2-t1;
-        double u; // in [0,1]
-        if(dt > 0)
-            u = (t-t1)/dt;
-        else if (t<t1)
-            u = 0;
-        else
-            u = 1;
+        double u = interpolationParameter_(time);
         QList<EdgeSample> sampling;
         for(int i=0; i<numSamples; ++i)
             sampling << beforeSampling[i] + (afterSampling[i]-beforeSampling[i]) * u;
@@ -628,57 +670,100 @@ InbetweenEdge::InbetweenEdge(VAC * vac, XmlStreamReader & xml) :
         return sampling;
     }
 
-    void InbetweenEdge::getMesh(
-            View3DSettings & viewSettings,
-            QList<Eigen::Vector3d>& positions,
-            QList<Eigen::Vector3d>& normals,
-            QList<int>& indices)
+    double InbetweenEdge::interpolationParameter_(Time time) const
     {
-        computeInbetweenSurface(viewSettings);
+        double t = time.floatTime(); // in [t1,t2]
+        double t1 = beforeTime().floatTime();
+        double t2 = afterTime().floatTime();
+        double dt = t2-t1;
+        if(dt > 0)
+            return (t-t1)/dt;
+        else if (t<t1)
+            return 0;
+        else
+            return 1;
+    }
 
-        // Compute number of quads, early return if no quads
-        int m = surf_.size();
-        if (m < 2 || norm_.size() != m) {
-            return;
-        }
-        int n = surf_[0].size();
-        if (n < 2 || norm_[0].size() != n) {
-            return;
-        }
+    double InbetweenEdge::endpointWidth_(double beforeWidth, double afterWidth, double u) const
+    {
+        // Same rule as getSampling(): do not shrink edge width when edge
+        // shrink to vertex
+        if(beforePath_.type() == Path::SingleVertex)
+            return afterWidth;
+        else if(afterPath_.type() == Path::SingleVertex)
+            return beforeWidth;
+        else
+            return beforeWidth + (afterWidth-beforeWidth) * u;
+    }
 
-        // Append positions and normals
-        int p0 = positions.size() + 1; // OBJ indices start at 1
-        for (int i = 0; i < m; ++i) {
-            for (int j = 0; j < n; ++j) {
-                positions.append(surf_[i][j]);
-                normals.append(norm_[i][j]);
-            }
-        }
+    // Derivative of the sampling computed by getSampling(), with respect to a
+    // parameter in [0,1] along the edge. Key paths are sampled uniformly by
+    // arclength, hence contribute their length times their unit tangent, and
+    // warping to the animated vertices adds a constant term.
+    Eigen::Vector2d InbetweenEdge::endpointTangent_(const Eigen::Vector2d & beforeTangent,
+                                                    const Eigen::Vector2d & afterTangent,
+                                                    Time time) const
+    {
+        double u = interpolationParameter_(time);
 
-        // Append indices
-        for(int i = m-2; i >= 0; i--) {
-            int j_ = 0;
-            for(int j = 0; j < n;) {
-                if (j > 0) {
-                    indices.append( i    * n + j_ + p0);
-                    indices.append((i+1) * n + j_ + p0);
-                    indices.append((i+1) * n + j  + p0);
-                    indices.append( i    * n + j  + p0);
-                }
-                j_ = j;
-                if(j == n-1)
-                {
-                    break;
-                }
-                else
-                {
-                    j += cacheK2_;
-                    if(j >= n)
-                        j = n-1;
-                }
-            }
-            glEnd();
-        }
+        EdgeSample beforeStart = beforePath_.startSample();
+        EdgeSample afterStart = afterPath_.startSample();
+        EdgeSample beforeEnd = beforePath_.endSample();
+        EdgeSample afterEnd = afterPath_.endSample();
+        Eigen::Vector2d currentStartPos((1-u)*beforeStart.x() + u*afterStart.x(),
+                                        (1-u)*beforeStart.y() + u*afterStart.y());
+        Eigen::Vector2d currentEndPos((1-u)*beforeEnd.x() + u*afterEnd.x(),
+                                      (1-u)*beforeEnd.y() + u*afterEnd.y());
+        Eigen::Vector2d deltaStartPos = startAnimatedVertex_.pos(time) - currentStartPos;
+        Eigen::Vector2d deltaEndPos = endAnimatedVertex_.pos(time) - currentEndPos;
+
+        Eigen::Vector2d der = (1-u) * beforePath_.length() * beforeTangent +
+                              u * afterPath_.length() * afterTangent +
+                              deltaEndPos - deltaStartPos;
+        double norm = der.norm();
+        if(norm < 1e-10)
+            return Eigen::Vector2d(1,0);
+        return der/norm;
+    }
+
+    EdgeSample InbetweenEdge::startSample(Time time) const
+    {
+        if(isClosed())
+            return EdgeCell::startSample(time);
+
+        Eigen::Vector2d pos = startAnimatedVertex_.pos(time);
+        double width = endpointWidth_(beforePath_.startSample().width(),
+                                      afterPath_.startSample().width(),
+                                      interpolationParameter_(time));
+        return EdgeSample(pos[0], pos[1], width);
+    }
+
+    EdgeSample InbetweenEdge::endSample(Time time) const
+    {
+        if(isClosed())
+            return EdgeCell::endSample(time);
+
+        Eigen::Vector2d pos = endAnimatedVertex_.pos(time);
+        double width = endpointWidth_(beforePath_.endSample().width(),
+                                      afterPath_.endSample().width(),
+                                      interpolationParameter_(time));
+        return EdgeSample(pos[0], pos[1], width);
+    }
+
+    Eigen::Vector2d InbetweenEdge::startTangent(Time time) const
+    {
+        if(isClosed())
+            return EdgeCell::startTangent(time);
+
+        return endpointTangent_(beforePath_.startTangent(), afterPath_.startTangent(), time);
+    }
+
+    Eigen::Vector2d InbetweenEdge::endTangent(Time time) const
+    {
+        if(isClosed())
+            return EdgeCell::endTangent(time);
+
+        return endpointTangent_(beforePath_.endTangent(), afterPath_.endTangent(), time);
     }
 
     void InbetweenEdge::triangulate_(Time time, Triangles & out) const
@@ -707,6 +792,19 @@ InbetweenEdge::InbetweenEdge(VAC * vac, XmlStreamReader & xml) :
         }
     }
 
+    void InbetweenEdge::triangulateApproximation_(Time time, double error, Triangles & out) const
+    {
+        out.clear();
+        if (exists(time))
+        {
+            QList<EdgeSample> samples = getSampling(time);
+            LinearSpline ls(samples);
+            if(isClosed())
+                ls.makeLoop();
+            ls.triangulateApproximation(error, out);
+        }
+    }
+
     KeyCellSet InbetweenEdge::beforeCells() const
     {
         if(isClosed())
@@ -27,6 +27,7 @@
 
 #include <QList>
 #include <QPair>
+#include <QVector>
 
 namespace VectorAnimationComplex
 {
@@ -86,13 +87,43 @@ public:
 
     // Other
     QList<EdgeSample> getSampling(Time time) const; // Note: repeat start and end vertices even when closed.
+    EdgeSample startSample(Time time) const;
+    EdgeSample endSample(Time time) const;
+    Eigen::Vector2d startTangent(Time time) const;
+    Eigen::Vector2d endTangent(Time time) const;
     QList<Eigen::Vector2d> getGeometry(Time time); // Note: repeat start and end vertices even when closed.
 
-    // Appends quads to the given out parameters
-    void getMesh(View3DSettings & viewSettings,
-                 QList<Eigen::Vector3d> & positions,
-                 QList<Eigen::Vector3d> & normals,
-                 QList<int> & indices);
+    // Space-time surface swept by the edge, as a grid of numRows x numCols
+    // vertices in View3D coordinates, stored row by row: vertex (i,j) is at
+    // index i*numCols+j. Rows sample the edge at evenly spaced times, from
+    // tMin (first row) to tMax (last row). The surface has no quads if it
+    // has less than two rows or columns.
+    struct SpaceTimeSurface
+    {
+        SpaceTimeSurface() : numRows(0), numCols(0), tMin(0), tMax(0), revision(0) {}
+
+        int numRows;
+        int numCols;
+        double tMin;
+        double tMax;
+        QVector<Eigen::Vector3d> positions;
+        QVector<Eigen::Vector3d> normals; // not normalized
+
+        // Unique among all surfaces ever computed, 0 if not computed
+        quint64 revision;
+    };
+
+    // Returns the space-time surface, sampled every timeStride/k1 frame and
+    // every sampleStride*k2 sample along the edge. The cached surface is
+    // reused until clearCachedGeometry_() is called or the arguments change.
+    // Surfaces of different edges may be computed concurrently, as long as
+    // the VAC is not modified meanwhile.
+    const SpaceTimeSurface & spaceTimeSurface(const View3DSettings & viewSettings,
+                                              int timeStride = 1, int sampleStride = 1);
+
+    // Allocated from a pool of inbetween edges, aligned for Eigen (see CellPool.h)
+    static void * operator new(std::size_t size);
+    static void operator delete(void * p, std::size_t size);
 
 private:
     // Cached geometry
@@ -100,10 +131,23 @@ private:
     double cacheTimeScale_;
     int cacheK1_;
     int cacheK2_;
-    QList< QList<Eigen::Vector3d> > surf_;
-    QList< QList<Eigen::Vector3d> > norm_;
+    int cacheTimeStride_;
+    int cacheSampleStride_;
+    SpaceTimeSurface surface_;
     virtual void clearCachedGeometry_();
-    void computeInbetweenSurface(View3DSettings & viewSettings);
+    void computeSpaceTimeSurface_(const View3DSettings & viewSettings);
+    void sampleKeyGeometry_(QList<Eigen::Vector2d> & beforeSampling,
+                            QList<Eigen::Vector2d> & afterSampling) const;
+    QList<Eigen::Vector2d> interpolateSamplings_(const QList<Eigen::Vector2d> & beforeSampling,
+                                                 const QList<Eigen::Vector2d> & afterSampling,
+                                                 Time time) const;
+
+    // Helpers for getSampling() and endpoint queries of open edges
+    double interpolationParameter_(Time time) const;
+    double endpointWidth_(double beforeWidth, double afterWidth, double u) const;
+    Eigen::Vector2d endpointTangent_(const Eigen::Vector2d & beforeTangent,
+                                     const Eigen::Vector2d & afterTangent,
+                                     Time time) const;
 
     // Trusting operators
     friend class VAC;
@@ -134,6 +178,7 @@ private:
     // Implementation of triangulate
     void triangulate_(Time time, Triangles & out) const;
     void triangulate_(double width, Time time, Triangles & out) const;
+    void triangulateApproximation_(Time time, double error, Triangles & out) const;
 
 // --------- Cloning, Assigning, Copying, Serializing ----------
 
@@ -29,6 +29,7 @@
 #include "KeyEdge.h"
 #include "KeyFace.h"
 #include "InbetweenFace.h"
+#include "CellPool.h"
 #include "VAC.h"
 #include "../DevSettings.h"
 #include "../Global.h"
@@ -203,7 +204,8 @@ void CALLBACK offlineTessCombine(GLdouble coords[3],
 
 typedef std::vector< std::vector< std::array<GLdouble, 3> > > PolygonData;
 
-PolygonData createPolygonData(const QList<AnimatedCycle> & cycles, Time time)
+// If error is positive, the sampling of each cycle is simplified within error
+PolygonData createPolygonData(const QList<AnimatedCycle> & cycles, Time time, double error = 0)
 {
     PolygonData vertices;
     for(int k=0; k<cycles.size(); ++k)      // for each cycle
@@ -213,6 +215,8 @@ PolygonData createPolygonData(const QList<AnimatedCycle> & cycles, Time time)
         QList<Eigen::Vector2d> sampling;
         AnimatedCycle cycle = cycles[k];
         cycle.sample(time, sampling);
+        if(error > 0)
+            FaceCell::simplifyOutline(sampling, error);
         for(int j=0; j<sampling.size(); ++j)
         {
             std::array<GLdouble, 3> a = {sampling[j][0], sampling[j][1], 0};
@@ -223,11 +227,11 @@ PolygonData createPolygonData(const QList<AnimatedCycle> & cycles, Time time)
     return vertices;
 }
 
-void computeTrianglesFromCycles(const QList<AnimatedCycle> & cycles, Triangles & triangles, Time time)
+void computeTrianglesFromCycles(const QList<AnimatedCycle> & cycles, Triangles & triangles, Time time, double error = 0)
 {
 
     // Creating polygon data for GLU tesselator
-    PolygonData vertices = createPolygonData(cycles,time);
+    PolygonData vertices = createPolygonData(cycles, time, error);
 
     // Creating the GLU tesselation object
     if(!tobjOffline)
@@ -414,6 +418,13 @@ void InbetweenFace::triangulate_(Time time, Triangles & out) const
         computeTrianglesFromCycles(cycles_, out, time);
 }
 
+void InbetweenFace::triangulateApproximation_(Time time, double error, Triangles & out) const
+{
+    out.clear();
+    if (exists(time))
+        computeTrianglesFromCycles(cycles_, out, time, error);
+}
+
 QList<QList<Eigen::Vector2d> > InbetweenFace::getSampling(Time time) const
 {
     QList<QList<Eigen::Vector2d> > res;
@@ -686,6 +697,25 @@ InbetweenFace * InbetweenFace::clone()
     return new InbetweenFace(this);
 }
 
+namespace
+{
+CellPool & inbetweenFacePool()
+{
+    static CellPool * res = new CellPool(sizeof(InbetweenFace));
+    return *res;
+}
+}
+
+void * InbetweenFace::operator new(std::size_t size)
+{
+    return inbetweenFacePool().allocate(size);
+}
+
+void InbetweenFace::operator delete(void * p, std::size_t size)
+{
+    inbetweenFacePool().deallocate(p, size);
+}
+
 void InbetweenFace::remapPointers(VAC * newVAC)
 {
     Cell::remapPointers(newVAC);
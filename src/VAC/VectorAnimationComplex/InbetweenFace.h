@@ -62,6 +62,10 @@ public:
     QSet<KeyFace*> beforeFaces() const;
     QSet<KeyFace*> afterFaces() const;
 
+    // Allocated from a pool of inbetween faces, aligned for Eigen (see CellPool.h)
+    static void * operator new(std::size_t size);
+    static void operator delete(void * p, std::size_t size);
+
 private:
     // Trusting operators
     friend class VAC;
@@ -82,6 +86,7 @@ private:
 
     // Implementation of triangulate
     void triangulate_(Time time, Triangles & out) const;
+    void triangulateApproximation_(Time time, double error, Triangles & out) const;
 
 // --------- Cloning, Assigning, Copying, Serializing ----------
 
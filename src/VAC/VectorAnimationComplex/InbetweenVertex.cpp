@@ -15,6 +15,7 @@
 // limitations under the License.
 
 #include "InbetweenVertex.h"
+#include "CellPool.h"
 #include "KeyVertex.h"
 
 #include "VAC.h"
@@ -79,6 +80,25 @@ InbetweenVertex::InbetweenVertex(VAC * vac, QTextStream & in) :
     in >> field >> tmp_->before;
     in >> field >> tmp_->after;
 }
+
+namespace
+{
+CellPool & inbetweenVertexPool()
+{
+    static CellPool * res = new CellPool(sizeof(InbetweenVertex));
+    return *res;
+}
+}
+
+void * InbetweenVertex::operator new(std::size_t size)
+{
+    return inbetweenVertexPool().allocate(size);
+}
+
+void InbetweenVertex::operator delete(void * p, std::size_t size)
+{
+    inbetweenVertexPool().deallocate(p, size);
+}
 void InbetweenVertex::read2ndPass()
 {
     // Base classes
@@ -56,6 +56,9 @@ public:
     */
     //KeyCell *insertKeyFrame(Time time);
 
+    // Allocated from a pool of inbetween vertices, aligned for Eigen (see CellPool.h)
+    static void * operator new(std::size_t size);
+    static void operator delete(void * p, std::size_t size);
 
 private:
     // Trusting operators
@@ -82,7 +82,9 @@ void KeyCell::setTime(Time time)
 
     if(minTime < time_ && time_ < maxTime)
     {
+        vac()->setDrawingChanged_(this);
         time_ = time;
+        vac()->timeIndex_.invalidate();
         processGeometryChanged_();
     }
 }
@@ -18,6 +18,7 @@
 
 #include "InbetweenEdge.h"
 #include "KeyEdge.h"
+#include "CellPool.h"
 #include "KeyVertex.h"
 #include "VAC.h"
 #include "Intersection.h"
@@ -115,7 +116,10 @@ KeyEdge::KeyEdge(VAC * vac, XmlStreamReader & xml)  :
     else
         tmp_->right = -1;
 
-    geometry_ = EdgeGeometry::read(xml);
+    // The curve is only parsed in read2ndPass(), which VAC::read() calls
+    // concurrently for all cells, since this is the bulk of the loading time
+    tmp_->curve = xml.attributes().value("curve").toString();
+    geometry_ = 0;
 }
 
 KeyEdge::KeyEdge(VAC * vac, QTextStream & in) :
@@ -162,6 +166,8 @@ void KeyEdge::read2ndPass()
         endVertex_ = 0;
 
     // Geometry
+    if(!tmp_->curve.isNull())
+        geometry_ = EdgeGeometry::read(QStringRef(&tmp_->curve));
     if(isClosed())
         geometry_->makeLoop();
 
@@ -236,6 +242,25 @@ KeyEdge::~KeyEdge()
     delete geometry_;
 }
 
+namespace
+{
+CellPool & keyEdgePool()
+{
+    static CellPool * res = new CellPool(sizeof(KeyEdge));
+    return *res;
+}
+}
+
+void * KeyEdge::operator new(std::size_t size)
+{
+    return keyEdgePool().allocate(size);
+}
+
+void KeyEdge::operator delete(void * p, std::size_t size)
+{
+    keyEdgePool().deallocate(p, size);
+}
+
 VertexCellSet KeyEdge::startVertices() const
 {
     VertexCellSet res;
@@ -297,12 +322,48 @@ void KeyEdge::triangulate_(double width, Time time, Triangles & out) const
         geometry()->triangulate(width, out);
 }
 
+void KeyEdge::triangulateApproximation_(Time time, double error, Triangles & out) const
+{
+    out.clear();
+    if (exists(time))
+        geometry()->triangulateApproximation(error, out);
+}
+
 QList<EdgeSample> KeyEdge::getSampling(Time /*time*/) const
 {
     return geometry()->edgeSampling();
 }
 
+EdgeSample KeyEdge::startSample(Time /*time*/) const
+{
+    return geometry()->leftPos();
+}
+
+EdgeSample KeyEdge::endSample(Time /*time*/) const
+{
+    return geometry()->rightPos();
+}
+
+Eigen::Vector2d KeyEdge::startTangent(Time /*time*/) const
+{
+    return geometry()->der(0);
+}
+
+Eigen::Vector2d KeyEdge::endTangent(Time /*time*/) const
+{
+    return geometry()->der(geometry()->length());
+}
+
 void KeyEdge::correctGeometry()
+{
+    if(geometry())
+    {
+        correctGeometry_();
+        processGeometryChanged_();
+    }
+}
+
+void KeyEdge::correctGeometry_()
 {
     if(geometry())
     {
@@ -317,8 +378,6 @@ void KeyEdge::correctGeometry()
         {
             geometry()->setLeftRightPos(startVertex()->pos(), endVertex()->pos());
         }
-
-        processGeometryChanged_();
     }
 }
 
@@ -328,6 +387,16 @@ void KeyEdge::setWidth(double newWidth)
     processGeometryChanged_();
 }
 
+void KeyEdge::setSamplingTolerance(double tolerance)
+{
+    // Uniformly sampled edges staying uniform are left untouched
+    if(tolerance > 0 || geometry()->samplingTolerance() > 0)
+    {
+        geometry()->setSamplingTolerance(tolerance);
+        processGeometryChanged_();
+    }
+}
+
 double KeyEdge::updateSculpt(double x, double y, double radius)
 {
     sculptRadius_ = radius;
@@ -66,7 +66,12 @@ public:
     EdgeGeometry * geometry() const { return geometry_; }
     void correctGeometry();
     void setWidth(double newWidth);
+    void setSamplingTolerance(double tolerance); // see EdgeGeometry
     QList<EdgeSample> getSampling(Time time) const;
+    EdgeSample startSample(Time time) const;
+    EdgeSample endSample(Time time) const;
+    Eigen::Vector2d startTangent(Time time) const;
+    Eigen::Vector2d endTangent(Time time) const;
 
 
     // Sculpting
@@ -127,12 +132,18 @@ private:
     double remainingRadiusLeft_;
     double remainingRadiusRight_;
 
+    // Implementation of correctGeometry, without notifying dependent cells
+    void correctGeometry_();
+
     // Implementation of triangulate
     void triangulate_(Time time, Triangles & out) const;
     void triangulate_(double width, Time time, Triangles & out) const;
+    void triangulateApproximation_(Time time, double error, Triangles & out) const;
 
-    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
-
+public:
+    // Allocated from a pool of key edges, aligned for Eigen (see CellPool.h)
+    static void * operator new(std::size_t size);
+    static void operator delete(void * p, std::size_t size);
 
 // --------- Cloning, Assigning, Copying, Serializing ----------
 
@@ -158,7 +169,7 @@ protected:
             {return new KeyEdge(g, in);}  };
       protected: virtual void read2ndPass();
 private:
-    struct TempRead { int left, right; };
+    struct TempRead { int left, right; QString curve; };
     TempRead * tmp_;
 };
 
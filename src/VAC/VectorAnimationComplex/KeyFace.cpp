@@ -30,6 +30,7 @@
 #include "KeyVertex.h"
 #include "KeyEdge.h"
 #include "KeyFace.h"
+#include "CellPool.h"
 #include "../DevSettings.h"
 #include "../Global.h"
 
@@ -200,7 +201,9 @@ void CALLBACK offlineTessCombine(GLdouble coords[3],
 
 typedef std::vector< std::vector< std::array<GLdouble, 3> > > PolygonData;
 
-PolygonData createPolygonData(const QList<Cycle> & cycles)
+// If error is positive, the sampling of each edge is simplified within
+// error, keeping the vertices where edges meet
+PolygonData createPolygonData(const QList<Cycle> & cycles, double error = 0)
 {
     PolygonData vertices;
     for(int k=0; k<cycles.size(); ++k)      // for each cycle
@@ -209,7 +212,14 @@ PolygonData createPolygonData(const QList<Cycle> & cycles)
 
         for(int i=0; i<cycles[k].size(); ++i) // for each edge in the cycle
         {
-            QList<Eigen::Vector2d> & sampling = cycles[k][i].edge->geometry()->sampling();
+            QList<Eigen::Vector2d> & edgeSampling = cycles[k][i].edge->geometry()->sampling();
+            QList<Eigen::Vector2d> simplifiedSampling;
+            if(error > 0)
+            {
+                simplifiedSampling = edgeSampling;
+                FaceCell::simplifyOutline(simplifiedSampling, error);
+            }
+            const QList<Eigen::Vector2d> & sampling = (error > 0) ? simplifiedSampling : edgeSampling;
             if(cycles[k][i].side)
             {
                 int last = sampling.size()-1;
@@ -246,11 +256,11 @@ PolygonData createPolygonData(const QList<Cycle> & cycles)
     return vertices;
 }
 
-void computeTrianglesFromCycles(const QList<Cycle> & cycles, Triangles & triangles)
+void computeTrianglesFromCycles(const QList<Cycle> & cycles, Triangles & triangles, double error = 0)
 {
 
     // Creating polygon data for GLU tesselator
-    PolygonData vertices = createPolygonData(cycles);
+    PolygonData vertices = createPolygonData(cycles, error);
 
     // Creating the GLU tesselation object
     if(!tobjOffline)
@@ -412,6 +422,13 @@ void KeyFace::triangulate_(Time time, Triangles & out) const
         computeTrianglesFromCycles(cycles_, out);
 }
 
+void KeyFace::triangulateApproximation_(Time time, double error, Triangles & out) const
+{
+    out.clear();
+    if (exists(time))
+        computeTrianglesFromCycles(cycles_, out, error);
+}
+
 QList<QList<Eigen::Vector2d> > KeyFace::getSampling(Time /*time*/) const
 {
     QList<QList<Eigen::Vector2d> > res;
@@ -529,6 +546,25 @@ CellSet KeyFace::spatialBoundary() const
     return res;
 }
 
+namespace
+{
+CellPool & keyFacePool()
+{
+    static CellPool * res = new CellPool(sizeof(KeyFace));
+    return *res;
+}
+}
+
+void * KeyFace::operator new(std::size_t size)
+{
+    return keyFacePool().allocate(size);
+}
+
+void KeyFace::operator delete(void * p, std::size_t size)
+{
+    keyFacePool().deallocate(p, size);
+}
+
 void KeyFace::updateBoundary_impl(KeyEdge * oldEdge, const KeyEdgeList & newEdges)
 {
     for(int i=0; i<cycles_.size(); ++i)
@@ -629,4 +665,42 @@ void PreviewKeyFace::draw(ViewSettings & /*viewSettings*/)
     triangles_.draw();
 }
 
+bool isCycleContainedInFace(const Cycle & cycle, const PreviewKeyFace & face)
+{
+    // Get edges involved in cycle
+    KeyEdgeSet cycleEdges = cycle.cells();
+
+    // Compute total length of edges
+    double totalLength = 0;
+    foreach (KeyEdge * edge, cycleEdges)
+        totalLength += edge->geometry()->length();
+
+    // Compute percentage of edges inside face, based on approximately N samples
+    double N = 100;
+    double ds = totalLength / N;
+    double nInside = 0;
+    double nOutside = 0;
+    foreach (KeyEdge * edge, cycleEdges)
+    {
+        EdgeGeometry * geometry = edge->geometry();
+        double L = geometry->length();
+        for(double s=0; s<L; s+=ds)
+        {
+            Eigen::Vector2d p = geometry->pos2d(s);
+            if(face.intersects(p[0],p[1]))
+            {
+                nInside++;
+            }
+            else
+            {
+                nOutside++;
+            }
+        }
+    }
+    if(nInside > nOutside)
+        return true;
+    else
+        return false;
+}
+
 }
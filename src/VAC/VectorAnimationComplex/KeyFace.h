@@ -71,7 +71,9 @@ public:
     // Boundary
     CellSet spatialBoundary() const;
 
-    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    // Allocated from a pool of key faces, aligned for Eigen (see CellPool.h)
+    static void * operator new(std::size_t size);
+    static void operator delete(void * p, std::size_t size);
 
 private:
     friend class VAC;
@@ -97,6 +99,7 @@ private:
 
     // Implementation of triangulate
     void triangulate_(Time time, Triangles & out) const;
+    void triangulateApproximation_(Time time, double error, Triangles & out) const;
 
 // --------- Cloning, Assigning, Copying, Serializing ----------
 
@@ -156,6 +159,10 @@ private:
     Triangles triangles_;
 };
 
+// Returns whether most of the cycle is within the face, which is used to
+// decide whether the cycle should be a hole of the face
+bool isCycleContainedInFace(const Cycle & cycle, const PreviewKeyFace & face);
+
 }
 
 #endif
@@ -15,6 +15,7 @@
 // limitations under the License.
 
 #include "KeyVertex.h"
+#include "CellPool.h"
 #include "KeyEdge.h"
 #include "InbetweenVertex.h"
 #include "EdgeGeometry.h"
@@ -244,6 +245,25 @@ void KeyVertex::computePosFromEdges()
         setPos(res / (double) n);
 }
 
+namespace
+{
+CellPool & keyVertexPool()
+{
+    static CellPool * res = new CellPool(sizeof(KeyVertex));
+    return *res;
+}
+}
+
+void * KeyVertex::operator new(std::size_t size)
+{
+    return keyVertexPool().allocate(size);
+}
+
+void KeyVertex::operator delete(void * p, std::size_t size)
+{
+    keyVertexPool().deallocate(p, size);
+}
+
 void KeyVertex::correctEdgesGeometry()
 {
     CellSet ss = spatialStar();
@@ -55,7 +55,9 @@ public:
     KeyVertexList beforeVertices() const;
     KeyVertexList afterVertices() const;
 
-    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    // Allocated from a pool of key vertices, aligned for Eigen (see CellPool.h)
+    static void * operator new(std::size_t size);
+    static void operator delete(void * p, std::size_t size);
 
 
 private:
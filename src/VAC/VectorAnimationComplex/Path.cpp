@@ -570,6 +570,58 @@ void Path::sample(int numSamples, QList<Eigen::Vector2d> & out) const
     }
 }
 
+EdgeSample Path::startSample() const
+{
+    assert(isValid());
+
+    if(type() == SingleVertex)
+    {
+        Eigen::Vector2d pos = singleVertex()->pos();
+        return EdgeSample(pos[0],pos[1],0);
+    }
+    else
+    {
+        KeyHalfedge he = halfedges_.first();
+        return he.startSample(he.time());
+    }
+}
+
+EdgeSample Path::endSample() const
+{
+    assert(isValid());
+
+    if(type() == SingleVertex)
+    {
+        Eigen::Vector2d pos = singleVertex()->pos();
+        return EdgeSample(pos[0],pos[1],0);
+    }
+    else
+    {
+        KeyHalfedge he = halfedges_.last();
+        return he.endSample(he.time());
+    }
+}
+
+Eigen::Vector2d Path::startTangent() const
+{
+    assert(isValid());
+
+    if(type() == SingleVertex)
+        return Eigen::Vector2d(0,0);
+    else
+        return KeyHalfedge(halfedges_.first()).leftDer();
+}
+
+Eigen::Vector2d Path::endTangent() const
+{
+    assert(isValid());
+
+    if(type() == SingleVertex)
+        return Eigen::Vector2d(0,0);
+    else
+        return KeyHalfedge(halfedges_.last()).rightDer();
+}
+
 Path Path::reversed() const
 {
     Path res;
@@ -98,6 +98,14 @@ public:
     void sample(int numSamples, QList<Eigen::Vector2d> & out) const;
     void sample(int numSamples, QList<EdgeSample> & out) const;
 
+    // Endpoints and unit tangents of the path, evaluated from its first and
+    // last halfedges only. Tangents are oriented along the path, and are null
+    // for a single vertex path.
+    EdgeSample startSample() const;
+    EdgeSample endSample() const;
+    Eigen::Vector2d startTangent() const;
+    Eigen::Vector2d endTangent() const;
+
     // Reversed path
     Path reversed() const;
 
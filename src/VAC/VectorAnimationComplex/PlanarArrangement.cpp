@@ -0,0 +1,467 @@
+// Copyright (C) 2012-2019 The VPaint Developers.
+// See the COPYRIGHT file at the top-level directory of this distribution
+// and at https://github.com/dalboris/vpaint/blob/master/COPYRIGHT
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "PlanarArrangement.h"
+#include "VAC.h"
+#include "KeyEdge.h"
+#include "KeyVertex.h"
+#include "KeyHalfedge.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace VectorAnimationComplex
+{
+
+namespace
+{
+
+// Maximum number of cells of the point location grid, in each dimension
+const int MAX_GRID_SIZE = 64;
+
+// Maximum number of grid cells covered by an orbit stored in the grid
+const int MAX_GRID_CELLS_PER_ORBIT = 16;
+
+int sideIndex(bool side)
+{
+    return side ? 1 : 0;
+}
+
+bool contains(const BoundingBox & bb, double x, double y)
+{
+    return !bb.isEmpty() &&
+           bb.xMin() <= x && x <= bb.xMax() &&
+           bb.yMin() <= y && y <= bb.yMax();
+}
+
+bool contains(const BoundingBox & bb, const BoundingBox & other)
+{
+    return bb.united(other) == bb;
+}
+
+}
+
+PlanarArrangement::PlanarArrangement() :
+    isValid_(false),
+    vac_(0),
+    time_(),
+    revision_(0),
+    nextOrbitId_(0),
+    isGridValid_(false),
+    gridSize_(0)
+{
+}
+
+void PlanarArrangement::invalidate()
+{
+    isValid_ = false;
+}
+
+void PlanarArrangement::clear_()
+{
+    edges_.clear();
+    vertexEdges_.clear();
+    orbits_.clear();
+    unwalked_.clear();
+    isGridValid_ = false;
+}
+
+void PlanarArrangement::update(VAC * vac, Time time)
+{
+    // Rebuild from scratch if needed
+    QSet<int> changedCells;
+    if(!isValid_ || vac != vac_ || !(time == time_) ||
+       !vac->changedCellsSince(revision_, changedCells))
+    {
+        clear_();
+        isValid_ = true;
+        vac_ = vac;
+        time_ = time;
+        revision_ = vac->drawingRevision();
+        KeyEdgeList edges = vac->instantEdges(time);
+        foreach(KeyEdge * edge, edges)
+            insertEdge_(edge);
+        walkOrbits_();
+        return;
+    }
+    revision_ = vac->drawingRevision();
+
+    // Update changed edges, and find the vertices where the orbits may have
+    // changed. Note that removed cells must not be dereferenced.
+    QSet<int> changedVertices;
+    QList<KeyEdge *> insertedEdges;
+    foreach(int id, changedCells)
+    {
+        auto it = edges_.find(id);
+        if(it != edges_.end())
+        {
+            changedVertices << it->startVertexId << it->endVertexId;
+            removeEdge_(id);
+        }
+        if(vertexEdges_.contains(id))
+        {
+            changedVertices << id;
+        }
+
+        Cell * cell = vac->getCell(id);
+        if(cell && cell->exists(time))
+        {
+            if(KeyEdge * edge = cell->toKeyEdge())
+                insertedEdges << edge;
+            else if(cell->toKeyVertex())
+                changedVertices << id;
+        }
+    }
+    foreach(KeyEdge * edge, insertedEdges)
+    {
+        insertEdge_(edge);
+        const EdgeRecord & record = edges_[edge->id()];
+        changedVertices << record.startVertexId << record.endVertexId;
+    }
+    changedVertices.remove(-1);
+
+    // Remove the orbits going through these vertices, and walk them again
+    foreach(int vertexId, changedVertices)
+    {
+        foreach(int edgeId, vertexEdges_.value(vertexId))
+        {
+            const EdgeRecord & record = edges_[edgeId];
+            removeOrbit_(record.orbitIds[0]);
+            removeOrbit_(record.orbitIds[1]);
+        }
+    }
+    walkOrbits_();
+}
+
+void PlanarArrangement::insertEdge_(KeyEdge * edge)
+{
+    EdgeRecord record;
+    record.edge = edge;
+    record.startVertexId = edge->startVertex() ? edge->startVertex()->id() : -1;
+    record.endVertexId = edge->endVertex() ? edge->endVertex()->id() : -1;
+    record.orbitIds[0] = -1;
+    record.orbitIds[1] = -1;
+
+    const int id = edge->id();
+    edges_.insert(id, record);
+    if(record.startVertexId != -1)
+        vertexEdges_[record.startVertexId].insert(id);
+    if(record.endVertexId != -1)
+        vertexEdges_[record.endVertexId].insert(id);
+    unwalked_ << HalfedgeId(id, false) << HalfedgeId(id, true);
+}
+
+void PlanarArrangement::removeEdge_(int edgeId)
+{
+    auto it = edges_.find(edgeId);
+    if(it == edges_.end())
+        return;
+
+    removeOrbit_(it->orbitIds[0]);
+    removeOrbit_(it->orbitIds[1]);
+    for(int vertexId: {it->startVertexId, it->endVertexId})
+    {
+        auto jt = vertexEdges_.find(vertexId);
+        if(jt != vertexEdges_.end())
+        {
+            jt->remove(edgeId);
+            if(jt->isEmpty())
+                vertexEdges_.erase(jt);
+        }
+    }
+    unwalked_.remove(HalfedgeId(edgeId, false));
+    unwalked_.remove(HalfedgeId(edgeId, true));
+    edges_.erase(it);
+}
+
+void PlanarArrangement::removeOrbit_(int orbitId)
+{
+    auto it = orbits_.find(orbitId);
+    if(it == orbits_.end())
+        return;
+
+    // Its halfedges must be walked again. Only IDs are used here, since
+    // the edges of the orbit may have been deleted.
+    foreach(const HalfedgeId & h, it->halfedgeIds)
+    {
+        auto jt = edges_.find(h.first);
+        if(jt != edges_.end())
+        {
+            jt->orbitIds[sideIndex(h.second)] = -1;
+            unwalked_ << h;
+        }
+    }
+    orbits_.erase(it);
+    isGridValid_ = false;
+}
+
+void PlanarArrangement::walkOrbits_()
+{
+    while(!unwalked_.isEmpty())
+    {
+        const HalfedgeId h0Id = *unwalked_.begin();
+        KeyEdge * edge = edges_[h0Id.first].edge;
+        const KeyHalfedge h0(edge, h0Id.second);
+
+        Orbit orbit;
+        orbit.area = 0;
+        orbit.isPreviewComputed = false;
+        orbit.isFaceComputed = false;
+
+        if(edge->isClosed())
+        {
+            unwalked_.remove(h0Id);
+            orbit.halfedgeIds << h0Id;
+            KeyEdgeSet edgeSet;
+            edgeSet << edge;
+            orbit.cycle = Cycle(edgeSet);
+        }
+        else
+        {
+            // Follow next() until back to h0. The walk is stopped if it
+            // reaches a halfedge already walked, which can only happen if
+            // next() is not a permutation (e.g., tangent edges).
+            QList<KeyHalfedge> halfedges;
+            KeyHalfedge h = h0;
+            bool isClosed = false;
+            const int maxIter = 2 * edges_.size() + 2;
+            for(int i=0; i<maxIter; ++i)
+            {
+                const HalfedgeId hId(h.edge->id(), h.side);
+                if(!unwalked_.contains(hId))
+                    break;
+                unwalked_.remove(hId);
+                orbit.halfedgeIds << hId;
+                halfedges << h;
+
+                h = h.next();
+                if(h == h0)
+                {
+                    isClosed = true;
+                    break;
+                }
+            }
+            if(isClosed)
+                orbit.cycle = Cycle(halfedges);
+        }
+
+        if(orbit.cycle.isValid())
+            computeGeometry_(orbit);
+
+        const int orbitId = nextOrbitId_++;
+        foreach(const HalfedgeId & h, orbit.halfedgeIds)
+            edges_[h.first].orbitIds[sideIndex(h.second)] = orbitId;
+        orbits_.insert(orbitId, orbit);
+        isGridValid_ = false;
+    }
+}
+
+void PlanarArrangement::computeGeometry_(Orbit & orbit) const
+{
+    // Signed area (shoelace formula) and bounding box of the concatenated
+    // samplings of the halfedges of the orbit
+    double area = 0;
+    BoundingBox bb;
+    bool isFirst = true;
+    double x0 = 0, y0 = 0, xPrev = 0, yPrev = 0;
+    foreach(const HalfedgeId & h, orbit.halfedgeIds)
+    {
+        const QList<EdgeSample> sampling = edges_[h.first].edge->getSampling(time_);
+        const int n = sampling.size();
+        for(int i=0; i<n; ++i)
+        {
+            const EdgeSample & s = sampling[h.second ? i : n-1-i];
+            if(isFirst)
+            {
+                x0 = s.x();
+                y0 = s.y();
+                isFirst = false;
+            }
+            else
+            {
+                area += xPrev*s.y() - s.x()*yPrev;
+            }
+            xPrev = s.x();
+            yPrev = s.y();
+            bb.unite(BoundingBox(s.x(), s.y()));
+        }
+    }
+    area += xPrev*y0 - x0*yPrev;
+
+    orbit.area = 0.5 * area;
+    orbit.boundingBox = bb;
+}
+
+bool PlanarArrangement::isFaceOrbit_(const Orbit & orbit) const
+{
+    return orbit.cycle.isValid() && orbit.area < 0;
+}
+
+const PreviewKeyFace & PlanarArrangement::preview_(Orbit & orbit)
+{
+    if(!orbit.isPreviewComputed)
+    {
+        orbit.preview = PreviewKeyFace(orbit.cycle);
+        orbit.isPreviewComputed = true;
+    }
+    return orbit.preview;
+}
+
+const PreviewKeyFace & PlanarArrangement::face_(Orbit & orbit)
+{
+    if(orbit.isFaceComputed)
+        return orbit.face;
+
+    // Candidate holes: external boundaries of other connected components
+    // within the bounding box of the face, largest first
+    QSet<int> edgeIds;
+    foreach(const HalfedgeId & h, orbit.halfedgeIds)
+        edgeIds << h.first;
+    QList<QPair<double, int> > candidates;
+    for(auto it = orbits_.cbegin(); it != orbits_.cend(); ++it)
+    {
+        const Orbit & other = *it;
+        if(!other.cycle.isValid() || other.area <= 0 ||
+           !contains(orbit.boundingBox, other.boundingBox))
+        {
+            continue;
+        }
+        bool sharesEdges = false;
+        foreach(const HalfedgeId & h, other.halfedgeIds)
+        {
+            if(edgeIds.contains(h.first))
+            {
+                sharesEdges = true;
+                break;
+            }
+        }
+        if(!sharesEdges)
+            candidates << qMakePair(-other.area, it.key());
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    // Add those contained in the face. Since larger holes are added first,
+    // components nested within holes are not added.
+    orbit.face = preview_(orbit);
+    for(int i=0; i<candidates.size(); ++i)
+    {
+        const Cycle & hole = orbits_[candidates[i].second].cycle;
+        if(isCycleContainedInFace(hole, orbit.face))
+            orbit.face << hole;
+    }
+    orbit.isFaceComputed = true;
+    return orbit.face;
+}
+
+void PlanarArrangement::updateGrid_()
+{
+    if(isGridValid_)
+        return;
+
+    grid_.clear();
+    largeOrbitIds_.clear();
+    gridBoundingBox_ = BoundingBox();
+    int numFaceOrbits = 0;
+    for(auto it = orbits_.begin(); it != orbits_.end(); ++it)
+    {
+        // Orbits have changed, so any face may have gained or lost holes
+        it->isFaceComputed = false;
+        it->face.clear();
+
+        if(isFaceOrbit_(*it))
+        {
+            gridBoundingBox_.unite(it->boundingBox);
+            ++numFaceOrbits;
+        }
+    }
+
+    gridSize_ = std::max(1, std::min(MAX_GRID_SIZE, (int) std::ceil(std::sqrt((double) numFaceOrbits))));
+    grid_.resize(gridSize_ * gridSize_);
+    if(numFaceOrbits > 0)
+    {
+        const double w = gridBoundingBox_.width();
+        const double h = gridBoundingBox_.height();
+        auto cellX = [this, w](double x) {
+            return w > 0 ? std::max(0, std::min(gridSize_-1, (int) ((x - gridBoundingBox_.xMin()) / w * gridSize_))) : 0;
+        };
+        auto cellY = [this, h](double y) {
+            return h > 0 ? std::max(0, std::min(gridSize_-1, (int) ((y - gridBoundingBox_.yMin()) / h * gridSize_))) : 0;
+        };
+        for(auto it = orbits_.cbegin(); it != orbits_.cend(); ++it)
+        {
+            if(!isFaceOrbit_(*it))
+                continue;
+
+            const BoundingBox & bb = it->boundingBox;
+            const int i1 = cellX(bb.xMin());
+            const int i2 = cellX(bb.xMax());
+            const int j1 = cellY(bb.yMin());
+            const int j2 = cellY(bb.yMax());
+            if((i2-i1+1) * (j2-j1+1) > MAX_GRID_CELLS_PER_ORBIT)
+            {
+                largeOrbitIds_ << it.key();
+            }
+            else
+            {
+                for(int j=j1; j<=j2; ++j)
+                    for(int i=i1; i<=i2; ++i)
+                        grid_[j*gridSize_ + i] << it.key();
+            }
+        }
+    }
+
+    isGridValid_ = true;
+}
+
+const PreviewKeyFace * PlanarArrangement::faceAt(double x, double y)
+{
+    updateGrid_();
+    if(!contains(gridBoundingBox_, x, y))
+        return 0;
+
+    // Candidate orbits
+    const double w = gridBoundingBox_.width();
+    const double h = gridBoundingBox_.height();
+    const int i = w > 0 ? std::min(gridSize_-1, (int) ((x - gridBoundingBox_.xMin()) / w * gridSize_)) : 0;
+    const int j = h > 0 ? std::min(gridSize_-1, (int) ((y - gridBoundingBox_.yMin()) / h * gridSize_)) : 0;
+    QVector<int> candidates = grid_[j*gridSize_ + i] + largeOrbitIds_;
+
+    // The face containing (x,y) is bounded by the smallest face orbit
+    // containing (x,y)
+    Orbit * res = 0;
+    double resArea = std::numeric_limits<double>::max();
+    foreach(int orbitId, candidates)
+    {
+        Orbit & orbit = orbits_[orbitId];
+        if(-orbit.area < resArea &&
+           contains(orbit.boundingBox, x, y) &&
+           preview_(orbit).intersects(x, y))
+        {
+            res = &orbit;
+            resArea = -orbit.area;
+        }
+    }
+    if(!res)
+        return 0;
+
+    // Prefer the face with its holes, unless (x,y) is in one of its holes,
+    // which can only happen if the faces within this hole are not valid
+    const PreviewKeyFace & face = face_(*res);
+    return face.intersects(x, y) ? &face : &res->preview;
+}
+
+}
@@ -0,0 +1,136 @@
+// Copyright (C) 2012-2019 The VPaint Developers.
+// See the COPYRIGHT file at the top-level directory of this distribution
+// and at https://github.com/dalboris/vpaint/blob/master/COPYRIGHT
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef VAC_PLANAR_ARRANGEMENT_H
+#define VAC_PLANAR_ARRANGEMENT_H
+
+// PlanarArrangement: the faces of the planar map formed by the key edges of
+// a VAC at a given time, used by the paint bucket to find, under the mouse
+// cursor, the face that painting would create.
+//
+// Key edges are seen as pairs of halfedges, and the faces of the planar map
+// as the orbits of KeyHalfedge::next(), i.e. the cycles obtained by always
+// turning the most to one side at vertices. Orbits are computed once and
+// kept up to date incrementally: when a key edge is inserted, removed, or
+// changed (see VAC::changedCellsSince()), only the orbits going through its
+// end vertices are walked again.
+//
+// Orbits are oriented such that the face they bound is on their right in
+// scene coordinates, i.e. their signed area is negative. Orbits with a
+// positive signed area are the external boundaries of connected components,
+// seen from outside, and are the candidate holes of the faces enclosing
+// them.
+//
+// Point location uses a uniform grid over the bounding boxes of face
+// orbits, so that only the few orbits near the cursor are tested, and the
+// containing face is the smallest of them. Triangulations of orbits and
+// holes of faces are computed on first use and kept until the orbits
+// change, so that moving the cursor within a face costs no triangulation.
+//
+// The arrangement is rebuilt from scratch when the time or the VAC changes,
+// or when the changes since the last update are not known anymore.
+
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QSet>
+#include <QVector>
+#include "../TimeDef.h"
+#include "BoundingBox.h"
+#include "Cycle.h"
+#include "KeyFace.h"
+
+namespace VectorAnimationComplex
+{
+
+class VAC;
+
+class PlanarArrangement
+{
+public:
+    PlanarArrangement();
+
+    // Mark the arrangement as out of date
+    void invalidate();
+
+    // Bring the arrangement up to date with the key edges of vac at the
+    // given time
+    void update(VAC * vac, Time time);
+
+    // Returns the face containing (x,y), i.e. its external boundary followed
+    // by its holes, or null if there is none. The arrangement must be up to
+    // date, and the returned face is valid until the next update.
+    const PreviewKeyFace * faceAt(double x, double y);
+
+private:
+    typedef QPair<int, bool> HalfedgeId; // edge ID, side
+
+    struct EdgeRecord
+    {
+        KeyEdge * edge;
+        int startVertexId; // -1 if closed
+        int endVertexId;   // -1 if closed
+        int orbitIds[2];   // for each side, -1 if not walked yet
+    };
+
+    struct Orbit
+    {
+        QList<HalfedgeId> halfedgeIds;
+        Cycle cycle; // invalid if the orbit is not a valid cycle
+        double area;
+        BoundingBox boundingBox;
+
+        // Computed on first use
+        bool isPreviewComputed;
+        PreviewKeyFace preview; // this orbit only
+        bool isFaceComputed;
+        PreviewKeyFace face;    // this orbit and its holes
+    };
+
+    void clear_();
+    void insertEdge_(KeyEdge * edge);
+    void removeEdge_(int edgeId);
+    void removeOrbit_(int orbitId);
+    void walkOrbits_();
+    void computeGeometry_(Orbit & orbit) const;
+    const PreviewKeyFace & preview_(Orbit & orbit);
+    const PreviewKeyFace & face_(Orbit & orbit);
+    void updateGrid_();
+    bool isFaceOrbit_(const Orbit & orbit) const;
+
+    bool isValid_;
+    VAC * vac_;
+    Time time_;
+    quint64 revision_;
+
+    QHash<int, EdgeRecord> edges_;
+    QHash<int, QSet<int> > vertexEdges_; // IDs of the edges incident to each vertex
+    QHash<int, Orbit> orbits_;
+    QSet<HalfedgeId> unwalked_;
+    int nextOrbitId_;
+
+    // Uniform grid over the bounding boxes of face orbits. Orbits covering
+    // too many cells are stored separately and always tested.
+    bool isGridValid_;
+    BoundingBox gridBoundingBox_;
+    int gridSize_;
+    QVector<QVector<int> > grid_;
+    QVector<int> largeOrbitIds_;
+};
+
+}
+
+#endif // VAC_PLANAR_ARRANGEMENT_H
@@ -0,0 +1,535 @@
+// Copyright (C) 2012-2019 The VPaint Developers.
+// See the COPYRIGHT file at the top-level directory of this distribution
+// and at https://github.com/dalboris/vpaint/blob/master/COPYRIGHT
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Rasterizer.h"
+
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace VectorAnimationComplex
+{
+
+namespace
+{
+
+// Size of the square tiles processed in parallel, in pixels
+const int TILE_SIZE = 64;
+
+// Sub-sample offsets from pixel center, along each axis (4x4 grid)
+const double SUBSAMPLE_OFFSETS[4] = { -0.375, -0.125, 0.125, 0.375 };
+
+// Half-extent of the sub-samples from the pixel center
+const double SUBSAMPLE_EXTENT = 0.375;
+
+inline int numSubSamples(std::uint16_t mask)
+{
+    std::uint32_t v = mask;
+    v = v - ((v >> 1) & 0x5555);
+    v = (v & 0x3333) + ((v >> 2) & 0x3333);
+    v = (v + (v >> 4)) & 0x0F0F;
+    return (v + (v >> 8)) & 0x1F;
+}
+
+// Composites a premultiplied color over a premultiplied pixel
+inline void blendOver(float * dst, float r, float g, float b, float a)
+{
+    const float k = 1.0f - a;
+    dst[0] = r + k * dst[0];
+    dst[1] = g + k * dst[1];
+    dst[2] = b + k * dst[2];
+    dst[3] = a + k * dst[3];
+}
+
+// Positive modulo, used for texture repeat
+inline int wrap(int i, int n)
+{
+    int res = i % n;
+    return res < 0 ? res + n : res;
+}
+
+// Length of the intersection between [a1, a2] and [b1, b2]
+inline double overlap(double a1, double a2, double b1, double b2)
+{
+    return std::max(0.0, std::min(a2, b2) - std::max(a1, b1));
+}
+
+// Edge function E(x,y) = A*x + B*y + C, positive on the left side of the
+// directed edge (p,q) in a y-down coordinate system
+struct EdgeFunction
+{
+    double A, B, C;
+    double offsets[16];
+
+    void init(double px, double py, double qx, double qy)
+    {
+        A = py - qy;
+        B = qx - px;
+        C = - A*px - B*py;
+        for (int l = 0; l < 4; ++l)
+            for (int k = 0; k < 4; ++k)
+                offsets[4*l+k] = A * SUBSAMPLE_OFFSETS[k] + B * SUBSAMPLE_OFFSETS[l];
+    }
+
+    double operator()(double x, double y) const
+    {
+        return A*x + B*y + C;
+    }
+
+    // Maximum deviation from the value at pixel center, over all sub-samples
+    double extent() const
+    {
+        return SUBSAMPLE_EXTENT * (std::abs(A) + std::abs(B));
+    }
+
+    // Restricts [xMin, xMax] to the values of x where E(x,y) >= 0 for
+    // at least one y in [y1, y2]. Returns false if this is empty.
+    bool clipSpan(double y1, double y2, double & xMin, double & xMax) const
+    {
+        const double r = - (std::max(B*y1, B*y2) + C);
+        if (A > 0)
+            xMin = std::max(xMin, r / A);
+        else if (A < 0)
+            xMax = std::min(xMax, r / A);
+        else if (r > 0)
+            return false;
+        return xMin <= xMax;
+    }
+};
+
+}
+
+// A triangle in pixel coordinates, or a reference to an image command
+struct Rasterizer::Fragment
+{
+    int command;
+    double ax, ay, bx, by, cx, cy;
+};
+
+// A rectangular region of the image, with the list of fragments (indices in
+// the fragments array) overlapping this region, in drawing order
+struct Rasterizer::Tile
+{
+    int x1, y1, x2, y2; // pixel range [x1, x2) x [y1, y2)
+    std::vector<int> fragments;
+};
+
+Rasterizer::Rasterizer(int width, int height) :
+    width_(std::max(0, width)),
+    height_(std::max(0, height)),
+    x_(0), y_(0), sx_(1), sy_(1),
+    buffer_(4 * (size_t)width_ * (size_t)height_, 0.0f)
+{
+}
+
+void Rasterizer::setViewport(double x, double y, double w, double h)
+{
+    x_ = x;
+    y_ = y;
+    sx_ = (w > 0) ? width_ / w : 1.0;
+    sy_ = (h > 0) ? height_ / h : 1.0;
+}
+
+void Rasterizer::clear(const QColor & color)
+{
+    const float a = color.alphaF();
+    const float r = color.redF() * a;
+    const float g = color.greenF() * a;
+    const float b = color.blueF() * a;
+    const size_t n = buffer_.size();
+    for (size_t i = 0; i < n; i += 4)
+    {
+        buffer_[i+0] = r;
+        buffer_[i+1] = g;
+        buffer_[i+2] = b;
+        buffer_[i+3] = a;
+    }
+    commands_.clear();
+}
+
+void Rasterizer::fill(const Triangles & triangles, const QColor & color)
+{
+    if (triangles.size() == 0 || color.alpha() == 0)
+        return;
+
+    commands_.push_back(Command());
+    Command & c = commands_.back();
+    c.type = Command::FillCommand;
+    c.triangles = &triangles;
+    c.color[3] = color.alphaF();
+    c.color[0] = color.redF() * c.color[3];
+    c.color[1] = color.greenF() * c.color[3];
+    c.color[2] = color.blueF() * c.color[3];
+}
+
+void Rasterizer::fillRect(double x1, double y1, double x2, double y2, const QColor & color)
+{
+    if (color.alpha() == 0)
+        return;
+
+    commands_.push_back(Command());
+    Command & c = commands_.back();
+    c.type = Command::FillCommand;
+    c.triangles = nullptr;
+    c.ownedTriangles.append(x1, y1, x2, y1, x2, y2);
+    c.ownedTriangles.append(x1, y1, x2, y2, x1, y2);
+    c.color[3] = color.alphaF();
+    c.color[0] = color.redF() * c.color[3];
+    c.color[1] = color.greenF() * c.color[3];
+    c.color[2] = color.blueF() * c.color[3];
+}
+
+void Rasterizer::drawImage(const QImage & image,
+                           double x1, double y1, double x2, double y2,
+                           double u1, double v1, double u2, double v2,
+                           double opacity)
+{
+    if (image.isNull() || opacity <= 0)
+        return;
+
+    // Convert to pixel coordinates, and ensure x1 <= x2 and y1 <= y2
+    x1 = (x1 - x_) * sx_;
+    x2 = (x2 - x_) * sx_;
+    y1 = (y1 - y_) * sy_;
+    y2 = (y2 - y_) * sy_;
+    if (x1 > x2)
+    {
+        std::swap(x1, x2);
+        std::swap(u1, u2);
+    }
+    if (y1 > y2)
+    {
+        std::swap(y1, y2);
+        std::swap(v1, v2);
+    }
+    if (x1 == x2 || y1 == y2)
+        return;
+
+    commands_.push_back(Command());
+    Command & c = commands_.back();
+    c.type = Command::ImageCommand;
+    c.triangles = nullptr;
+    c.image = image.convertToFormat(QImage::Format_RGBA8888_Premultiplied);
+    c.x1 = x1; c.y1 = y1; c.x2 = x2; c.y2 = y2;
+    c.u1 = u1; c.v1 = v1; c.u2 = u2; c.v2 = v2;
+    c.opacity = std::min(1.0, opacity);
+}
+
+void Rasterizer::flush()
+{
+    if (commands_.empty())
+        return;
+
+    if (width_ == 0 || height_ == 0)
+    {
+        commands_.clear();
+        return;
+    }
+
+    // Create tiles
+    const int numTilesX = (width_ + TILE_SIZE - 1) / TILE_SIZE;
+    const int numTilesY = (height_ + TILE_SIZE - 1) / TILE_SIZE;
+    std::vector<Tile> tiles(numTilesX * numTilesY);
+    for (int j = 0; j < numTilesY; ++j)
+    {
+        for (int i = 0; i < numTilesX; ++i)
+        {
+            Tile & tile = tiles[j*numTilesX + i];
+            tile.x1 = i * TILE_SIZE;
+            tile.y1 = j * TILE_SIZE;
+            tile.x2 = std::min(width_, tile.x1 + TILE_SIZE);
+            tile.y2 = std::min(height_, tile.y1 + TILE_SIZE);
+        }
+    }
+
+    // Bin fragments into the tiles overlapped by their bounding box. Since
+    // commands are processed in order, each tile receives its fragments in
+    // drawing order.
+    std::vector<Fragment> fragments;
+    auto binFragment = [&](double xMin, double xMax, double yMin, double yMax)
+    {
+        if (!(xMax > 0 && yMax > 0 && xMin < width_ && yMin < height_))
+            return; // also discards NaNs
+        const int i1 = std::max(0, (int)std::floor(xMin) / TILE_SIZE);
+        const int j1 = std::max(0, (int)std::floor(yMin) / TILE_SIZE);
+        const int i2 = std::min(numTilesX - 1, (int)std::floor(xMax) / TILE_SIZE);
+        const int j2 = std::min(numTilesY - 1, (int)std::floor(yMax) / TILE_SIZE);
+        const int index = (int)fragments.size() - 1;
+        for (int j = j1; j <= j2; ++j)
+            for (int i = i1; i <= i2; ++i)
+                tiles[j*numTilesX + i].fragments.push_back(index);
+    };
+    for (size_t k = 0; k < commands_.size(); ++k)
+    {
+        const Command & c = commands_[k];
+        if (c.type == Command::FillCommand)
+        {
+            const Triangles & triangles = c.triangles ? *c.triangles : c.ownedTriangles;
+            for (int m = 0; m < triangles.size(); ++m)
+            {
+                const Triangle & t = triangles[m];
+                Fragment f;
+                f.command = (int)k;
+                f.ax = (t.a[0] - x_) * sx_; f.ay = (t.a[1] - y_) * sy_;
+                f.bx = (t.b[0] - x_) * sx_; f.by = (t.b[1] - y_) * sy_;
+                f.cx = (t.c[0] - x_) * sx_; f.cy = (t.c[1] - y_) * sy_;
+                fragments.push_back(f);
+                binFragment(std::min(f.ax, std::min(f.bx, f.cx)),
+                            std::max(f.ax, std::max(f.bx, f.cx)),
+                            std::min(f.ay, std::min(f.by, f.cy)),
+                            std::max(f.ay, std::max(f.by, f.cy)));
+            }
+        }
+        else
+        {
+            Fragment f;
+            f.command = (int)k;
+            f.ax = f.ay = f.bx = f.by = f.cx = f.cy = 0;
+            fragments.push_back(f);
+            binFragment(c.x1, c.x2, c.y1, c.y2);
+        }
+    }
+
+    // Rasterize all tiles in parallel. This is thread-safe since tiles
+    // write to disjoint regions of the buffer.
+    QtConcurrent::blockingMap(tiles, [this, &fragments](Tile & tile)
+    {
+        rasterizeTile_(tile, fragments);
+    });
+
+    commands_.clear();
+}
+
+void Rasterizer::rasterizeTile_(Tile & tile, const std::vector<Fragment> & fragments)
+{
+    if (tile.fragments.empty())
+        return;
+
+    const int tw = tile.x2 - tile.x1;
+    const int th = tile.y2 - tile.y1;
+
+    // Coverage mask of the current fill command, and the sub-rectangle of the
+    // tile (in image coordinates) where it may be non-zero
+    std::vector<std::uint16_t> mask(tw * th, 0);
+    int mx1 = tile.x2, my1 = tile.y2, mx2 = tile.x1, my2 = tile.y1;
+
+    // Composites the coverage mask of the given fill command, then resets it
+    auto resolveMask = [&](const Command & c)
+    {
+        for (int y = my1; y < my2; ++y)
+        {
+            std::uint16_t * m = &mask[(y - tile.y1) * tw + (mx1 - tile.x1)];
+            float * dst = &buffer_[4 * ((size_t)y * width_ + mx1)];
+            for (int x = mx1; x < mx2; ++x, ++m, dst += 4)
+            {
+                if (*m)
+                {
+                    const float cov = numSubSamples(*m) * (1.0f / 16.0f);
+                    blendOver(dst, cov * c.color[0], cov * c.color[1],
+                                   cov * c.color[2], cov * c.color[3]);
+                    *m = 0;
+                }
+            }
+        }
+        mx1 = tile.x2; my1 = tile.y2; mx2 = tile.x1; my2 = tile.y1;
+    };
+
+    // Draws an image command directly in the tile
+    auto drawImage = [&](const Command & c)
+    {
+        const int x1 = std::max(tile.x1, (int)std::floor(c.x1));
+        const int x2 = std::min(tile.x2, (int)std::ceil(c.x2));
+        const int y1 = std::max(tile.y1, (int)std::floor(c.y1));
+        const int y2 = std::min(tile.y2, (int)std::ceil(c.y2));
+        const int iw = c.image.width();
+        const int ih = c.image.height();
+        for (int y = y1; y < y2; ++y)
+        {
+            const double covY = overlap(y, y+1, c.y1, c.y2);
+            const double py = std::min(c.y2, std::max(c.y1, y + 0.5));
+            const double v = c.v1 + (c.v2 - c.v1) * (py - c.y1) / (c.y2 - c.y1);
+            const double ty = (1.0 - v) * ih - 0.5;
+            const double fy = std::floor(ty);
+            const double wy = ty - fy;
+            const uchar * row0 = c.image.constScanLine(wrap((int)fy, ih));
+            const uchar * row1 = c.image.constScanLine(wrap((int)fy + 1, ih));
+            float * dst = &buffer_[4 * ((size_t)y * width_ + x1)];
+            for (int x = x1; x < x2; ++x, dst += 4)
+            {
+                const double cov = covY * overlap(x, x+1, c.x1, c.x2);
+                if (cov <= 0)
+                    continue;
+                const double px = std::min(c.x2, std::max(c.x1, x + 0.5));
+                const double u = c.u1 + (c.u2 - c.u1) * (px - c.x1) / (c.x2 - c.x1);
+                const double tx = u * iw - 0.5;
+                const double fx = std::floor(tx);
+                const double wx = tx - fx;
+                const int i0 = 4 * wrap((int)fx, iw);
+                const int i1 = 4 * wrap((int)fx + 1, iw);
+                const float k = (float)(cov * c.opacity / 255.0);
+                float rgba[4];
+                for (int ch = 0; ch < 4; ++ch)
+                {
+                    const double top = (1-wx) * row0[i0+ch] + wx * row0[i1+ch];
+                    const double bottom = (1-wx) * row1[i0+ch] + wx * row1[i1+ch];
+                    rgba[ch] = k * (float)((1-wy) * top + wy * bottom);
+                }
+                blendOver(dst, rgba[0], rgba[1], rgba[2], rgba[3]);
+            }
+        }
+    };
+
+    // Adds the sub-samples covered by the given triangle to the coverage mask
+    auto rasterizeTriangle = [&](const Fragment & f)
+    {
+        // Ensure counter-clockwise orientation (in y-down coordinates), and
+        // skip degenerate triangles
+        double ax = f.ax, ay = f.ay, bx = f.bx, by = f.by, cx = f.cx, cy = f.cy;
+        const double area = (bx-ax)*(cy-ay) - (by-ay)*(cx-ax);
+        if (!(area != 0))
+            return;
+        if (area < 0)
+        {
+            std::swap(bx, cx);
+            std::swap(by, cy);
+        }
+        EdgeFunction e[3];
+        e[0].init(ax, ay, bx, by);
+        e[1].init(bx, by, cx, cy);
+        e[2].init(cx, cy, ax, ay);
+        const double r0 = e[0].extent();
+        const double r1 = e[1].extent();
+        const double r2 = e[2].extent();
+
+        // Rows of the tile overlapped by the triangle
+        const int y1 = std::max(tile.y1, (int)std::floor(std::min(ay, std::min(by, cy))));
+        const int y2 = std::min(tile.y2, (int)std::floor(std::max(ay, std::max(by, cy))) + 1);
+        const double triXMin = std::min(ax, std::min(bx, cx));
+        const double triXMax = std::max(ax, std::max(bx, cx));
+
+        for (int y = y1; y < y2; ++y)
+        {
+            // Compute the span of pixels of this row which may contain
+            // covered sub-samples
+            double xMin = triXMin;
+            double xMax = triXMax;
+            const double sy1 = y + 0.5 - SUBSAMPLE_EXTENT;
+            const double sy2 = y + 0.5 + SUBSAMPLE_EXTENT;
+            if (!e[0].clipSpan(sy1, sy2, xMin, xMax) ||
+                !e[1].clipSpan(sy1, sy2, xMin, xMax) ||
+                !e[2].clipSpan(sy1, sy2, xMin, xMax))
+            {
+                continue;
+            }
+            const int x1 = std::max(tile.x1, (int)std::floor(xMin - 0.5 - SUBSAMPLE_EXTENT));
+            const int x2 = std::min(tile.x2, (int)std::floor(xMax - 0.5 + SUBSAMPLE_EXTENT) + 1);
+            if (x1 >= x2)
+                continue;
+
+            // Update region of the mask to resolve
+            mx1 = std::min(mx1, x1);
+            mx2 = std::max(mx2, x2);
+            my1 = std::min(my1, y);
+            my2 = std::max(my2, y+1);
+
+            // Incrementally evaluate edge functions at pixel centers
+            const double py = y + 0.5;
+            double E0 = e[0](x1 + 0.5, py);
+            double E1 = e[1](x1 + 0.5, py);
+            double E2 = e[2](x1 + 0.5, py);
+            std::uint16_t * m = &mask[(y - tile.y1) * tw + (x1 - tile.x1)];
+            for (int x = x1; x < x2; ++x, ++m, E0 += e[0].A, E1 += e[1].A, E2 += e[2].A)
+            {
+                // Trivial reject: all sub-samples outside one edge
+                if (E0 < -r0 || E1 < -r1 || E2 < -r2)
+                    continue;
+
+                // Trivial accept: all sub-samples inside all edges
+                if (E0 >= r0 && E1 >= r1 && E2 >= r2)
+                {
+                    *m = 0xFFFF;
+                    continue;
+                }
+
+                // Partial coverage: test all sub-samples
+                std::uint16_t bits = 0;
+                for (int s = 0; s < 16; ++s)
+                {
+                    const bool inside = (E0 + e[0].offsets[s] >= 0) &
+                                        (E1 + e[1].offsets[s] >= 0) &
+                                        (E2 + e[2].offsets[s] >= 0);
+                    bits |= (std::uint16_t)(inside << s);
+                }
+                *m |= bits;
+            }
+        }
+    };
+
+    // Process all fragments in drawing order
+    int currentCommand = -1;
+    for (int index : tile.fragments)
+    {
+        const Fragment & f = fragments[index];
+        if (f.command != currentCommand)
+        {
+            if (currentCommand != -1 && commands_[currentCommand].type == Command::FillCommand)
+                resolveMask(commands_[currentCommand]);
+            currentCommand = f.command;
+        }
+
+        const Command & c = commands_[f.command];
+        if (c.type == Command::FillCommand)
+            rasterizeTriangle(f);
+        else
+            drawImage(c);
+    }
+    if (currentCommand != -1 && commands_[currentCommand].type == Command::FillCommand)
+        resolveMask(commands_[currentCommand]);
+}
+
+void Rasterizer::accumulate(const Rasterizer & other, double weight)
+{
+    if (other.width_ != width_ || other.height_ != height_)
+        return;
+
+    const float w = weight;
+    const size_t n = buffer_.size();
+    for (size_t i = 0; i < n; ++i)
+        buffer_[i] += w * other.buffer_[i];
+}
+
+QImage Rasterizer::toImage() const
+{
+    QImage res(width_, height_, QImage::Format_RGBA8888);
+    for (int y = 0; y < height_; ++y)
+    {
+        uchar * dst = res.scanLine(y);
+        const float * src = &buffer_[4 * (size_t)y * width_];
+        for (int x = 0; x < width_; ++x, dst += 4, src += 4)
+        {
+            const float a = std::min(1.0f, std::max(0.0f, src[3]));
+            const float s = (a > 0) ? 1.0f / a : 0.0f;
+            for (int ch = 0; ch < 3; ++ch)
+                dst[ch] = (uchar) std::min(255.0f, std::floor(0.5f + 255.0f * s * src[ch]));
+            dst[3] = (uchar) std::floor(0.5f + 255.0f * a);
+        }
+    }
+    return res;
+}
+
+}
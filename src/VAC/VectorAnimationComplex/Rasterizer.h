@@ -0,0 +1,141 @@
+// Copyright (C) 2012-2019 The VPaint Developers.
+// See the COPYRIGHT file at the top-level directory of this distribution
+// and at https://github.com/dalboris/vpaint/blob/master/COPYRIGHT
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef VAC_RASTERIZER_H
+#define VAC_RASTERIZER_H
+
+#include "Triangles.h"
+
+#include <QColor>
+#include <QImage>
+#include <vector>
+
+namespace VectorAnimationComplex
+{
+
+// Rasterizer is a pure-CPU replacement for the fixed-function OpenGL pipeline
+// used to draw Triangles. It does not require any OpenGL context, which makes
+// it possible to render a scene in a headless environment, and its output is
+// deterministic (independent from the GPU and driver), which makes it suitable
+// for regression tests.
+//
+// Usage:
+//
+//     Rasterizer r(imgW, imgH);
+//     r.setViewport(x, y, w, h); // scene rectangle mapped to the whole image
+//     r.clear();
+//     r.fill(cell->triangles(t), cell->color());
+//     ...
+//     r.flush();
+//     QImage img = r.toImage();
+//
+// Drawing commands are only recorded by fill(), fillRect() and drawImage().
+// They are executed by flush(), which bins them into square tiles, then
+// processes all tiles in parallel. Within a tile, commands are executed in
+// the order they were recorded, so the result is the same as drawing them
+// one after the other.
+//
+// Anti-aliasing is coverage-based: each pixel has 16 sub-samples, and all the
+// triangles of a same fill() command are merged into a single coverage mask
+// before being composited. Therefore, unlike with OpenGL, overlapping
+// triangles of a same command (which is common for edges) do not blend twice
+// when the color is semi-transparent.
+//
+// The image is stored as premultiplied RGBA floats, with the top row first
+// (i.e., the y-axis is pointing down, like in scene coordinates).
+//
+class Rasterizer
+{
+public:
+    // Creates a rasterizer with an image of the given size, cleared to fully
+    // transparent, and whose viewport is (0, 0, width, height).
+    Rasterizer(int width, int height);
+
+    // Image size
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+    // Sets which rectangle of the scene is mapped to the whole image
+    void setViewport(double x, double y, double w, double h);
+
+    // Clears the whole image with the given color. This discards all
+    // recorded commands that have not been flushed yet.
+    void clear(const QColor & color = QColor(0, 0, 0, 0));
+
+    // Records a command to draw the given triangles with the given color.
+    // The triangles are not copied: they must stay valid until flush().
+    void fill(const Triangles & triangles, const QColor & color);
+
+    // Records a command to fill the given rectangle (in scene coordinates)
+    void fillRect(double x1, double y1, double x2, double y2, const QColor & color);
+
+    // Records a command to draw the given image in the given rectangle (in
+    // scene coordinates). (u1, v1) and (u2, v2) are the texture coordinates
+    // at (x1, y1) and (x2, y2), using the OpenGL convention that v = 1 is the
+    // top row of the image. Texture coordinates outside [0, 1] repeat the
+    // image. The image is modulated by the given opacity.
+    void drawImage(const QImage & image,
+                   double x1, double y1, double x2, double y2,
+                   double u1, double v1, double u2, double v2,
+                   double opacity = 1.0);
+
+    // Executes all recorded commands
+    void flush();
+
+    // Adds weight * other to this image. Both must have the same size.
+    // This is typically used to implement motion blur.
+    void accumulate(const Rasterizer & other, double weight);
+
+    // Access the premultiplied RGBA float buffer (4 * width * height floats)
+    const float * data() const { return buffer_.data(); }
+
+    // Converts to an 8-bit non-premultiplied RGBA image
+    QImage toImage() const;
+
+private:
+    // A recorded drawing command
+    struct Command
+    {
+        enum Type { FillCommand, ImageCommand };
+        Type type;
+
+        // FillCommand: triangles (either borrowed or owned) and
+        // premultiplied color
+        const Triangles * triangles;
+        Triangles ownedTriangles;
+        float color[4];
+
+        // ImageCommand: image and rectangle in pixel coordinates
+        QImage image;
+        double x1, y1, x2, y2;
+        double u1, v1, u2, v2;
+        float opacity;
+    };
+    struct Fragment;
+    struct Tile;
+
+    void rasterizeTile_(Tile & tile, const std::vector<Fragment> & fragments);
+
+    int width_;
+    int height_;
+    double x_, y_, sx_, sy_;
+    std::vector<float> buffer_;
+    std::vector<Command> commands_;
+};
+
+}
+
+#endif // VAC_RASTERIZER_H
@@ -41,6 +41,11 @@
  *  Invariant: after calling resample(), the distance between two consecutive sample is
  *                0 < epsilon() < d(pi,pi+1) < ds()
  *
+ *  Adaptive sampling: if a tolerance() > 0 is set, resample() then removes all the samples
+ *  which are not needed for the curve to stay within tolerance of its uniform sampling, both
+ *  in position and width. The invariant becomes 0 < epsilon() < d(pi,pi+1), and segments
+ *  longer than ds() are straight lines of linearly varying width, up to the tolerance.
+ *
  * Note that for loops (= closed edges), the start/end point is duplicated,
  * that is, the first and last samples are equal. This makes it easier for code
  * who doesn't care about closedness, for example computing arclength
@@ -59,6 +64,7 @@
 #include <cmath>
 #include <algorithm>
 #include <cassert>
+#include <limits>
 
 #include <Eigen/Core>
 #include <Eigen/LU>
@@ -105,15 +111,15 @@ public:
 
     // Construct an empty curve. Optionally, specify a sampling rate
     Curve(double ds = 5.0) :
-        dirtyArclengths_(false), isClosed_(false), sketchInProgress_(false),
+        isClosed_(false), sketchInProgress_(false),
         N_(10), fitterType_(QUARTIC_BEZIER_FITTER),
-        ds_(ds), lastDs_(-1) {}
+        ds_(ds), lastDs_(-1), tolerance_(0) {}
 
     // Construct a straight line
     Curve(const T & start, const T & end, double ds = 5.0) :
-        dirtyArclengths_(true), isClosed_(false), sketchInProgress_(false),
+        isClosed_(false), sketchInProgress_(false),
         N_(20), fitterType_(QUARTIC_BEZIER_FITTER),
-        ds_(ds), lastDs_(-1)
+        ds_(ds), lastDs_(-1), tolerance_(0)
     {
         vertices_.push_back(start);
         vertices_.push_back(end);
@@ -122,7 +128,7 @@ public:
 
     // Reinitialize curve
     void clear() {
-        vertices_.clear(); arclengths_.clear(); lastDs_ = -1; dirtyArclengths_ = false; isClosed_ = false;
+        vertices_.clear(); arclengths_.clear(); lastDs_ = -1; isClosed_ = false;
 
 
         p_.clear(); // raw input from mouse
@@ -138,6 +144,11 @@ public:
         isClosed_ = true;
     }
 
+    bool isClosed() const
+    {
+        return isClosed_;
+    }
+
     double epsilon() const
     {
         return 1e-6;
@@ -157,6 +168,7 @@ public:
         pushFirstVertex_(vertex);
 
         lastFinalS_ = 0;
+        lastFittingInvolved_i = 0;
         sketchInProgress_ = true;
     }
 
@@ -184,7 +196,8 @@ public:
         if(p_.size() < (unsigned int) N_)
         {
             // Compute fit
-            Fitter * fit = fitter(fitterType_, p_, 0, static_cast<int>(p_.size()), ds_);
+            Fitter * fit = fits_.scratch(fitterType_, p_);
+            fit->fit(0, static_cast<int>(p_.size()), ds_);
 
             T q = vertices_.back(); // = q_[0]
             double s = lastFinalS_;                 // = 0
@@ -201,14 +214,12 @@ public:
             // add last vertex
             T lastP = p_.back().p;
             qTemp_.push_back(lastP);
-
-            delete fit;
         }
         else
         {
             // compute new fitting
-            Fitter * fit = fitter(fitterType_, p_,static_cast<int>(p_.size()) - N_, N_, ds_);
-            fits_ << fit;
+            Fitter * fit = fits_.push(fitterType_, p_);
+            fit->fit(static_cast<int>(p_.size()) - N_, N_, ds_);
 
             T q = vertices_.back();
             //double qt = qt_.last();
@@ -235,6 +246,11 @@ public:
             // add last vertex
             T lastP = p_.back().p;
             qTemp_.push_back(lastP);
+
+            // phi_() will never be called again before lastFinalS_, so
+            // fits which can only be blended before it can be reused
+            int i = lastFittingInvolved_(lastFinalS_);
+            fits_.releaseBefore(i-N_+2);
         }
 
         lastDs_ = -1;
@@ -278,7 +294,6 @@ public:
     }
     double arclength(int i) const
     {
-        precomputeArclengths_();
         return arclengths_[i];
     }
 
@@ -301,6 +316,7 @@ public:
 
     double ds() const { return ds_; }
     void setDs(double ds) {  ds_ = ds; }
+    bool isSampledAt(double ds) const { return ds_ == ds && lastDs_ == ds; } // i.e., resample(ds) is a no-op
     void resample(double ds)    { setDs(ds); resample(); }
     void resample(bool force = false)
     {
@@ -313,6 +329,29 @@ public:
                 lastDs_ = ds_;
         }
 
+        resampleUniformly();
+        if(tolerance_ > 0)
+            simplify_(tolerance_);
+    }
+
+    // Tolerance of adaptive sampling, 0 (the default) for uniform sampling
+    double tolerance() const { return tolerance_; }
+    void setTolerance(double tolerance) { tolerance_ = tolerance; lastDs_ = -1; }
+
+    // Removes the samples not needed to stay within the given error, whatever
+    // tolerance() is. This is used to draw coarse levels of detail.
+    void simplify(double error) { simplify_(error); }
+
+    // Same as resample(true), but ignoring tolerance(). This is used while
+    // sculpting, which needs samples all along the sculpted part.
+    void resampleUniformly()
+    {
+        // Long segments of adaptively sampled curves are straight: split
+        // them linearly first, so that the subdivision scheme below doesn't
+        // bend them
+        if(tolerance_ > 0)
+            subdivideLinearly_(0, 0, std::numeric_limits<double>::infinity());
+
         // We'll work on a linked list for fast insertion/deletion in the middle
         typedef std::list<T,Eigen::aligned_allocator<T> > SampleList;
         SampleList samples;
@@ -594,7 +633,7 @@ public:
         typename SampleList::iterator itEnd = samples.end();
         for(typename SampleList::iterator it = itBegin; it != itEnd; ++it)
             vertices_.push_back(*it);
-        setDirtyArclengths_();
+        computeArclengths_();
     }
 
     // directly set the curve to be the provided vertices, for instance
@@ -609,7 +648,7 @@ public:
 
         // set vertices
         vertices_ = newVertices;
-        setDirtyArclengths_();
+        computeArclengths_();
     }
 
     // -------- Continuous curve --------
@@ -619,7 +658,6 @@ public:
 
     double length() const
     {
-        precomputeArclengths_();
         return arclengths_.back();
     }
 
@@ -693,6 +731,59 @@ public:
         return res;
     }
 
+    // Closest point on the curve, given by its arclength s and its distance
+    // d to (x, y). Unlike findClosestVertex(), this is accurate near long
+    // segments of adaptively sampled curves. Returns s = -1 if no vertices.
+    struct ClosestPoint { double s; double d; };
+    ClosestPoint findClosestPoint(double x, double y) const
+    {
+        ClosestPoint res = { -1, std::numeric_limits<double>::max() };
+        int n = size();
+        if(n == 0)
+            return res;
+
+        Eigen::Vector2d p(x, y);
+        res.s = 0;
+        res.d = (Eigen::Vector2d(vertices_[0].x(), vertices_[0].y()) - p).norm();
+        for(int i=1; i<n; ++i)
+        {
+            Eigen::Vector2d a(vertices_[i-1].x(), vertices_[i-1].y());
+            Eigen::Vector2d ab(vertices_[i].x() - a[0], vertices_[i].y() - a[1]);
+            double l2 = ab.squaredNorm();
+            double u = (l2 > 0) ? std::min(1.0, std::max(0.0, (p - a).dot(ab) / l2)) : 0.0;
+            double d = (a + u * ab - p).norm();
+            if(d < res.d)
+            {
+                res.s = arclengths_[i-1] + u * (arclengths_[i] - arclengths_[i-1]);
+                res.d = d;
+            }
+        }
+        return res;
+    }
+
+    // Whether some segments longer than ds() are within the given distance
+    // of (x, y). This only happens for adaptively sampled curves.
+    bool needsRefinement(double x, double y, double distance) const
+    {
+        for(std::size_t i=1; i<vertices_.size(); ++i)
+        {
+            if(vertices_[i-1].distanceTo(vertices_[i]) > ds_ &&
+               segmentDistance_(vertices_[i-1], vertices_[i], x, y) < distance)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Splits linearly the segments longer than ds() which are within the
+    // given distance of (x, y). This doesn't change the shape of the curve,
+    // but makes it possible to sculpt it there.
+    void refine(double x, double y, double distance)
+    {
+        subdivideLinearly_(x, y, distance);
+    }
+
     double prepareSculpt(double x, double y, double radius)
     {
         ClosestVertex v = findClosestVertex(x,y);
@@ -705,7 +796,6 @@ public:
     {
         if(sculptIndex_>=0 && sculptIndex_<size() )
         {
-            precomputeArclengths_();
             return arclengths_[sculptIndex_];
         }
         else return 0;
@@ -744,9 +834,6 @@ public:
 
     void beginSculptDeform(double x, double y)
     {
-        // This method needs arclengths
-        precomputeArclengths_();
-
         // Store start x and y
         sculptStartX_ = x;
         sculptStartY_ = y;
@@ -873,25 +960,23 @@ public:
 
     void continueSculptDeform(double x, double y)
     {
-        setDirtyArclengths_();
-
         for(auto & v: sculptTemp_)
         {
             vertices_[v.i].setX(v.x  + v.w * (x - sculptStartX_));
             vertices_[v.i].setY(v.y  + v.w * (y - sculptStartY_));
         }
+        computeArclengths_();
     }
 
     void endSculptDeform()
     {
         sculptTemp_.clear();
-        resample(true);
+        resampleUniformly();
     }
 
     // apply a smooth filter of radius sculptRadius_ and intensity intensity at sculptVertex_
     void sculptSmooth(double intensity)
     {
-        precomputeArclengths_();
         std::vector<T,Eigen::aligned_allocator<T> > copyVertices = vertices_;
         if(!size())
             return;
@@ -983,7 +1068,7 @@ public:
                 }
             }
         }
-        resample(true);
+        resampleUniformly();
     }
 
 
@@ -1097,9 +1182,6 @@ public:
     // Return value not sorted.
     std::vector<Intersection> intersections(const SculptCurve::Curve<T> & other, double tolerance = 15.0) const
     {
-        precomputeArclengths_();
-        other.precomputeArclengths_();
-
         std::vector<Intersection> res;
 
         // Returns in trivial cases
@@ -1273,8 +1355,6 @@ public:
     // Return value not sorted.
     std::vector<Intersection> selfIntersections(double tolerance = 15.0) const
     {
-        precomputeArclengths_();
-
         std::vector<Intersection> res;
 
         // Returns in trivial cases
@@ -1398,8 +1478,6 @@ public:
         }
 
         // Now, we know the curve is non-null, and that there is at least one split
-        precomputeArclengths_();
-
         //cout << "Curve to split:";
         //for(auto s: vertices_)
         //    std::cout << " (" << s.x() << "," << s.y() << "," << s.width() << ") ";
@@ -1472,6 +1550,7 @@ public:
             //cout << "splitValue = " << splitValue << endl;
 
             Curve curve(ds_);
+            curve.tolerance_ = tolerance_;
             if(hasLooped)
             {
                 splitValue -= length();
@@ -1571,7 +1650,7 @@ public:
 
             // handle special case
             if(isClosed_)
-                curve.setDirtyArclengths_();
+                curve.computeArclengths_();
 
             // add the curve to the result
             res.push_back(curve);
@@ -1604,8 +1683,6 @@ public:
         }
         else
         {
-            precomputeArclengths_();
-
             // this method could be replaced using lerp only, but it would make it
             // much much less efficient and readable
             T dStart = newStart - vertices_.front();
@@ -1627,9 +1704,10 @@ private:
     // Sampled curve: the one that is exposed to the user
     std::vector<T,Eigen::aligned_allocator<T> > vertices_;
 
-    // Arc-length precomputation
-    mutable std::vector<double> arclengths_;
-    mutable bool dirtyArclengths_;
+    // Arc-length precomputation. It is computed whenever vertices_ is
+    // modified, so that const methods never write to it: curves are shared
+    // by copies of a VAC, which may be read from several threads.
+    std::vector<double> arclengths_;
 
     // If treated as a loop
     bool isClosed_;
@@ -1653,8 +1731,6 @@ private:
     }
     T interpolatedVertex_(double s) const // size must be > 1
     {
-        precomputeArclengths_();
-
         int i = 0;
         int j = static_cast<int>(vertices_.size()) - 1;
         double si = arclengths_[i];
@@ -1712,18 +1788,37 @@ private:
     };
     std::vector<Input,Eigen::aligned_allocator<Input> > p_;
 
+    // Available fitting algorithms
+    enum FitterType
+    {
+        CUBIC_BEZIER_FITTER,
+        QUARTIC_BEZIER_FITTER,
+        CLOTHOID_FITTER
+    };
+
     // fit a smooth curve to a subpart of the raw mouse input
     class Fitter
     {
     public:
-        // the fitting computation must be implemented in derived constructors.
+        // fitters are created once, and then reused for many fits, by
+        // calling fit() each time
+        Fitter(const std::vector<Input,Eigen::aligned_allocator<Input> > & p) :
+            p_(p), j_(0), N_(0), ds_(0) {}
+        virtual ~Fitter() {}
+
+        // the fitting computation must be implemented in derived classes,
+        // which must call this base implementation first. It must replace
+        // any previous fit, and should reuse previously allocated memory.
         //
         // the N input points from p[j] to p[j+N-1] (guaranteed to exist)
         // is the local part of the curve that should be fit.
         //
-        Fitter(const std::vector<Input,Eigen::aligned_allocator<Input> > & p, int j, int N, double ds) :
-            p_(p), j_(j), N_(N), ds_(ds) {}
-        virtual ~Fitter() {}
+        virtual void fit(int j, int N, double ds)
+        {
+            j_ = j;
+            N_ = N;
+            ds_ = ds;
+        }
 
         // eval() must be implemented in derived classes
         //
@@ -1777,17 +1872,98 @@ private:
         double ds_;
     };
 
-    // List storing all the local fitting
-    std::vector<Fitter*> fits_;
+    // Local fittings which may still be blended by phi_(), indexed by the
+    // index j of their first input point. They are stored in a ring buffer
+    // which owns the Fitter objects, and reuses them once their fit has
+    // been released. Therefore, once the ring is large enough, sketching
+    // doesn't allocate memory, and its cost per input point doesn't depend
+    // on the length of the stroke.
+    //
+    // The sketching state is not copied along with the curve: a copy starts
+    // with no fits.
+    class FitRing
+    {
+    public:
+        FitRing() : begin_(0), end_(0), scratch_(0) {}
+        FitRing(const FitRing & /*other*/) : begin_(0), end_(0), scratch_(0) {}
+        FitRing & operator=(const FitRing & /*other*/) { clear(); return *this; }
+        ~FitRing() { clear(); }
+
+        // Fits of index in [begin(), end()) are available
+        int begin() const { return begin_; }
+        int end() const { return end_; }
+        Fitter * operator[](int j) const
+        {
+            assert(begin_ <= j && j < end_);
+            return slots_[j & (slots_.size()-1)];
+        }
+
+        // Appends a fitter of index end(), for the caller to fit
+        Fitter * push(FitterType type, const std::vector<Input,Eigen::aligned_allocator<Input> > & p)
+        {
+            if(end_ - begin_ == static_cast<int>(slots_.size()))
+                grow_();
+            Fitter * & slot = slots_[end_ & (slots_.size()-1)];
+            if(!slot)
+                slot = newFitter_(type, p);
+            ++end_;
+            return slot;
+        }
+
+        // Releases all fits of index less than j
+        void releaseBefore(int j)
+        {
+            begin_ = std::max(begin_, std::min(j, end_));
+        }
+
+        // A fitter not stored in the ring, for temporary fits
+        Fitter * scratch(FitterType type, const std::vector<Input,Eigen::aligned_allocator<Input> > & p)
+        {
+            if(!scratch_)
+                scratch_ = newFitter_(type, p);
+            return scratch_;
+        }
+
+        // Releases all fits and frees all fitters
+        void clear()
+        {
+            for(Fitter * f : slots_)
+                delete f;
+            delete scratch_;
+            slots_.clear();
+            begin_ = end_ = 0;
+            scratch_ = 0;
+        }
+
+    private:
+        // The number of slots is a power of two, and fit j is in slot
+        // j & (slots_.size()-1). Null slots have never been used.
+        std::vector<Fitter*> slots_;
+        int begin_;
+        int end_;
+        Fitter * scratch_;
+
+        // Only called when all slots are in use
+        void grow_()
+        {
+            const std::size_t n = slots_.size();
+            std::vector<Fitter*> slots(n ? 2*n : 16, static_cast<Fitter*>(0));
+            for(int j=begin_; j<end_; ++j)
+                slots[j & (slots.size()-1)] = slots_[j & (n-1)];
+            slots_.swap(slots);
+        }
+    };
+    FitRing fits_;
     void clearFits_()
     {
-        for(Fitter * f : fits_)
-            delete f;
         fits_.clear();
     }
 
     // Blend overlapping fitting together
-    int lastFittingInvolved_i; // not initialized, but it's ok
+    //
+    // Returns the index i such that p_[i].s <= s < p_[i+1].s. The search
+    // starts from the previous result, since s is usually close to it.
+    int lastFittingInvolved_i;
     int lastFittingInvolved_(double s)
     {
         int i = lastFittingInvolved_i; // make it more readable
@@ -1797,6 +1973,7 @@ private:
             i--;
         while((unsigned int)i+1<p_.size() && s>=p_[i+1].s)
             i++;
+        lastFittingInvolved_i = i;
         return i;
     }
 
@@ -1871,9 +2048,14 @@ private:
     class CubicBezierFitter: public Fitter
     {
     public:
-        CubicBezierFitter(const std::vector<Input,Eigen::aligned_allocator<Input> > & p, int j, int N, double ds) :
-            Fitter(p,j,N, ds)
+        CubicBezierFitter(const std::vector<Input,Eigen::aligned_allocator<Input> > & p) :
+            Fitter(p)
+        {
+        }
+
+        void fit(int j, int N, double ds)
         {
+            Fitter::fit(j, N, ds);
 
             assert(N>=2);
 
@@ -1899,14 +2081,13 @@ private:
             }
             else
             {
-
-                // create linear system
-                Eigen::MatrixXd A(2*(this->N_-2),4);
-                Eigen::VectorXd B(2*(this->N_-2));
-                double Ax = this->startP()[0];
-                double Ay = this->startP()[1];
-                double Dx = this->endP()[0];
-                double Dy = this->endP()[1];
+                // Least squares: the x and y coordinates are independent
+                // and share the same basis functions, so instead of the
+                // 4x4 system on (P1x, P1y, P2x, P2y), we directly
+                // accumulate the 2x2 normal equations M * [P1 P2]^T = R,
+                // which doesn't allocate memory
+                Eigen::Matrix2d M = Eigen::Matrix2d::Zero();
+                Eigen::Matrix2d R = Eigen::Matrix2d::Zero();
                 for(int i=1; i<this->N_-1; i++)
                 {
                     double Ui = this->u_(this->s(i+this->j_));
@@ -1915,39 +2096,22 @@ private:
                     double OneMinusUi2 = OneMinusUi*OneMinusUi;
                     double Ui3 = Ui2*Ui;
                     double OneMinusUi3 = OneMinusUi2*OneMinusUi;
-                    double ThreeOneMinusUi2Ui = 3 * OneMinusUi2 * Ui;
-                    double ThreeOneMinusUiUi2 = 3 * OneMinusUi * Ui2;
-
-                    int TwoTimesIMinus1 = 2*(i-1);
-                    int TwoTimesIMinus1Plus1 = 2*(i-1)+1;
-
-                    A(TwoTimesIMinus1, 0) = ThreeOneMinusUi2Ui;
-                    A(TwoTimesIMinus1, 1) = 0;
-                    A(TwoTimesIMinus1, 2) = ThreeOneMinusUiUi2;
-                    A(TwoTimesIMinus1, 3) = 0;
-
-                    A(TwoTimesIMinus1Plus1, 0) = 0;
-                    A(TwoTimesIMinus1Plus1, 1) = ThreeOneMinusUi2Ui;
-                    A(TwoTimesIMinus1Plus1, 2) = 0;
-                    A(TwoTimesIMinus1Plus1, 3) = ThreeOneMinusUiUi2;
+                    Eigen::Vector2d b(3 * OneMinusUi2 * Ui, 3 * OneMinusUi * Ui2);
+                    Eigen::Vector2d B = this->p(i+this->j_) - OneMinusUi3 * P0_ - Ui3 * P3_;
 
-                    B(TwoTimesIMinus1) = this->p(i+this->j_)[0] - OneMinusUi3 * Ax - Ui3 * Dx;
-                    B(TwoTimesIMinus1Plus1) = this->p(i+this->j_)[1] - OneMinusUi3 * Ay - Ui3 * Dy;
+                    M += b * b.transpose();
+                    R += b * B.transpose();
                 }
 
                 // solve it
-                //Eigen::VectorXd X = (A.transpose() * A).inverse() * A.transpose() * B;
-                // For some reason above code breaks with Eigen 3.2, need to split it
-                Eigen::MatrixXd M = (A.transpose() * A).inverse();
-                M *= A.transpose();
-                Eigen::VectorXd X = M * B;
-
-                P1_ = Eigen::Vector2d(X(0),X(1));
-                P2_ = Eigen::Vector2d(X(2),X(3));
+                Eigen::Matrix2d X = M.inverse() * R;
+                P1_ = X.row(0).transpose();
+                P2_ = X.row(1).transpose();
             }
 
             // --- Compute an approximate uniform parameterization ---
 
+            sampling_.clear();
             for(double u=0; u<1; u+=0.75*this->ds_/der(u).norm())
             {
                 sampling_ << this->pos(u);
@@ -1996,9 +2160,15 @@ private:
     class QuarticBezierFitter: public Fitter
     {
     public:
-        QuarticBezierFitter(const std::vector<Input,Eigen::aligned_allocator<Input> > & p, int j, int N, double ds) :
-            Fitter(p,j,N, ds)
+        QuarticBezierFitter(const std::vector<Input,Eigen::aligned_allocator<Input> > & p) :
+            Fitter(p)
         {
+        }
+
+        void fit(int j, int N, double ds)
+        {
+            Fitter::fit(j, N, ds);
+
             assert(N>=2);
 
             // --- Fit a quartic (degree four) bezier curve to the input points ---
@@ -2015,58 +2185,45 @@ private:
             }
             else if(N==3)
             {
-                P2_ = p(j+1);
+                P2_ = this->p(j+1);
                 P1_ = 0.5 * (P0_ + P2_);
                 P3_ = 0.5 * (P2_ + P4_);
             }
             else if(N==4)
             {
-                P1_ = p(j+1);
-                P3_ = p(j+2);
+                P1_ = this->p(j+1);
+                P3_ = this->p(j+2);
                 P2_ = 0.5 * (P1_ + P3_);
             }
             else
             {
-
-                // create linear system
-                Eigen::MatrixXd A(2*(this->N_-2),6);
-                Eigen::VectorXd B(2*(this->N_-2));
+                // Least squares, with 3x3 normal equations shared by the x
+                // and y coordinates (see CubicBezierFitter)
+                Eigen::Matrix3d M = Eigen::Matrix3d::Zero();
+                Eigen::Matrix<double,3,2> R = Eigen::Matrix<double,3,2>::Zero();
                 for(int i=1; i<this->N_-1; i++)
                 {
-                    int TwoTimesIMinus1 = 2*(i-1);
-                    int TwoTimesIMinus1Plus1 = 2*(i-1)+1;
-
-                    double u = u_(s(i+this->j_));
-
-                    A(TwoTimesIMinus1, 0) = 4*(1-u)*(1-u)*(1-u)*u;
-                    A(TwoTimesIMinus1, 1) = 0;
-                    A(TwoTimesIMinus1, 2) = 6*(1-u)*(1-u)*u*u;
-                    A(TwoTimesIMinus1, 3) = 0;
-                    A(TwoTimesIMinus1, 4) = 4*(1-u)*u*u*u;
-                    A(TwoTimesIMinus1, 5) = 0;
-
-                    A(TwoTimesIMinus1Plus1, 0) = 0;
-                    A(TwoTimesIMinus1Plus1, 1) = 4*(1-u)*(1-u)*(1-u)*u;
-                    A(TwoTimesIMinus1Plus1, 2) = 0;
-                    A(TwoTimesIMinus1Plus1, 3) = 6*(1-u)*(1-u)*u*u;
-                    A(TwoTimesIMinus1Plus1, 4) = 0;
-                    A(TwoTimesIMinus1Plus1, 5) = 4*(1-u)*u*u*u;
-
-                    B(TwoTimesIMinus1) = p(i+this->j_)[0] - (1-u)*(1-u)*(1-u)*(1-u) * P0_[0] - u*u*u*u * P4_[0];
-                    B(TwoTimesIMinus1Plus1) = p(i+this->j_)[1] - (1-u)*(1-u)*(1-u)*(1-u) * P0_[1] - u*u*u*u * P4_[1];
+                    double u = this->u_(this->s(i+this->j_));
+
+                    Eigen::Vector3d b(4*(1-u)*(1-u)*(1-u)*u,
+                                      6*(1-u)*(1-u)*u*u,
+                                      4*(1-u)*u*u*u);
+                    Eigen::Vector2d B = this->p(i+this->j_) - (1-u)*(1-u)*(1-u)*(1-u) * P0_ - u*u*u*u * P4_;
+
+                    M += b * b.transpose();
+                    R += b * B.transpose();
                 }
 
                 // solve it
-                Eigen::MatrixXd M = (A.transpose() * A).inverse();
-                M *= A.transpose();
-                Eigen::VectorXd X = M * B;
-                P1_ = Eigen::Vector2d(X(0),X(1));
-                P2_ = Eigen::Vector2d(X(2),X(3));
-                P3_ = Eigen::Vector2d(X(4),X(5));
+                Eigen::Matrix<double,3,2> X = M.inverse() * R;
+                P1_ = X.row(0).transpose();
+                P2_ = X.row(1).transpose();
+                P3_ = X.row(2).transpose();
             }
 
             // --- Compute an approximate uniform parameterization ---
 
+            sampling_.clear();
             for(double u=0; u<1; u+=0.75*this->ds_/der(u).norm())
             {
                 sampling_ << this->pos(u);
@@ -2111,48 +2268,162 @@ private:
     };
 
     // Current fitting algorithm to use
-    enum FitterType
-    {
-        CUBIC_BEZIER_FITTER,
-        QUARTIC_BEZIER_FITTER,
-        CLOTHOID_FITTER
-    };
     FitterType fitterType_;
 
     // Create a new Fitter object (call the appropriate derived constructor)
     // It is caller's responsability to call "delete" to free the memory
-    static Fitter * fitter(FitterType /*type*/, const std::vector<Input,Eigen::aligned_allocator<Input> > & p, int j, int N, double ds)
+    static Fitter * newFitter_(FitterType /*type*/, const std::vector<Input,Eigen::aligned_allocator<Input> > & p)
     {
         /*
         switch(type)
         {
         case CUBIC_BEZIER_FITTER:
-            return new CubicBezierFitter(p, j, N, ds);
+            return new CubicBezierFitter(p);
         case QUARTIC_BEZIER_FITTER:
-            return new QuarticBezierFitter(p, j, N, ds);
+            return new QuarticBezierFitter(p);
         }
         */
-        return new CubicBezierFitter(p, j, N, ds);
+        return new CubicBezierFitter(p);
     }
 
     // Sampling
     double ds_;
     double lastDs_;
-    void setDirtyArclengths_()   const { dirtyArclengths_ = true; }
-    void precomputeArclengths_() const
+    double tolerance_;
+
+    // Distance from (x, y) to the segment [a, b]
+    static double segmentDistance_(const T & a, const T & b, double x, double y)
+    {
+        Eigen::Vector2d p(x, y);
+        Eigen::Vector2d pa(a.x(), a.y());
+        Eigen::Vector2d ab(b.x() - a.x(), b.y() - a.y());
+        double l2 = ab.squaredNorm();
+        double u = (l2 > 0) ? std::min(1.0, std::max(0.0, (p - pa).dot(ab) / l2)) : 0.0;
+        return (pa + u * ab - p).norm();
+    }
+
+    // Error made by approximating the sample p by the segment [a, b]: the
+    // distance to its closest point q on the segment, plus half the width
+    // difference, since the outline moves by this amount
+    static double approximationError_(const T & a, const T & b, const T & p)
     {
-        if(!dirtyArclengths_)
+        Eigen::Vector2d pa(a.x(), a.y());
+        Eigen::Vector2d ab(b.x() - a.x(), b.y() - a.y());
+        Eigen::Vector2d pp(p.x(), p.y());
+        double l2 = ab.squaredNorm();
+        double u = (l2 > 0) ? std::min(1.0, std::max(0.0, (pp - pa).dot(ab) / l2)) : 0.0;
+        T q = a.lerp(u, b);
+        return q.distanceTo(p) + 0.5 * std::abs(q.width() - p.width());
+    }
+
+    // Splits linearly the segments longer than ds within distance of (x, y)
+    // into segments of equal length between ds/2 and ds, which are kept as
+    // is by the uniform resampling
+    void subdivideLinearly_(double x, double y, double distance)
+    {
+        std::vector<T,Eigen::aligned_allocator<T> > vertices;
+        const std::size_t n = vertices_.size();
+        for(std::size_t i=0; i<n; ++i)
+        {
+            if(i > 0)
+            {
+                const T & a = vertices_[i-1];
+                const T & b = vertices_[i];
+                double d = a.distanceTo(b);
+                if(d > ds_ && (distance == std::numeric_limits<double>::infinity() ||
+                               segmentDistance_(a, b, x, y) < distance))
+                {
+                    int k = static_cast<int>(std::ceil(d / ds_));
+                    for(int j=1; j<k; ++j)
+                        vertices.push_back(a.lerp(static_cast<double>(j) / k, b));
+                }
+            }
+            vertices.push_back(vertices_[i]);
+        }
+        if(vertices.size() != n)
+        {
+            vertices_.swap(vertices);
+            computeArclengths_();
+        }
+    }
+
+    // Removes the samples not needed to stay within tolerance, using the
+    // Douglas-Peucker algorithm: the number of remaining samples adapts to
+    // the curvature and the width variation. Ends are always kept, as well
+    // as one sample in the middle of open curves and two for loops, so that
+    // the curve never degenerates.
+    void simplify_(double tolerance)
+    {
+        const int n = static_cast<int>(vertices_.size());
+        if(n < 4)
             return;
 
-        int n = size();
-        assert(n>0);
+        std::vector<bool> keep(n, false);
+        keep[0] = true;
+        keep[n-1] = true;
+        if(isClosed_)
+        {
+            keep[n/3] = true;
+            keep[2*n/3] = true;
+        }
+        else
+        {
+            keep[n/2] = true;
+        }
+
+        std::vector< std::pair<int,int> > ranges;
+        for(int i=1, j=0; i<n; ++i)
+        {
+            if(keep[i])
+            {
+                ranges.push_back(std::make_pair(j, i));
+                j = i;
+            }
+        }
+        while(!ranges.empty())
+        {
+            int a = ranges.back().first;
+            int b = ranges.back().second;
+            ranges.pop_back();
+
+            double maxError = tolerance;
+            int k = -1;
+            for(int i=a+1; i<b; ++i)
+            {
+                double error = approximationError_(vertices_[a], vertices_[b], vertices_[i]);
+                if(error > maxError)
+                {
+                    maxError = error;
+                    k = i;
+                }
+            }
+            if(k >= 0)
+            {
+                keep[k] = true;
+                ranges.push_back(std::make_pair(a, k));
+                ranges.push_back(std::make_pair(k, b));
+            }
+        }
 
+        int m = 0;
+        for(int i=0; i<n; ++i)
+        {
+            if(keep[i])
+                vertices_[m++] = vertices_[i];
+        }
+        vertices_.resize(m);
+        computeArclengths_();
+    }
+    void computeArclengths_()
+    {
+        int n = static_cast<int>(vertices_.size());
         arclengths_.resize(n);
+        if(n == 0)
+            return;
+
         arclengths_[0] = 0;
         for(int i=1; i<n; ++i)
             arclengths_[i] = arclengths_[i-1] + vertices_[i-1].distanceTo(vertices_[i]);
-
-        dirtyArclengths_ = false;
     }
 public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
@@ -15,8 +15,7 @@
 // limitations under the License.
 
 #include "SmartKeyEdgeSet.h"
-
-#include <QStack>
+#include "Algorithms.h"
 
 namespace VectorAnimationComplex
 {
@@ -115,146 +114,21 @@ SmartKeyEdgeSet::SmartKeyEdgeSet(const KeyEdgeSet & edgeSetConst) :
 {
     // ----- Compute connected components -----
 
-    // This variable store the edges that have not yet been assigned a connected component
-    KeyEdgeSet remainingEdges = edgeSet_;
-
-
-    // ===== First, each closed edge is its own connected component =====
+    QList<KeyEdgeSet> components = Algorithms::connectedComponents(edgeSet_);
 
-    KeyEdgeSet remainingEdgesCopy = remainingEdges;
-    foreach(KeyEdge * iedge, remainingEdgesCopy)
+    // Each closed edge is its own connected component, listed first
+    foreach(const KeyEdgeSet & connectedEdges, components)
     {
-        if(iedge->isClosed())
-        {
-            remainingEdges.remove(iedge);
-            KeyEdgeSet connectedEdges;
-            connectedEdges << iedge;
+        if(connectedEdges.size() == 1 && (*connectedEdges.begin())->isClosed())
             connectedComponents_ << SmartConnectedKeyEdgeSet(connectedEdges);
-        }
-    }
-
-
-    // ===== Define the 1-subcomplex made of the remaining vertices and open edges =====
-
-    // Data structure for cells of the original complex
-    typedef KeyVertex Vertex;
-    typedef KeyEdge Edge;
-
-    // Data structure for cells of the subcomplex
-    struct SubVertex;
-    struct SubEdge
-    {
-        SubEdge(Edge * edge) : edge(edge), leftSubVertex(0), rightSubVertex(0), marked(false) {}
-
-        // Edge from SubEdge
-        Edge * edge;
-
-        // Boundary SubVertices
-        SubVertex * leftSubVertex;
-        SubVertex * rightSubVertex;
-
-        // Has the edge already been visited
-        bool marked;
-    };
-    struct SubVertex
-    {
-        SubVertex(Vertex * vertex) : vertex(vertex), subEdges() {}
-
-        // Vertex from SubVertex
-        Vertex * vertex;
-
-        // Star SubEdges
-        QSet<SubEdge*> subEdges;
-    };
-
-    // Populate subcomplex
-    QSet<SubEdge*> subEdges;
-    QSet<SubVertex*> subVertices;
-    QMap<Vertex*, SubVertex*> vertexToSubVertex;
-    QMap<Edge*, SubEdge*> edgeToSubEdge;
-    foreach(Edge * edge, remainingEdges)
-    {
-        // create new subcomplex edge
-        SubEdge * subEdge = new SubEdge(edge);
-        subEdges << subEdge;
-        edgeToSubEdge[edge] = subEdge;
-
-        // assign its left subcomplex vertex (create it if doesn't exist yet)
-        Vertex * startVertex = edge->startVertex(); // not NULL because edge is open
-        SubVertex * leftSubVertex = vertexToSubVertex.value(startVertex, 0); // returns 0 if not found
-        if(!leftSubVertex)
-        {
-            leftSubVertex = new SubVertex(startVertex);
-            subVertices << leftSubVertex;
-            vertexToSubVertex[startVertex] = leftSubVertex;
-        }
-        subEdge->leftSubVertex = leftSubVertex;
-        leftSubVertex->subEdges << subEdge;
-
-        // assign its right subcomplex vertex (create it if doesn't exist yet)
-        Vertex * endVertex = edge->endVertex(); // we know it's not null since we rejected pure loops
-        SubVertex * rightSubVertex = vertexToSubVertex.value(endVertex, 0); // returns 0 if not found
-        if(!rightSubVertex)
-        {
-            rightSubVertex = new SubVertex(endVertex);
-            subVertices << rightSubVertex;
-            vertexToSubVertex[endVertex] = rightSubVertex;
-        }
-        subEdge->rightSubVertex = rightSubVertex;
-        rightSubVertex->subEdges << subEdge;
     }
 
-    // ===== Compute connected components of subcomplex =====
-
-    while(!remainingEdges.isEmpty())
+    // Then, the connected components made of open edges
+    foreach(const KeyEdgeSet & connectedEdges, components)
     {
-        // New connected component
-        KeyEdgeSet connectedEdges;
-
-        // get the first edge/subEdge of a new connected component
-        Edge * firstEdge = *remainingEdges.begin();
-        SubEdge * firstSubEdge =    edgeToSubEdge[firstEdge];
-
-        // get all subEdges/edges connected to this sub/edge/edge
-        QStack<SubEdge *> toProcess;
-        toProcess.push(firstSubEdge);
-        while(!toProcess.isEmpty())
-        {
-            SubEdge * subEdge = toProcess.top();
-            toProcess.pop();
-
-            // marked means:
-            //  - it has already been removed from remainingEdges
-            //  - it has already been added to connectedEdges
-            //  - all its neighbours have already been inserted in toProcess (possibly twice)
-
-            if(!subEdge->marked)
-            {
-                // Mark and remove
-                remainingEdges.remove(subEdge->edge);
-                connectedEdges.insert(subEdge->edge);
-                subEdge->marked = true;
-
-                // Insert neighbours in stack
-                foreach(SubEdge * neighbour, subEdge->leftSubVertex->subEdges)
-                    toProcess.push(neighbour);
-                foreach(SubEdge * neighbour, subEdge->rightSubVertex->subEdges)
-                    toProcess.push(neighbour);
-            }
-        }
-
-        // Process connected component
-        connectedComponents_ << SmartConnectedKeyEdgeSet(connectedEdges);
+        if(!(*connectedEdges.begin())->isClosed())
+            connectedComponents_ << SmartConnectedKeyEdgeSet(connectedEdges);
     }
-
-
-    // ===== Release memory =====
-
-    // release memory
-    foreach(SubEdge * subEdge, subEdges)
-        delete subEdge;
-    foreach(SubVertex * subVertex, subVertices)
-        delete subVertex;
 }
 
 int SmartKeyEdgeSet::numConnectedComponents() const
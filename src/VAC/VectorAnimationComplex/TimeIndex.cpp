@@ -0,0 +1,233 @@
+// Copyright (C) 2012-2019 The VPaint Developers.
+// See the COPYRIGHT file at the top-level directory of this distribution
+// and at https://github.com/dalboris/vpaint/blob/master/COPYRIGHT
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "TimeIndex.h"
+
+#include "CellStore.h"
+#include "KeyVertex.h"
+#include "KeyEdge.h"
+#include "KeyFace.h"
+#include "InbetweenVertex.h"
+#include "InbetweenEdge.h"
+#include "InbetweenFace.h"
+
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+namespace VectorAnimationComplex
+{
+
+namespace
+{
+
+template <class T>
+bool idLess(T * c1, T * c2)
+{
+    return c1->id() < c2->id();
+}
+
+template <class TList, class TRange>
+void insertKeyCells(TList & others, QHash<int, TList> & byFrame, const TRange & range)
+{
+    for(auto c: range)
+    {
+        Time t = c->time();
+        if(t.type() == Time::ExactFrame)
+            byFrame[t.frame()] << c;
+        else
+            others << c;
+    }
+}
+
+template <class TIntervals, class TRange>
+void insertInbetweenCells(TIntervals & intervals, const TRange & range)
+{
+    for(auto c: range)
+    {
+        typename TIntervals::value_type interval;
+        interval.start = c->beforeTime().floatTime();
+        interval.end = c->afterTime().floatTime();
+        interval.cell = c;
+        intervals.push_back(interval);
+    }
+}
+
+}
+
+TimeIndex::TimeIndex() :
+    isValid_(false),
+    revision_(0)
+{
+}
+
+void TimeIndex::invalidate()
+{
+    isValid_ = false;
+}
+
+void TimeIndex::update(const CellStore & cells)
+{
+    if(isValid_ && revision_ == cells.revision())
+        return;
+
+    keyVertices_.clear();
+    keyEdges_.clear();
+    keyFaces_.clear();
+    inbetweenVertices_.clear();
+    inbetweenEdges_.clear();
+    inbetweenFaces_.clear();
+
+    insertKeyCells(keyVertices_.others, keyVertices_.byFrame, cells.keyVertices());
+    insertKeyCells(keyEdges_.others, keyEdges_.byFrame, cells.keyEdges());
+    insertKeyCells(keyFaces_.others, keyFaces_.byFrame, cells.keyFaces());
+
+    insertInbetweenCells(inbetweenVertices_.intervals, cells.inbetweenVertices());
+    insertInbetweenCells(inbetweenEdges_.intervals, cells.inbetweenEdges());
+    insertInbetweenCells(inbetweenFaces_.intervals, cells.inbetweenFaces());
+    inbetweenVertices_.build();
+    inbetweenEdges_.build();
+    inbetweenFaces_.build();
+
+    isValid_ = true;
+    revision_ = cells.revision();
+}
+
+KeyVertexList TimeIndex::keyVertices(Time time) const
+{
+    return keyVertices_.at(time);
+}
+
+KeyEdgeList TimeIndex::keyEdges(Time time) const
+{
+    return keyEdges_.at(time);
+}
+
+KeyFaceList TimeIndex::keyFaces(Time time) const
+{
+    return keyFaces_.at(time);
+}
+
+InbetweenVertexList TimeIndex::inbetweenVertices(Time time) const
+{
+    return inbetweenVertices_.at(time);
+}
+
+InbetweenEdgeList TimeIndex::inbetweenEdges(Time time) const
+{
+    return inbetweenEdges_.at(time);
+}
+
+InbetweenFaceList TimeIndex::inbetweenFaces(Time time) const
+{
+    return inbetweenFaces_.at(time);
+}
+
+template <class TList>
+void TimeIndex::KeyCells<TList>::clear()
+{
+    byFrame.clear();
+    others.clear();
+}
+
+template <class TList>
+TList TimeIndex::KeyCells<TList>::at(Time time) const
+{
+    TList res;
+    if(time.type() == Time::ExactFrame)
+        res = byFrame.value(time.frame()); // shallow copy
+
+    // Only detach if some key cell not at an exact frame exists at time
+    bool isSorted = true;
+    for(auto c: others)
+    {
+        if(c->exists(time))
+        {
+            res << c;
+            isSorted = false;
+        }
+    }
+    if(!isSorted)
+        std::sort(res.begin(), res.end(), idLess<typename std::remove_pointer<typename TList::value_type>::type>);
+
+    return res;
+}
+
+template <class TList>
+void TimeIndex::InbetweenCells<TList>::clear()
+{
+    intervals.clear();
+    maxEnd.clear();
+}
+
+template <class TList>
+void TimeIndex::InbetweenCells<TList>::build()
+{
+    std::sort(intervals.begin(), intervals.end(),
+              [](const Interval & a, const Interval & b) { return a.start < b.start; });
+    maxEnd.resize(intervals.size());
+    build_(0, intervals.size());
+}
+
+template <class TList>
+double TimeIndex::InbetweenCells<TList>::build_(int begin, int end)
+{
+    if(begin >= end)
+        return -std::numeric_limits<double>::infinity();
+
+    int mid = (begin + end) / 2;
+    double res = std::max(intervals[mid].end,
+                          std::max(build_(begin, mid), build_(mid+1, end)));
+    maxEnd[mid] = res;
+    return res;
+}
+
+template <class TList>
+TList TimeIndex::InbetweenCells<TList>::at(Time time) const
+{
+    TList res;
+    query_(0, intervals.size(), time, res);
+    std::sort(res.begin(), res.end(), idLess<typename std::remove_pointer<TPtr>::type>);
+    return res;
+}
+
+template <class TList>
+void TimeIndex::InbetweenCells<TList>::query_(int begin, int end, Time time, TList & out) const
+{
+    // Intervals are tested inclusively, since two times with equal
+    // floatTime() may still compare as different, e.g. JustAfterFrame(5)
+    // and FloatTime(5+1e-10). Then exists() decides.
+    const double t = time.floatTime();
+    if(begin >= end)
+        return;
+
+    int mid = (begin + end) / 2;
+    if(maxEnd[mid] < t)
+        return;
+
+    query_(begin, mid, time, out);
+
+    const Interval & interval = intervals[mid];
+    if(interval.start <= t)
+    {
+        if(t <= interval.end && interval.cell->exists(time))
+            out << interval.cell;
+        query_(mid+1, end, time, out);
+    }
+}
+
+}
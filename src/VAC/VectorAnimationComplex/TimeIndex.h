@@ -0,0 +1,121 @@
+// Copyright (C) 2012-2019 The VPaint Developers.
+// See the COPYRIGHT file at the top-level directory of this distribution
+// and at https://github.com/dalboris/vpaint/blob/master/COPYRIGHT
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef VAC_TIME_INDEX_H
+#define VAC_TIME_INDEX_H
+
+// TimeIndex: the cells of a VAC, indexed by time
+//
+// Key cells are bucketed by frame, so that the key cells existing at a given
+// frame are returned without iterating over the whole VAC. The lists of each
+// bucket are returned as implicitly shared QLists, i.e., no copy is made
+// unless the caller modifies them.
+//
+// Inbetween cells are stored in a static interval tree: intervals are sorted
+// by start time in an array, which is seen as a balanced binary tree (the
+// root of a subarray is its middle element), and each node stores the max end
+// time of its subtree. Querying the inbetween cells existing at a given time
+// is then O(log n + k).
+//
+// Intervals are computed from floatTime(), and candidates are confirmed with
+// Cell::exists(), so that queries return exactly the cells that exist at the
+// given time, by increasing ID.
+//
+// The index is rebuilt lazily by update(), when cells have been inserted or
+// removed from the CellStore since the last update, or when invalidate() has
+// been called, e.g. because the time of a key cell changed.
+
+#include <QHash>
+#include <vector>
+#include "CellList.h"
+#include "../TimeDef.h"
+
+namespace VectorAnimationComplex
+{
+
+class CellStore;
+
+class TimeIndex
+{
+public:
+    TimeIndex();
+
+    // Mark the index as out of date
+    void invalidate();
+
+    // Rebuild the index if it is out of date
+    void update(const CellStore & cells);
+
+    // Cells existing at the given time, by increasing ID. The index must be
+    // up to date.
+    KeyVertexList keyVertices(Time time) const;
+    KeyEdgeList keyEdges(Time time) const;
+    KeyFaceList keyFaces(Time time) const;
+    InbetweenVertexList inbetweenVertices(Time time) const;
+    InbetweenEdgeList inbetweenEdges(Time time) const;
+    InbetweenFaceList inbetweenFaces(Time time) const;
+
+private:
+    // Key cells of a given type, bucketed by frame. Key cells whose time is
+    // not an exact frame (in practice, never) are stored separately.
+    template <class TList>
+    struct KeyCells
+    {
+        QHash<int, TList> byFrame;
+        TList others;
+
+        void clear();
+        TList at(Time time) const;
+    };
+
+    // Inbetween cells of a given type, in a static interval tree
+    template <class TList>
+    struct InbetweenCells
+    {
+        typedef typename TList::value_type TPtr;
+        struct Interval
+        {
+            double start;
+            double end;
+            TPtr cell;
+        };
+        std::vector<Interval> intervals; // sorted by start
+        std::vector<double> maxEnd;      // max end of the subtree rooted at i
+
+        void clear();
+        void build();
+        TList at(Time time) const;
+
+    private:
+        double build_(int begin, int end);
+        void query_(int begin, int end, Time time, TList & out) const;
+    };
+
+    bool isValid_;
+    quint64 revision_;
+
+    KeyCells<KeyVertexList> keyVertices_;
+    KeyCells<KeyEdgeList> keyEdges_;
+    KeyCells<KeyFaceList> keyFaces_;
+    InbetweenCells<InbetweenVertexList> inbetweenVertices_;
+    InbetweenCells<InbetweenEdgeList> inbetweenEdges_;
+    InbetweenCells<InbetweenFaceList> inbetweenFaces_;
+};
+
+}
+
+#endif // VAC_TIME_INDEX_H
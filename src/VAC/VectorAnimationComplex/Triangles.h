@@ -90,6 +90,7 @@ public:
     // Access and modify content
     inline int size() const {return (int)triangles_.size();}
     inline Triangle & operator[] (int i) {return triangles_[i];}
+    inline const Triangle & operator[] (int i) const {return triangles_[i];}
 
     // Access raw data
     inline double * data() {return reinterpret_cast<double*>(triangles_.data());}
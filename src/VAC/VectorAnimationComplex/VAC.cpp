@@ -38,8 +38,10 @@
 #include "EdgeSample.h"
 #include "EdgeGeometry.h"
 #include "Intersection.h"
+#include "Rasterizer.h"
 
 #include "../GLUtils.h"
+#include "../Profiler.h"
 #include "../Timeline.h"
 #include "../SaveAndLoad.h"
 #include "../DevSettings.h"
@@ -53,12 +55,20 @@
 #include "../XmlStreamReader.h"
 
 #include <QPair>
+#include <QVector>
 #include <QtDebug>
 #include <QApplication>
 #include <QMessageBox>
 #include <QStatusBar>
 #include <QColorDialog>
 #include <QInputDialog>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <vector>
 
 #define MYDEBUG 0
 
@@ -72,190 +82,158 @@ namespace
 
 const double PI = 3.14159;
 
-bool isCycleContainedInFace(const Cycle & cycle, const PreviewKeyFace & face)
-{
-    // Get edges involved in cycle
-    KeyEdgeSet cycleEdges = cycle.cells();
+// Below this number of cells, reading a VAC is done in the calling thread
+const int MIN_CELLS_FOR_PARALLEL_READ = 1000;
 
-    // Compute total length of edges
-    double totalLength = 0;
-    foreach (KeyEdge * edge, cycleEdges)
-        totalLength += edge->geometry()->length();
+// Number of cells processed by each task when reading a VAC in parallel
+const int READ_BATCH_SIZE = 256;
 
-    // Compute percentage of edges inside face, based on approximately N samples
-    double N = 100;
-    double ds = totalLength / N;
-    double nInside = 0;
-    double nOutside = 0;
-    foreach (KeyEdge * edge, cycleEdges)
+// Calls f(i) for all i in [0, n), either in the calling thread or in
+// parallel on the global thread pool, by batches of batchSize indices
+template <class F>
+void forEachIndex(int n, int batchSize, bool isParallel, F f)
+{
+    if(!isParallel)
     {
-        EdgeGeometry * geometry = edge->geometry();
-        double L = geometry->length();
-        for(double s=0; s<L; s+=ds)
-        {
-            Eigen::Vector2d p = geometry->pos2d(s);
-            if(face.intersects(p[0],p[1]))
-            {
-                nInside++;
-            }
-            else
-            {
-                nOutside++;
-            }
-        }
+        for(int i=0; i<n; ++i)
+            f(i);
     }
-    if(nInside > nOutside)
-        return true;
     else
-        return false;
-}
-
-// return invalid cycle if not found
-Cycle findClosestPlanarCycle(QSet<KeyEdge*> & potentialEdges,
-                                    QMap<KeyEdge*,EdgeGeometry::ClosestVertexInfo> & distancesToEdges, double x, double y)
-{
-    while(!potentialEdges.isEmpty())
     {
-        // Find closest potential edge
-        KeyEdge * closestPotentialEdge = 0;
-        EdgeGeometry::ClosestVertexInfo cvi;
-        cvi.s = 0;
-        cvi.d = std::numeric_limits<double>::max();
-        foreach(KeyEdge * e, potentialEdges)
-        {
-            EdgeGeometry::ClosestVertexInfo cvi_e = distancesToEdges[e];
-            if(cvi_e.d < cvi.d)
-            {
-                closestPotentialEdge = e;
-                cvi = cvi_e;
-            }
-        }
-
-        // Compute direction of halfedge
-        Eigen::Vector2d der = closestPotentialEdge->geometry()->der(cvi.s);
-        double cross = der[0] * (y - cvi.p.y()) - der[1] * (x - cvi.p.x());
-        KeyHalfedge h(closestPotentialEdge, (cross>0 ? false : true) ); // Note: canvas is left-handed
-
-        // Case where closestPotentialEdge is closed
-        if(closestPotentialEdge->isClosed())
-        {
-            KeyEdgeSet edgeSet;
-            edgeSet << closestPotentialEdge;
-            Cycle cycle(edgeSet);
-            if(cycle.isValid())
-            {
-                return cycle;
-            }
-            else
-            {
-                potentialEdges.remove(closestPotentialEdge);
-            }
-        }
-
-        // Case where closestPotentialEdge is open
-        else
+        QVector<int> batches;
+        for(int i=0; i<n; i+=batchSize)
+            batches << i;
+        QtConcurrent::blockingMap(batches, [n, batchSize, &f](int begin)
         {
-            // First halfedge of non-simple-cycle
-            KeyHalfedge h0 = h;
-            QList<KeyHalfedge> potentialPlanarCycle;
-            potentialPlanarCycle << h;
+            int end = std::min(n, begin+batchSize);
+            for(int i=begin; i<end; ++i)
+                f(i);
+        });
+    }
+}
 
-            // Find the corresponding planar map cycle
-            int maxIter = 2 * potentialEdges.size() + 2;
-            bool foundPotentialPlanarCycle = false;
-            for(int i=0; i<maxIter; i++)
-            {
-                // Find next halfedge in cycle
-                h = h.next();
+// Drawing revisions are shared by all VACs, so that a VAC never reuses the
+// revisions of another VAC, e.g. one previously allocated at the same address
+std::atomic<quint64> lastDrawingRevision(0);
 
-                // Check it has not already been rejected
-                if(!potentialEdges.contains(h.edge))
-                {
-                    break;
-                }
+quint64 newDrawingRevision()
+{
+    return ++lastDrawingRevision;
+}
 
-                // Test if cycle completed or not
-                if(h == h0)
-                {
-                    // Cycle completed: leave loop
-                    foundPotentialPlanarCycle = true;
-                    break;
-                }
-                else
-                {
-                    // Cycle not completed: insert and iterate
-                    potentialPlanarCycle << h;
-                }
-            }
+// Above this number of time ranges, drawing changes are forgotten and
+// everything is considered changed
+const int MAX_DRAWING_CHANGES = 1000;
+const int MAX_CHANGED_CELLS = 10000;
 
-            // If not found (maxIter reached or edge already rejected)
-            if(!foundPotentialPlanarCycle)
-            {
-                foreach(KeyHalfedge he, potentialPlanarCycle)
-                {
-                    potentialEdges.remove(he.edge);
-                }
-            }
-            else
-            {
-                Cycle cycle(potentialPlanarCycle);
-                if(cycle.isValid())
-                {
-                    return cycle;
-                }
-                else
-                {
-                    foreach(KeyHalfedge he, potentialPlanarCycle)
-                    {
-                        potentialEdges.remove(he.edge);
-                    }
-                }
-            }
-        }
+// Returns the closed time range where the cell may be drawn
+QPair<double, double> drawingTimeRange(Cell * cell)
+{
+    KeyCell * keyCell = cell->toKeyCell();
+    if(keyCell)
+    {
+        double t = keyCell->time().floatTime();
+        return qMakePair(t, t);
+    }
+    else
+    {
+        InbetweenCell * inbetweenCell = cell->toInbetweenCell();
+        return qMakePair(inbetweenCell->beforeTime().floatTime(),
+                         inbetweenCell->afterTime().floatTime());
     }
-
-    return Cycle();
 }
 
-bool addHoleToPaintedFace(QSet<KeyEdge*> & potentialHoleEdges,
-                          PreviewKeyFace & toBePaintedFace,
-                          QMap<KeyEdge*,EdgeGeometry::ClosestVertexInfo> & distancesToEdges,
-                          double x, double y)
+// Returns whether the cell must be drawn when only the given region, if
+// any, is redrawn
+bool isInRegion(Cell * cell, Time time, const ViewSettings & viewSettings,
+                const BoundingBox * region)
 {
-    while(!potentialHoleEdges.isEmpty())
-    {
-        // Find closest planar cycle
-        Cycle cycle = findClosestPlanarCycle(potentialHoleEdges, distancesToEdges, x, y);
-
-        // Returns directly if no planar cycle found, otherwise, proceed.
-        if(!cycle.isValid())
-        {
-            return false;
-        }
+    return !region || (cell->exists(time) &&
+                       cell->drawnBoundingBox(time, viewSettings).intersects(*region));
+}
 
-        // Remove potential edges
-        KeyEdgeSet cycleEdges = cycle.cells();
-        potentialHoleEdges.subtract(cycleEdges);
+typedef std::vector<SculptCurve::Curve<EdgeSample>,
+                    Eigen::aligned_allocator<SculptCurve::Curve<EdgeSample> > > CurveVector;
 
-        // Create face from cycle for geometric query
-        PreviewKeyFace face;
-        face << cycle;
+// Returns the geometry of the key edge as a curve, as used to compute
+// intersections with a sketched edge
+SculptCurve::Curve<EdgeSample> sketchCurve(KeyEdge * iedge, double ds)
+{
+    EdgeGeometry * geometry = iedge->geometry();
+    LinearSpline * linearSpline = dynamic_cast<LinearSpline *>(geometry);
+    if(linearSpline)
+        return linearSpline->constCurve();
 
-        // Check if the planar cycle should be added as a hole or not
-        if(!face.intersects(x,y) && isCycleContainedInFace(cycle,toBePaintedFace))
-        {
-            // Add it as a hole
-            toBePaintedFace << cycle;
-            return true;
-        }
+    QList<Eigen::Vector2d> eigenSampling = geometry->sampling(ds);
+    std::vector<EdgeSample,Eigen::aligned_allocator<EdgeSample> > vertices;
+    for(int i=0; i<eigenSampling.size(); ++i)
+        vertices << EdgeSample(eigenSampling[i][0], eigenSampling[i][1], 10); // todo: get actual width
+    SculptCurve::Curve<EdgeSample> res;
+    res.setVertices(vertices);
+    return res;
+}
 
-    }// end while( !( found external boundary || isEmpty) )
+// Same for an inbetween edge at the given time
+SculptCurve::Curve<EdgeSample> sketchCurve(InbetweenEdge * sedge, Time time)
+{
+    QList<EdgeSample> sampling = sedge->getSampling(time);
+    std::vector<EdgeSample,Eigen::aligned_allocator<EdgeSample> > stdSampling;
+    for(int i=0; i<sampling.size(); ++i)
+        stdSampling << sampling[i];
+    SculptCurve::Curve<EdgeSample> res;
+    res.setVertices(stdSampling);
+    return res;
+}
 
-    return false;
+bool haveSameVertices(const SculptCurve::Curve<EdgeSample> & a,
+                      const SculptCurve::Curve<EdgeSample> & b)
+{
+    if(a.size() != b.size())
+        return false;
+    for(int i=0; i<a.size(); ++i)
+    {
+        EdgeSample u = a[i];
+        EdgeSample v = b[i];
+        if(u.x() != v.x() || u.y() != v.y() || u.width() != v.width())
+            return false;
+    }
+    return true;
 }
 
 } // end of namespace
 
+// Input and output of the computation of the intersections of a sketched
+// edge. The input is copied in the GUI thread, so that the computation may
+// run in a worker thread while the VAC is used.
+struct VAC::SketchIntersections
+{
+    // Input
+    SculptCurve::Curve<EdgeSample> sketchedCurve;
+    Time time;
+    double tolerance;
+    bool planarMapMode;
+    std::vector<int> edgeIds; // key edges and inbetween edges near the sketched edge
+    CurveVector edgeCurves;   // their geometry at time
+
+    // Output
+    std::vector<SculptCurve::Intersection> selfIntersections;
+    std::vector< std::vector<SculptCurve::Intersection> > edgeIntersections;
+
+    // Whether the input is the same as other's
+    bool hasSameInput(const SketchIntersections & other) const
+    {
+        if(tolerance != other.tolerance ||
+           planarMapMode != other.planarMapMode ||
+           edgeIds != other.edgeIds ||
+           !haveSameVertices(sketchedCurve, other.sketchedCurve))
+            return false;
+        for(size_t i=0; i<edgeCurves.size(); ++i)
+            if(!haveSameVertices(edgeCurves[i], other.edgeCurves[i]))
+                return false;
+        return true;
+    }
+};
+
 
 
     // ----------------- Constructors & Destructors ----------------
@@ -264,6 +242,7 @@ bool addHoleToPaintedFace(QSet<KeyEdge*> & potentialHoleEdges,
 void VAC::initNonCopyable()
 {
     drawRectangleOfSelection_ = false;
+    isInteracting_ = false;
     sketchedEdge_ = 0;
     hoveredFaceOnMousePress_ = 0;
     hoveredFaceOnMouseRelease_ = 0;
@@ -280,16 +259,23 @@ void VAC::initCopyable()
 {
     setMaxID_(-1);
     ds_ = 5.0;
+    samplingTolerance_ = 0.0;
     cells_.clear();
     zOrdering_.clear();
+    setAllDrawingChanged_();
 }
 
 
 VAC::VAC() :
-    SceneObject()
+    SceneObject(),
+    batchEditCounter_(0),
+    wereSignalsBlocked_(false),
+    isBatchDrawingChanged_(false),
+    isBatchSelectionChanged_(false)
 {
     initNonCopyable();
     initCopyable();
+    connect(&pendingSketchWatcher_, SIGNAL(finished()), this, SLOT(onSketchIntersectionsComputed_()));
 }
 
 VAC::~VAC()
@@ -313,16 +299,18 @@ VAC * VAC::clone()
 
     // Copy sampling precision
     newVAC->ds_ = ds_;
+    newVAC->samplingTolerance_ = samplingTolerance_;
 
     // Copy cells
-    foreach(Cell * cell, cells_)
+    for(Cell * cell: cells_)
     {
         Cell * newCell = cell->clone();
-        newVAC->cells_[newCell->id()] = newCell;
+        newVAC->cells_.insert(newCell);
         newCell->setSelected(false);
         newCell->setHovered(false);
     }
-    foreach(Cell * newCell, newVAC->cells_)
+    newVAC->cells_.copyGenerations(cells_);
+    for(Cell * newCell: newVAC->cells_)
         newCell->remapPointers(newVAC);
     for(auto c: zOrdering_)
         newVAC->zOrdering_.insertLast(newVAC->getCell(c->id()));
@@ -338,19 +326,21 @@ QMap<int,int> VAC::import(VAC * other, bool selectImportedCells)
     // Create copy
     VAC * copyOfOther = other->clone();
 
-    // Create copy of zOrdering, since removing cells
-    // from copyOfOther invalidate iteration on zOrdering
+    // Take ownership of all cells. The copy has no selected or hovered
+    // cells, so it can simply forget all its cells rather than removing
+    // them one by one.
     QList<Cell*> ordering;
     for(auto c: copyOfOther->zOrdering_)
     {
         ordering << c;
     }
-
-    // Take ownership of all cells
+    copyOfOther->zOrdering_.clear();
+    copyOfOther->cells_.clear();
+    BatchEdit batchEdit(this);
+    batchEdit.reserve(ordering.size());
     foreach(Cell * c, ordering)
     {
         int oldID = c->id();
-        copyOfOther->removeCell_(c);
         insertCellLast_(c);
         if(selectImportedCells)
             addToSelection(c,false);
@@ -488,6 +478,16 @@ void VAC::drawTopologySketchedEdge(Time time, ViewSettings & viewSettings) const
 
 void VAC::draw(Time time, ViewSettings & viewSettings)
 {
+    ProfilerScope profilerScope("VAC::draw");
+
+    drawCells(time, viewSettings);
+    drawOverlay(time, viewSettings);
+}
+
+void VAC::drawCells(Time time, ViewSettings & viewSettings, const BoundingBox * region)
+{
+    ProfilerScope profilerScope("VAC::drawCells");
+
     ViewSettings::DisplayMode displayMode = viewSettings.displayMode();
 
     // Illustration mode
@@ -495,11 +495,10 @@ void VAC::draw(Time time, ViewSettings & viewSettings)
     {
         // Draw all cells
         for(auto c: zOrdering_)
-            c->draw(time, viewSettings);
-
-        // Draw sketched edge
-        if(sketchedEdge_)
-            drawSketchedEdge(time, viewSettings);
+        {
+            if(isInRegion(c, time, viewSettings, region))
+                c->draw(time, viewSettings);
+        }
     }
 
     // Outline only mode
@@ -507,11 +506,10 @@ void VAC::draw(Time time, ViewSettings & viewSettings)
     {
         // Draw all cells
         for(auto c: zOrdering_)
-            c->drawTopology(time, viewSettings);
-
-        // Draw sketched edge
-        if(sketchedEdge_)
-            drawTopologySketchedEdge(time, viewSettings);
+        {
+            if(isInRegion(c, time, viewSettings, region))
+                c->drawTopology(time, viewSettings);
+        }
     }
 
     // Illustration + Outline mode
@@ -519,20 +517,42 @@ void VAC::draw(Time time, ViewSettings & viewSettings)
     {
         // First pass
         for(auto c: zOrdering_)
-            c->draw(time, viewSettings);
-        if(sketchedEdge_)
-            drawSketchedEdge(time, viewSettings);
+        {
+            if(isInRegion(c, time, viewSettings, region))
+                c->draw(time, viewSettings);
+        }
 
         // Second pass
         for(auto c: zOrdering_)
-            c->drawTopology(time, viewSettings);
-        if(sketchedEdge_)
+        {
+            if(isInRegion(c, time, viewSettings, region))
+                c->drawTopology(time, viewSettings);
+        }
+    }
+}
+
+void VAC::drawOverlay(Time time, ViewSettings & viewSettings)
+{
+    ViewSettings::DisplayMode displayMode = viewSettings.displayMode();
+
+    // Draw sketched edge
+    if(sketchedEdge_)
+    {
+        if(displayMode == ViewSettings::ILLUSTRATION ||
+           displayMode == ViewSettings::ILLUSTRATION_OUTLINE)
+        {
+            drawSketchedEdge(time, viewSettings);
+        }
+        if(displayMode == ViewSettings::OUTLINE ||
+           displayMode == ViewSettings::ILLUSTRATION_OUTLINE)
+        {
             drawTopologySketchedEdge(time, viewSettings);
+        }
     }
 
-    // Draw to be painted face
+    // Draw to be painted face, only once (i.e., not in onion skins)
     if( (global()->toolMode() == Global::PAINT) &&
-            toBePaintedFace_)
+            toBePaintedFace_ && viewSettings.isMainDrawing())
     {
         toBePaintedFace_->draw(viewSettings);
     }
@@ -718,8 +738,89 @@ void VAC::draw(Time time, ViewSettings & viewSettings)
     }
 }
 
-void VAC::drawPick(Time time, ViewSettings & viewSettings)
+void VAC::rasterize(Time time, Rasterizer & rasterizer)
+{
+    // Same as draw() in illustration mode, ignoring highlighting and
+    // selection. Note that vertices are never drawn in this case.
+    for(auto c: zOrdering_)
+    {
+        if(!c->toVertexCell() && c->exists(time))
+            rasterizer.fill(c->triangles(time), c->color());
+    }
+
+    // Flush now, since the rasterizer references the cached triangles,
+    // which may be invalidated by subsequent calls to triangles()
+    rasterizer.flush();
+}
+
+quint64 VAC::drawingRevision() const
+{
+    return drawingRevision_;
+}
+
+bool VAC::isDrawingChangedSince(quint64 revision, Time time) const
 {
+    if(revision < drawingBaseRevision_)
+        return true;
+
+    // Time ranges are sorted by start time
+    const double t = time.floatTime();
+    for(auto it = drawingChanges_.cbegin(); it != drawingChanges_.cend(); ++it)
+    {
+        if(it.key().first > t)
+            break;
+        if(t <= it.key().second && it.value() > revision)
+            return true;
+    }
+    return false;
+}
+
+bool VAC::changedCellsSince(quint64 revision, QSet<int> & ids) const
+{
+    if(revision < drawingBaseRevision_)
+        return false;
+
+    for(int i=changedCells_.size()-1; i>=0 && changedCells_[i].first > revision; --i)
+        ids.insert(changedCells_[i].second);
+    return true;
+}
+
+void VAC::setDrawingChanged_(Cell * cell)
+{
+    if(batchEditCounter_ > 0)
+    {
+        isBatchDrawingChanged_ = true;
+        return;
+    }
+
+    drawingRevision_ = newDrawingRevision();
+    drawingChanges_[drawingTimeRange(cell)] = drawingRevision_;
+    changedCells_ << qMakePair(drawingRevision_, cell->id());
+    if(drawingChanges_.size() > MAX_DRAWING_CHANGES ||
+       changedCells_.size() > MAX_CHANGED_CELLS)
+    {
+        setAllDrawingChanged_();
+    }
+}
+
+void VAC::setDrawingChanged_(const CellSet & cells)
+{
+    for(Cell * cell: cells)
+        setDrawingChanged_(cell);
+}
+
+void VAC::setAllDrawingChanged_()
+{
+    drawingChanges_.clear();
+    changedCells_.clear();
+    drawingRevision_ = newDrawingRevision();
+    drawingBaseRevision_ = drawingRevision_;
+}
+
+void VAC::drawPick(Time time, ViewSettings & viewSettings, const BoundingBox * region)
+{
+    ProfilerScope profilerScope("VAC::drawPick");
+
     ViewSettings::DisplayMode displayMode = viewSettings.displayMode();
 
     if( (displayMode == ViewSettings::ILLUSTRATION) )
@@ -727,7 +828,8 @@ void VAC::drawPick(Time time, ViewSettings & viewSettings)
         // Draw all cells
         for(auto c: zOrdering_)
         {
-            c->drawPick(time, viewSettings);
+            if(isInRegion(c, time, viewSettings, region))
+                c->drawPick(time, viewSettings);
         }
     }
 
@@ -736,7 +838,8 @@ void VAC::drawPick(Time time, ViewSettings & viewSettings)
         // Draw all cells
         for(auto c: zOrdering_)
         {
-            c->drawPickTopology(time, viewSettings);
+            if(isInRegion(c, time, viewSettings, region))
+                c->drawPickTopology(time, viewSettings);
         }
     }
 
@@ -745,7 +848,7 @@ void VAC::drawPick(Time time, ViewSettings & viewSettings)
         // first pass: pick faces normally
         for(auto c: zOrdering_)
         {
-            if(c->toFaceCell())
+            if(c->toFaceCell() && isInRegion(c, time, viewSettings, region))
                 c->drawPick(time, viewSettings);
         }
 
@@ -753,7 +856,7 @@ void VAC::drawPick(Time time, ViewSettings & viewSettings)
         // second pass: pick vertices and edges as outline
         for(auto c: zOrdering_)
         {
-            if(!c->toFaceCell())
+            if(!c->toFaceCell() && isInRegion(c, time, viewSettings, region))
                 c->drawPickTopology(time, viewSettings);
         }
     }
@@ -768,7 +871,11 @@ void VAC::drawPick(Time time, ViewSettings & viewSettings)
 
 void VAC::emitSelectionChanged_()
 {
-    if(signalCounter_ == 0)
+    if(batchEditCounter_ > 0)
+    {
+        isBatchSelectionChanged_ = true;
+    }
+    else if(signalCounter_ == 0)
     {
         transformTool_.setCells(selectedCells());
         emit selectionChanged();
@@ -797,9 +904,79 @@ void VAC::endAggregateSignals_()
     if(signalCounter_ == 0)
     {
         if(shouldEmitSelectionChanged_)
+        {
+            if(batchEditCounter_ > 0)
+            {
+                isBatchSelectionChanged_ = true;
+            }
+            else
+            {
+                transformTool_.setCells(selectedCells());
+                emit selectionChanged();
+            }
+        }
+    }
+}
+
+VAC::BatchEdit::BatchEdit(VAC * vac) :
+    vac_(vac)
+{
+    vac_->beginBatchEdit_();
+}
+
+VAC::BatchEdit::~BatchEdit()
+{
+    vac_->endBatchEdit_();
+}
+
+void VAC::BatchEdit::reserve(int numCells)
+{
+    vac_->cells_.reserve(vac_->maxID_ + numCells);
+    vac_->batchInsertedCells_.reserve(vac_->batchInsertedCells_.size() + numCells);
+}
+
+void VAC::beginBatchEdit_()
+{
+    if(batchEditCounter_ == 0)
+    {
+        wereSignalsBlocked_ = blockSignals(true);
+        isBatchDrawingChanged_ = false;
+        isBatchSelectionChanged_ = false;
+    }
+
+    batchEditCounter_++;
+}
+
+void VAC::endBatchEdit_()
+{
+    batchEditCounter_--;
+
+    if(batchEditCounter_ == 0)
+    {
+        // Insert created cells in the z-ordering, in creation order, which
+        // gives the same z-ordering as inserting them one by one. Cells
+        // deleted during the batch are not in cells_ anymore.
+        for(const BatchInsertedCell & c: batchInsertedCells_)
+        {
+            if(cells_.cell(c.id) == c.cell)
+            {
+                if(c.isLast)
+                    zOrdering_.insertLast(c.cell);
+                else
+                    zOrdering_.insertCell(c.cell);
+            }
+        }
+        batchInsertedCells_.clear();
+
+        if(isBatchDrawingChanged_)
+            setAllDrawingChanged_();
+
+        blockSignals(wereSignalsBlocked_);
+        if(isBatchSelectionChanged_)
         {
             transformTool_.setCells(selectedCells());
             emit selectionChanged();
+            informTimelineOfSelection();
         }
     }
 }
@@ -883,12 +1060,32 @@ int VAC::hoveredTransformWidgetId() const
 
 void VAC::write(XmlStreamWriter & xml)
 {
+    // Write compacted IDs, i.e. 0, 1, 2, ... in z-order. IDs are only
+    // changed while writing, since other VACs (e.g., the clipboard for
+    // motion-paste) may refer to the cells of this VAC by their IDs.
+    QVector<int> ids;
+    ids.reserve(cells_.size());
+    int compactId = 0;
+    for(Cell * cell: zOrdering_)
+    {
+        ids << cell->id_;
+        cell->id_ = compactId++;
+    }
+
     for(Cell * cell: zOrdering_)
         cell->write(xml);
+
+    int i = 0;
+    for(Cell * cell: zOrdering_)
+        cell->id_ = ids[i++];
 }
 
 void VAC::clear()
 {
+    // Discard the pending sketched edge, if any. Its computation may still
+    // be running, but only on its own copy of the geometry.
+    pendingSketch_.reset();
+
     deleteAllCells();
     initNonCopyable();
     initCopyable();
@@ -922,7 +1119,7 @@ void VAC::read(XmlStreamReader & xml)
             int id = cell->id();
             if(id > maxID_)
                 setMaxID_(id);
-            cells_.insert(id, cell);
+            cells_.insert(cell);
             zOrdering_.insertLast(cell);
         }
     }
@@ -932,35 +1129,68 @@ void VAC::read(XmlStreamReader & xml)
 
 void VAC::read2ndPass_()
 {
-    // Convert temp IDs (int) to pointers (Cell*)
-    foreach(Cell * cell, cells_)
-        cell->read2ndPass();
-
-    // Create star from boundary
-    foreach(Cell * cell, cells_)
+    // All passes below are done in parallel, and give exactly the same VAC
+    // as doing them serially. This is possible because each cell only
+    // modifies itself, except when creating stars (see below).
+    std::vector<Cell*> cells;
+    cells.reserve(cells_.size());
+    for(Cell * cell: cells_)
+        cells.push_back(cell);
+    const int n = cells.size();
+    const bool isParallel = n >= MIN_CELLS_FOR_PARALLEL_READ;
+
+    // Convert temp IDs (int) to pointers (Cell*), and parse edge geometry.
+    // This only reads cells_, which is not modified in the meantime.
+    forEachIndex(n, READ_BATCH_SIZE, isParallel, [&cells](int i)
+    {
+        cells[i]->read2ndPass();
+    });
+
+    // Create star from boundary. Each cell adds itself to the star of its
+    // boundary cells, therefore boundary cells are split into shards, each
+    // processed by a single task. Within a shard, cells are processed by
+    // increasing ID like in the serial case, so that each star is built by
+    // the same sequence of insertions, and ends up with the same iteration
+    // order.
+    struct Boundary { CellSet spatial, before, after; };
+    std::vector<Boundary> boundaries(n);
+    forEachIndex(n, READ_BATCH_SIZE, isParallel, [&cells, &boundaries](int i)
+    {
+        boundaries[i].spatial = cells[i]->spatialBoundary();
+        boundaries[i].before = cells[i]->beforeCells();
+        boundaries[i].after = cells[i]->afterCells();
+    });
+    const int numShards = isParallel ? std::max(1, QThreadPool::globalInstance()->maxThreadCount()) : 1;
+    forEachIndex(numShards, 1, isParallel, [&cells, &boundaries, n, numShards](int shard)
     {
-        CellSet spatialBoundary = cell->spatialBoundary();
-        foreach(Cell * bcell, spatialBoundary)
-            cell->addMeToSpatialStarOf_(bcell);
+        for(int i=0; i<n; ++i)
+        {
+            Cell * cell = cells[i];
+            const Boundary & boundary = boundaries[i];
 
-        CellSet temporalBoundaryBefore = cell->beforeCells();
-        foreach(Cell * bcell, temporalBoundaryBefore)
-            cell->addMeToTemporalStarAfterOf_(bcell);
+            for(Cell * bcell: boundary.spatial)
+                if(bcell->id() % numShards == shard)
+                    cell->addMeToSpatialStarOf_(bcell);
 
-        CellSet temporalBoundaryAfter = cell->afterCells();
-        foreach(Cell * bcell, temporalBoundaryAfter)
-            cell->addMeToTemporalStarBeforeOf_(bcell);
-    }
+            for(Cell * bcell: boundary.before)
+                if(bcell->id() % numShards == shard)
+                    cell->addMeToTemporalStarAfterOf_(bcell);
 
-    // Clean geometry
-    foreach(Cell * cell, cells_)
-    {
-        KeyEdge * kedge = cell->toKeyEdge();
-        if(kedge)
-        {
-            kedge->correctGeometry();
+            for(Cell * bcell: boundary.after)
+                if(bcell->id() % numShards == shard)
+                    cell->addMeToTemporalStarBeforeOf_(bcell);
         }
-    }
+    });
+
+    // Clean geometry. There is no need to notify dependent cells that the
+    // geometry changed, since nothing has been computed from it yet.
+    std::vector<KeyEdge*> keyEdges;
+    for(KeyEdge * kedge: cells_.keyEdges())
+        keyEdges.push_back(kedge);
+    forEachIndex((int)keyEdges.size(), READ_BATCH_SIZE, isParallel, [&keyEdges](int i)
+    {
+        keyEdges[i]->correctGeometry_();
+    });
 }
 
 void VAC::save_(QTextStream & out)
@@ -990,8 +1220,13 @@ void VAC::exportSVG_(Time t, QTextStream & out)
 }
 
 VAC::VAC(QTextStream & in) :
-    SceneObject()
+    SceneObject(),
+    batchEditCounter_(0),
+    wereSignalsBlocked_(false),
+    isBatchDrawingChanged_(false),
+    isBatchSelectionChanged_(false)
 {
+    connect(&pendingSketchWatcher_, SIGNAL(finished()), this, SLOT(onSketchIntersectionsComputed_()));
     clear();
 
     Field field;
@@ -1006,7 +1241,7 @@ VAC::VAC(QTextStream & in) :
         int id = cell->id();
         if(id > maxID_)
             setMaxID_(id);
-        cells_.insert(id, cell);
+        cells_.insert(cell);
         zOrdering_.insertLast(cell);
         Read::skipBracket(in); // }
     }
@@ -1021,10 +1256,7 @@ VAC::VAC(QTextStream & in) :
 
 Cell * VAC::getCell(int id)
 {
-    if(cells_.contains(id))
-        return cells_[id];
-    else
-        return 0;
+    return cells_.cell(id);
 }
 
 KeyVertex * VAC::getKeyVertex(int id)
@@ -1045,24 +1277,50 @@ KeyEdge * VAC::getKeyEdge(int id)
         return 0;
 }
 
-KeyFace * VAC::getKeyFace(int /*id*/)
+KeyFace * VAC::getKeyFace(int id)
 {
-    return 0;
+    Cell * object = getCell(id);
+    if(object)
+        return object->toKeyFace();
+    else
+        return 0;
 }
 
-InbetweenVertex * VAC::getInbetweenVertex(int /*id*/)
+InbetweenVertex * VAC::getInbetweenVertex(int id)
 {
-    return 0;
+    Cell * object = getCell(id);
+    if(object)
+        return object->toInbetweenVertex();
+    else
+        return 0;
+}
+
+InbetweenEdge * VAC::getInbetweenEdge(int id)
+{
+    Cell * object = getCell(id);
+    if(object)
+        return object->toInbetweenEdge();
+    else
+        return 0;
+}
+
+InbetweenFace * VAC::getInbetweenFace(int id)
+{
+    Cell * object = getCell(id);
+    if(object)
+        return object->toInbetweenFace();
+    else
+        return 0;
 }
 
-InbetweenEdge * VAC::getInbetweenEdge(int /*id*/)
+CellHandle VAC::getHandle(Cell * cell) const
 {
-    return 0;
+    return cells_.handle(cell);
 }
 
-InbetweenFace * VAC::getInbetweenFace(int /*id*/)
+Cell * VAC::getCell(const CellHandle & handle)
 {
-    return 0;
+    return cells_.cell(handle);
 }
 
 const ZOrderedCells & VAC::zOrdering() const
@@ -1073,26 +1331,39 @@ const ZOrderedCells & VAC::zOrdering() const
 CellSet VAC::cells()
 {
     CellSet res;
-    foreach(Cell * obj, cells_)
+    for(Cell * obj: cells_)
         res << obj;
     return res;
 }
 
 CellSet VAC::cells(Time time)
 {
+    // Note: lists are stored as const, otherwise iterating over them would
+    // detach them from the lists of the index
+    timeIndex_.update(cells_);
+    const KeyVertexList keyVertices = timeIndex_.keyVertices(time);
+    const KeyEdgeList keyEdges = timeIndex_.keyEdges(time);
+    const KeyFaceList keyFaces = timeIndex_.keyFaces(time);
+    const InbetweenVertexList inbetweenVertices = timeIndex_.inbetweenVertices(time);
+    const InbetweenEdgeList inbetweenEdges = timeIndex_.inbetweenEdges(time);
+    const InbetweenFaceList inbetweenFaces = timeIndex_.inbetweenFaces(time);
+
     CellSet res;
-    foreach(Cell * c, cells_)
-    {
-        if(c->exists(time))
-            res << c;
-    }
+    res.reserve(keyVertices.size() + keyEdges.size() + keyFaces.size() +
+                inbetweenVertices.size() + inbetweenEdges.size() + inbetweenFaces.size());
+    for(Cell * c: keyVertices) res << c;
+    for(Cell * c: keyEdges) res << c;
+    for(Cell * c: keyFaces) res << c;
+    for(Cell * c: inbetweenVertices) res << c;
+    for(Cell * c: inbetweenEdges) res << c;
+    for(Cell * c: inbetweenFaces) res << c;
     return res;
 }
 
 VertexCellList VAC::vertices()
 {
     VertexCellList res;
-    foreach(Cell * o, cells_)
+    for(Cell * o: cells_)
     {
         VertexCell *node = o->toVertexCell();
         if(node)
@@ -1103,19 +1374,15 @@ VertexCellList VAC::vertices()
 KeyVertexList VAC::instantVertices()
 {
     KeyVertexList res;
-    foreach(Cell * o, cells_)
-    {
-        KeyVertex *node = o->toKeyVertex();
-        if(node)
-            res << node;
-    }
+    for(KeyVertex * node: cells_.keyVertices())
+        res << node;
     return res;
 }
 
 EdgeCellList VAC::edges()
 {
     EdgeCellList res;
-    foreach(Cell * o, cells_)
+    for(Cell * o: cells_)
     {
         EdgeCell *edge = o->toEdgeCell();
         if(edge)
@@ -1126,20 +1393,23 @@ EdgeCellList VAC::edges()
 
 EdgeCellList VAC::edges(Time time)
 {
+    timeIndex_.update(cells_);
+    const KeyEdgeList keyEdges = timeIndex_.keyEdges(time);
+    const InbetweenEdgeList inbetweenEdges = timeIndex_.inbetweenEdges(time);
+
     EdgeCellList res;
-    foreach(Cell * o, cells_)
-    {
-        EdgeCell *edge = o->toEdgeCell();
-        if(edge && edge->exists(time))
-            res << edge;
-    }
+    for(KeyEdge * e: keyEdges)
+        res << e;
+    for(InbetweenEdge * e: inbetweenEdges)
+        res << e;
+    std::sort(res.begin(), res.end(), [](EdgeCell * e1, EdgeCell * e2) { return e1->id() < e2->id(); });
     return res;
 }
 
 FaceCellList VAC::faces()
 {
     FaceCellList res;
-    foreach(Cell * o, cells_)
+    for(Cell * o: cells_)
     {
         FaceCell *face = o->toFaceCell();
         if(face)
@@ -1152,37 +1422,21 @@ FaceCellList VAC::faces()
 KeyEdgeList VAC::instantEdges()
 {
     KeyEdgeList res;
-    foreach(Cell * o, cells_)
-    {
-        KeyEdge * iedge = o->toKeyEdge();
-        if(iedge)
-            res << iedge;
-    }
+    for(KeyEdge * iedge: cells_.keyEdges())
+        res << iedge;
     return res;
 }
 
 KeyVertexList VAC::instantVertices(Time time)
 {
-    KeyVertexList res;
-    foreach(Cell * o, cells_)
-    {
-        KeyVertex *node = o->toKeyVertex();
-        if(node && node->exists(time))
-            res << node;
-    }
-    return res;
+    timeIndex_.update(cells_);
+    return timeIndex_.keyVertices(time);
 }
 
 KeyEdgeList VAC::instantEdges(Time time)
 {
-    KeyEdgeList res;
-    foreach(Cell * o, cells_)
-    {
-        KeyEdge * iedge = o->toKeyEdge();
-        if(iedge && iedge->exists(time))
-            res << iedge;
-    }
-    return res;
+    timeIndex_.update(cells_);
+    return timeIndex_.keyEdges(time);
 }
 
 // ----------------------- Managing IDs ------------------------
@@ -1198,8 +1452,12 @@ void VAC::insertCell_(Cell * cell)
     int id = getAvailableID();
     cell->id_ = id;
     cell->vac_ = this;
-    cells_.insert(id, cell);
-    zOrdering_.insertCell(cell);
+    cells_.insert(cell);
+    if(batchEditCounter_ > 0)
+        batchInsertedCells_.append({cell, id, false});
+    else
+        zOrdering_.insertCell(cell);
+    setDrawingChanged_(cell);
 }
 
 void VAC::insertCellLast_(Cell * cell)
@@ -1207,15 +1465,20 @@ void VAC::insertCellLast_(Cell * cell)
     int id = getAvailableID();
     cell->id_ = id;
     cell->vac_ = this;
-    cells_.insert(id, cell);
-    zOrdering_.insertLast(cell);
+    cells_.insert(cell);
+    if(batchEditCounter_ > 0)
+        batchInsertedCells_.append({cell, id, true});
+    else
+        zOrdering_.insertLast(cell);
+    setDrawingChanged_(cell);
 }
 
 void VAC::removeCell_(Cell * cell)
 {
     if(cell)
     {
-        cells_.remove(cell->id());
+        setDrawingChanged_(cell);
+        cells_.remove(cell);
         zOrdering_.removeCell(cell);
         removeFromSelection(cell,false);
         if(cell->isSelected())
@@ -1453,11 +1716,36 @@ void VAC::smartDeleteCell(Cell * cell)
 
 void VAC::deleteAllCells()
 {
-    while(!cells_.isEmpty())
-    {
-        Cell * obj = *cells_.begin();
-        deleteCell(obj);
-    }
+    // Since all cells are deleted, there is no need to keep the complex valid
+    // while deleting them one by one (see deleteCell()): we inform observers
+    // while all cells are still alive, reset the cell sets, then release
+    // memory in a single pass.
+    CellList cellsToDelete;
+    for(Cell * cell: cells_)
+        cellsToDelete << cell;
+
+    foreach(Cell * cell, cellsToDelete)
+        foreach(CellObserver * observer, cell->observers_)
+            observer->observedCellDeleted(cell);
+
+    bool hadSelection = !selectedCells_.isEmpty();
+    selectedCells_.clear();
+    hoveredCell_ = 0;
+    sculptedEdge_ = 0;
+    hoveredFaceOnMousePress_ = 0;
+    hoveredFaceOnMouseRelease_ = 0;
+    hoveredFacesOnMouseMove_.clear();
+    facesToConsiderForCutting_.clear();
+    zOrdering_.clear();
+    cells_.clear();
+    batchInsertedCells_.clear();
+
+    foreach(Cell * cell, cellsToDelete)
+        delete cell;
+
+    if(hadSelection)
+        emitSelectionChanged_();
+
     setMaxID_(-1);
 }
 
@@ -1573,6 +1861,8 @@ InbetweenFace * VAC::newInbetweenFace(const QList<AnimatedCycle> & cycles,
 
 void VAC::beginRectangleOfSelection(double x, double y, Time time)
 {
+    beginInteraction_();
+
     timeInteractivity_ = time;
     rectangleOfSelectionStartX_ = x;
     rectangleOfSelectionStartY_ = y;
@@ -1610,7 +1900,7 @@ void VAC::continueRectangleOfSelection(double x, double y)
 void VAC::setSelectedCellsFromRectangleOfSelection()
 {
     // Get keyboard modifiers to know what to do
-    Qt::KeyboardModifiers modifiers = QGuiApplication::keyboardModifiers();
+    Qt::KeyboardModifiers modifiers = global()->keyboardModifiers();
     setSelectedCellsFromRectangleOfSelection(modifiers);
 }
 
@@ -1650,12 +1940,16 @@ void VAC::setSelectedCellsFromRectangleOfSelection(Qt::KeyboardModifiers modifie
 void VAC::endRectangleOfSelection()
 {
     drawRectangleOfSelection_ = false;
+
+    endInteraction_();
 }
 
 // ------------- User action: drawing a new stroke -------------
 
 void VAC::beginSketchEdge(double x, double y, double w, Time time)
 {
+    beginInteraction_();
+
     timeInteractivity_ = time;
     sketchedEdge_ = new LinearSpline(ds_);
     sketchedEdge_->beginSketch(EdgeSample(x,y,w));
@@ -1673,7 +1967,7 @@ void VAC::beginSketchEdge(double x, double y, double w, Time time)
 
 void VAC::continueSketchEdge(double x, double y, double w)
 {
-    if(sketchedEdge_)
+    if(sketchedEdge_ && !pendingSketch_)
     {
         sketchedEdge_->continueSketch(EdgeSample(x,y,w));
         if(hoveredCell_)
@@ -1693,7 +1987,7 @@ void VAC::continueSketchEdge(double x, double y, double w)
 
 void VAC::endSketchEdge()
 {
-    if(sketchedEdge_)
+    if(sketchedEdge_ && !pendingSketch_)
     {
         InbetweenFace * sface = nullptr;
         if (hoveredCell_)
@@ -1714,19 +2008,82 @@ void VAC::endSketchEdge()
             facesToConsiderForCutting_.insert(hoveredFaceOnMousePress_);
         if(hoveredFaceOnMouseRelease_)
             facesToConsiderForCutting_.insert(hoveredFaceOnMouseRelease_);
-        insertSketchedEdgeInVAC();
 
-        delete sketchedEdge_;
-        sketchedEdge_ = 0;
+        if(global()->planarMapMode())
+        {
+            // Compute intersections in a worker thread, and keep drawing
+            // the sketched edge until they are known
+            ProfilerScope profilerScope("VAC::endSketchEdge (prepare)");
+            std::shared_ptr<SketchIntersections> data = std::make_shared<SketchIntersections>();
+            prepareSketchIntersections_(*data, sketchTolerance_(), true);
+            pendingSketch_ = data;
+            pendingSketchWatcher_.setFuture(QtConcurrent::run([data]()
+            {
+                computeSketchIntersections_(*data);
+            }));
+        }
+        else
+        {
+            insertSketchedEdgeInVAC();
 
+            delete sketchedEdge_;
+            sketchedEdge_ = 0;
 
-        //emit changed();
-        emit checkpoint();
+
+            //emit changed();
+            emit checkpoint();
+        }
     }
+
+    endInteraction_();
+}
+
+void VAC::completePendingSketch()
+{
+    if(!pendingSketch_)
+        return;
+
+    ProfilerScope profilerScope("VAC::completePendingSketch");
+
+    pendingSketchWatcher_.waitForFinished();
+    std::shared_ptr<SketchIntersections> data;
+    data.swap(pendingSketch_);
+
+    timeInteractivity_ = data->time;
+    insertSketchedEdgeInVAC(data->tolerance, true, data.get());
+
+    delete sketchedEdge_;
+    sketchedEdge_ = 0;
+
+    emit needUpdatePicking();
+    emit changed();
+    emit checkpoint();
+}
+
+void VAC::onSketchIntersectionsComputed_()
+{
+    // Inserting the sketch may delete cells used by the current
+    // interaction. In this case, it is inserted when the interaction ends.
+    if(pendingSketch_ && pendingSketchWatcher_.isFinished() && !isInteracting_)
+        completePendingSketch();
+}
+
+void VAC::beginInteraction_()
+{
+    completePendingSketch();
+    isInteracting_ = true;
+}
+
+void VAC::endInteraction_()
+{
+    isInteracting_ = false;
+    onSketchIntersectionsComputed_();
 }
 
 void VAC::beginCutFace(double x, double y, double w, KeyVertex * startVertex)
 {
+    beginInteraction_();
+
     cut_startVertex_ = startVertex;
 
     if(cut_startVertex_)
@@ -1807,6 +2164,8 @@ void VAC::endCutFace(KeyVertex * endVertex)
             emit checkpoint();
         }
     }
+
+    endInteraction_();
 }
 
 bool VAC::cutFace_(KeyFace * face, KeyEdge * edge, CutFaceFeedback * feedback)
@@ -2138,7 +2497,7 @@ VAC::SplitInfo VAC::cutEdgeAtVertices_(KeyEdge * edgeToSplit, const std::vector<
     res.oldEdge = edgeToSplit;
 
     // Split the curve
-    std::vector<SketchedEdge,Eigen::aligned_allocator<SketchedEdge> > split = static_cast<LinearSpline *>(edgeToSplit->geometry())->curve().split(splitValues);
+    std::vector<SketchedEdge,Eigen::aligned_allocator<SketchedEdge> > split = static_cast<LinearSpline *>(edgeToSplit->geometry())->constCurve().split(splitValues);
 
     // Get start node or create it in case of loop
     KeyVertex * startVertex;
@@ -2378,8 +2737,8 @@ void VAC::glue_(const KeyHalfedge &h1, const KeyHalfedge &h2)
     KeyEdge * e2 = h2.edge;
 
     // compute new geometry
-    SculptCurve::Curve<EdgeSample> & g1 = static_cast<LinearSpline*>(h1.edge->geometry())->curve();
-    SculptCurve::Curve<EdgeSample> & g2 = static_cast<LinearSpline*>(h2.edge->geometry())->curve();
+    const SculptCurve::Curve<EdgeSample> & g1 = static_cast<LinearSpline*>(h1.edge->geometry())->constCurve();
+    const SculptCurve::Curve<EdgeSample> & g2 = static_cast<LinearSpline*>(h2.edge->geometry())->constCurve();
     double l1 = h1.edge->geometry()->length();
     double l2 = h2.edge->geometry()->length();
     std::vector<EdgeSample,Eigen::aligned_allocator<EdgeSample> > g3Vertices;
@@ -2894,8 +3253,8 @@ bool VAC::uncut_(KeyVertex * v)
         // [... ; h = (e,true) ; ...]  <=>  [...;h1;h2;...]
 
         // compute new geometry
-        SculptCurve::Curve<EdgeSample> & g1 = static_cast<LinearSpline*>(e1->geometry())->curve();
-        SculptCurve::Curve<EdgeSample> & g2 = static_cast<LinearSpline*>(e2->geometry())->curve();
+        const SculptCurve::Curve<EdgeSample> & g1 = static_cast<LinearSpline*>(e1->geometry())->constCurve();
+        const SculptCurve::Curve<EdgeSample> & g2 = static_cast<LinearSpline*>(e2->geometry())->constCurve();
         std::vector<EdgeSample,Eigen::aligned_allocator<EdgeSample> > g3Vertices;
         int n1 = g1.size();
         int n2 = g2.size();
@@ -3366,28 +3725,120 @@ bool VAC::uncut_(KeyEdge * e)
     return true;
 }
 
-void VAC::insertSketchedEdgeInVAC()
+double VAC::sketchTolerance_() const
 {
     double tolerance = global()->snapThreshold();
     double toleranceEpsilon = 1e-2;
     if( (tolerance < toleranceEpsilon) || !(global()->snapMode()) )
         tolerance = 1e-2;
-    insertSketchedEdgeInVAC(tolerance);
+    return tolerance;
+}
+
+void VAC::prepareSketchIntersections_(SketchIntersections & data, double tolerance, bool planarMapMode)
+{
+    data.sketchedCurve = sketchedEdge_->constCurve();
+    data.time = timeInteractivity_;
+    data.tolerance = tolerance;
+    data.planarMapMode = planarMapMode;
+    data.edgeIds.clear();
+    data.edgeCurves.clear();
+    if(!planarMapMode)
+        return;
+
+    // Only edges near the sketched edge may intersect it. Curves are
+    // extended by at most tolerance at their ends to find intersections.
+    double xMin = std::numeric_limits<double>::max();
+    double xMax = std::numeric_limits<double>::lowest();
+    double yMin = xMin;
+    double yMax = xMax;
+    for(int i=0; i<data.sketchedCurve.size(); ++i)
+    {
+        EdgeSample v = data.sketchedCurve[i];
+        xMin = std::min(xMin, v.x());
+        xMax = std::max(xMax, v.x());
+        yMin = std::min(yMin, v.y());
+        yMax = std::max(yMax, v.y());
+    }
+    const double margin = 2 * tolerance + 1;
+    const BoundingBox nearby(xMin - margin, xMax + margin, yMin - margin, yMax + margin);
+    auto isNearby = [this, &nearby](Cell * cell)
+    {
+        const BoundingBox & bb = cell->boundingBox(timeInteractivity_);
+        return bb.isEmpty() || bb.intersects(nearby);
+    };
+
+    // Inbetween edges, which are keyframed if they intersect
+    foreach(Cell * cell, cells())
+    {
+        InbetweenEdge * sedge = cell->toInbetweenEdge();
+        if(sedge && sedge->exists(timeInteractivity_) && isNearby(sedge))
+        {
+            data.edgeIds.push_back(sedge->id());
+            data.edgeCurves.push_back(sketchCurve(sedge, timeInteractivity_));
+        }
+    }
+
+    // Key edges
+    foreach(KeyEdge * iedge, instantEdges(timeInteractivity_))
+    {
+        if(isNearby(iedge))
+        {
+            data.edgeIds.push_back(iedge->id());
+            data.edgeCurves.push_back(sketchCurve(iedge, ds_));
+        }
+    }
+}
+
+void VAC::computeSketchIntersections_(SketchIntersections & data)
+{
+    if(!data.planarMapMode)
+        return;
+
+    data.selfIntersections = data.sketchedCurve.selfIntersections(data.tolerance);
+    data.edgeIntersections.clear();
+    for(const SculptCurve::Curve<EdgeSample> & curve : data.edgeCurves)
+        data.edgeIntersections.push_back(data.sketchedCurve.intersections(curve, data.tolerance));
 }
 
-void VAC::insertSketchedEdgeInVAC(double tolerance, bool useFaceToConsiderForCutting)
+void VAC::insertSketchedEdgeInVAC()
+{
+    ProfilerScope profilerScope("VAC::insertSketchedEdgeInVAC");
+
+    insertSketchedEdgeInVAC(sketchTolerance_());
+}
+
+void VAC::insertSketchedEdgeInVAC(double tolerance, bool useFaceToConsiderForCutting,
+                                  SketchIntersections * intersections)
 {
     // --------------------------------------------------------------------
     // ---------------------- Input Variables -----------------------------
     // --------------------------------------------------------------------
 
-    bool intersectWithSelf = global()->planarMapMode();
-    bool intersectWithOthers = global()->planarMapMode();
+    // Planar map mode when the edge was sketched, which may differ from
+    // the current one if the insertion was deferred
+    bool planarMapMode = intersections ? intersections->planarMapMode : global()->planarMapMode();
+    bool intersectWithSelf = planarMapMode;
+    bool intersectWithOthers = planarMapMode;
 
     // --------------------------------------------------------------------
     // ----------------- Compute dirty intersections ----------------------
     // --------------------------------------------------------------------
 
+    // Use the given intersections unless the geometry changed since they
+    // were computed
+    SketchIntersections data;
+    prepareSketchIntersections_(data, tolerance, planarMapMode);
+    if(intersections && intersections->hasSameInput(data))
+    {
+        data.selfIntersections.swap(intersections->selfIntersections);
+        data.edgeIntersections.swap(intersections->edgeIntersections);
+    }
+    else
+    {
+        ProfilerScope profilerScope("VAC::computeSketchIntersections_");
+        computeSketchIntersections_(data);
+    }
+
     typedef SculptCurve::Curve<EdgeSample> SketchedEdge;
     std::vector<             SculptCurve::Intersection  > selfIntersections;
     std::vector< std::vector<SculptCurve::Intersection> > othersIntersections;
@@ -3399,40 +3850,23 @@ void VAC::insertSketchedEdgeInVAC(double tolerance, bool useFaceToConsiderForCut
     // Store geometry of existing edges as a "SketchedEdge"
     std::vector< SculptCurve::Curve<EdgeSample>,Eigen::aligned_allocator<SculptCurve::Curve<EdgeSample> >  > sketchedEdges; // sketchedEdges.size() == nEdges.
 
-    // Compute intersections with self
+    // Intersections with self
     if(intersectWithSelf)
-        selfIntersections = sketchedEdge_->curve().selfIntersections(tolerance);
+        selfIntersections.swap(data.selfIntersections);
 
-    // Keyframe existing inbetween edge that intersect with sketched edge
+    // Keyframe existing inbetween edge that intersect with sketched edge,
+    // and index the intersections with nearby key edges by their ID
+    QMap<int, int> nearbyEdges;
+    KeyEdgeSet keyframedEdges;
     if(intersectWithOthers)
     {
-        InbetweenEdgeSet inbetweenEdges;
-        foreach(Cell * cell, cells())
+        for(size_t i=0; i<data.edgeIds.size(); ++i)
         {
-            InbetweenEdge * sedge = cell->toInbetweenEdge();
-            if(sedge && sedge->exists(timeInteractivity_))
-                inbetweenEdges << sedge;
-        }
-        foreach(InbetweenEdge * sedge, inbetweenEdges)
-        {
-            // Get sampling as a QList of EdgeSamples
-            QList<EdgeSample> sampling = sedge->getSampling(timeInteractivity_);
-
-            // Convert sampling to a std::vector of EdgeSamples
-            std::vector<EdgeSample,Eigen::aligned_allocator<EdgeSample> > stdSampling;
-            for(int i=0; i<sampling.size(); ++i)
-                stdSampling << sampling[i];
-
-            // Convert sampling to a SculptCurve::Curve<EdgeSample>
-            SculptCurve::Curve<EdgeSample> sketchedEdge;
-            sketchedEdge.setVertices(stdSampling);
-
-            // Compute intersections
-            std::vector<SculptCurve::Intersection> intersections = sketchedEdge_->curve().intersections(sketchedEdge, tolerance);
-
-            // Keyframe edge if there are some intersections
-            if(intersections.size() > 0)
-                keyframe_(sedge, timeInteractivity_);
+            InbetweenEdge * sedge = getCell(data.edgeIds[i])->toInbetweenEdge();
+            if(!sedge)
+                nearbyEdges[data.edgeIds[i]] = static_cast<int>(i);
+            else if(data.edgeIntersections[i].size() > 0)
+                keyframedEdges << keyframe_(sedge, timeInteractivity_);
         }
     }
 
@@ -3445,31 +3879,30 @@ void VAC::insertSketchedEdgeInVAC(double tolerance, bool useFaceToConsiderForCut
         iedgesBefore = instantEdges(timeInteractivity_);
         nEdges = iedgesBefore.size();
 
-        // For each of them, compute intersections with sketched edge
+        // For each of them, get intersections with sketched edge. Edges
+        // which are not nearby have none, and edges just keyframed are
+        // not known yet.
         foreach (KeyEdge * iedge, iedgesBefore)
         {
-            // Convert geometry of instant edge to a SketchedEdge
-            EdgeGeometry * geometry = iedge->geometry();
-            LinearSpline * linearSpline = dynamic_cast<LinearSpline *>(geometry);
-            if(linearSpline)
+            auto it = nearbyEdges.constFind(iedge->id());
+            if(it != nearbyEdges.constEnd())
+            {
+                sketchedEdges << data.edgeCurves[it.value()];
+                othersIntersections << data.edgeIntersections[it.value()];
+            }
+            else if(keyframedEdges.contains(iedge))
             {
-                sketchedEdges << linearSpline->curve() ;
+                sketchedEdges << sketchCurve(iedge, ds_);
+                othersIntersections << data.sketchedCurve.intersections(sketchedEdges.back(), tolerance);
             }
             else
             {
-                QList<Eigen::Vector2d> eigenSampling = geometry->sampling(ds_);
-                std::vector<EdgeSample,Eigen::aligned_allocator<EdgeSample> > vertices;
-                for(int i=0; i<eigenSampling.size(); ++i)
-                    vertices << EdgeSample(eigenSampling[i][0], eigenSampling[i][1], 10); // todo: get actual width
                 sketchedEdges << SculptCurve::Curve<EdgeSample>();
-                sketchedEdges.back().setVertices(vertices);
+                othersIntersections << std::vector<SculptCurve::Intersection>();
             }
 
-            // Compute intersections
-            othersIntersections << sketchedEdge_->curve().intersections(sketchedEdges.back(), tolerance);
-
             // Store length
-            lOthers << sketchedEdges.back().length();
+            lOthers << (sketchedEdges.back().size() > 0 ? sketchedEdges.back().length() : 0.0);
         }
     }
 
@@ -4016,7 +4449,7 @@ void VAC::insertSketchedEdgeInVAC(double tolerance, bool useFaceToConsiderForCut
         KeyEdge * iedge = newKeyEdge(timeInteractivity_, geometry);
 
         // if planar map mode, the loop can "cut" a face
-        if(global()->planarMapMode())
+        if(planarMapMode)
         {
             if(hoveredFaceOnMousePress_)
             {
@@ -4040,7 +4473,7 @@ void VAC::insertSketchedEdgeInVAC(double tolerance, bool useFaceToConsiderForCut
     {
         // if planar map mode, the first and last vertices can "cut" faces
         // by being added as Steiner cycles
-        if(global()->planarMapMode() && nSelf>0)
+        if(planarMapMode && nSelf>0)
         {
             KeyVertex * firstVertex = selfNodes[0];
             KeyVertex * lastVertex = selfNodes[nSelf-1];
@@ -4084,7 +4517,7 @@ void VAC::insertSketchedEdgeInVAC(double tolerance, bool useFaceToConsiderForCut
                 iedge = newKeyEdge(timeInteractivity_, startNode, endNode, geometry);
 
             // if planar map mode, cut a potential face underneath
-            if(iedge && global()->planarMapMode())
+            if(iedge && planarMapMode)
             {
                 // find a face to cut
                 KeyFaceSet startFaces = startNode->spatialStar();
@@ -4137,6 +4570,8 @@ void VAC::updateSculpt(double x, double y, Time time)
 
 void VAC::beginSculptDeform(double x, double y)
 {
+    beginInteraction_();
+
     if(sculptedEdge_)
     {
         sculptedEdge_->beginSculptDeform(x, y);
@@ -4157,13 +4592,18 @@ void VAC::endSculptDeform()
     if(sculptedEdge_)
     {
         sculptedEdge_->endSculptDeform();
+        sculptedEdge_->setSamplingTolerance(samplingTolerance_);
         //emit changed(); // done manually by View, after calling updatePicking(newX, newY)
         emit checkpoint();
     }
+
+    endInteraction_();
 }
 
 void VAC::beginSculptEdgeWidth(double x, double y)
 {
+    beginInteraction_();
+
     if(sculptedEdge_)
     {
         sculptedEdge_->beginSculptEdgeWidth(x, y);
@@ -4184,13 +4624,18 @@ void VAC::endSculptEdgeWidth()
     if(sculptedEdge_)
     {
         sculptedEdge_->endSculptEdgeWidth();
+        sculptedEdge_->setSamplingTolerance(samplingTolerance_);
         //emit changed(); // done manually by View, after calling updatePicking(newX, newY)
         emit checkpoint();
     }
+
+    endInteraction_();
 }
 
 void VAC::beginSculptSmooth(double /*x*/, double /*y*/)
 {
+    beginInteraction_();
+
     /* useless
         if(sculptedEdge_)
         {
@@ -4216,9 +4661,12 @@ void VAC::endSculptSmooth()
     if(sculptedEdge_)
     {
         sculptedEdge_->endSculptSmooth();
+        sculptedEdge_->setSamplingTolerance(samplingTolerance_);
         //emit changed(); // done manually by View, after calling updatePicking(newX, newY)
         emit checkpoint();
     }
+
+    endInteraction_();
 }
 
 
@@ -5330,6 +5778,7 @@ void VAC::changeColor()
             foreach(Cell * cell, selectedCells())
             {
                 cell->setColor(color);
+                setDrawingChanged_(cell);
             }
         }
 
@@ -5344,6 +5793,7 @@ void VAC::raise()
     if(numSelectedCells() > 0)
     {
         zOrdering_.raise(selectedCells());
+        setDrawingChanged_(selectedCells());
 
         emit needUpdatePicking();
         emit changed();
@@ -5356,6 +5806,7 @@ void VAC::lower()
     if(numSelectedCells() > 0)
     {
         zOrdering_.lower(selectedCells());
+        setDrawingChanged_(selectedCells());
 
         emit needUpdatePicking();
         emit changed();
@@ -5368,6 +5819,7 @@ void VAC::raiseToTop()
     if(numSelectedCells() > 0)
     {
         zOrdering_.raiseToTop(selectedCells());
+        setDrawingChanged_(selectedCells());
 
         emit needUpdatePicking();
         emit changed();
@@ -5380,6 +5832,7 @@ void VAC::lowerToBottom()
     if(numSelectedCells() > 0)
     {
         zOrdering_.lowerToBottom(selectedCells());
+        setDrawingChanged_(selectedCells());
 
         emit needUpdatePicking();
         emit changed();
@@ -5570,6 +6023,7 @@ void VAC::paste(VAC *& clipboard)
     {
         kc->time_ = kc->time_ + deltaTime;
     }
+    cloneOfClipboard->timeIndex_.invalidate();
 
     // Import into this VAC and set as selection
     removeFromSelection(selectedCells());
@@ -5616,6 +6070,13 @@ void VAC::motionPaste(VAC* & clipboard)
     {
         kc->time_ = kc->time_ + deltaTime;
     }
+    cloneOfClipboard->timeIndex_.invalidate();
+
+    // Get handles to the copied cells, which unlike their IDs are not
+    // reused by other cells, e.g. if another file was opened since copying
+    QMap<int, CellHandle> copiedCells;
+    for(Cell * c: cloneOfClipboard->cells_)
+        copiedCells[c->id()] = cloneOfClipboard->getHandle(c);
 
     // Import into this VAC and set as selection
     removeFromSelection(selectedCells());
@@ -5630,10 +6091,10 @@ void VAC::motionPaste(VAC* & clipboard)
     {
         i.next();
 
-        int copyID =  (deltaTime.frame() > 0) ? i.key()   : i.value();
-        int pasteID = (deltaTime.frame() > 0) ? i.value() : i.key();
-        Cell * copyCell = getCell(copyID);
-        Cell * pasteCell = getCell(pasteID);
+        Cell * copiedCell = getCell(copiedCells.value(i.key()));
+        Cell * pastedCell = getCell(i.value());
+        Cell * copyCell = (deltaTime.frame() > 0) ? copiedCell : pastedCell;
+        Cell * pasteCell = (deltaTime.frame() > 0) ? pastedCell : copiedCell;
         KeyVertex * v1 = copyCell  ? copyCell->toKeyVertex()  : 0;
         KeyVertex * v2 = pasteCell ? pasteCell->toKeyVertex() : 0;
         KeyEdge * e1 = copyCell  ? copyCell->toKeyEdge()  : 0;
@@ -5800,6 +6261,7 @@ void VAC::setHoveredCell(Cell * cell)
         {
             hoveredCell_ = cell;
             hoveredCell_->setHovered(true);
+            setDrawingChanged_(hoveredCell_);
         }
     }
 }
@@ -5809,6 +6271,7 @@ void VAC::setNoHoveredCell()
     if(hoveredCell_)
     {
         hoveredCell_->setHovered(false);
+        setDrawingChanged_(hoveredCell_);
         hoveredCell_ = 0;
     }
 }
@@ -5878,6 +6341,7 @@ void VAC::addToSelection(Cell * cell, bool emitSignal)
     {
         selectedCells_ << cell;
         cell->setSelected(true);
+        setDrawingChanged_(cell);
         emitSelectionChanged_();
         if(emitSignal)
         {
@@ -5892,6 +6356,7 @@ void VAC::removeFromSelection(Cell * cell, bool emitSignal)
     {
         selectedCells_.remove(cell);
         cell->setSelected(false);
+        setDrawingChanged_(cell);
         emitSelectionChanged_();
         if(emitSignal)
         {
@@ -5976,6 +6441,7 @@ void VAC::setSelectedCells(const CellSet & cells, bool emitSignal)
         else
         {
             changing = true;
+            setDrawingChanged_(cell);
         }
     }
 
@@ -5989,6 +6455,7 @@ void VAC::setSelectedCells(const CellSet & cells, bool emitSignal)
         {
             changing = true;
             cell->setSelected(false);
+            setDrawingChanged_(cell);
         }
     }
 
@@ -6249,6 +6716,8 @@ void VAC::deselectInbetweenFaces(bool emitSignal)
 
 void VAC::prepareDragAndDrop(double x0, double y0, Time time)
 {
+    beginInteraction_();
+
     draggedVertices_.clear();
     draggedEdges_.clear();
 
@@ -6362,10 +6831,14 @@ void VAC::completeDragAndDrop()
 
     //emit changed();
     emit checkpoint();
+
+    endInteraction_();
 }
 
 void VAC::beginTransformSelection(double x0, double y0, Time time)
 {
+    beginInteraction_();
+
     transformTool_.beginTransform(x0, y0, time);
 }
 
@@ -6378,10 +6851,14 @@ void VAC::endTransformSelection()
 {
     transformTool_.endTransform();
     emit checkpoint();
+
+    endInteraction_();
 }
 
 void VAC::prepareTemporalDragAndDrop(Time t0)
 {
+    beginInteraction_();
+
     t0_ = t0;
     draggedKeyCells_ = KeyCellSet(selectedCells());
     draggedKeyCellTime_.clear();
@@ -6421,12 +6898,16 @@ void VAC::performTemporalDragAndDrop(Time t)
 void VAC::completeTemporalDragAndDrop()
 {
     emit checkpoint();
+
+    endInteraction_();
 }
 
 
 
 KeyVertex * VAC::split(double x, double y, Time time, bool interactive)
 {
+    completePendingSketch();
+
     KeyVertex * res = 0;
 
     if(hoveredCell_)
@@ -6557,7 +7038,7 @@ KeyVertex * VAC::split(double x, double y, Time time, bool interactive)
 
 bool VAC::check() const
 {
-    foreach(Cell * c, cells_)
+    for(Cell * c: cells_)
         if(!(c->check()))
             return false;
     return true;
@@ -6565,8 +7046,7 @@ bool VAC::check() const
 
 bool VAC::checkContains(const Cell * c) const
 {
-    int id = c->id();
-    return (cells_.contains(id)) && (cells_[id] == c);
+    return cells_.cell(c->id()) == c;
 }
 
 void VAC::updateToBePaintedFace(double x, double y, Time time)
@@ -6586,187 +7066,13 @@ void VAC::updateToBePaintedFace(double x, double y, Time time)
         return;
     }
 
-    // From here, we try to find a list of cycles such that
-    // the corresponding face would intersect with the cursor
-
-    // Compute distances to all edges
-    QMap<KeyEdge*,EdgeGeometry::ClosestVertexInfo> distancesToEdges;
-    foreach(KeyEdge * e, instantEdges())
-        distancesToEdges[e] = e->geometry()->closestPoint(x,y);
-
-    // First, we try to create such a face assuming that the
-    // VGC is actually planar (cells are not overlapping).
-    bool foundPlanarFace = false;
-    {
-        // Find external boundary: the closest planar cycle containing mouse cursor
-        QSet<KeyEdge*> potentialExternalBoundaryEdges;
-        foreach(KeyEdge* e, instantEdges())
-        {
-            if(e->exists(time))
-                potentialExternalBoundaryEdges.insert(e);
-        }
-        PreviewKeyFace externalBoundary;
-        bool foundExternalBoundary = false;
-        while(!(foundExternalBoundary || potentialExternalBoundaryEdges.isEmpty()))
-        {
-            // Find closest potential edge
-            KeyEdge * closestPotentialExternalBoundaryEdge = 0;
-            EdgeGeometry::ClosestVertexInfo cvi;
-            cvi.s = 0;
-            cvi.d = std::numeric_limits<double>::max();
-            foreach(KeyEdge * e, potentialExternalBoundaryEdges)
-            {
-                EdgeGeometry::ClosestVertexInfo cvi_e = distancesToEdges[e];
-                if(cvi_e.d < cvi.d) // TODO: cvi_e.d could be NaN, in which case it returns false, and closestPotentialExternalBoundaryEdge can be null, resulting in a segfault 8 lines below.
-                {
-                    closestPotentialExternalBoundaryEdge = e;
-                    cvi = cvi_e;
-                }
-            }
-
-            // Find direction of halfedge
-            Eigen::Vector2d der = closestPotentialExternalBoundaryEdge->geometry()->der(cvi.s);
-            double cross = der[0] * (y - cvi.p.y()) - der[1] * (x - cvi.p.x());
-            KeyHalfedge h(closestPotentialExternalBoundaryEdge, (cross>0 ? false : true) ); // be careful here, canvas is left-handed
-
-            // Find potential external boundary
-            if(closestPotentialExternalBoundaryEdge->isClosed())
-            {
-                KeyEdgeSet edgeSet;
-                edgeSet << closestPotentialExternalBoundaryEdge;
-                Cycle cycle(edgeSet);
-                if(cycle.isValid())
-                {
-                    externalBoundary << cycle;
-                    if(externalBoundary.intersects(x,y))
-                    {
-                        foundExternalBoundary = true;
-                    }
-                    else
-                    {
-                        potentialExternalBoundaryEdges.remove(closestPotentialExternalBoundaryEdge);
-                        externalBoundary.clear();
-                    }
-                }
-                else
-                {
-                    potentialExternalBoundaryEdges.remove(closestPotentialExternalBoundaryEdge);
-                }
-            }
-            else // i.e., if closestPotentialExternalBoundaryEdge is open
-            {
-                // First halfedge of non-simple-cycle
-                KeyHalfedge h0 = h;
-                QList<KeyHalfedge> potentialPlanarCycle;
-                potentialPlanarCycle << h;
-
-                // Find the corresponding planar map cycle
-                int maxIter = 2 * potentialExternalBoundaryEdges.size() + 2;
-                bool foundPotentialPlanarCycle = false;
-                for(int i=0; i<maxIter; i++)
-                {
-                    // Find next halfedge in cycle
-                    h = h.next();
-
-                    // Check it has not already been rejected
-                    if(!potentialExternalBoundaryEdges.contains(h.edge))
-                    {
-                        break;
-                    }
-
-                    // Test if cycle completed or not
-                    if(h == h0)
-                    {
-                        // Cycle completed: leave loop
-                        foundPotentialPlanarCycle = true;
-                        break;
-                    }
-                    else
-                    {
-                        // Cycle not completed: insert and iterate
-                        potentialPlanarCycle << h;
-                    }
-                }
-
-                // If not found (maxIter reached or edge already rejected)
-                if(!foundPotentialPlanarCycle)
-                {
-                    foreach(KeyHalfedge he, potentialPlanarCycle)
-                    {
-                        potentialExternalBoundaryEdges.remove(he.edge);
-                    }
-                }
-                else
-                {
-                    Cycle cycle(potentialPlanarCycle);
-                    if(cycle.isValid())
-                    {
-                        externalBoundary << cycle;
-                        if(externalBoundary.intersects(x,y))
-                        {
-                            foundExternalBoundary = true;
-                        }
-                        else
-                        {
-                            foreach(KeyHalfedge he, potentialPlanarCycle)
-                            {
-                                potentialExternalBoundaryEdges.remove(he.edge);
-                            }
-                            externalBoundary.clear();
-                        }
-                    }
-                    else
-                    {
-                        foreach(KeyHalfedge he, potentialPlanarCycle)
-                        {
-                            potentialExternalBoundaryEdges.remove(he.edge);
-                        }
-                    }
-                }
-            } // end if/then/else "closestPotentialExternalBoundaryEdge is closed?"
-
-        }// end while( !( found external boundary || isEmpty) )
-
-        // We left the while loop, so either we found an external boundary, or there's no hope to find one
-        if(foundExternalBoundary)
-        {
-            // Great, so we know we have a valid planar face!
-            // Plus, it's already stored as a PreviewFace :)
-            *toBePaintedFace_ = externalBoundary;
-            foundPlanarFace = true;
-
-            // Now, let's try to add holes to the external boundary
-            QSet<KeyEdge*> potentialHoleEdges;
-            foreach(KeyEdge* e, instantEdges())
-            {
-                if(e->exists(time))
-                    potentialHoleEdges.insert(e);
-            }
-            CellSet cellsInExternalBoundary = externalBoundary.cycles()[0].cells();
-            KeyEdgeSet edgesInExternalBoundary = cellsInExternalBoundary;
-            foreach(KeyEdge * e, edgesInExternalBoundary)
-                potentialHoleEdges.remove(e);
-            QList<PreviewKeyFace> holes;
-            while(!potentialHoleEdges.isEmpty())
-            {
-                // Ordered by distance to mouse cursor p, add planar cycles gamma which:
-                //   - Do not contain p
-                //   - Are contained in external boundary
-                //   - Are not contained in holes already added
-                addHoleToPaintedFace(potentialHoleEdges, *toBePaintedFace_, distancesToEdges, x, y);
-            }
-        }
-        else
-        {
-            // If we haven't found an external boundary, then we can't find a planar face
-            // Just continue the method to find a non-planar face
-            foundPlanarFace = false;
-        }
-    } // end of trying to find a planar face
-
-    if(foundPlanarFace)
+    // Find the face of the planar map containing the mouse cursor, assuming
+    // that the VAC is actually planar (cells are not overlapping)
+    planarArrangement_.update(this, time);
+    const PreviewKeyFace * face = planarArrangement_.faceAt(x, y);
+    if(face)
     {
-        // Great, nothing to do! Everything has already been taken care of.
+        *toBePaintedFace_ = *face;
     }
     else
     {
@@ -6774,8 +7080,15 @@ void VAC::updateToBePaintedFace(double x, double y, Time time)
     }
 }
 
-Cell * VAC::paint(double /*x*/, double /*y*/, Time /*time*/)
+Cell * VAC::paint(double x, double y, Time time)
 {
+    // Inserting the pending sketched edge may split the face to be painted
+    if(pendingSketch_)
+    {
+        completePendingSketch();
+        updateToBePaintedFace(x, y, time);
+    }
+
     // The created face, if any
     Cell * res = 0;
 
@@ -6783,6 +7096,7 @@ Cell * VAC::paint(double /*x*/, double /*y*/, Time /*time*/)
     if(hoveredCell())
     {
         hoveredCell()->setColor(global()->faceColor());
+        setDrawingChanged_(hoveredCell());
         res = hoveredCell();
     }
 
@@ -19,7 +19,12 @@
 
 #include <QSet>
 #include <QMap>
+#include <QPair>
+#include <QVector>
 #include <QColor>
+#include <QFutureWatcher>
+
+#include <memory>
 
 #include "../SceneObject.h"
 
@@ -27,6 +32,9 @@
 #include "CellList.h"
 #include "Cell.h"
 #include "ZOrderedCells.h"
+#include "CellStore.h"
+#include "TimeIndex.h"
+#include "PlanarArrangement.h"
 #include "Eigen.h"
 #include "TransformTool.h"
 #include "EdgeSample.h"
@@ -52,6 +60,7 @@ class AnimatedVertex;
 class KeyHalfedge;
 class PreviewKeyFace;
 class BoundingBox;
+class Rasterizer;
 
 class VAC: public SceneObject
 {
@@ -74,13 +83,78 @@ public:
     void initNonCopyable();
     void initCopyable();
 
+    // Tolerance of the adaptive sampling of imported and sculpted edges, or 0
+    // for uniform sampling (see SculptCurve). Set by the Scene, since this
+    // is a property of the document.
+    double samplingTolerance() const { return samplingTolerance_; }
+    void setSamplingTolerance(double tolerance) { samplingTolerance_ = tolerance; }
+
     // VAC extraction and insertion
     QMap<int, int> import(VAC * other, bool selectImportedCells = false); // insert a copy of other inside this
     VAC * subcomplex(const CellSet & subcomplexCells); // Create a new VAC whose cells are cells
 
-    // Drawing
+    // Batch editing: while a BatchEdit exists for this VAC, the work done
+    // for each created or deleted cell is deferred until the last BatchEdit
+    // is destroyed, and then done in a single pass. This makes creating many
+    // cells in a row (importing, pasting, generating...) much faster:
+    //
+    //     {
+    //         VAC::BatchEdit batchEdit(vac);
+    //         batchEdit.reserve(numCells);
+    //         KeyVertex * v1 = vac->newKeyVertex(time, p1);
+    //         ...
+    //     }
+    //
+    // Within a batch:
+    //   - created cells have their ID and are linked to their boundary, but
+    //     are inserted in zOrdering() only at the end, in creation order.
+    //     Therefore, z-ordering operations must not be used.
+    //   - drawing changes are not recorded: the whole drawing is considered
+    //     changed at the end.
+    //   - no signals are emitted. At the end, selectionChanged() is emitted
+    //     once if needed. Like after newKeyVertex() and friends, emitting
+    //     changed(), needUpdatePicking() and checkpoint() is left to the
+    //     caller.
+    class BatchEdit
+    {
+    public:
+        explicit BatchEdit(VAC * vac);
+        ~BatchEdit();
+
+        // Reserves memory for the given number of cells to create
+        void reserve(int numCells);
+
+    private:
+        VAC * vac_;
+
+        BatchEdit(const BatchEdit &);
+        BatchEdit & operator=(const BatchEdit &);
+    };
+
+    // Drawing. draw() is the same as drawCells() followed by drawOverlay(),
+    // which draws what is not part of the cells themselves (sketched edge,
+    // cursors, transform tool...). If a region is given, cells whose drawn
+    // bounding box (see Cell::drawnBoundingBox()) doesn't intersect it are
+    // skipped, which is useful when only a part of the view is redrawn.
     void draw(Time time, ViewSettings & viewSettings);
-    void drawPick(Time time, ViewSettings & viewSettings);
+    void drawCells(Time time, ViewSettings & viewSettings, const BoundingBox * region = 0);
+    void drawOverlay(Time time, ViewSettings & viewSettings);
+    void drawPick(Time time, ViewSettings & viewSettings, const BoundingBox * region = 0);
+    void rasterize(Time time, Rasterizer & rasterizer); // software rendering, illustration mode only
+
+    // Drawing revisions. Any change to how this VAC is drawn (geometry,
+    // color, selection, insertion or removal of cells...) is given a new
+    // revision, recorded for the time range of the changed cells. Views
+    // use this to know whether a drawing they cached for a given time
+    // (e.g., an onion skin) is still valid.
+    quint64 drawingRevision() const;
+    bool isDrawingChangedSince(quint64 revision, Time time) const;
+
+    // Inserts in ids the IDs of the cells whose drawing changed since the
+    // given revision, including removed cells. Returns false if these are
+    // not known anymore, in which case everything should be considered
+    // changed.
+    bool changedCellsSince(quint64 revision, QSet<int> & ids) const;
 
     // Selecting and Highlighting
     void setHoveredObject(Time time, int id);
@@ -122,6 +196,12 @@ public:
     InbetweenEdge * getInbetweenEdge(int id);
     InbetweenFace * getInbetweenFace(int id);
 
+    // Get a handle to a cell, and the cell from a handle: returns NULL if the
+    // cell has been deleted since. Unlike IDs, handles are never reused, and
+    // a handle also refers to the copy of its cell in a clone of this VAC.
+    CellHandle getHandle(Cell * cell) const;
+    Cell * getCell(const CellHandle & handle);
+
     // Get all cells of a given type
     CellSet cells();
     VertexCellList vertices();
@@ -172,6 +252,15 @@ public:
     void continueSketchEdge(double x, double y, double w);
     void endSketchEdge();
 
+    // In planar map mode, endSketchEdge() computes the intersections of the
+    // sketched edge with itself and with nearby edges in a worker thread,
+    // and returns immediately. The edge is drawn as a preview until the
+    // intersections are known, and then inserted (split and glued) in the
+    // GUI thread. This waits for the computation if needed and inserts the
+    // edge now. It is called before any other interactive operation starts,
+    // and does nothing if no sketched edge is pending.
+    void completePendingSketch();
+
     // -- Sculpt --
     void updateSculpt(double x, double y, Time time);
     // Deform
@@ -330,16 +419,54 @@ protected:
 signals:
     void selectionChanged();
 
+private slots:
+    void onSketchIntersectionsComputed_();
+
 private:
     // Trusting operators
     friend class Operator;
 
     // All cells in vac, accessible by ID
-    QMap<int, Cell*> cells_;
+    CellStore cells_;
+
+    // All cells in vac, accessible by time. Updated on demand, and
+    // invalidated by key cells when their time changes.
+    friend class KeyCell;
+    TimeIndex timeIndex_;
+
+    // Time ranges where the drawing of this VAC has changed, with the
+    // revision of their last change, and IDs of the changed cells in
+    // increasing order of revision. Cleared, as if everything changed,
+    // by initCopyable().
+    friend class Cell;
+    void setDrawingChanged_(Cell * cell);
+    void setDrawingChanged_(const CellSet & cells);
+    void setAllDrawingChanged_();
+    QMap<QPair<double, double>, quint64> drawingChanges_;
+    QVector<QPair<quint64, int>> changedCells_;
+    quint64 drawingRevision_;
+    quint64 drawingBaseRevision_;
     void removeCell_(Cell * cell);
     void insertCell_(Cell * cell);
     void insertCellLast_(Cell * cell);
 
+    // Batch editing (see BatchEdit). Cells inserted during the batch are
+    // stored with their ID, so that cells deleted since can be skipped
+    // without dereferencing them.
+    struct BatchInsertedCell
+    {
+        Cell * cell;
+        int id;
+        bool isLast; // insertCellLast_() rather than insertCell_()
+    };
+    void beginBatchEdit_();
+    void endBatchEdit_();
+    int batchEditCounter_;
+    bool wereSignalsBlocked_;
+    bool isBatchDrawingChanged_;
+    bool isBatchSelectionChanged_;
+    QVector<BatchInsertedCell> batchInsertedCells_;
+
     // Managing IDs
     int getAvailableID();
     void deleteAllCells();
@@ -358,13 +485,30 @@ private:
     CellSet rectangleOfSelectionSelectedBefore_;
     CellSet cellsInRectangleOfSelection_;
 
-    // Drawing a new stroke
+    // Drawing a new stroke. If intersections are given (see
+    // completePendingSketch()), they are used unless the geometry they were
+    // computed from has changed since.
+    struct SketchIntersections;
+    double sketchTolerance_() const;
+    void prepareSketchIntersections_(SketchIntersections & data, double tolerance, bool planarMapMode);
+    static void computeSketchIntersections_(SketchIntersections & data);
+    std::shared_ptr<SketchIntersections> pendingSketch_;
+    QFutureWatcher<void> pendingSketchWatcher_;
+
+    // Whether a multi-event user action (e.g., beginSculptDeform() to
+    // endSculptDeform()) is in progress. Such actions may hold cells that
+    // inserting the pending sketch deletes, so it is inserted when they end.
+    bool isInteracting_;
+    void beginInteraction_();
+    void endInteraction_();
     void insertSketchedEdgeInVAC();
-    void insertSketchedEdgeInVAC(double tolerance, bool useFaceToConsiderForCutting = true);
+    void insertSketchedEdgeInVAC(double tolerance, bool useFaceToConsiderForCutting = true,
+                                 SketchIntersections * intersections = nullptr);
     void drawSketchedEdge(Time time, ViewSettings & viewSettings) const;
     void drawTopologySketchedEdge(Time time, ViewSettings & viewSettings) const;
     LinearSpline * sketchedEdge_;
     double ds_;
+    double samplingTolerance_;
     KeyFace * hoveredFaceOnMousePress_;
     KeyFace * hoveredFaceOnMouseRelease_;
     KeyFaceSet hoveredFacesOnMouseMove_;
@@ -437,8 +581,10 @@ private:
     Time deltaTMin_;
     Time deltaTMax_;
 
-    // Painting
+    // Painting. The planar arrangement is updated on demand, from the
+    // cells changed since its last update.
     PreviewKeyFace * toBePaintedFace_;
+    PlanarArrangement planarArrangement_;
 
     // Cut-Copy-Paste
     Time timeCopy_;
@@ -20,19 +20,45 @@
 #include "Algorithms.h"
 
 #include <iostream>
+#include <algorithm>
+#include <iterator>
+#include <limits>
 #include <QDebug>
+#include <QPair>
+#include <QVector>
 
 namespace VectorAnimationComplex
 {
 
+namespace
+{
+
+// Gap between two consecutive labels after relabelling everything
+const qint64 LABEL_GAP = 1 << 20;
+
+// Labels are in [0, 2^LABEL_BITS)
+const int LABEL_BITS = 62;
+const qint64 LABEL_RANGE = qint64(1) << LABEL_BITS;
+
+// A range of 2^i labels is sparse enough to be relabelled if it contains
+// less than DENSITY_RATIO^i cells (i.e., for a density threshold of 3/2)
+const double DENSITY_RATIO = 4.0 / 3.0;
+
+const qint64 MIN_LABEL = std::numeric_limits<qint64>::min();
+const qint64 MAX_LABEL = std::numeric_limits<qint64>::max();
+
+}
+
 ZOrderedCells::ZOrderedCells() :
-    list_()
+    list_(),
+    positions_()
 {
 }
 
 void ZOrderedCells::clear()
 {
     list_.clear();
+    positions_.clear();
 }
 
 ZOrderedCells::Iterator ZOrderedCells::begin()
@@ -77,7 +103,7 @@ ZOrderedCells::ConstReverseIterator ZOrderedCells::crend() const
 
 void ZOrderedCells::insertLast(Cell * cell)
 {
-    list_.append(cell);
+    insertBefore_(end(), cell);
 }
 
 // Insert the new cell just below the lowest boundary cell
@@ -95,43 +121,72 @@ void ZOrderedCells::insertCell(Cell * cell)
     else
     {
         // Insert before boundary
-        Iterator it = begin();
-        while(it!=end() && !boundary.contains(*it))
-            ++it;
-        list_.insert(it,cell);
+        insertBefore_(findFirst(boundary), cell);
     }
 }
 
 void ZOrderedCells::removeCell(Cell * cell)
 {
-    list_.remove(cell);
+    QHash<Cell *, Position>::iterator p = positions_.find(cell);
+    if(p != positions_.end())
+    {
+        list_.erase(p->it);
+        positions_.erase(p);
+    }
 }
 
 ZOrderedCells::Iterator ZOrderedCells::find(Cell * cell)
 {
-    Iterator it = begin();
-    for(; it != end(); ++it)
-        if(*it == cell)
-            break;
-    return it;
+    QHash<Cell *, Position>::const_iterator p = positions_.constFind(cell);
+    if(p != positions_.constEnd())
+        return p->it;
+    else
+        return end();
 }
 
 ZOrderedCells::Iterator ZOrderedCells::findFirst(const CellSet & cells)
 {
-    Iterator it = begin();
-    for(; it != end(); ++it)
-        if(cells.contains(*it))
-            break;
-    return it;
+    Iterator res = end();
+    qint64 resLabel = MAX_LABEL;
+    foreach(Cell * c, cells)
+    {
+        QHash<Cell *, Position>::const_iterator p = positions_.constFind(c);
+        if(p != positions_.constEnd() && p->label <= resLabel)
+        {
+            res = p->it;
+            resLabel = p->label;
+        }
+    }
+    return res;
 }
 
 ZOrderedCells::ReverseIterator ZOrderedCells::findLast(const CellSet & cells)
 {
-    ReverseIterator it = rbegin();
-    for(; it != rend(); ++it)
-        if(cells.contains(*it))
-            break;
-    return it;
+    Iterator res = end();
+    qint64 resLabel = MIN_LABEL;
+    foreach(Cell * c, cells)
+    {
+        QHash<Cell *, Position>::const_iterator p = positions_.constFind(c);
+        if(p != positions_.constEnd() && p->label >= resLabel)
+        {
+            res = p->it;
+            resLabel = p->label;
+        }
+    }
+    if(res == end())
+        return rend();
+    else
+        return ReverseIterator(++res);
+}
+
+bool ZOrderedCells::contains(Cell * cell) const
+{
+    return positions_.contains(cell);
+}
+
+bool ZOrderedCells::isBelow(Cell * c1, Cell * c2) const
+{
+    return positions_.value(c1).label < positions_.value(c2).label;
 }
 
 void ZOrderedCells::raise(Cell * cell) { raise(CellSet() << cell); }
@@ -201,35 +256,37 @@ void ZOrderedCells::raise(CellSet cellsToRaise)
     }
     if(!c1) // not found, raise to top.
     {
-        list_.splice(it,raisedCells);
+        splice_(it,raisedCells);
         return;
     }
 
-    // Second loop: find the highest cell c2 such that:
+    // Second step: find the highest cell c2 such that:
     //   - c2 is not in the closure of the cells to raise
     //   - c2 is in the closure of c1
-    CellSet c1Boundary = c1->boundary(); // Note: *it = c1 AND while(it2 != it) => no need for c1Closure
-    Iterator it2 = end(); --it2;
-    while(it2 != it)
+    //   - c2 is above c1 (or c2 = c1 if there is no such cell)
+    // Note: c2 is above c1 => no need for c1Closure
+    const qint64 c1Label = positions_.value(c1).label;
+    Iterator it2 = it;
+    qint64 it2Label = c1Label;
+    foreach(Cell * c, c1->boundary())
     {
-        if(c1Boundary.contains(*it2) && !closure.contains(*it2))
-            break;
-        else
-            --it2;
+        if(closure.contains(c))
+            continue;
+        QHash<Cell *, Position>::const_iterator p = positions_.constFind(c);
+        if(p != positions_.constEnd() && p->label > it2Label)
+        {
+            it2 = p->it;
+            it2Label = p->label;
+        }
     }
 
-    // Third loop: finish to find cells to raise (i.e., boundary of c up to it2)
-    while(it != it2)
-    {
-        if(closure.contains(*it))
-            it = list_.extractTo(it,raisedCells);
-        else
-            ++it;
-    }
+    // Third step: finish to find cells to raise (i.e., closure of the cells
+    // to raise between c1 and c2). Cells already extracted are all below c1.
+    extract_(closure, raisedCells, c1Label, it2Label);
 
     // Move raised cells above it2
     ++it2;
-    list_.splice(it2,raisedCells);
+    splice_(it2,raisedCells);
 }
 
 void ZOrderedCells::lower(CellSet cellsToLower)
@@ -276,35 +333,40 @@ void ZOrderedCells::lower(CellSet cellsToLower)
     }
     if(!c1) // not found, raise to top.
     {
-        list_.splice(it,loweredCells);
+        splice_(it,loweredCells);
         return;
     }
 
-    // Second loop: find the lowest cell c2 such that:
+    // Second step: find the lowest cell c2 such that:
     //   - c2 is not in the fullstar of the cells to lower
-    //   - c2 is in the closure of c1
-    CellSet c1Star = c1->star(); // Note: *it = c1 AND while(it2 != it) => no need for c1Fullstar
-    ReverseIterator it2 = rend(); --it2;
-    while(it2 != it)
+    //   - c2 is in the star of c1
+    //   - c2 is below c1 (or c2 = c1 if there is no such cell)
+    // Note: c2 is below c1 => no need for c1Fullstar
+    // Note: we use a forward iterator to c2, since the base of a reverse
+    // iterator to c2 may be one of the cells extracted below.
+    const qint64 c1Label = positions_.value(c1).label;
+    Iterator it2 = positions_.value(c1).it;
+    qint64 it2Label = c1Label;
+    foreach(Cell * c, c1->star())
     {
-        if(c1Star.contains(*it2) && !fullstar.contains(*it2))
-            break;
-        else
-            --it2;
+        if(fullstar.contains(c))
+            continue;
+        QHash<Cell *, Position>::const_iterator p = positions_.constFind(c);
+        if(p != positions_.constEnd() && p->label < it2Label)
+        {
+            it2 = p->it;
+            it2Label = p->label;
+        }
     }
 
-    // Third loop: finish to find cells to lower (i.e., fullstar of c down to it2)
-    while(it != it2)
-    {
-        if(fullstar.contains(*it))
-            it = list_.extractTo(it,loweredCells);
-        else
-            ++it;
-    }
+    // Third step: finish to find cells to lower (i.e., fullstar of the cells
+    // to lower between c2 and c1). Cells already extracted are all above c1.
+    CellLinkedList belowC1;
+    extract_(fullstar, belowC1, it2Label, c1Label);
+    loweredCells.splice(loweredCells.begin(), belowC1);
 
     // Move lowered cells below it2
-    ++it2;
-    list_.splice(it2,loweredCells);
+    splice_(it2,loweredCells);
 }
 
 void ZOrderedCells::raiseToTop(CellSet cellsToRaise)
@@ -319,18 +381,11 @@ void ZOrderedCells::raiseToTop(CellSet cellsToRaise)
     // List of actually raised cells
     CellLinkedList raisedCells;
 
-    // Advance to top and extract closure
-    Iterator it = begin();
-    while(it != end())
-    {
-        if(closure.contains(*it))
-            it = list_.extractTo(it,raisedCells);
-        else
-            ++it;
-    }
+    // Extract closure
+    extract_(closure, raisedCells);
 
     // Move raised cells to top
-    list_.splice(it,raisedCells);
+    splice_(end(),raisedCells);
 }
 
 void ZOrderedCells::lowerToBottom(CellSet cellsToLower)
@@ -345,18 +400,11 @@ void ZOrderedCells::lowerToBottom(CellSet cellsToLower)
     // List of actually lowered cells
     CellLinkedList loweredCells;
 
-    // Advance to bottom and extract fullstar
-    ReverseIterator it = rbegin();
-    while(it != rend())
-    {
-        if(fullstar.contains(*it))
-            it = list_.extractTo(it,loweredCells);
-        else
-            ++it;
-    }
+    // Extract fullstar
+    extract_(fullstar, loweredCells);
 
     // Move lowered cells to bottom
-    list_.splice(it,loweredCells);
+    splice_(begin(),loweredCells);
 }
 
 void ZOrderedCells::altRaise(CellSet cellsToRaise)
@@ -395,13 +443,13 @@ void ZOrderedCells::altRaise(CellSet cellsToRaise)
     }
     if(!c1) // not found, raise to top.
     {
-        list_.splice(it,raisedCells);
+        splice_(it,raisedCells);
         return;
     }
 
     // Move raised cells above it
     ++it;
-    list_.splice(it,raisedCells);
+    splice_(it,raisedCells);
 }
 
 void ZOrderedCells::altLower(CellSet cellsToLower)
@@ -440,13 +488,13 @@ void ZOrderedCells::altLower(CellSet cellsToLower)
     }
     if(!c1) // not found, raise to top.
     {
-        list_.splice(it,loweredCells);
+        splice_(it,loweredCells);
         return;
     }
 
     // Move lowered cells below it
     ++it;
-    list_.splice(it,loweredCells);
+    splice_(it,loweredCells);
 }
 
 void ZOrderedCells::altRaiseToTop(CellSet cellsToRaise)
@@ -458,18 +506,11 @@ void ZOrderedCells::altRaiseToTop(CellSet cellsToRaise)
     // List of actually raised cells
     CellLinkedList raisedCells;
 
-    // Advance to top and extract cells
-    Iterator it = begin();
-    while(it != end())
-    {
-        if(cellsToRaise.contains(*it))
-            it = list_.extractTo(it,raisedCells);
-        else
-            ++it;
-    }
+    // Extract cells
+    extract_(cellsToRaise, raisedCells);
 
     // Move raised cells to top
-    list_.splice(it,raisedCells);
+    splice_(end(),raisedCells);
 }
 
 void ZOrderedCells::altLowerToBottom(CellSet cellsToLower)
@@ -481,27 +522,17 @@ void ZOrderedCells::altLowerToBottom(CellSet cellsToLower)
     // List of actually lowered cells
     CellLinkedList loweredCells;
 
-    // Advance to bottom and extract cells
-    ReverseIterator it = rbegin();
-    while(it != rend())
-    {
-        if(cellsToLower.contains(*it))
-            it = list_.extractTo(it,loweredCells);
-        else
-            ++it;
-    }
+    // Extract cells
+    extract_(cellsToLower, loweredCells);
 
     // Move lowered cells to bottom
-    list_.splice(it,loweredCells);
+    splice_(begin(),loweredCells);
 }
 
 void ZOrderedCells::moveBelow(Cell * c1, Cell * c2)
 {
-    Iterator it1 = find(c1);
-    list_.erase(it1);
-
-    Iterator it2 = find(c2);
-    list_.insert(it2,c1);
+    removeCell(c1);
+    insertBefore_(find(c2), c1);
 }
 
 void ZOrderedCells::moveBelowBoundary(Cell * c)
@@ -509,11 +540,167 @@ void ZOrderedCells::moveBelowBoundary(Cell * c)
     CellSet boundary = c->boundary();
     if(!boundary.isEmpty())
     {
-        Iterator it1 = find(c);
-        list_.erase(it1);
+        removeCell(c);
+        insertBefore_(findFirst(boundary), c);
+    }
+}
+
+void ZOrderedCells::insertBefore_(Iterator pos, Cell * cell)
+{
+    Iterator it = list_.insert(pos, cell);
+    positions_[cell].it = it;
+    relabel_(it, pos);
+}
+
+void ZOrderedCells::splice_(Iterator pos, CellLinkedList & cells)
+{
+    if(cells.begin() == cells.end())
+        return;
+
+    // Nodes are moved, not copied, so first remains valid
+    Iterator first = cells.begin();
+    list_.splice(pos, cells);
+    relabel_(first, pos);
+}
+
+void ZOrderedCells::splice_(ReverseIterator pos, CellLinkedList & cells)
+{
+    splice_(pos.base(), cells);
+}
+
+void ZOrderedCells::extract_(const CellSet & cells, CellLinkedList & extracted,
+                             qint64 minLabel, qint64 maxLabel)
+{
+    QVector< QPair<qint64, Cell*> > toExtract;
+    foreach(Cell * c, cells)
+    {
+        QHash<Cell *, Position>::const_iterator p = positions_.constFind(c);
+        if(p != positions_.constEnd() && minLabel < p->label && p->label < maxLabel)
+            toExtract << qMakePair(p->label, c);
+    }
+    std::sort(toExtract.begin(), toExtract.end());
+
+    for(int i=0; i<toExtract.size(); ++i)
+        list_.extractTo(positions_.value(toExtract[i].second).it, extracted);
+}
+
+void ZOrderedCells::extract_(const CellSet & cells, CellLinkedList & extracted)
+{
+    // Labels are never equal to MIN_LABEL or MAX_LABEL
+    extract_(cells, extracted, MIN_LABEL, MAX_LABEL);
+}
+
+void ZOrderedCells::relabel_(Iterator first, Iterator last)
+{
+    int n = std::distance(first, last);
+    if(n == 0)
+        return;
+
+    // Labels of neighbours
+    bool hasBefore = (first != begin());
+    bool hasAfter = (last != end());
+    qint64 before = 0;
+    qint64 after = 0;
+    if(hasBefore)
+    {
+        Iterator it = first;
+        --it;
+        before = positions_.value(*it).label;
+    }
+    if(hasAfter)
+    {
+        after = positions_.value(*last).label;
+    }
+
+    // Compute labels of [first, last) as before + i*step, i in [1..n]
+    qint64 step = LABEL_GAP;
+    if(hasBefore && hasAfter)
+    {
+        step = (after - before) / (n + 1);
+    }
+    else if(hasAfter)
+    {
+        before = after - (n + 1) * LABEL_GAP;
+    }
+    else if(!hasBefore)
+    {
+        before = 0;
+    }
+
+    // Not enough room: relabel their neighbourhood
+    if(step == 0 ||
+       before < 0 ||
+       before > LABEL_RANGE - (n + 1) * step)
+    {
+        relabelRange_(first, last, hasBefore ? before : after);
+        return;
+    }
+
+    qint64 label = before;
+    for(Iterator it = first; it != last; ++it)
+    {
+        label += step;
+        positions_[*it].label = label;
+    }
+}
+
+void ZOrderedCells::relabelRange_(Iterator first, Iterator last, qint64 label)
+{
+    // Find the smallest range of labels [lo, hi) of size 2^i, aligned on
+    // 2^i, and containing the given label, which is sparse enough once the
+    // cells in [first, last) are added to it. The range is grown by
+    // extending [first, last) to the cells whose labels are in it. Since
+    // labels increase with the z-order, these cells are contiguous.
+    int count = std::distance(first, last);
+    double maxCount = 1;
+    for(int i=1; i<=LABEL_BITS; ++i)
+    {
+        maxCount *= DENSITY_RATIO;
+        const qint64 size = qint64(1) << i;
+        const qint64 lo = label & ~(size - 1);
+        const qint64 hi = lo + size;
+        while(first != begin())
+        {
+            Iterator prev = first;
+            --prev;
+            if(positions_.value(*prev).label < lo)
+                break;
+            first = prev;
+            ++count;
+        }
+        while(last != end() && positions_.value(*last).label < hi)
+        {
+            ++last;
+            ++count;
+        }
 
-        Iterator it2 = findFirst(boundary);
-        list_.insert(it2,c);
+        // Spread the cells evenly in the range
+        if(count < maxCount)
+        {
+            const qint64 step = size / (count + 1);
+            qint64 l = lo;
+            for(Iterator it = first; it != last; ++it)
+            {
+                l += step;
+                positions_[*it].label = l;
+            }
+            return;
+        }
+    }
+
+    // The whole label space is too dense
+    relabelAll_();
+}
+
+void ZOrderedCells::relabelAll_()
+{
+    qint64 label = 0;
+    for(Iterator it = begin(); it != end(); ++it)
+    {
+        label += LABEL_GAP;
+        Position & p = positions_[*it];
+        p.it = it;
+        p.label = label;
     }
 }
 
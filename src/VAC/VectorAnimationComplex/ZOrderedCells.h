@@ -18,10 +18,24 @@
 #define ZORDEREDCELLS_H
 
 // ZOrderedCells: A doubly linked list of cells with convenient methods
+//
+// In addition to the list itself, each cell is mapped to its node in the list
+// and to an integer label which increases with the z-order (order-maintenance
+// labels with gaps between them). This makes find(), removeCell() and
+// isBelow() O(1), and lets insertCell(), findFirst() and the raise/lower
+// methods only visit the cells involved rather than walk the whole list.
+//
+// Labels are reassigned to the cells moved by each operation, using the gap
+// available between their new neighbours. When there is no gap left, the
+// labels of a range around them are spread evenly, the range growing
+// geometrically until it is sparse enough (as in order-maintenance
+// structures). This relabels O(log n) cells per moved cell, amortized.
 
 #include "CellList.h"
 #include "CellLinkedList.h"
 
+#include <QHash>
+
 namespace VectorAnimationComplex
 {
 
@@ -54,6 +68,12 @@ public:
     Iterator findFirst(const CellSet & cells);
     ReverseIterator findLast(const CellSet & cells);
 
+    // Returns whether the cell is in this list
+    bool contains(Cell * cell) const;
+
+    // Returns whether c1 is strictly below c2. Both must be in this list.
+    bool isBelow(Cell * c1, Cell * c2) const;
+
     // Raise or lower a single cell
 
     void raise(Cell * cell);
@@ -85,6 +105,38 @@ public:
 private:
     CellLinkedList list_;
 
+    // Node and order-maintenance label of each cell in list_
+    struct Position
+    {
+        Position() : label(0) {}
+        Iterator it;
+        qint64 label;
+    };
+    QHash<Cell *, Position> positions_;
+
+    // Non-copyable: positions_ refer to the nodes of list_
+    ZOrderedCells(const ZOrderedCells &);
+    ZOrderedCells & operator=(const ZOrderedCells &);
+
+    // Insert cell just before pos, and map it
+    void insertBefore_(Iterator pos, Cell * cell);
+
+    // Move all cells of the given list just before pos, and relabel them
+    void splice_(Iterator pos, CellLinkedList & cells);
+    void splice_(ReverseIterator pos, CellLinkedList & cells);
+
+    // Move the given cells that are in this list and whose label is in
+    // (minLabel, maxLabel) at the end of extracted, preserving their z-order
+    void extract_(const CellSet & cells, CellLinkedList & extracted,
+                  qint64 minLabel, qint64 maxLabel);
+    void extract_(const CellSet & cells, CellLinkedList & extracted);
+
+    // Assign labels to the cells in [first, last), between the labels of
+    // their neighbours, or relabel a range around them if there isn't
+    // enough room (relabelRange_), starting at the given label
+    void relabel_(Iterator first, Iterator last);
+    void relabelRange_(Iterator first, Iterator last, qint64 label);
+    void relabelAll_();
 };
 
 }
@@ -19,16 +19,20 @@
 #include "Scene.h"
 #include "Timeline.h"
 #include "DevSettings.h"
+#include "Profiler.h"
+#include "InputRecorder.h"
 #include "Global.h"
 #include "Background/Background.h"
 #include "Background/BackgroundRenderer.h"
 #include "VectorAnimationComplex/VAC.h"
 #include "VectorAnimationComplex/Cell.h"
+#include "VectorAnimationComplex/Rasterizer.h"
 #include "Layer.h"
 
 #include <QtDebug>
 #include <QApplication>
 #include <QPushButton>
+#include <QPainter>
 #include <cmath>
 
 // define mouse actions
@@ -60,8 +64,16 @@ View::View(Scene * scene, QWidget * parent) :
     scene_(scene),
     pickingImg_(0),
     pickingIsEnabled_(true),
+    pickingLayerIndex_(-1),
+    wasUntrackedPicked_(false),
     currentAction_(0),
-    vac_(0)
+    vac_(0),
+    isDrawingToImage_(false),
+    backBufferFboId_(0),
+    backBufferColorId_(0),
+    backBufferWidth_(0),
+    backBufferHeight_(0),
+    isBackBufferSupported_(true)
 {
     // View settings widget
     viewSettingsWidget_ = new ViewSettingsWidget(viewSettings_, this);
@@ -88,6 +100,10 @@ View::View(Scene * scene, QWidget * parent) :
 
 View::~View()
 {
+    makeCurrent();
+    onionSkinCache_.clear();
+    deleteBackBuffer_();
+    doneCurrent();
     deletePicking();
 }
 
@@ -396,6 +412,7 @@ void View::ClicEvent(int action, double x, double y)
             vac_ = scene_->activeVAC();
             if(vac_)
             {
+                recordInput_(InputEvent::Split, x, y);
                 vac_->split(x, y, interactiveTime(), true);
 
                 emit allViewsNeedToUpdatePicking();
@@ -410,6 +427,7 @@ void View::ClicEvent(int action, double x, double y)
         vac_ = layer ? layer->vac() : nullptr;
         if(vac_)
         {
+            recordInput_(InputEvent::Paint, x, y);
             VectorAnimationComplex::Cell * paintedCell = vac_->paint(x, y, interactiveTime());
             if (!paintedCell)
             {
@@ -428,6 +446,7 @@ void View::ClicEvent(int action, double x, double y)
     {
         if(!hoveredObject_.isNull())
         {
+            recordInput_(InputEvent::Select, x, y);
             scene_->deselectAll();
             scene_->select(activeTime(),
                            hoveredObject_.index(),
@@ -439,6 +458,7 @@ void View::ClicEvent(int action, double x, double y)
     }
     else if(action==DESELECTALL_ACTION)
     {
+        recordInput_(InputEvent::DeselectAll);
         scene_->deselectAll();
         emit allViewsNeedToUpdatePicking();
         updateHoveredObject(mouse_Event_X_, mouse_Event_Y_);
@@ -448,6 +468,7 @@ void View::ClicEvent(int action, double x, double y)
     {
         if(!hoveredObject_.isNull())
         {
+            recordInput_(InputEvent::AddSelect, x, y);
             scene_->select(activeTime(),
                            hoveredObject_.index(),
                            hoveredObject_.id());
@@ -460,6 +481,7 @@ void View::ClicEvent(int action, double x, double y)
     {
         if(!hoveredObject_.isNull())
         {
+            recordInput_(InputEvent::Deselect, x, y);
             scene_->deselect(activeTime(),
                              hoveredObject_.index(),
                              hoveredObject_.id());
@@ -472,6 +494,7 @@ void View::ClicEvent(int action, double x, double y)
     {
         if(!hoveredObject_.isNull())
         {
+            recordInput_(InputEvent::ToggleSelect, x, y);
             scene_->toggle(activeTime(),
                            hoveredObject_.index(),
                            hoveredObject_.id());
@@ -525,6 +548,7 @@ void View::MoveEvent(double x, double y)
         if (vac)
         {
             Time time = interactiveTime();
+            recordInput_(InputEvent::SculptUpdate, x, y);
             vac->updateSculpt(x, y, time);
             mustRedraw = true;
         }
@@ -537,6 +561,7 @@ void View::MoveEvent(double x, double y)
         if (vac)
         {
             Time time = interactiveTime();
+            recordInput_(InputEvent::PaintUpdate, x, y);
             vac->updateToBePaintedFace(x, y, time);
             mustRedraw = true;
         }
@@ -558,6 +583,18 @@ Time View::interactiveTime() const
     return viewSettings_.time();
 }
 
+void View::recordInput_(InputEvent::Type type, double x, double y, double w)
+{
+    if (!InputRecorder::isRecording())
+        return;
+
+    // Only the active layer is pickable
+    const int layer = scene_->activeLayerIndex();
+    const int hovered = (!hoveredObject_.isNull() && hoveredObject_.index() == layer) ?
+                            static_cast<int>(hoveredObject_.id()) : -1;
+    InputRecorder::record(type, layer, hovered, interactiveTime(), x, y, w);
+}
+
 
 void View::PMRPressEvent(int action, double x, double y)
 {
@@ -606,6 +643,7 @@ void View::PMRPressEvent(int action, double x, double y)
             if(mouse_isTablet_ &&  global()->useTabletPressure())
                 w *= 2 * mouse_tabletPressure_; // 2 so that a half-pressure would get the default width
         }
+        recordInput_(InputEvent::SketchBegin, xScene, yScene, w);
         vac_->beginSketchEdge(xScene,yScene, w, interactiveTime());
 
         //emit allViewsNeedToUpdatePicking();
@@ -614,14 +652,17 @@ void View::PMRPressEvent(int action, double x, double y)
     }
     else if(action==DRAG_AND_DROP_ACTION)
     {
+        recordInput_(InputEvent::DragBegin, mouse_PressEvent_XScene_, mouse_PressEvent_YScene_);
         vac_->prepareDragAndDrop(mouse_PressEvent_XScene_, mouse_PressEvent_YScene_, interactiveTime());
     }
     else if(action==TRANSFORM_SELECTION_ACTION)
     {
+        recordInput_(InputEvent::TransformBegin, mouse_PressEvent_XScene_, mouse_PressEvent_YScene_);
         vac_->beginTransformSelection(mouse_PressEvent_XScene_, mouse_PressEvent_YScene_, interactiveTime());
     }
     else if(action==RECTANGLE_OF_SELECTION_ACTION)
     {
+        recordInput_(InputEvent::RectangleBegin, x, y);
         vac_->beginRectangleOfSelection(x,y,interactiveTime());
     }
     else if(action==SCULPT_CHANGE_RADIUS_ACTION)
@@ -678,6 +719,7 @@ void View::PMRPressEvent(int action, double x, double y)
         sculptStartRadius_ = global()->sculptRadius();
         sculptStartX_ = x;
         sculptStartY_ = y;
+        recordInput_(InputEvent::SculptDeformBegin, x, y);
         vac_->beginSculptDeform(x,y);
 
         //emit allViewsNeedToUpdatePicking();
@@ -689,6 +731,7 @@ void View::PMRPressEvent(int action, double x, double y)
         sculptStartRadius_ = global()->sculptRadius();
         sculptStartX_ = x;
         sculptStartY_ = y;
+        recordInput_(InputEvent::SculptWidthBegin, x, y);
         vac_->beginSculptEdgeWidth(x,y);
 
         //emit allViewsNeedToUpdatePicking();
@@ -700,6 +743,7 @@ void View::PMRPressEvent(int action, double x, double y)
         sculptStartRadius_ = global()->sculptRadius();
         sculptStartX_ = x;
         sculptStartY_ = y;
+        recordInput_(InputEvent::SculptSmoothBegin, x, y);
         vac_->beginSculptSmooth(x,y);
 
         //emit allViewsNeedToUpdatePicking();
@@ -729,6 +773,7 @@ void View::PMRMoveEvent(int action, double x, double y)
                 if(mouse_isTablet_ &&  global()->useTabletPressure())
                     w *= 2 * mouse_tabletPressure_; // 2 so that a half-pressure would get the default width
             }
+            recordInput_(InputEvent::SketchContinue, x, y, w);
             vac_->continueSketchEdge(x,y, w); // Note: this call "changed", hence all views are updated
         }
 
@@ -738,6 +783,7 @@ void View::PMRMoveEvent(int action, double x, double y)
     }
     else if(action==DRAG_AND_DROP_ACTION)
     {
+        recordInput_(InputEvent::DragContinue, x, y);
         vac_->performDragAndDrop(x, y);
 
         //emit allViewsNeedToUpdatePicking();
@@ -747,11 +793,13 @@ void View::PMRMoveEvent(int action, double x, double y)
     }
     else if(action==TRANSFORM_SELECTION_ACTION)
     {
+        recordInput_(InputEvent::TransformContinue, x, y);
         vac_->continueTransformSelection(x, y);
         emit allViewsNeedToUpdate();
     }
     else if(action==RECTANGLE_OF_SELECTION_ACTION)
     {
+        recordInput_(InputEvent::RectangleContinue, x, y);
         vac_->continueRectangleOfSelection(x,y);
 
         emit allViewsNeedToUpdate();
@@ -852,6 +900,7 @@ void View::PMRMoveEvent(int action, double x, double y)
     }
     else if(action==SCULPT_DEFORM_ACTION)
     {
+        recordInput_(InputEvent::SculptDeformContinue, x, y);
         vac_->continueSculptDeform(x,y);
 
         //emit allViewsNeedToUpdatePicking();
@@ -860,6 +909,7 @@ void View::PMRMoveEvent(int action, double x, double y)
     }
     else if(action==SCULPT_CHANGE_WIDTH_ACTION)
     {
+        recordInput_(InputEvent::SculptWidthContinue, x, y);
         vac_->continueSculptEdgeWidth(x,y);
 
         //emit allViewsNeedToUpdatePicking();
@@ -868,6 +918,7 @@ void View::PMRMoveEvent(int action, double x, double y)
     }
     else if(action==SCULPT_SMOOTH_ACTION)
     {
+        recordInput_(InputEvent::SculptSmoothContinue, x, y);
         vac_->continueSculptSmooth(x,y);
 
         //emit allViewsNeedToUpdatePicking();
@@ -885,6 +936,7 @@ void View::PMRReleaseEvent(int action, double x, double y)
 
     if(action==SKETCH_ACTION)
     {
+        recordInput_(InputEvent::SketchEnd);
         vac_->endSketchEdge();
 
         emit allViewsNeedToUpdatePicking();
@@ -893,6 +945,7 @@ void View::PMRReleaseEvent(int action, double x, double y)
     }
     else if(action==DRAG_AND_DROP_ACTION)
     {
+        recordInput_(InputEvent::DragEnd);
         vac_->completeDragAndDrop();
 
         emit allViewsNeedToUpdatePicking();
@@ -901,6 +954,7 @@ void View::PMRReleaseEvent(int action, double x, double y)
     }
     else if(action==TRANSFORM_SELECTION_ACTION)
     {
+        recordInput_(InputEvent::TransformEnd);
         vac_->endTransformSelection();
         emit allViewsNeedToUpdatePicking();
         updateHoveredObject(mouse_Event_X_, mouse_Event_Y_);
@@ -908,6 +962,7 @@ void View::PMRReleaseEvent(int action, double x, double y)
     }
     else if(action==RECTANGLE_OF_SELECTION_ACTION)
     {
+        recordInput_(InputEvent::RectangleEnd);
         vac_->endRectangleOfSelection();
 
         emit allViewsNeedToUpdatePicking();
@@ -916,6 +971,7 @@ void View::PMRReleaseEvent(int action, double x, double y)
     }
     else if(action==SCULPT_CHANGE_RADIUS_ACTION)
     {
+        recordInput_(InputEvent::SculptUpdate, x, y);
         vac_->updateSculpt(x, y, interactiveTime());
 
         emit allViewsNeedToUpdatePicking();
@@ -930,7 +986,9 @@ void View::PMRReleaseEvent(int action, double x, double y)
     }
     else if(action==SCULPT_DEFORM_ACTION)
     {
+        recordInput_(InputEvent::SculptDeformEnd);
         vac_->endSculptDeform();
+        recordInput_(InputEvent::SculptUpdate, x, y);
         vac_->updateSculpt(x, y, interactiveTime());
 
         emit allViewsNeedToUpdatePicking();
@@ -939,7 +997,9 @@ void View::PMRReleaseEvent(int action, double x, double y)
     }
     else if(action==SCULPT_CHANGE_WIDTH_ACTION)
     {
+        recordInput_(InputEvent::SculptWidthEnd);
         vac_->endSculptEdgeWidth();
+        recordInput_(InputEvent::SculptUpdate, x, y);
         vac_->updateSculpt(x, y, interactiveTime());
 
         emit allViewsNeedToUpdatePicking();
@@ -948,7 +1008,9 @@ void View::PMRReleaseEvent(int action, double x, double y)
     }
     else if(action==SCULPT_SMOOTH_ACTION)
     {
+        recordInput_(InputEvent::SculptSmoothEnd);
         vac_->endSculptSmooth();
+        recordInput_(InputEvent::SculptUpdate, x, y);
         vac_->updateSculpt(x, y, interactiveTime());
 
         emit allViewsNeedToUpdatePicking();
@@ -967,6 +1029,13 @@ void View::PMRReleaseEvent(int action, double x, double y)
 void View::onBackgroundDestroyed_(Background * background)
 {
     destroyBackgroundRenderer_(background);
+    displayDamage_.invalidate();
+}
+
+void View::onBackgroundChanged_()
+{
+    displayDamage_.invalidate();
+    update();
 }
 
 BackgroundRenderer * View::getBackgroundRenderer_(Background * background)
@@ -986,6 +1055,7 @@ BackgroundRenderer * View::createBackgroundRenderer_(Background * background)
 {
     BackgroundRenderer * res = new BackgroundRenderer(background, this);
     connect(res, &BackgroundRenderer::backgroundDestroyed, this, &View::onBackgroundDestroyed_);
+    connect(res, &BackgroundRenderer::changed, this, &View::onBackgroundChanged_);
     backgroundRenderers_.insert(background, res);
     return res;
 }
@@ -1012,7 +1082,8 @@ void View::drawBackground_(Background * background, int frame)
     br->draw(frame,
              global()->showCanvas(),
              scene_->left(), scene_->top(), scene_->width(), scene_->height(),
-             xSceneMin(), xSceneMax(), ySceneMin(), ySceneMax());
+             xSceneMin(), xSceneMax(), ySceneMin(), ySceneMax(),
+             isDrawingToImage_);
 }
 
 void View::drawScene()
@@ -1039,26 +1110,207 @@ void View::drawScene()
         }
     }
 
-    // Clear to white
-    glClearColor(1.0,1.0,1.0,1.0);
-    glClear(GL_COLOR_BUFFER_BIT);
+    // Draw scene
+    {
+        ProfilerScope profilerScope("View::drawScene");
+
+        // Draw canvas and layers, preferably only where they changed since
+        // the last frame, using the back buffer
+        if(!drawToBackBuffer_())
+        {
+            // Clear to white
+            glClearColor(1.0,1.0,1.0,1.0);
+            glClear(GL_COLOR_BUFFER_BIT);
+
+            // Note:
+            // It is the responsability of view to decide when to call scene()->drawCanvas
+            // draw a canvas, and layer backgrounds, and in which order,
+            // since this is dependent on onion skinning settings which only
+            // view should be aware of
+
+            // Draw canvas
+            // XXX Should be replaced by drawCanvas_(scene_->canvas());
+            scene_->drawCanvas(viewSettings_);
+
+            // Draw layers
+            drawLayers_(activeTime(), true);
+        }
+
+        // Draw overlays, which are not tracked by the back buffer
+        drawOverlays_(activeTime());
+    }
+
+    // Draw profiler overlay
+    if(Profiler::isEnabled())
+        drawProfilerOverlay_();
+}
 
-    // Note:
-    // It is the responsability of view to decide when to call scene()->drawCanvas
-    // draw a canvas, and layer backgrounds, and in which order,
-    // since this is dependent on onion skinning settings which only
-    // view should be aware of
+void View::drawProfilerOverlay_()
+{
+    QString report = Profiler::lastFrameReport();
+    if (report.isEmpty())
+        return;
 
-    // Draw canvas
-    // XXX Should be replaced by drawCanvas_(scene_->canvas());
-    scene_->drawCanvas(viewSettings_);
+    // Draw report as text in the top-left corner, over a translucent box
+    QPainter painter(this);
+    QFont font = painter.font();
+    font.setStyleHint(QFont::Monospace);
+    font.setFamily("Monospace");
+    painter.setFont(font);
+    QRect textRect = painter.boundingRect(QRect(0, 0, width(), height()),
+                                          Qt::AlignLeft | Qt::AlignTop, report);
+    textRect.translate(10, 10);
+    painter.fillRect(textRect.adjusted(-5, -5, 5, 5), QColor(255, 255, 255, 200));
+    painter.setPen(Qt::black);
+    painter.drawText(textRect, Qt::AlignLeft | Qt::AlignTop, report);
+    painter.end();
+
+    // Restore OpenGL state modified by QPainter. See GLWidget::initializeGL()
+    glEnable(GL_BLEND);
+    gl_->glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA,
+                             GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+}
 
-    // Draw scene
-    drawSceneDelegate_(activeTime());
+bool View::drawToBackBuffer_()
+{
+    if (!isBackBufferSupported_) {
+        return false;
+    }
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    const GLsizei w = viewport[2];
+    const GLsizei h = viewport[3];
+    if (w <= 0 || h <= 0) {
+        return false;
+    }
+    const GLuint viewFboId = defaultFramebufferObject();
+
+    // (Re)create the back buffer if needed. It has the same number of
+    // samples as the view, so that it can be copied as is.
+    if (!(backBufferFboId_ && backBufferWidth_ == w && backBufferHeight_ == h))
+    {
+        deleteBackBuffer_();
+
+        GLint samples = 0;
+        glGetIntegerv(GL_SAMPLES, &samples);
+        gl_fbo_->glGenFramebuffers(1, &backBufferFboId_);
+        gl_fbo_->glBindFramebuffer(GL_FRAMEBUFFER, backBufferFboId_);
+        gl_fbo_->glGenRenderbuffers(1, &backBufferColorId_);
+        gl_fbo_->glBindRenderbuffer(GL_RENDERBUFFER, backBufferColorId_);
+        gl_fbo_->glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, w, h);
+        GLint actualSamples = 0;
+        gl_fbo_->glGetRenderbufferParameteriv(GL_RENDERBUFFER, GL_RENDERBUFFER_SAMPLES, &actualSamples);
+        gl_fbo_->glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        gl_fbo_->glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                           GL_RENDERBUFFER, backBufferColorId_);
+        GLenum status = gl_fbo_->glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        gl_fbo_->glBindFramebuffer(GL_FRAMEBUFFER, viewFboId);
+        backBufferWidth_ = w;
+        backBufferHeight_ = h;
+        displayDamage_.invalidate();
+
+        if (status != GL_FRAMEBUFFER_COMPLETE || actualSamples != samples)
+        {
+            qDebug() << "Error: back buffer FBO can't be used. The view is entirely redrawn at each frame.";
+            deleteBackBuffer_();
+            isBackBufferSupported_ = false;
+            return false;
+        }
+    }
+
+    // Find which part of the back buffer must be redrawn
+    Time t = activeTime();
+    QList<VectorAnimationComplex::VAC*> vacs;
+    for (int j = 0; j < scene()->numLayers(); ++j)
+    {
+        Layer * layer = scene()->layer(j);
+        if (layer->isVisible()) {
+            vacs << layer->vac();
+        }
+    }
+    QList<Time> onionSkinTimes = onionSkinTimes_(t);
+    View * hoveredView = global()->hoveredView();
+    for (int i = 0; i < onionSkinTimes.size(); ++i)
+    {
+        // Onion skins at the frame where the user interacts may show the
+        // sketched edge or the cursor, which are not tracked
+        if (hoveredView && hoveredView->activeTime().frame() == onionSkinTimes[i].frame()) {
+            displayDamage_.invalidate();
+        }
+    }
+    QRect damaged;
+    VectorAnimationComplex::BoundingBox cullRegion;
+    const bool isFullyDamaged = displayDamage_.update(
+                scene_, vacs, t, onionSkinTimes, viewSettings_, damaged, cullRegion);
+
+    // Redraw it
+    if (isFullyDamaged || !damaged.isEmpty())
+    {
+        gl_fbo_->glBindFramebuffer(GL_FRAMEBUFFER, backBufferFboId_);
+        if (!isFullyDamaged)
+        {
+            glEnable(GL_SCISSOR_TEST);
+            glScissor(damaged.x(), damaged.y(), damaged.width(), damaged.height());
+        }
+
+        glClearColor(1.0,1.0,1.0,1.0);
+        glClear(GL_COLOR_BUFFER_BIT);
+        scene_->drawCanvas(viewSettings_);
+        drawLayers_(t, true, isFullyDamaged ? 0 : &cullRegion);
+
+        glDisable(GL_SCISSOR_TEST);
+    }
+
+    // Copy it to the view
+    gl_fbo_->glBindFramebuffer(GL_READ_FRAMEBUFFER, backBufferFboId_);
+    gl_fbo_->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, viewFboId);
+    gl_fbo_->glBlitFramebuffer(viewport[0], viewport[1], viewport[0] + w, viewport[1] + h,
+                               viewport[0], viewport[1], viewport[0] + w, viewport[1] + h,
+                               GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    gl_fbo_->glBindFramebuffer(GL_FRAMEBUFFER, viewFboId);
+
+    return true;
 }
 
-void View::drawSceneDelegate_(Time t)
+void View::deleteBackBuffer_()
 {
+    if (backBufferFboId_)
+    {
+        gl_fbo_->glDeleteFramebuffers(1, &backBufferFboId_);
+        gl_fbo_->glDeleteRenderbuffers(1, &backBufferColorId_);
+        backBufferFboId_ = 0;
+        backBufferColorId_ = 0;
+        backBufferWidth_ = 0;
+        backBufferHeight_ = 0;
+    }
+    displayDamage_.invalidate();
+}
+
+void View::drawSceneDelegate_(Time t, bool useOnionSkinCache)
+{
+    drawLayers_(t, useOnionSkinCache);
+    drawOverlays_(t);
+}
+
+void View::drawOverlays_(Time t)
+{
+    viewSettings_.setMainDrawing(true);
+    for (int j = 0; j < scene()->numLayers(); ++j)
+    {
+        Layer * layer = scene()->layer(j);
+        if (layer->isVisible()) {
+            layer->vac()->drawOverlay(t, viewSettings_);
+        }
+    }
+}
+
+void View::drawLayers_(Time t, bool useOnionSkinCache, const VectorAnimationComplex::BoundingBox * region)
+{
+    if (useOnionSkinCache) {
+        onionSkinCache_.beginFrame(gl_, gl_fbo_.get(), viewSettings_);
+    }
+
     for (int j = 0; j < scene()->numLayers(); ++j)
     {
         Layer * layer = scene()->layer(j);
@@ -1087,40 +1339,84 @@ void View::drawSceneDelegate_(Time t)
         viewSettings_.setMainDrawing(false);
         if(viewSettings_.onionSkinningIsEnabled())
         {
+            const Time dt = viewSettings_.onionSkinsTimeOffset();
+            const double dx = viewSettings_.onionSkinsXOffset();
+            const double dy = viewSettings_.onionSkinsYOffset();
+
             // Draw onion skins before
+            const int numBefore = viewSettings_.numOnionSkinsBefore();
             Time tOnion = t;
-            for(int i=0; i<viewSettings_.numOnionSkinsBefore(); ++i)
-            {
-                tOnion = tOnion - viewSettings_.onionSkinsTimeOffset();
-                glTranslated(-viewSettings_.onionSkinsXOffset(),-viewSettings_.onionSkinsYOffset(),0);
-            }
-            for(int i=0; i<viewSettings_.numOnionSkinsBefore(); ++i)
+            for(int i=0; i<numBefore; ++i)
+                tOnion = tOnion - dt;
+            for(int i=numBefore; i>0; --i)
             {
-                vac->draw(tOnion, viewSettings_);
-                tOnion = tOnion + viewSettings_.onionSkinsTimeOffset();
-                glTranslated(viewSettings_.onionSkinsXOffset(),viewSettings_.onionSkinsYOffset(),0);
+                drawOnionSkin_(vac, tOnion, -i*dx, -i*dy, useOnionSkinCache);
+                tOnion = tOnion + dt;
             }
 
             // Draw onion skins after
+            const int numAfter = viewSettings_.numOnionSkinsAfter();
             tOnion = t;
-            for(int i=0; i<viewSettings_.numOnionSkinsAfter(); ++i)
+            for(int i=1; i<=numAfter; ++i)
             {
-                glTranslated(viewSettings_.onionSkinsXOffset(),viewSettings_.onionSkinsYOffset(),0);
-                tOnion = tOnion + viewSettings_.onionSkinsTimeOffset();
-                vac->draw(tOnion, viewSettings_);
-            }
-            for(int i=0; i<viewSettings_.numOnionSkinsAfter(); ++i)
-            {
-                glTranslated(-viewSettings_.onionSkinsXOffset(),-viewSettings_.onionSkinsYOffset(),0);
+                tOnion = tOnion + dt;
+                drawOnionSkin_(vac, tOnion, i*dx, i*dy, useOnionSkinCache);
             }
         }
 
         // Draw current frame
         viewSettings_.setMainDrawing(true);
+        vac->drawCells(t, viewSettings_, region);
+    }
+
+    if (useOnionSkinCache) {
+        onionSkinCache_.endFrame();
+    }
+}
+
+void View::drawOnionSkin_(VectorAnimationComplex::VAC * vac, Time t, double dx, double dy, bool useOnionSkinCache)
+{
+    // Onion skins at the frame where the user interacts are never cached,
+    // since they may show the sketched edge or the cursor
+    View * hoveredView = global()->hoveredView();
+    const bool isInteractive = hoveredView && hoveredView->activeTime().frame() == t.frame();
+
+    if (useOnionSkinCache && !isInteractive)
+    {
+        onionSkinCache_.draw(vac, t, dx, dy, viewSettings_);
+    }
+    else
+    {
+        glPushMatrix();
+        glTranslated(dx, dy, 0);
         vac->draw(t, viewSettings_);
+        glPopMatrix();
     }
 }
 
+QList<Time> View::onionSkinTimes_(Time t) const
+{
+    // Same times as drawn by drawLayers_()
+    QList<Time> res;
+    if(viewSettings_.onionSkinningIsEnabled())
+    {
+        const Time dt = viewSettings_.onionSkinsTimeOffset();
+        Time tOnion = t;
+        for(int i=0; i<viewSettings_.numOnionSkinsBefore(); ++i)
+        {
+            tOnion = tOnion - dt;
+            res << tOnion;
+        }
+        tOnion = t;
+        for(int i=0; i<viewSettings_.numOnionSkinsAfter(); ++i)
+        {
+            tOnion = tOnion + dt;
+            res << tOnion;
+        }
+    }
+    return res;
+}
+
 void View::toggleOutline()
 {
     viewSettings_.toggleOutline();
@@ -1216,7 +1512,7 @@ ViewSettingsWidget * View::viewSettingsWidget() const
  *              PICKING
  */
 
-void View::drawPick()
+void View::drawPick(const VectorAnimationComplex::BoundingBox * region)
 {
     Time t = activeTime();
     {
@@ -1249,7 +1545,10 @@ void View::drawPick()
         }
 
         // Draw current frame
-        scene_->drawPick(t, viewSettings_);
+        if(region)
+            scene_->drawPick(t, viewSettings_, *region);
+        else
+            scene_->drawPick(t, viewSettings_);
     }
 }
 
@@ -1387,6 +1686,7 @@ void View::deletePicking()
         pickingWidth_ = 0;
         pickingHeight_ = 0;
     }
+    pickingDamage_.invalidate();
 }
 
 void View::newPicking()
@@ -1470,6 +1770,14 @@ QImage View::drawToImage(double x, double y, double w, double h, int imgW, int i
     return drawToImage(activeTime(), x, y, w, h, imgW, imgH, useViewSettings);
 }
 
+QImage View::rasterizeToImage_(Time t, double x, double y, double w, double h, int imgW, int imgH)
+{
+    VectorAnimationComplex::Rasterizer rasterizer(imgW, imgH);
+    rasterizer.setViewport(x, y, w, h);
+    scene()->rasterize(t, rasterizer, x, x+w, y, y+h);
+    return rasterizer.toImage();
+}
+
 QImage View::drawToImage(Time t, double x, double y, double w, double h, int IMG_SIZE_X, int IMG_SIZE_Y, bool useViewSettings)
 {
     // Make this widget's rendering context the current OpenGL context
@@ -1502,8 +1810,13 @@ QImage View::drawToImage(Time t, double x, double y, double w, double h, int IMG
     // Check FBO status
     GLenum ms_status = gl_fbo_->glCheckFramebufferStatus(GL_FRAMEBUFFER);
     if(ms_status != GL_FRAMEBUFFER_COMPLETE) {
-        qDebug() << "Error: FBO ms_status != GL_FRAMEBUFFER_COMPLETE";
-        return QImage();
+        qDebug() << "Error: FBO ms_status != GL_FRAMEBUFFER_COMPLETE. Falling back to software rendering.";
+        gl_fbo_->glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebufferObject());
+        gl_fbo_->glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        gl_fbo_->glDeleteFramebuffers(1, &ms_fboId);
+        gl_fbo_->glDeleteRenderbuffers(1, &ms_ColorBufferId);
+        gl_fbo_->glDeleteRenderbuffers(1, &ms_DepthBufferId);
+        return rasterizeToImage_(t, x, y, w, h, IMG_SIZE_X, IMG_SIZE_Y);
     }
 
 
@@ -1538,8 +1851,15 @@ QImage View::drawToImage(Time t, double x, double y, double w, double h, int IMG
     // Check FBO status
     GLenum status = gl_fbo_->glCheckFramebufferStatus(GL_FRAMEBUFFER);
     if(status != GL_FRAMEBUFFER_COMPLETE) {
-        qDebug() << "Error: FBO status != GL_FRAMEBUFFER_COMPLETE";
-        return QImage();
+        qDebug() << "Error: FBO status != GL_FRAMEBUFFER_COMPLETE. Falling back to software rendering.";
+        gl_fbo_->glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebufferObject());
+        gl_fbo_->glDeleteFramebuffers(1, &ms_fboId);
+        gl_fbo_->glDeleteRenderbuffers(1, &ms_ColorBufferId);
+        gl_fbo_->glDeleteRenderbuffers(1, &ms_DepthBufferId);
+        gl_fbo_->glDeleteFramebuffers(1, &fboId);
+        gl_fbo_->glDeleteRenderbuffers(1, &rboId);
+        glDeleteTextures(1, &textureId);
+        return rasterizeToImage_(t, x, y, w, h, IMG_SIZE_X, IMG_SIZE_Y);
     }
 
 
@@ -1572,6 +1892,7 @@ QImage View::drawToImage(Time t, double x, double y, double w, double h, int IMG
     glLoadMatrixd(camera2d.viewMatrixData());
 
     // Draw scene
+    isDrawingToImage_ = true;
     if (useViewSettings)
     {
         drawSceneDelegate_(t);
@@ -1595,6 +1916,7 @@ QImage View::drawToImage(Time t, double x, double y, double w, double h, int IMG
         viewSettings_.setDrawCursor(true);
         viewSettings_.setDisplayMode(oldDM);
     }
+    isDrawingToImage_ = false;
 
     // Restore viewport
     glViewport(oldViewport[0], oldViewport[1], oldViewport[2], oldViewport[3]);
@@ -1680,6 +2002,8 @@ QImage View::drawToImage(Time t, double x, double y, double w, double h, int IMG
 
 void View::updatePicking()
 {
+    ProfilerScope profilerScope("View::updatePicking");
+
     // Remove previously highlighted object
     hoveredObject_ = Picking::Object();
 
@@ -1711,10 +2035,6 @@ void View::updatePicking()
     // set rendering destination to FBO
     gl_fbo_->glBindFramebuffer(GL_FRAMEBUFFER, fboId_);
 
-    // clear buffers
-    glClearColor(1.0, 1.0, 1.0, 1.0);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
     // Should we setup other things? (e.g., disabling antialiasing)
     // Seems to work as is. If issues, check GLWidget::initilizeGL()
 
@@ -1726,8 +2046,60 @@ void View::updatePicking()
     // Setup camera position and orientation
     setCameraPositionAndOrientation();
 
-    // draw the picking
-    drawPick();
+    // Find which part of the picking image must be redrawn. The transform
+    // tool and pickable onion skins are not tracked, so everything is
+    // redrawn when they are drawn.
+    Time t = activeTime();
+    Layer * layer = scene_->activeLayer();
+    QList<VectorAnimationComplex::VAC*> vacs;
+    if(layer && layer->isVisible())
+        vacs << layer->vac();
+    const bool isTransformToolDrawn =
+            global()->toolMode() == Global::SELECT &&
+            layer && layer->vac()->numSelectedCells() > 0;
+    const bool areOnionSkinsDrawn =
+            viewSettings_.onionSkinningIsEnabled() &&
+            viewSettings_.areOnionSkinsPickable();
+    const bool isUntrackedDrawn = isTransformToolDrawn || areOnionSkinsDrawn;
+    if(isUntrackedDrawn || wasUntrackedPicked_ ||
+       pickingLayerIndex_ != scene_->activeLayerIndex())
+    {
+        pickingDamage_.invalidate();
+    }
+    wasUntrackedPicked_ = isUntrackedDrawn;
+    pickingLayerIndex_ = scene_->activeLayerIndex();
+    QRect damaged;
+    VectorAnimationComplex::BoundingBox cullRegion;
+    const bool isFullyDamaged = pickingDamage_.update(
+                scene_, vacs, t, QList<Time>(), viewSettings_, damaged, cullRegion);
+
+    if(isFullyDamaged)
+    {
+        // clear buffers
+        glClearColor(1.0, 1.0, 1.0, 1.0);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        // draw the picking
+        drawPick();
+    }
+    else if(!damaged.isEmpty())
+    {
+        // Same, but only in the damaged rectangle
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(damaged.x(), damaged.y(), damaged.width(), damaged.height());
+        glClearColor(1.0, 1.0, 1.0, 1.0);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        drawPick(&cullRegion);
+        glDisable(GL_SCISSOR_TEST);
+
+        // Only read back the damaged rectangle, which is much cheaper
+        // than reading back the whole texture
+        glPixelStorei(GL_PACK_ROW_LENGTH, pickingWidth_);
+        glReadPixels(damaged.x(), damaged.y(), damaged.width(), damaged.height(),
+                     GL_RGBA, GL_UNSIGNED_BYTE,
+                     pickingImg_ + 4 * (damaged.y() * pickingWidth_ + damaged.x()));
+        glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+    }
 
     // Restore viewport
     glViewport(oldViewport[0], oldViewport[1], oldViewport[2], oldViewport[3]);
@@ -1736,9 +2108,12 @@ void View::updatePicking()
     gl_fbo_->glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebufferObject());
 
     // extract the texture info from GPU to RAM: EXPENSIVE + MAY CAUSE OPENGL STALL
-    glBindTexture(GL_TEXTURE_2D, textureId_);
-    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pickingImg_);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    if(isFullyDamaged)
+    {
+        glBindTexture(GL_TEXTURE_2D, textureId_);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pickingImg_);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
 
     // Update highlighted object
     if(underMouse())
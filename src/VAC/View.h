@@ -31,6 +31,9 @@
 #include <QMap>
 
 #include "ViewSettings.h"
+#include "OnionSkinCache.h"
+#include "DamageTracker.h"
+#include "InputRecorder.h"
 
 class Scene;
 namespace VectorAnimationComplex
@@ -118,6 +121,10 @@ public:
     // View opened (e.g., command-line vec->png conversion).
     // In the meantime, that was the easiest way to implement it.
     // Will refactor later.
+    //
+    // If framebuffer objects are not supported, the image is rasterized in
+    // software instead, in illustration mode: useViewSettings is then
+    // ignored, as if it was false.
     QImage drawToImage(double x, double y, double w, double h, int imgW, int imgH, bool useViewSettings);
     QImage drawToImage(Time t, double x, double y, double w, double h, int imgW, int imgH, bool useViewSettings);
 
@@ -135,7 +142,11 @@ public slots:
 
     void updateZoomFromView();
 
-    void drawSceneDelegate_(Time t);
+    // Draws all layers at time t, then their overlays (see
+    // VAC::drawOverlay()). Onion skins are drawn from a cache of textures
+    // if useOnionSkinCache is true, which is only valid when drawing the
+    // view itself, not when drawing to an image.
+    void drawSceneDelegate_(Time t, bool useOnionSkinCache = false);
 
 protected:
     virtual void resizeEvent(QResizeEvent * event);
@@ -148,6 +159,7 @@ signals:
 
 private slots:
     void onBackgroundDestroyed_(Background * background);
+    void onBackgroundChanged_();
 
 private:
     // What scene to draw
@@ -163,9 +175,13 @@ private:
     MouseEvent mouseEvent() const;
     QPoint lastMousePos_;
 
+    // Records the VAC operation about to be performed on the active layer,
+    // if input recording is enabled (see InputRecorder)
+    void recordInput_(InputEvent::Type type, double x = 0, double y = 0, double w = 0);
+
     // picking
     void newPicking();
-    void drawPick();
+    void drawPick(const VectorAnimationComplex::BoundingBox * region = 0);
     uchar * pickingImg(int x, int y);
     GLsizei pickingWidth_;
     GLsizei pickingHeight_;
@@ -175,6 +191,9 @@ private:
     uchar *pickingImg_;
     Picking::Object hoveredObject_;
     bool pickingIsEnabled_;
+    DamageTracker pickingDamage_;
+    int pickingLayerIndex_;
+    bool wasUntrackedPicked_; // whether the transform tool or onion skins were picked
 
     // PMR mouse event temp variables
     int currentAction_;
@@ -202,7 +221,33 @@ private:
     void destroyBackgroundRenderer_(Background * background);
     BackgroundRenderer * getOrCreateBackgroundRenderer_(Background * background);
     void drawBackground_(Background * background, int frame);
+    bool isDrawingToImage_; // backgrounds are then drawn at full resolution
+    void drawProfilerOverlay_();
+    QImage rasterizeToImage_(Time t, double x, double y, double w, double h, int imgW, int imgH);
     QMap<Background *, BackgroundRenderer *> backgroundRenderers_;
+
+    // Draw onion skins
+    void drawOnionSkin_(VectorAnimationComplex::VAC * vac, Time t, double dx, double dy, bool useOnionSkinCache);
+    QList<Time> onionSkinTimes_(Time t) const;
+    OnionSkinCache onionSkinCache_;
+
+    // Draw layers, without their overlays. If a region is given, only the
+    // cells which may be drawn in this region are drawn.
+    void drawLayers_(Time t, bool useOnionSkinCache,
+                     const VectorAnimationComplex::BoundingBox * region = 0);
+    void drawOverlays_(Time t);
+
+    // Back buffer where the canvas and layers are drawn, and where only the
+    // part damaged since the last frame is redrawn. It is then copied to
+    // the view, and overlays are drawn on top of it.
+    bool drawToBackBuffer_();
+    void deleteBackBuffer_();
+    GLuint backBufferFboId_;
+    GLuint backBufferColorId_;
+    GLsizei backBufferWidth_;
+    GLsizei backBufferHeight_;
+    bool isBackBufferSupported_;
+    DamageTracker displayDamage_;
 };
 
 #endif
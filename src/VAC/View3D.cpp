@@ -23,6 +23,7 @@
 #include <QtDebug>
 #include "Global.h"
 #include "View.h"
+#include "MeshWriter.h"
 #include "Background/Background.h"
 #include "Background/BackgroundRenderer.h"
 
@@ -48,6 +49,20 @@
 #define TOGGLESELECT_ACTION 23
 #define DESELECTALL_ACTION 24
 
+namespace
+{
+
+// Approximate distance between consecutive samples of space-time surfaces,
+// in scene units (see InbetweenEdge::getGeometry())
+const double SURFACE_SAMPLE_SPACING = 5.0;
+
+// Rows and columns of space-time surfaces are skipped when they would be
+// closer than this on screen, in pixels, up to MAX_SURFACE_STRIDE
+const double MIN_SURFACE_SPACING = 2.0;
+const int MAX_SURFACE_STRIDE = 16;
+
+}
+
 View3D::View3D(Scene *scene, QWidget *parent) :
     GLWidget(parent, false), // Difference from View here
     scene_(scene),
@@ -90,6 +105,9 @@ View3D::View3D(Scene *scene, QWidget *parent) :
 
 View3D::~View3D()
 {
+    makeCurrent();
+    surfaceCache_.clear();
+    doneCurrent();
     deletePicking();
 }
 
@@ -479,6 +497,21 @@ void View3D::drawSceneDelegate_(Time activeTime)
             }
     });
 
+    // Compute and upload the space-time surfaces of inbetween edges
+    surfaceEdges_.clear();
+    for (const DrawItem& item: drawItems_) {
+        if (item.mode == DrawMode::Draw3D) {
+            if (InbetweenEdge * ie = item.cell->toInbetweenEdge()) {
+                surfaceEdges_ << ie;
+            }
+        }
+    }
+    std::sort(surfaceEdges_.begin(), surfaceEdges_.end());
+    surfaceEdges_.erase(std::unique(surfaceEdges_.begin(), surfaceEdges_.end()), surfaceEdges_.end());
+    int timeStride, sampleStride;
+    surfaceStrides_(timeStride, sampleStride);
+    surfaceCache_.beginFrame(gl_, viewSettings_, surfaceEdges_, timeStride, sampleStride);
+
     // Set 2D settings from 3D settings
     ViewSettings view2DSettings = global()->activeView()->viewSettings();
     view2DSettings.setScreenRelative(false);
@@ -519,13 +552,13 @@ void View3D::drawSceneDelegate_(Time activeTime)
                 glColor4d(0.0, 0.0, 0.0, opacity);
                 item.cell->draw3D(viewSettings_);
             }
-            else if (item.cell->toInbetweenEdge()) {
+            else if (InbetweenEdge * ie = item.cell->toInbetweenEdge()) {
                 glColor4d(1.0, 0.5, 0.5, opacity);
                 if(drawAsMesh) {
                     glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
                     glLineWidth(2); // TODO: make this a view settings
                 }
-                item.cell->draw3D(viewSettings_);
+                surfaceCache_.draw(ie, t1, t2);
                 if(drawAsMesh) {
                     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
                     glLineWidth(1);
@@ -561,6 +594,29 @@ void View3D::drawSceneDelegate_(Time activeTime)
     //
     glDepthMask(true);
     glPopMatrix();
+
+    surfaceCache_.endFrame();
+}
+
+void View3D::surfaceStrides_(int & timeStride, int & sampleStride) const
+{
+    // Size of one OpenGL unit on screen, in pixels, at the distance of the
+    // camera to its focus point
+    double pixelsPerUnit = height() / (2.0 * camera_.r() * std::tan(camera_.fovy() / 2.0));
+
+    // Distance between rows and between columns of surfaces on screen,
+    // before level of detail is applied
+    double s = viewSettings_.spaceScale();
+    double rowSpacing = viewSettings_.timeScale() / viewSettings_.k1() * pixelsPerUnit;
+    double colSpacing = SURFACE_SAMPLE_SPACING * viewSettings_.k2() * s * pixelsPerUnit;
+
+    // Skip rows and columns by powers of two as long as they're too close
+    timeStride = 1;
+    while (timeStride < MAX_SURFACE_STRIDE && timeStride * rowSpacing < MIN_SURFACE_SPACING)
+        timeStride *= 2;
+    sampleStride = 1;
+    while (sampleStride < MAX_SURFACE_STRIDE && sampleStride * colSpacing < MIN_SURFACE_SPACING)
+        sampleStride *= 2;
 }
 
 
@@ -1027,54 +1083,13 @@ QImage View3D::drawToImage(Time t, int IMG_SIZE_X, int IMG_SIZE_Y)
 
 bool View3D::exportMesh(QString filename)
 {
-    using namespace VectorAnimationComplex;
-
-    QFile file(filename);
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
-        return false;
-
     // Get VAC
-    VAC * vac = scene_->activeVAC();
+    VectorAnimationComplex::VAC * vac = scene_->activeVAC();
     if (!vac) {
         return false;
     }
 
-    // Get mesh geometry
-    QList<Eigen::Vector3d> positions;
-    QList<Eigen::Vector3d> normals;
-    QList<int> indices;
-    const ZOrderedCells & cells = vac->zOrdering();
-    for(auto it = cells.cbegin(); it != cells.cend(); ++it)
-    {
-        if (InbetweenEdge * ie = (*it)->toInbetweenEdge()) {
-            ie->getMesh(viewSettings_, positions, normals, indices);
-        }
-    }
-
-    // Write to file.
-    double s = viewSettings_.spaceScale();
-    QTextStream out(&file);
-    out.setLocale(QLocale::c());
-    out.setRealNumberNotation(QTextStream::FixedNotation);
-    out.setRealNumberPrecision(6);
-    for (Eigen::Vector3d& p : positions) {
-        out << "v " << s * p[0] << " " << s * p[1] << " " << s * p[2] << "\n";
-    }
-    for (Eigen::Vector3d p : normals) {
-        p.normalize();
-        out << "vn " << p[0] << " " << p[1] << " " << p[2] << "\n";
-    }
-    for (int i = 3; i < indices.size(); i += 4) {
-        int k1 = indices[i-3];
-        int k2 = indices[i-2];
-        int k3 = indices[i-1];
-        int k4 = indices[i];
-        out << "f "
-            << k1 << "//" << k1 << " "
-            << k2 << "//" << k2 << " "
-            << k3 << "//" << k3 << " "
-            << k4 << "//" << k4 << "\n";
-    }
-
-    return true;
+    MeshWriter writer(MeshWriter::formatFromFilePath(filename),
+                      viewSettings_.exportMeshIndexed());
+    return writer.write(vac, viewSettings_, filename);
 }
@@ -24,10 +24,12 @@
 #include <QList>
 #include <QPoint>
 #include <QPointF>
+#include <QVector>
 
 #include "GLWidget.h"
 #include "GeometryUtils.h"
 #include "Picking.h"
+#include "SpaceTimeSurfaceCache.h"
 #include "View3DSettings.h"
 
 // pre-declarations
@@ -155,6 +157,11 @@ struct MouseEvent
         Time t2;
     };
     std::vector<DrawItem> drawItems_;
+
+    // Vertex and index buffers of the space-time surfaces of inbetween edges
+    SpaceTimeSurfaceCache surfaceCache_;
+    QVector<VectorAnimationComplex::InbetweenEdge *> surfaceEdges_;
+    void surfaceStrides_(int & timeStride, int & sampleStride) const;
 };
 
 #endif
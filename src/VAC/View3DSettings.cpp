@@ -53,7 +53,8 @@ View3DSettings::View3DSettings() :
     pngWidth_(1920),
     pngHeight_(1080),
     exportSequence_(false),
-    exportSubframes_(1)
+    exportSubframes_(1),
+    exportMeshIndexed_(true)
 {
 }
 
@@ -302,6 +303,16 @@ void View3DSettings::setExportSubframes(int newValue)
     exportSubframes_ = newValue;
 }
 
+bool View3DSettings::exportMeshIndexed() const
+{
+    return exportMeshIndexed_;
+}
+
+void View3DSettings::setExportMeshIndexed(bool newValue)
+{
+    exportMeshIndexed_ = newValue;
+}
+
 double View3DSettings::xFromX2D(double xScene) const
 {
     return xScene;
@@ -453,7 +464,9 @@ View3DSettingsWidget::View3DSettingsWidget() :
     meshLayout->addRow("Temporal resolution:", k1_);
     meshLayout->addRow("Inverse spatial resolution:", k2_);
     frames3dLayout->addLayout(meshLayout);
-    exportMeshButton_ = new QPushButton("Export as OBJ...");
+    exportMeshIndexed_ = new QCheckBox("Export with shared vertices");
+    frames3dLayout->addWidget(exportMeshIndexed_);
+    exportMeshButton_ = new QPushButton("Export mesh...");
     exportMeshButton_->setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
     exportMeshButton_->setMinimumWidth(110);
     frames3dLayout->addWidget(exportMeshButton_);
@@ -523,6 +536,7 @@ View3DSettingsWidget::View3DSettingsWidget() :
     connect(pngHeight_, SIGNAL(valueChanged(int)), this, SLOT(updateSettingsFromWidget()));
     connect(exportSequence_, SIGNAL(stateChanged(int)), this, SLOT(updateSettingsFromWidget()));
     connect(exportSubframes_, SIGNAL(valueChanged(int)), this, SLOT(updateSettingsFromWidget()));
+    connect(exportMeshIndexed_, SIGNAL(stateChanged(int)), this, SLOT(updateSettingsFromWidget()));
 
     connect(exportMeshButton_, SIGNAL(clicked()), this, SLOT(onExportMeshButtonClicked()));
     connect(exportBrowseButton_, SIGNAL(clicked()), this, SLOT(onExportBrowseButtonClicked()));
@@ -590,6 +604,7 @@ void View3DSettingsWidget::updateWidgetFromSettings()
         pngHeight_->setValue(viewSettings_->pngHeight());
         exportSequence_->setChecked(viewSettings_->exportSequence());
         exportSubframes_->setValue(viewSettings_->exportSubframes());
+        exportMeshIndexed_->setChecked(viewSettings_->exportMeshIndexed());
     }
 
     isUpdatingWidgetFromSettings_ = false;
@@ -625,6 +640,7 @@ void View3DSettingsWidget::updateSettingsFromWidget()
         viewSettings_->setPngHeight(pngHeight_->value());
         viewSettings_->setExportSequence(exportSequence_->isChecked());
         viewSettings_->setExportSubframes(exportSubframes_->value());
+        viewSettings_->setExportMeshIndexed(exportMeshIndexed_->isChecked());
 
         emit changed();
     }
@@ -640,15 +656,27 @@ void View3DSettingsWidget::onExportMeshButtonClicked()
         initialDirOrFile = exportMeshFilename_;
     }
 
-    QString selectedFilter = tr("Wavefront OBJ (*.obj)");
-    QString filters = tr("All files (*)") + ";;" + selectedFilter;
+    QString objFilter = tr("Wavefront OBJ (*.obj)");
+    QString plyFilter = tr("Stanford PLY, binary (*.ply)");
+    QString glbFilter = tr("glTF, binary (*.glb)");
+    QString selectedFilter = objFilter;
+    QString filters = tr("All files (*)") + ";;" + objFilter + ";;" + plyFilter + ";;" + glbFilter;
     QString filename = QFileDialog::getSaveFileName(
-                this, tr("Export OBJ filename"), initialDirOrFile,
+                this, tr("Export mesh filename"), initialDirOrFile,
                 filters, &selectedFilter);
 
     if (!filename.isEmpty()) {
-        if(!filename.endsWith(".obj")) {
-            filename.append(".obj");
+        QString suffix = QFileInfo(filename).suffix().toLower();
+        if (suffix != "obj" && suffix != "ply" && suffix != "glb") {
+            if (selectedFilter == plyFilter) {
+                filename.append(".ply");
+            }
+            else if (selectedFilter == glbFilter) {
+                filename.append(".glb");
+            }
+            else {
+                filename.append(".obj");
+            }
         }
         exportMeshFilename_ = filename;
         emit exportMeshClicked();
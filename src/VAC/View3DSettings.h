@@ -99,6 +99,8 @@ public:
     void setExportSequence(bool newValue);
     int exportSubframes() const;
     void setExportSubframes(int newValue);
+    bool exportMeshIndexed() const;
+    void setExportMeshIndexed(bool newValue);
 
     // Convert 2D scene coordinate and time to 3D coordinates for View3D
     // XXX Refactor in one method:
@@ -155,6 +157,7 @@ private:
     int pngHeight_;
     bool exportSequence_;
     int exportSubframes_;
+    bool exportMeshIndexed_;
 
     // Scene settings
     double xSceneMin_, xSceneMax_, ySceneMin_, ySceneMax_;
@@ -222,6 +225,7 @@ private:
     QCheckBox * drawAsMesh_;
     QSpinBox * k1_;
     QSpinBox * k2_;
+    QCheckBox * exportMeshIndexed_;
     QString exportMeshFilename_;
     QPushButton * exportMeshButton_;
 
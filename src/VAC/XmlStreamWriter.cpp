@@ -16,12 +16,176 @@
 
 #include "XmlStreamWriter.h"
 
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+
+// Raw attribute values are written to the device by chunks of this size
+const int RAW_CHUNK_SIZE = 1 << 16;
+
+// Splits a into hi + lo, each with at most 26 significant bits (Veltkamp)
+void split_(double a, double & hi, double & lo)
+{
+    const double c = 134217729.0 * a; // 2^27 + 1
+    hi = c - (c - a);
+    lo = a - hi;
+}
+
+// Computes p and e such that p + e == a * b exactly (Dekker), assuming no
+// overflow or underflow
+void twoProduct_(double a, double b, double & p, double & e)
+{
+    p = a * b;
+    double ah, al, bh, bl;
+    split_(a, ah, al);
+    split_(b, bh, bl);
+    e = ((ah * bh - p) + ah * bl + al * bh) + al * bl;
+}
+
+// Writes x to out like QString::setNum(x, 'g', 15), i.e., rounded to 15
+// significant digits, without trailing zeros, and in fixed notation if its
+// decimal exponent is in [-4, 14]. Returns the number of characters
+// written, or 0 if x is not in this common case (negative zero,
+// non-finite, very small or very large, or halfway between two 15-digit
+// decimals), which is left to Qt.
+//
+// The rounding is exact: x is scaled by a power of ten with an error-free
+// product, so the 15-digit integer nearest to the scaled value is known,
+// unless it is a tie.
+int formatDouble_(double x, char * out)
+{
+    static const double POW10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,
+        1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18 };
+    const int NUM_DIGITS = 15;
+    const int MIN_EXPONENT = -4;
+    const int MAX_EXPONENT = NUM_DIGITS - 1;
+
+    if(x == 0 && !std::signbit(x))
+    {
+        *out = '0';
+        return 1;
+    }
+    if(x == 0 || !std::isfinite(x))
+        return 0;
+    const double a = std::abs(x);
+    if(!(a >= 1e-5 && a < 1e15))
+        return 0;
+
+    // Find the decimal exponent e, and the 15-digit integer r nearest to
+    // a * 10^(14-e). The estimate of e may be off by one near powers of ten.
+    int e = (int) std::floor(std::log10(a));
+    qint64 r = 0;
+    for(int attempt=0; attempt<3; ++attempt)
+    {
+        const int k = MAX_EXPONENT - e;
+        if(k < 0 || k > 18)
+            return 0;
+
+        // Check the estimate of e, i.e. that 10^14 <= p + err < 10^15
+        double p, err;
+        twoProduct_(a, POW10[k], p, err);
+        if(p < POW10[NUM_DIGITS-1] || (p == POW10[NUM_DIGITS-1] && err < 0))
+        {
+            --e;
+            continue;
+        }
+        if(p > POW10[NUM_DIGITS] || (p == POW10[NUM_DIGITS] && err >= 0))
+        {
+            ++e;
+            continue;
+        }
+
+        // Round p + err to the nearest integer. Since |err| is at most half
+        // the spacing of doubles around p, only an exact half needs err.
+        double res = std::floor(p);
+        const double frac = p - res; // exact
+        if(frac > 0.5 || (frac == 0.5 && err > 0))
+            res += 1;
+        else if(frac == 0.5 && err == 0)
+            return 0; // tie
+
+        // Rounding up may give 10^15, e.g. for 9.999999999999999
+        if(res == POW10[NUM_DIGITS])
+        {
+            res = POW10[NUM_DIGITS-1];
+            ++e;
+        }
+        r = (qint64) res;
+        break;
+    }
+    if(r == 0 || e < MIN_EXPONENT || e > MAX_EXPONENT)
+        return 0;
+
+    // Digits, without trailing zeros
+    char digits[NUM_DIGITS];
+    for(int i=NUM_DIGITS-1; i>=0; --i)
+    {
+        digits[i] = '0' + (r % 10);
+        r /= 10;
+    }
+    int numDigits = NUM_DIGITS;
+    while(numDigits > 1 && digits[numDigits-1] == '0')
+        --numDigits;
+
+    // Fixed notation
+    char * c = out;
+    if(x < 0)
+        *c++ = '-';
+    if(e >= 0)
+    {
+        for(int i=0; i<=e; ++i)
+            *c++ = (i < numDigits) ? digits[i] : '0';
+        if(numDigits > e+1)
+        {
+            *c++ = '.';
+            for(int i=e+1; i<numDigits; ++i)
+                *c++ = digits[i];
+        }
+    }
+    else
+    {
+        *c++ = '0';
+        *c++ = '.';
+        for(int i=-1; i>e; --i)
+            *c++ = '0';
+        for(int i=0; i<numDigits; ++i)
+            *c++ = digits[i];
+    }
+    return c - out;
+}
+
+// Returns whether the attribute value has newlines to indent or characters
+// to escape
+bool needsCleaning_(const QString & value)
+{
+    const QChar * c = value.constData();
+    const QChar * end = c + value.size();
+    for (; c != end; ++c)
+    {
+        const ushort u = c->unicode();
+        if (u == '\n' || u == '<' || u == '>' || u == '&' ||
+            u == '"' || u == '\r' || u == '\t')
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+}
+
 XmlStreamWriter::XmlStreamWriter(QIODevice * device) :
     QXmlStreamWriter(device),
     indentLevel_(0)
 {
     setAutoFormatting(true);
     setAutoFormattingIndent(2);
+
+    // Reserving makes the capacity kept when resizing to zero
+    rawBuffer_.reserve(RAW_CHUNK_SIZE + 64);
 }
 
 XmlStreamWriter::~XmlStreamWriter()
@@ -80,34 +244,99 @@ void XmlStreamWriter::writeAttribute(const QString & qualifiedName, const QStrin
     //     attr3="value3"/>
     //
 
-    // Compute indent
-    const QChar space(' ');
-    const int numSpaces = indentLevel_*autoFormattingIndent();
-    QString indent("\n");
-    for(int i=0; i<numSpaces; ++i)
-        indent += space;
-
     // Write attribute name
-    write(indent);
+    writeAttributeIndent_();
     write(qualifiedName);
+    write("=\"");
 
-    // Compute indent for attribute value newlines
-    for(int i=0; i<qualifiedName.length()+2; ++i)
-        indent += space;
-
-    // Replace newlines in attribute value by indented new lines
-    QString cleanedValue = value;
-    cleanedValue.replace('\n', indent);
+    // Replace newlines in attribute value by indented new lines, and escape
+    // special characters except newlines. Most values have none of these.
+    if (needsCleaning_(value))
+    {
+        // Compute indent for attribute value newlines
+        const QChar space(' ');
+        const int numSpaces = indentLevel_*autoFormattingIndent() + qualifiedName.length() + 2;
+        QString indent("\n");
+        for(int i=0; i<numSpaces; ++i)
+            indent += space;
 
-    // Escape special characters except newlines
-    cleanedValue = escapedExceptNewlines(cleanedValue);
+        QString cleanedValue = value;
+        cleanedValue.replace('\n', indent);
+        cleanedValue = escapedExceptNewlines(cleanedValue);
+        write(cleanedValue);
+    }
+    else
+    {
+        write(value);
+    }
 
-    // Write attribute value
-    write("=\"");
-    write(cleanedValue);
+    // Write attribute value end
     write("\"");
 }
 
+void XmlStreamWriter::writeAttributeIndent_()
+{
+    const int numSpaces = indentLevel_*autoFormattingIndent();
+    char indent[256];
+    if (numSpaces < (int)sizeof(indent))
+    {
+        indent[0] = '\n';
+        std::memset(indent + 1, ' ', numSpaces);
+        device()->write(indent, numSpaces + 1);
+    }
+    else
+    {
+        device()->write(QByteArray(1, '\n') + QByteArray(numSpaces, ' '));
+    }
+}
+
+void XmlStreamWriter::beginRawAttribute(const char * qualifiedName)
+{
+    writeAttributeIndent_();
+    rawBuffer_.resize(0);
+    rawBuffer_.append(qualifiedName);
+    rawBuffer_.append("=\"");
+}
+
+void XmlStreamWriter::appendRaw(const char * s)
+{
+    rawBuffer_.append(s);
+    if (rawBuffer_.size() >= RAW_CHUNK_SIZE)
+        flushRawBuffer_();
+}
+
+void XmlStreamWriter::appendRaw(char c)
+{
+    rawBuffer_.append(c);
+    if (rawBuffer_.size() >= RAW_CHUNK_SIZE)
+        flushRawBuffer_();
+}
+
+void XmlStreamWriter::appendDouble(double x)
+{
+    char s[32];
+    const int n = formatDouble_(x, s);
+    if (n > 0)
+        rawBuffer_.append(s, n);
+    else
+        rawBuffer_.append(QByteArray::number(x, 'g', 15));
+
+    if (rawBuffer_.size() >= RAW_CHUNK_SIZE)
+        flushRawBuffer_();
+}
+
+void XmlStreamWriter::endRawAttribute()
+{
+    rawBuffer_.append('"');
+    flushRawBuffer_();
+}
+
+void XmlStreamWriter::flushRawBuffer_()
+{
+    device()->write(rawBuffer_);
+    rawBuffer_.resize(0);
+}
+
 // Escape special characters
 QString XmlStreamWriter::escaped(const QString & s)
 {
@@ -71,9 +71,37 @@ public:
     void writeAttribute(const QXmlStreamAttribute & attribute);
     void writeAttributes(const QXmlStreamAttributes & attributes);
 
+    // Writes an attribute whose value is appended piece by piece, directly
+    // as UTF-8 into a buffer reused across attributes, and streamed to the
+    // device by chunks. This is meant for large numeric values, which would
+    // otherwise be built as a QString, then copied several times:
+    //
+    //     xml.beginRawAttribute("curve");
+    //     xml.appendRaw("xywdense(");
+    //     xml.appendDouble(ds);
+    //     ...
+    //     xml.appendRaw(')');
+    //     xml.endRawAttribute();
+    //
+    // The value is not escaped, therefore it must not contain newlines nor
+    // characters to escape. Doubles are written exactly like with
+    // QString::setNum(x, 'g', 15).
+    void beginRawAttribute(const char * qualifiedName);
+    void appendRaw(const char * s);
+    void appendRaw(char c);
+    void appendDouble(double x);
+    void endRawAttribute();
+
 private:
     int indentLevel_;
 
+    // Buffer of raw attribute values
+    QByteArray rawBuffer_;
+    void flushRawBuffer_();
+
+    // Writes indent for an attribute at current indent level
+    void writeAttributeIndent_();
+
     // Raw-write to device, without escaping XML characters
     void write(const QString & string) const;
 